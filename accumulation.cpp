@@ -0,0 +1,192 @@
+//
+// Concurrent accumulation into a matrix: sharded buffers and batched scatter-add.
+//
+
+#include "accumulation.h"
+#include "parallel.h"
+#include <algorithm>
+
+
+/*
+ * Shards
+ */
+
+template<typename T>
+ShardedAccumulator<T>::Shard::Shard(int rows, int cols, bool shared)
+    : blocks_(new std::atomic<T*>[(rows + ACCUMULATION_BLOCK_ROWS - 1) / ACCUMULATION_BLOCK_ROWS]()),
+      rows_(rows), cols_(cols), shared_(shared) {}
+
+// First touch of block b, several threads of a shared shard may race to allocate it
+template<typename T>
+T* ShardedAccumulator<T>::Shard::allocate(int b) {
+    const int rows = std::min(ACCUMULATION_BLOCK_ROWS, rows_ - b * ACCUMULATION_BLOCK_ROWS);
+    T* block = new T[static_cast<std::size_t>(rows) * cols_]();
+    T* expected = nullptr;
+    if (!blocks_[b].compare_exchange_strong(expected, block, std::memory_order_acq_rel)) {
+        delete[] block;
+        return expected;
+    }
+    return block;
+}
+
+template<typename T>
+void ShardedAccumulator<T>::Shard::release() {
+    const int blocks = (rows_ + ACCUMULATION_BLOCK_ROWS - 1) / ACCUMULATION_BLOCK_ROWS;
+    for (int b = 0; b < blocks; b++) {
+        delete[] blocks_[b].exchange(nullptr);
+    }
+}
+
+template<typename T>
+ShardedAccumulator<T>::ShardedAccumulator(int rows, int cols, int threads, int maxShards)
+    : height_(rows), width_(cols), threads_(threads) {
+    if (rows < 0 || cols < 0 || threads <= 0 || maxShards <= 0)
+        throw std::invalid_argument("Dimensions must be positive.");
+    const int count = std::min(threads, maxShards);
+    shards_.reserve(count);
+    for (int s = 0; s < count; s++) {
+        // A shard used by several threads adds atomically
+        const int users = threads / count + (s < threads % count ? 1 : 0);
+        shards_.push_back(Shard(rows, cols, users > 1));
+    }
+}
+
+template<typename T>
+ShardedAccumulator<T>::~ShardedAccumulator() {
+    for (Shard& s : shards_) {
+        s.release();
+    }
+}
+
+template<typename T>
+typename ShardedAccumulator<T>::Shard& ShardedAccumulator<T>::shard(int thread) {
+    if (thread < 0 || thread >= threads_)
+        throw std::out_of_range("Thread index out of bounds.");
+    return shards_[thread % shards_.size()];
+}
+
+template<typename T>
+std::size_t ShardedAccumulator<T>::allocatedBlocks() const {
+    std::size_t count = 0;
+    for (const Shard& s : shards_) {
+        for (int b = 0; b < blockCount(); b++) {
+            count += s.blocks_[b].load(std::memory_order_relaxed) != nullptr;
+        }
+    }
+    return count;
+}
+
+
+/*
+ * Tree merge
+ * Level by level, every (shard s, shard s + stride) pair of every block is
+ * an independent task. Summing pairwise keeps the floating point error in
+ * O(log shards) instead of O(shards).
+ */
+template<typename T>
+Matrix<T> ShardedAccumulator<T>::merge() {
+    const int shards = shardCount();
+    const int blocks = blockCount();
+    for (int stride = 1; stride < shards; stride *= 2) {
+        const int pairs = (shards - stride + 2 * stride - 1) / (2 * stride);
+        const int tasks = pairs * blocks;
+        long work = static_cast<long>(tasks) * ACCUMULATION_BLOCK_ROWS * width_;
+        #pragma omp parallel for schedule(dynamic) if(work > PARALLEL_THRESHOLD)
+        for (int t = 0; t < tasks; t++) {
+            const int b = t % blocks;
+            const int target = t / blocks * 2 * stride;
+            std::atomic<T*>& into = shards_[target].blocks_[b];
+            std::atomic<T*>& from = shards_[target + stride].blocks_[b];
+            T* source = from.exchange(nullptr, std::memory_order_relaxed);
+            if (source == nullptr) {
+                continue;
+            }
+            T* destination = into.load(std::memory_order_relaxed);
+            if (destination == nullptr) {
+                into.store(source, std::memory_order_relaxed);
+                continue;
+            }
+            const std::size_t n = static_cast<std::size_t>(
+                std::min(ACCUMULATION_BLOCK_ROWS, height_ - b * ACCUMULATION_BLOCK_ROWS)) * width_;
+            for (std::size_t x = 0; x < n; x++) {
+                destination[x] += source[x];
+            }
+            delete[] source;
+        }
+    }
+
+    Matrix<T> result(height_, width_);
+    if (shards > 0) {
+        long work = static_cast<long>(height_) * width_;
+        #pragma omp parallel for schedule(static) if(work > PARALLEL_THRESHOLD)
+        for (int b = 0; b < blocks; b++) {
+            T* block = shards_[0].blocks_[b].exchange(nullptr, std::memory_order_relaxed);
+            if (block == nullptr) {
+                continue;
+            }
+            const int first = b * ACCUMULATION_BLOCK_ROWS;
+            const int last = std::min(first + ACCUMULATION_BLOCK_ROWS, height_);
+            for (int i = first; i < last; i++) {
+                const T* row = block + static_cast<std::size_t>(i - first) * width_;
+                std::copy(row, row + width_, result(i).data());
+            }
+            delete[] block;
+        }
+    }
+    return result;
+}
+
+
+/*
+ * Batched scatter-add
+ * A counting sort groups the updates by row, in O(n). Each row is then
+ * updated by a single thread, without atomics: the duplicates of a row are
+ * summed in place while the row is in cache.
+ */
+template<typename T>
+void scatterAdd(Matrix<T>& m, const std::vector<int>& rows, const std::vector<int>& cols, const std::vector<T>& values) {
+    if (rows.size() != cols.size() || rows.size() != values.size())
+        throw std::invalid_argument("Rows, columns and values must have the same size.");
+    MATRIX_PROFILE(Compound, m.getHeight(), m.getWidth(), static_cast<long>(values.size()), 0);
+    const long n = static_cast<long>(values.size());
+    const int height = m.getHeight();
+    const int width = m.getWidth();
+    std::vector<long> offsets(height + 1, 0);
+    for (long k = 0; k < n; k++) {
+        if (rows[k] < 0 || rows[k] >= height || cols[k] < 0 || cols[k] >= width)
+            throw std::out_of_range("Index out of bounds.");
+        offsets[rows[k] + 1]++;
+    }
+    for (int i = 0; i < height; i++) {
+        offsets[i + 1] += offsets[i];
+    }
+    std::vector<std::pair<int, T>> sorted(n);
+    std::vector<long> next(offsets.begin(), offsets.end() - 1);
+    for (long k = 0; k < n; k++) {
+        sorted[next[rows[k]]++] = std::make_pair(cols[k], values[k]);
+    }
+
+    // Every row is written by one thread (see Matrix::detach)
+    m.detach();
+    #pragma omp parallel for schedule(dynamic, 16) if(n > PARALLEL_THRESHOLD)
+    for (int i = 0; i < height; i++) {
+        if (offsets[i] == offsets[i + 1]) {
+            continue;
+        }
+        T* row = m(i).data();
+        for (long p = offsets[i]; p < offsets[i + 1]; p++) {
+            row[sorted[p].first] += sorted[p].second;
+        }
+    }
+}
+
+
+// Explicit instantiation
+#define ACCUMULATION_INSTANTIATE(T) \
+    template class ShardedAccumulator<T>; \
+    template void scatterAdd<T>(Matrix<T>& m, const std::vector<int>& rows, const std::vector<int>& cols, \
+                                const std::vector<T>& values);
+
+ACCUMULATION_INSTANTIATE(int)
+ACCUMULATION_INSTANTIATE(float)
+ACCUMULATION_INSTANTIATE(double)
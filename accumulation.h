@@ -0,0 +1,109 @@
+//
+// Concurrent accumulation into a matrix: sharded buffers and batched scatter-add.
+//
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "matrix.h"
+
+#ifndef ACCUMULATION_H
+#define ACCUMULATION_H
+
+
+// Rows of the blocks a shard allocates on first use
+constexpr int ACCUMULATION_BLOCK_ROWS = 64;
+// Default number of shards above which threads share shards
+constexpr int DEFAULT_MAX_SHARDS = 16;
+
+/*
+ * Three ways to accumulate into a matrix from several threads:
+ *
+ * Matrix::accumulate(h, w, v) adds atomically to the matrix itself: no
+ * extra memory, but every update is an atomic read-modify-write and
+ * threads hitting the same cache lines contend. Fits sparse updates. A
+ * matrix whose rows are shared with a copy must be detached first.
+ *
+ * ShardedAccumulator gives every thread a shard: a private copy of the
+ * matrix allocated by blocks of ACCUMULATION_BLOCK_ROWS rows on first
+ * touch, so a thread only pays for the rows it updates. Shards are capped
+ * at maxShards: with more threads, thread t uses shard t % maxShards and
+ * adds atomically, the contention is divided by the number of shards.
+ * Memory stays below maxShards copies of the touched blocks. merge()
+ * sums the shards in a parallel tree: at each level shard s receives
+ * shard s + stride block by block, a block missing in one of them is
+ * moved instead of added.
+ *
+ * scatterAdd(m, rows, cols, values) applies a batch of updates: a
+ * counting sort groups them by row, then every row is updated by one
+ * thread without atomics, its duplicates summed while it is in cache.
+ */
+
+template<typename T>
+class ShardedAccumulator {
+public:
+    class Shard {
+    public:
+        // m(h, w) += value, h and w are not checked (like Matrix::operator())
+        inline void add(int h, int w, T value) {
+            const int b = h / ACCUMULATION_BLOCK_ROWS;
+            T* block = blocks_[b].load(std::memory_order_acquire);
+            if (block == nullptr) {
+                block = allocate(b);
+            }
+            T* x = block + static_cast<std::size_t>(h % ACCUMULATION_BLOCK_ROWS) * cols_ + w;
+            if (shared_) {
+                atomicAdd(x, value);
+            }
+            else {
+                *x += value;
+            }
+        }
+
+    private:
+        friend class ShardedAccumulator<T>;
+        Shard(int rows, int cols, bool shared);
+        T* allocate(int b);
+        void release();
+
+        std::unique_ptr<std::atomic<T*>[]> blocks_;
+        int rows_;
+        int cols_;
+        bool shared_;
+    };
+
+    // threads: number of threads calling shard(), ids 0 to threads - 1
+    ShardedAccumulator(int rows, int cols, int threads, int maxShards=DEFAULT_MAX_SHARDS);
+    ShardedAccumulator(const ShardedAccumulator<T>&) = delete;
+    ShardedAccumulator<T>& operator=(const ShardedAccumulator<T>&) = delete;
+    ~ShardedAccumulator();
+
+    // The shard of a thread, thread in [0, threads)
+    Shard& shard(int thread);
+
+    // Inline getters
+    [[nodiscard]] inline int getHeight() const { return height_; }
+    [[nodiscard]] inline int getWidth() const { return width_; }
+    [[nodiscard]] inline int shardCount() const { return static_cast<int>(shards_.size()); }
+    // Blocks currently allocated over all the shards
+    [[nodiscard]] std::size_t allocatedBlocks() const;
+
+    // Sum of all the updates, the shards are emptied. Not concurrent with add.
+    Matrix<T> merge();
+
+private:
+    inline int blockCount() const { return (height_ + ACCUMULATION_BLOCK_ROWS - 1) / ACCUMULATION_BLOCK_ROWS; }
+
+    std::vector<Shard> shards_;
+    int height_;
+    int width_;
+    int threads_;
+};
+
+// m(rows[k], cols[k]) += values[k] for every k
+template<typename T>
+void scatterAdd(Matrix<T>& m, const std::vector<int>& rows, const std::vector<int>& cols, const std::vector<T>& values);
+
+
+#endif // ACCUMULATION_H
@@ -0,0 +1,44 @@
+//
+// Lock-free atomic addition on plain elements, for concurrent accumulation.
+//
+
+#include <type_traits>
+
+#include "half.h"
+
+#ifndef ATOMIC_ADD_H
+#define ATOMIC_ADD_H
+
+/*
+ * *address += value, atomically (relaxed ordering)
+ * Integers use a single fetch-add. Other types (float, double, half) have
+ * no atomic add instruction: the sum is retried with a compare-exchange on
+ * the bits of the element until no other thread wrote it in between.
+ * Complex elements add their two components one after the other: each
+ * one is atomic, a reader may see one added before the other.
+ * The GCC builtins act on plain memory, the elements of a Matrix need not
+ * be std::atomic.
+ */
+template<typename T>
+inline void atomicAdd(T* address, T value) {
+    if constexpr (std::is_integral<T>::value) {
+        __atomic_fetch_add(address, value, __ATOMIC_RELAXED);
+    }
+    else if constexpr (IsComplex<T>::value) {
+        // std::complex is laid out as an array of its two components
+        auto* parts = reinterpret_cast<typename T::value_type*>(address);
+        atomicAdd(parts, value.real());
+        atomicAdd(parts + 1, value.imag());
+    }
+    else {
+        T expected;
+        __atomic_load(address, &expected, __ATOMIC_RELAXED);
+        T desired = static_cast<T>(expected + value);
+        while (!__atomic_compare_exchange(address, &expected, &desired, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            desired = static_cast<T>(expected + value);
+        }
+    }
+}
+
+
+#endif // ATOMIC_ADD_H
@@ -0,0 +1,304 @@
+//
+// In-place balancing of symmetric matrices (ICE and Knight-Ruiz).
+//
+
+#include "balancing.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+/*
+ * Masking shared by both algorithms
+ * Zeroes the ignored diagonals, then the masked rows and columns, and
+ * returns the row sums of the result. Masking a column can empty a row, so
+ * the selection is repeated until no new bin is masked.
+ */
+template<typename T>
+static std::vector<double> prepare(Matrix<T>& m, const BalanceOptions& options, std::vector<bool>& masked) {
+    int n = m.getHeight();
+    if (m.getWidth() != n)
+        throw std::invalid_argument("Matrix must be square.");
+    if (!options.mask.empty() && static_cast<int>(options.mask.size()) != n)
+        throw std::invalid_argument("Mask size must be the same as the matrix size.");
+    // The rows are then modified from several threads (see Matrix::detach)
+    m.detach();
+
+    long work = static_cast<long>(n) * n;
+    std::vector<double> sums(n);
+    std::vector<int> nonZero(n);
+    #pragma omp parallel for schedule(static) if(work > PARALLEL_THRESHOLD)
+    for (int i = 0; i < n; i++) {
+        T* row = m(i).data();
+        if (options.ignoreDiagonals > 0) {
+            std::fill(row + std::max(0, i - options.ignoreDiagonals + 1),
+                      row + std::min(n, i + options.ignoreDiagonals), T(0));
+        }
+        sums[i] = static_cast<double>(reduceSum(row, n, Summation::Widened));
+        nonZero[i] = static_cast<int>(std::count_if(row, row + n, [](const T& x) { return x != T(0); }));
+    }
+
+    masked.assign(n, false);
+    std::vector<int> newlyMasked;
+    for (int i = 0; i < n; i++) {
+        if ((!options.mask.empty() && options.mask[i]) || sums[i] <= 0 ||
+            sums[i] < options.minCount || nonZero[i] < options.minNonZero) {
+            masked[i] = true;
+            newlyMasked.push_back(i);
+        }
+    }
+
+    while (!newlyMasked.empty()) {
+        #pragma omp parallel for schedule(static) if(work > PARALLEL_THRESHOLD)
+        for (int i = 0; i < n; i++) {
+            T* row = m(i).data();
+            if (masked[i]) {
+                std::fill(row, row + n, T(0));
+            } else {
+                for (int j : newlyMasked) {
+                    row[j] = T(0);
+                }
+            }
+            sums[i] = static_cast<double>(reduceSum(row, n, Summation::Widened));
+        }
+        newlyMasked.clear();
+        for (int i = 0; i < n; i++) {
+            if (!masked[i] && sums[i] <= 0) {
+                masked[i] = true;
+                newlyMasked.push_back(i);
+            }
+        }
+    }
+    return sums;
+}
+
+template<typename T>
+BalanceResult balanceICE(Matrix<T>& m, const BalanceOptions& options) {
+    int n = m.getHeight();
+    MATRIX_PROFILE(Balance, n, m.getWidth(), static_cast<long>(n) * m.getWidth(), 0);
+    BalanceResult result;
+    std::vector<double> sums = prepare(m, options, result.masked);
+    result.bias.assign(n, 1.0);
+
+    long work = static_cast<long>(n) * n;
+    std::vector<double> inverse(n, 1.0);
+    for (int iteration = 0; ; iteration++) {
+        double mean = 0;
+        int active = 0;
+        for (int i = 0; i < n; i++) {
+            if (!result.masked[i]) {
+                mean += sums[i];
+                active++;
+            }
+        }
+        if (active == 0) {
+            result.converged = true;
+            break;
+        }
+        mean /= active;
+
+        double residual = 0;
+        for (int i = 0; i < n; i++) {
+            if (!result.masked[i]) {
+                residual = std::max(residual, std::abs(sums[i] / mean - 1));
+            }
+        }
+        result.residuals.push_back(residual);
+        if (residual < options.tolerance) {
+            result.converged = true;
+            break;
+        }
+        if (iteration == options.maxIterations) {
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            if (!result.masked[i]) {
+                double scale = sums[i] / mean;
+                result.bias[i] *= scale;
+                inverse[i] = 1 / scale;
+            }
+        }
+
+        // Rescale every row and sum it while it is still in cache
+        #pragma omp parallel for schedule(static) if(work > PARALLEL_THRESHOLD)
+        for (int i = 0; i < n; i++) {
+            if (result.masked[i]) {
+                continue;
+            }
+            T* row = m(i).data();
+            const double rowScale = inverse[i];
+            for (int j = 0; j < n; j++) {
+                row[j] = static_cast<T>(row[j] * (rowScale * inverse[j]));
+            }
+            sums[i] = static_cast<double>(reduceSum(row, n, Summation::Widened));
+        }
+        result.iterations++;
+    }
+
+    for (int i = 0; i < n; i++) {
+        if (result.masked[i]) {
+            result.bias[i] = std::numeric_limits<double>::quiet_NaN();
+        }
+    }
+    return result;
+}
+
+// out = m x, computed in double whatever T is
+template<typename T>
+static void multiplyVector(const Matrix<T>& m, const std::vector<double>& x, std::vector<double>& out) {
+    int n = m.getHeight();
+    const double* xs = x.data();
+    #pragma omp parallel for schedule(static) if(static_cast<long>(n) * n > PARALLEL_THRESHOLD)
+    for (int i = 0; i < n; i++) {
+        const T* row = m(i).data();
+        out[i] = summation::naiveSum<double>(n, [row, xs](std::size_t j) { return static_cast<double>(row[j]) * xs[j]; });
+    }
+}
+
+static double innerProduct(const std::vector<double>& a, const std::vector<double>& b) {
+    return summation::naiveSum<double>(a.size(), [&](std::size_t i) { return a[i] * b[i]; });
+}
+
+template<typename T>
+BalanceResult balanceKR(Matrix<T>& m, const BalanceOptions& options) {
+    int n = m.getHeight();
+    MATRIX_PROFILE(Balance, n, m.getWidth(), static_cast<long>(n) * m.getWidth(), 0);
+    BalanceResult result;
+    prepare(m, options, result.masked);
+    int active = static_cast<int>(std::count(result.masked.begin(), result.masked.end(), false));
+
+    // Parameters of the reference implementation: the Newton step y stays
+    // in [delta, Delta], eta bounds the accuracy of the inner solve
+    const double delta = 0.1;
+    const double Delta = 3;
+    const double g = 0.9;
+    const double etaMax = 0.1;
+    const double stopTolerance = options.tolerance * 0.5;
+    const double rt = options.tolerance * options.tolerance;
+
+    // Masked bins keep x = 0, v = 1 and a zero residual, so they add nothing
+    // to the inner products and never limit the step
+    std::vector<double> x(n), v(n), rk(n), mx(n);
+    for (int i = 0; i < n; i++) {
+        x[i] = result.masked[i] ? 0 : 1;
+    }
+    auto updateResidual = [&]() {
+        multiplyVector(m, x, mx);
+        for (int i = 0; i < n; i++) {
+            v[i] = result.masked[i] ? 1 : x[i] * mx[i];
+            rk[i] = result.masked[i] ? 0 : 1 - v[i];
+        }
+        return innerProduct(rk, rk);
+    };
+
+    double rhoKm1 = updateResidual();
+    double rout = rhoKm1;
+    double rold = rout;
+    double eta = etaMax;
+    result.residuals.push_back(std::sqrt(rout));
+
+    std::vector<double> y(n), z(n), p(n), w(n), xp(n), ynew(n);
+    while (rout > rt && result.iterations < options.maxIterations) {
+        result.iterations++;
+        std::fill(y.begin(), y.end(), 1.0);
+        double innerTolerance = std::max(eta * eta * rout, rt);
+        double rhoKm2 = 0;
+
+        // Inner conjugate gradient on the Newton system
+        for (int k = 1; rhoKm1 > innerTolerance && k <= active; k++) {
+            if (k == 1) {
+                for (int i = 0; i < n; i++) {
+                    z[i] = rk[i] / v[i];
+                }
+                p = z;
+                rhoKm1 = innerProduct(rk, z);
+            } else {
+                double beta = rhoKm1 / rhoKm2;
+                for (int i = 0; i < n; i++) {
+                    p[i] = z[i] + beta * p[i];
+                }
+            }
+
+            for (int i = 0; i < n; i++) {
+                xp[i] = x[i] * p[i];
+            }
+            multiplyVector(m, xp, w);
+            for (int i = 0; i < n; i++) {
+                w[i] = x[i] * w[i] + v[i] * p[i];
+            }
+            double alpha = rhoKm1 / innerProduct(p, w);
+
+            // Stop at the boundary of [delta, Delta] if the step crosses it
+            double gamma = std::numeric_limits<double>::infinity();
+            bool lowBoundary = false;
+            bool highBoundary = false;
+            for (int i = 0; i < n; i++) {
+                ynew[i] = y[i] + alpha * p[i];
+                lowBoundary |= ynew[i] <= delta;
+                highBoundary |= ynew[i] >= Delta;
+            }
+            if (lowBoundary || highBoundary) {
+                for (int i = 0; i < n; i++) {
+                    double ap = alpha * p[i];
+                    if (lowBoundary && ap < 0) {
+                        gamma = std::min(gamma, (delta - y[i]) / ap);
+                    } else if (!lowBoundary && ynew[i] >= Delta) {
+                        gamma = std::min(gamma, (Delta - y[i]) / ap);
+                    }
+                }
+                for (int i = 0; i < n; i++) {
+                    y[i] += gamma * alpha * p[i];
+                }
+                break;
+            }
+            y.swap(ynew);
+
+            for (int i = 0; i < n; i++) {
+                rk[i] -= alpha * w[i];
+                z[i] = rk[i] / v[i];
+            }
+            rhoKm2 = rhoKm1;
+            rhoKm1 = innerProduct(rk, z);
+        }
+
+        for (int i = 0; i < n; i++) {
+            x[i] *= y[i];
+        }
+        rhoKm1 = updateResidual();
+        rout = rhoKm1;
+        result.residuals.push_back(std::sqrt(rout));
+
+        double ratio = rout / rold;
+        rold = rout;
+        double etaOld = eta;
+        eta = g * ratio;
+        if (g * etaOld * etaOld > 0.1) {
+            eta = std::max(eta, g * etaOld * etaOld);
+        }
+        eta = std::max(std::min(eta, etaMax), stopTolerance / std::sqrt(rout));
+    }
+    result.converged = rout <= rt;
+
+    #pragma omp parallel for schedule(static) if(static_cast<long>(n) * n > PARALLEL_THRESHOLD)
+    for (int i = 0; i < n; i++) {
+        T* row = m(i).data();
+        const double rowScale = x[i];
+        for (int j = 0; j < n; j++) {
+            row[j] = static_cast<T>(row[j] * (rowScale * x[j]));
+        }
+    }
+
+    result.bias.resize(n);
+    for (int i = 0; i < n; i++) {
+        result.bias[i] = result.masked[i] ? std::numeric_limits<double>::quiet_NaN() : 1 / x[i];
+    }
+    return result;
+}
+
+
+// Explicit instantiation (in-place balancing needs a floating point type)
+template BalanceResult balanceICE(Matrix<float>& m, const BalanceOptions& options);
+template BalanceResult balanceICE(Matrix<double>& m, const BalanceOptions& options);
+template BalanceResult balanceKR(Matrix<float>& m, const BalanceOptions& options);
+template BalanceResult balanceKR(Matrix<double>& m, const BalanceOptions& options);
@@ -0,0 +1,64 @@
+//
+// In-place balancing of symmetric matrices (ICE and Knight-Ruiz).
+//
+
+#include <vector>
+
+#include "matrix.h"
+
+#ifndef BALANCING_H
+#define BALANCING_H
+
+
+/*
+ * Balancing options
+ * Bins (rows and the matching columns) can be masked before balancing: they
+ * are set to zero and excluded from the normalization. A bin whose sum is
+ * zero is always masked.
+ */
+struct BalanceOptions {
+    int maxIterations = 200;
+    double tolerance = 1e-5;
+    int ignoreDiagonals = 0;           // zero the diagonals |i - j| < ignoreDiagonals first
+    double minCount = 0;               // mask the bins whose sum is below this value
+    int minNonZero = 0;                // mask the bins with fewer non-zero elements
+    std::vector<bool> mask;            // bins masked by the caller (empty: none)
+};
+
+/*
+ * Balancing result
+ * The balanced matrix is raw(i, j) / (bias[i] * bias[j]). The bias of a
+ * masked bin is NaN. residuals holds the convergence measure of every
+ * iteration (see balanceICE and balanceKR).
+ */
+struct BalanceResult {
+    std::vector<double> bias;
+    std::vector<bool> masked;
+    std::vector<double> residuals;
+    int iterations = 0;
+    bool converged = false;
+};
+
+/*
+ * Iterative correction (ICE)
+ * Every iteration divides the matrix by the outer product of the row sums
+ * normalized by their mean. The rescale of a row and its next sum are done
+ * in the same pass. The residual is max |s_i - 1| over the normalized sums.
+ * The matrix must be square and symmetric.
+ */
+template<typename T>
+BalanceResult balanceICE(Matrix<T>& m, const BalanceOptions& options=BalanceOptions());
+
+/*
+ * Knight-Ruiz
+ * Newton iterations with an inner conjugate gradient (Knight & Ruiz, 2013)
+ * find x such that diag(x) M diag(x) has unit row sums; the matrix is only
+ * read by matrix-vector products and scaled once at the end. Converges in
+ * far fewer passes than ICE. The residual is ||1 - x * (M x)||_2.
+ * The matrix must be square and symmetric.
+ */
+template<typename T>
+BalanceResult balanceKR(Matrix<T>& m, const BalanceOptions& options=BalanceOptions());
+
+
+#endif // BALANCING_H
@@ -0,0 +1,234 @@
+//
+// Banded square matrix storing only the diagonals close to the main one.
+//
+
+#include "banded_matrix.h"
+#include "parallel.h"
+#include <algorithm>
+#include <fstream>
+
+// Number of rows processed together by the matrix-vector product
+static const int ROW_BLOCK = 1024;
+
+
+template<class T>
+BandedMatrix<T>::BandedMatrix(int n, int lower, int upper) : BandedMatrix(n, lower, upper, T(0)) {}
+
+template<class T>
+BandedMatrix<T>::BandedMatrix(int n, int lower, int upper, T defaultValue) {
+    if (n < 0 || lower < 0 || upper < 0)
+        throw std::invalid_argument("Size and bandwidths must be positive.");
+    // A band wider than the matrix is clamped
+    n_ = n;
+    lower_ = std::min(lower, std::max(n - 1, 0));
+    upper_ = std::min(upper, std::max(n - 1, 0));
+    diagonals_.reserve(lower_ + upper_ + 1);
+    for (int d = -lower_; d <= upper_; d++) {
+        diagonals_.emplace_back(n_ - std::abs(d), defaultValue);
+    }
+}
+
+template<class T>
+BandedMatrix<T>::BandedMatrix(const Matrix<T>& m, int lower, int upper) : BandedMatrix(m.getHeight(), lower, upper) {
+    if (m.getHeight() != m.getWidth())
+        throw std::invalid_argument("Matrix must be square.");
+    for (int d = -lower_; d <= upper_; d++) {
+        std::vector<T>& diag = diagonals_[d + lower_];
+        for (int k = 0; k < static_cast<int>(diag.size()); k++) {
+            diag[k] = d >= 0 ? m(k, k + d) : m(k - d, k);
+        }
+    }
+}
+
+template<class T>
+const std::vector<T>& BandedMatrix<T>::diagonal(int offset) const {
+    if (offset < -lower_ || offset > upper_)
+        throw std::out_of_range("Diagonal outside of the band.");
+    return diagonals_[offset + lower_];
+}
+
+template<class T>
+std::vector<T>& BandedMatrix<T>::diagonal(int offset) {
+    if (offset < -lower_ || offset > upper_)
+        throw std::out_of_range("Diagonal outside of the band.");
+    return diagonals_[offset + lower_];
+}
+
+template<class T>
+void BandedMatrix<T>::fill(const T& value) {
+    for (auto& diag : diagonals_) {
+        std::fill(diag.begin(), diag.end(), value);
+    }
+}
+
+template<class T>
+Matrix<T> BandedMatrix<T>::toMatrix() const {
+    Matrix<T> result(n_, n_, T(0));
+    for (int i = 0; i < n_; i++) {
+        // A(i, i + d) is stored at min(i, i + d) of diagonal d
+        T* row = result(i).data();
+        for (int d = std::max(-lower_, -i); d <= std::min(upper_, n_ - 1 - i); d++) {
+            row[i + d] = diagonals_[d + lower_][std::min(i, i + d)];
+        }
+    }
+    return result;
+}
+
+template<class T>
+std::vector<T> BandedMatrix<T>::dot(const std::vector<T>& v) const {
+    if (static_cast<int>(v.size()) != n_)
+        throw std::invalid_argument("Vector size must be the same as the matrix width.");
+
+    // y(i) = sum_d A(i, i + d) * v(i + d): for every diagonal this is a
+    // contiguous multiply-add between two shifted arrays
+    using Acc = typename Accumulator<T>::type;
+    std::vector<T> result(n_);
+    long work = static_cast<long>(n_) * (lower_ + upper_ + 1);
+
+    #pragma omp parallel for schedule(static) if(work > PARALLEL_THRESHOLD)
+    for (int start = 0; start < n_; start += ROW_BLOCK) {
+        int end = std::min(start + ROW_BLOCK, n_);
+        std::vector<Acc> acc(end - start, 0);
+        for (int d = -lower_; d <= upper_; d++) {
+            // rows i in [start, end) with 0 <= i + d < n, stored at min(i, i + d)
+            const T* diag = diagonals_[d + lower_].data();
+            const int shift = std::min(d, 0);
+            int first = std::max(start, -d);
+            int last = std::min(end, n_ - d);
+            for (int i = first; i < last; i++) {
+                acc[i - start] += static_cast<Acc>(diag[i + shift]) * static_cast<Acc>(v[i + d]);
+            }
+        }
+        for (int i = start; i < end; i++) {
+            result[i] = static_cast<T>(acc[i - start]);
+        }
+    }
+    return result;
+}
+
+template<class T>
+Matrix<T> BandedMatrix<T>::dot(const Matrix<T>& m) const {
+    if (m.getHeight() != n_)
+        throw std::invalid_argument("Dot product not compatible.");
+
+    using Acc = typename Accumulator<T>::type;
+    int width = m.getWidth();
+    long work = static_cast<long>(n_) * (lower_ + upper_ + 1) * width;
+    Matrix<T> result(n_, width);
+
+    #pragma omp parallel if(work > PARALLEL_THRESHOLD)
+    {
+        std::vector<Acc> acc(width);
+        #pragma omp for schedule(static)
+        for (int i = 0; i < n_; i++) {
+            std::fill(acc.begin(), acc.end(), Acc(0));
+            for (int j = std::max(0, i - lower_); j <= std::min(n_ - 1, i + upper_); j++) {
+                const Acc a = static_cast<Acc>(diagonals_[j - i + lower_][std::min(i, j)]);
+                const T* row = m(j).data();
+                for (int k = 0; k < width; k++) {
+                    acc[k] += a * static_cast<Acc>(row[k]);
+                }
+            }
+            std::copy(acc.begin(), acc.end(), result(i).begin());
+        }
+    }
+    return result;
+}
+
+template<class T>
+T BandedMatrix<T>::sum() const {
+    using Wide = typename Widened<T>::type;
+    Wide total = 0;
+    for (const auto& diag : diagonals_) {
+        total += reduceSum(diag.data(), diag.size(), Summation::Naive);
+    }
+    return static_cast<T>(total);
+}
+
+template<class T>
+std::vector<T> BandedMatrix<T>::diagonalSum() const {
+    std::vector<T> result(diagonals_.size());
+    #pragma omp parallel for schedule(dynamic) if(static_cast<long>(n_) * diagonals_.size() > PARALLEL_THRESHOLD)
+    for (int d = 0; d < static_cast<int>(diagonals_.size()); d++) {
+        result[d] = static_cast<T>(reduceSum(diagonals_[d].data(), diagonals_[d].size(), Summation::Naive));
+    }
+    return result;
+}
+
+template<class T>
+std::vector<double> BandedMatrix<T>::diagonalMean() const {
+    std::vector<double> result(diagonals_.size(), 0.0);
+    #pragma omp parallel for schedule(dynamic) if(static_cast<long>(n_) * diagonals_.size() > PARALLEL_THRESHOLD)
+    for (int d = 0; d < static_cast<int>(diagonals_.size()); d++) {
+        const auto& diag = diagonals_[d];
+        if (!diag.empty()) {
+            double total = static_cast<double>(reduceSum(diag.data(), diag.size(), Summation::Pairwise));
+            result[d] = total / static_cast<double>(diag.size());
+        }
+    }
+    return result;
+}
+
+template<class T>
+BandedMatrix<T> BandedMatrix<T>::cumuSumDiagonal() const {
+    using Acc = typename Accumulator<T>::type;
+    BandedMatrix<T> result(n_, lower_, upper_);
+    #pragma omp parallel for schedule(dynamic) if(static_cast<long>(n_) * diagonals_.size() > PARALLEL_THRESHOLD)
+    for (int d = 0; d < static_cast<int>(diagonals_.size()); d++) {
+        const auto& diag = diagonals_[d];
+        auto& out = result.diagonals_[d];
+        Acc running = 0;
+        for (std::size_t k = 0; k < diag.size(); k++) {
+            running += static_cast<Acc>(diag[k]);
+            out[k] = static_cast<T>(running);
+        }
+    }
+    return result;
+}
+
+template<class T>
+void BandedMatrix<T>::dumpToProto(const std::string& filePath) const {
+    protoMatrix protoMat;
+    protoMat.set_height(n_);
+    protoMat.set_width(n_);
+    protoMat.set_storage(protoMatrix::BANDED);
+    protoMat.set_lower(lower_);
+    protoMat.set_upper(upper_);
+    for (const auto& diag : diagonals_) {
+        for (const T& value : diag) {
+            protoMat.add_data(static_cast<double>(value));
+        }
+    }
+    MATRIX_PROFILE(DumpToProto, n_, n_, protoMat.data_size(), sizeof(double) * protoMat.data_size());
+    std::ofstream outFile(filePath, std::ios::binary);
+    protoMat.SerializeToOstream(&outFile);
+    outFile.close();
+}
+
+template<class T>
+BandedMatrix<T> BandedMatrix<T>::loadFromProto(const std::string& filePath) {
+    protoMatrix protoMat;
+    std::ifstream inFile(filePath, std::ios::binary);
+    protoMat.ParseFromIstream(&inFile);
+    inFile.close();
+
+    if (protoMat.storage() != protoMatrix::BANDED)
+        throw std::invalid_argument("The file does not contain a banded matrix.");
+    if (protoMat.height() != protoMat.width())
+        throw std::invalid_argument("Matrix must be square.");
+
+    BandedMatrix<T> result(protoMat.height(), protoMat.lower(), protoMat.upper());
+    int index = 0;
+    for (auto& diag : result.diagonals_) {
+        for (T& value : diag) {
+            value = static_cast<T>(protoMat.data(index++));
+        }
+    }
+    return result;
+}
+
+
+// Explicit instantiation of the template class
+template class BandedMatrix<int>;
+template class BandedMatrix<float>;
+template class BandedMatrix<double>;
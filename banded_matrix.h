@@ -0,0 +1,81 @@
+//
+// Banded square matrix storing only the diagonals close to the main one.
+//
+
+#include <vector>
+#include <utility>
+#include <stdexcept>
+
+#include "matrix.h"
+
+#ifndef BANDED_MATRIX_H
+#define BANDED_MATRIX_H
+
+
+/*
+ * BandedMatrix class
+ * A square n x n matrix whose elements are zero outside of the diagonals
+ * -lower .. upper. Each diagonal is stored contiguously: the element (h, w)
+ * is on diagonal w - h at position min(h, w). Memory is in O(n * band).
+ */
+
+template<typename T>
+class BandedMatrix {
+public:
+    BandedMatrix() = default;
+    BandedMatrix(int n, int lower, int upper);
+    BandedMatrix(int n, int lower, int upper, T defaultValue);
+    // Keep the band of a square matrix
+    BandedMatrix(const Matrix<T>& m, int lower, int upper);
+
+    /*
+     * Inline element access
+     * The const accessor returns zero outside of the band, the mutable one
+     * throws since those elements are not stored.
+     */
+    inline bool contains(int h, int w) const { return w - h >= -lower_ && w - h <= upper_; }
+    inline T operator()(int h, int w) const { return contains(h, w) ? diagonals_[w - h + lower_][std::min(h, w)] : T(0); }
+    inline T& operator()(int h, int w) {
+        if (!contains(h, w))
+            throw std::out_of_range("Element outside of the band.");
+        return diagonals_[w - h + lower_][std::min(h, w)];
+    }
+
+    // Inline getters
+    [[nodiscard]] inline int getHeight() const { return n_; }
+    [[nodiscard]] inline int getWidth() const { return n_; }
+    [[nodiscard]] inline std::pair<int, int> getShape() const { return std::make_pair(n_, n_); }
+    [[nodiscard]] inline int getLower() const { return lower_; }
+    [[nodiscard]] inline int getUpper() const { return upper_; }
+
+    // Elements (i, i + offset), offset in [-lower, upper]
+    const std::vector<T>& diagonal(int offset) const;
+    std::vector<T>& diagonal(int offset);
+
+    // Methods
+    void fill(const T& value);
+    Matrix<T> toMatrix() const;
+
+    // Maths operations
+    std::vector<T> dot(const std::vector<T>& v) const;    // banded matrix-vector product
+    Matrix<T> dot(const Matrix<T>& m) const;              // banded matrix-matrix product
+    T sum() const;
+    std::vector<T> diagonalSum() const;                   // one value per offset, from -lower to upper
+    std::vector<double> diagonalMean() const;             // expected value by distance
+    BandedMatrix<T> cumuSumDiagonal() const;              // running sums along every diagonal
+
+    // Serialization & deserialization (only the band is written)
+    void dumpToProto(const std::string& filePath) const;
+    static BandedMatrix<T> loadFromProto(const std::string& filePath);
+
+private:
+    std::vector<std::vector<T>> diagonals_;
+    int n_ = 0;
+    int lower_ = 0;
+    int upper_ = 0;
+};
+
+template <class T> inline std::ostream& operator<<(std::ostream &flux, const BandedMatrix<T>& m) { m.toMatrix().print(flux); return flux; }
+
+
+#endif // BANDED_MATRIX_H
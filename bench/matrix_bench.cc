@@ -0,0 +1,681 @@
+//
+// Benchmarks of the Matrix kernels.
+// Usage: matrix_bench [section]   (no argument runs every section)
+//
+
+#include "../matrix.h"
+#include "../accumulation.h"
+#include "../balancing.h"
+#include "../decomposition.h"
+#include "../dispatch.h"
+#include "../elementwise.h"
+#include "../filters.h"
+#include "../integer.h"
+#include "../masked_matrix.h"
+#include "../pairwise.h"
+#include "../permutation.h"
+#include "../stacking.h"
+#include "../tiled_matrix.h"
+#include "../triples.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+
+// Best wall time in milliseconds over a few repetitions
+static double timeIt(const std::function<void()>& f, int repeat = 3) {
+    double best = 1e300;
+    for (int r = 0; r < repeat; r++) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return best;
+}
+
+static Matrix<float> randomMatrix(int rows, int cols, unsigned seed = 42) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    Matrix<float> m(rows, cols);
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++) {
+            m(i, j) = dist(gen);
+        }
+    }
+    return m;
+}
+
+static const char* policyName(Summation mode) {
+    switch (mode) {
+        case Summation::Pairwise: return "pairwise";
+        case Summation::Kahan: return "kahan";
+        case Summation::Widened: return "widened";
+        default: return "naive";
+    }
+}
+
+/*
+ * Summation policies: speed and relative error of Matrix<float> reductions,
+ * the reference is computed in long double.
+ */
+static void benchSummation() {
+    const int n = 4000;
+    Matrix<float> m = randomMatrix(n, n);
+
+    long double reference = 0;
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            reference += m(i, j);
+        }
+    }
+
+    Matrix<float> a = randomMatrix(512, 512, 1);
+    Matrix<float> b = randomMatrix(512, 512, 2);
+    Matrix<double> exact = a.astype<double>().dot(b.astype<double>(), Summation::Kahan);
+
+    std::cout << "== summation (sum of " << n << "x" << n << ", dot of 512x512) ==" << std::endl;
+    std::cout << std::setw(10) << "policy" << std::setw(14) << "sum ms" << std::setw(14) << "sum rel err"
+              << std::setw(14) << "dot ms" << std::setw(14) << "dot max err" << std::endl;
+    for (Summation mode : {Summation::Naive, Summation::Pairwise, Summation::Kahan, Summation::Widened}) {
+        float s = 0;
+        double sumMs = timeIt([&]() { s = m.sum(mode); });
+        Matrix<float> d;
+        double dotMs = timeIt([&]() { d = a.dot(b, mode); });
+
+        double dotErr = 0;
+        for (int i = 0; i < d.getHeight(); i++) {
+            for (int j = 0; j < d.getWidth(); j++) {
+                dotErr = std::max(dotErr, std::abs(d(i, j) - exact(i, j)) / exact(i, j));
+            }
+        }
+        std::cout << std::setw(10) << policyName(mode) << std::setw(14) << sumMs
+                  << std::setw(14) << static_cast<double>(std::abs((s - reference) / reference))
+                  << std::setw(14) << dotMs << std::setw(14) << dotErr << std::endl;
+    }
+}
+
+/*
+ * Text output: operator<< and CSV write / read of a float matrix
+ */
+static void benchText() {
+    const int n = 2000;
+    Matrix<float> m = randomMatrix(n, n);
+    std::string path = "matrix_bench.csv";
+
+    std::cout << "== text (" << n << "x" << n << ") ==" << std::endl;
+    std::ostringstream sink;
+    std::cout << "operator<<  " << timeIt([&]() { sink.str(""); sink << m; }, 1) << " ms" << std::endl;
+    std::cout << "toCSV       " << timeIt([&]() { m.toCSV(path); }, 1) << " ms" << std::endl;
+    Matrix<float> loaded;
+    std::cout << "fromCSV     " << timeIt([&]() { loaded = Matrix<float>::fromCSV(path); }, 1) << " ms" << std::endl;
+    std::remove(path.c_str());
+}
+
+/*
+ * Strassen-Winograd: time against the classical dot for several crossover
+ * sizes, and max relative error against a double precision product
+ */
+static void benchStrassen() {
+    std::cout << "== strassen (float, square) ==" << std::endl;
+    std::cout << std::setw(6) << "n" << std::setw(12) << "classical" << std::setw(10) << "cross"
+              << std::setw(12) << "strassen" << std::setw(14) << "err classic" << std::setw(14) << "err strassen"
+              << std::endl;
+    for (int n : {256, 512, 1024, 2048}) {
+        Matrix<float> a = randomMatrix(n, n, 1);
+        Matrix<float> b = randomMatrix(n, n, 2);
+        Matrix<double> exact = a.astype<double>().dot(b.astype<double>());
+        auto maxError = [&](const Matrix<float>& c) {
+            double err = 0;
+            for (int i = 0; i < n; i++) {
+                for (int j = 0; j < n; j++) {
+                    err = std::max(err, std::abs(c(i, j) - exact(i, j)) / exact(i, j));
+                }
+            }
+            return err;
+        };
+
+        Matrix<float> classical;
+        double classicalMs = timeIt([&]() { classical = a.dot(b); }, 1);
+        for (int crossover : {64, 128, 256, 512}) {
+            if (crossover >= n) {
+                continue;
+            }
+            Matrix<float> fast;
+            double fastMs = timeIt([&]() { fast = a.dotStrassen(b, crossover); }, 1);
+            std::cout << std::setw(6) << n << std::setw(12) << classicalMs << std::setw(10) << crossover
+                      << std::setw(12) << fastMs << std::setw(14) << maxError(classical)
+                      << std::setw(14) << maxError(fast) << std::endl;
+        }
+    }
+}
+
+/*
+ * Matrix-vector products against the previous way of computing them:
+ * wrapping the vector in an n x 1 matrix (and transposing for v^T M)
+ */
+static void benchGemv() {
+    std::cout << "== gemv (float) ==" << std::endl;
+    for (auto shape : {std::make_pair(4000, 4000), std::make_pair(100000, 64), std::make_pair(64, 100000)}) {
+        int rows = shape.first;
+        int cols = shape.second;
+        Matrix<float> m = randomMatrix(rows, cols);
+        Matrix<float> x = randomMatrix(cols, 1, 1);
+        Matrix<float> y = randomMatrix(1, rows, 2);
+        std::vector<float> xv = x.getCol(0);
+        std::vector<float> yv = y(0);
+
+        std::vector<float> out;
+        Matrix<float> wrapped;
+        std::cout << rows << "x" << cols << std::endl;
+        std::cout << "  dot(n x 1)        " << timeIt([&]() { wrapped = m.dot(x); }) << " ms" << std::endl;
+        std::cout << "  dot(vector)       " << timeIt([&]() { out = m.dot(xv); }) << " ms" << std::endl;
+        std::cout << "  (1 x n).dot       " << timeIt([&]() { wrapped = y.dot(m); }) << " ms" << std::endl;
+        std::cout << "  dotTransposed     " << timeIt([&]() { out = m.dotTransposed(yv); }) << " ms" << std::endl;
+    }
+}
+
+/*
+ * Balancing of a symmetric matrix: ICE written with the allocating
+ * sum / divide calls against the in-place engines
+ */
+static void benchBalance() {
+    const int n = 3000;
+    const int iterations = 20;
+    Matrix<double> raw = randomMatrix(n, n).astype<double>();
+    raw += raw.transpose();
+    std::cout << "== balance (double, " << n << "x" << n << ", " << iterations << " ICE iterations) ==" << std::endl;
+
+    Matrix<double> m;
+    double allocatingMs = timeIt([&]() {
+        m = raw.duplicate();
+        for (int it = 0; it < iterations; it++) {
+            std::vector<double> s = m.sum(0);
+            double mean = 0;
+            for (double x : s) mean += x / n;
+            for (double& x : s) x /= mean;
+            m = m.divide(s).transpose().divide(s);
+        }
+    }, 1);
+    BalanceOptions options;
+    options.maxIterations = iterations;
+    options.tolerance = 0;
+    double iceMs = timeIt([&]() { m = raw.duplicate(); balanceICE(m, options); }, 1);
+    BalanceResult kr;
+    double krMs = timeIt([&]() { m = raw.duplicate(); kr = balanceKR(m); }, 1);
+    std::cout << "sum/divide  " << allocatingMs << " ms" << std::endl;
+    std::cout << "balanceICE  " << iceMs << " ms" << std::endl;
+    std::cout << "balanceKR   " << krMs << " ms (" << kr.iterations << " iterations to 1e-5)" << std::endl;
+}
+
+/*
+ * Eigen-decomposition: full eigh on a medium matrix, top-3 eigenpairs of a
+ * large correlation-like matrix with Lanczos and the randomized method
+ */
+static void benchEigen() {
+    std::cout << "== eigen ==" << std::endl;
+    Matrix<double> medium = randomMatrix(800, 800).astype<double>();
+    medium += medium.transpose();
+    std::cout << "eigh 800x800 (double)          " << timeIt([&]() { eigh(medium); }, 1) << " ms" << std::endl;
+
+    const int n = 10000;
+    Matrix<float> large = randomMatrix(n, n);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < i; j++) {
+            large(i, j) = large(j, i);
+        }
+    }
+    EigenDecomposition<float> lanczosTop, randomizedTop;
+    double lanczosMs = timeIt([&]() { lanczosTop = lanczos(large, 3, 1e-6); }, 1);
+    double randomizedMs = timeIt([&]() { randomizedTop = randomizedEigh(large, 3); }, 1);
+    std::cout << "top-3 " << n << "x" << n << " (float) lanczos      " << lanczosMs << " ms, values";
+    for (float value : lanczosTop.values) std::cout << " " << value;
+    std::cout << std::endl << "top-3 " << n << "x" << n << " (float) randomized   " << randomizedMs << " ms, values";
+    for (float value : randomizedTop.values) std::cout << " " << value;
+    std::cout << std::endl;
+}
+
+/*
+ * Elementwise functions against a loop calling the C library per element
+ */
+static void benchElementwise() {
+    const int n = 4000;
+    Matrix<float> m = randomMatrix(n, n);
+    Matrix<double> md = m.astype<double>();
+    std::cout << "== elementwise (" << n << "x" << n << ") ==" << std::endl;
+    std::cout << std::setw(8) << "" << std::setw(14) << "std float" << std::setw(14) << "kernel float"
+              << std::setw(14) << "std double" << std::setw(14) << "kernel double" << std::endl;
+    Matrix<float> out;
+    Matrix<double> outd;
+    auto row = [&](const char* name, float (*f)(float), double (*fd)(double),
+                   Matrix<float> (*kernel)(const Matrix<float>&), Matrix<double> (*kerneld)(const Matrix<double>&)) {
+        std::cout << std::setw(8) << name
+                  << std::setw(14) << timeIt([&]() { out = m.map(f); })
+                  << std::setw(14) << timeIt([&]() { out = kernel(m); })
+                  << std::setw(14) << timeIt([&]() { outd = md.map(fd); })
+                  << std::setw(14) << timeIt([&]() { outd = kerneld(md); }) << std::endl;
+    };
+    row("exp", std::exp, std::exp, elementwise::exp<float>, elementwise::exp<double>);
+    row("log", std::log, std::log, elementwise::log<float>, elementwise::log<double>);
+    row("log1p", std::log1p, std::log1p, elementwise::log1p<float>, elementwise::log1p<double>);
+    row("sqrt", std::sqrt, std::sqrt, elementwise::sqrt<float>, elementwise::sqrt<double>);
+}
+
+/*
+ * NaN-skipping and masked reductions against a scalar loop with a branch
+ */
+static void benchNaN() {
+    const int n = 4000;
+    Matrix<float> m = randomMatrix(n, n);
+    std::mt19937 gen(3);
+    std::uniform_int_distribution<int> pick(0, 9);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            if (pick(gen) == 0) {
+                m(i, j) = std::nanf("");
+            }
+        }
+    }
+    std::cout << "== NaN reductions (" << n << "x" << n << ", 10% NaN) ==" << std::endl;
+    volatile float sink = 0;
+    auto scalarMax = [&]() {
+        float best = -INFINITY;
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) {
+                if (!std::isnan(m(i, j)) && m(i, j) > best) {
+                    best = m(i, j);
+                }
+            }
+        }
+        sink = best;
+    };
+    std::cout << std::setw(24) << "scalar max" << std::setw(12) << timeIt(scalarMax) << " ms" << std::endl;
+    std::cout << std::setw(24) << "max" << std::setw(12) << timeIt([&]() { sink = m.max(); }) << " ms" << std::endl;
+    std::cout << std::setw(24) << "nanmax" << std::setw(12) << timeIt([&]() { sink = nanmax(m); }) << " ms" << std::endl;
+    std::cout << std::setw(24) << "max(axis 1)" << std::setw(12) << timeIt([&]() { sink = m.max(1)[0]; }) << " ms" << std::endl;
+    std::cout << std::setw(24) << "sum(axis 1)" << std::setw(12) << timeIt([&]() { sink = m.sum(1)[0]; }) << " ms" << std::endl;
+    std::cout << std::setw(24) << "nanmax(axis 1)" << std::setw(12) << timeIt([&]() { sink = nanmax(m, 1)[0]; }) << " ms" << std::endl;
+    std::cout << std::setw(24) << "nansum" << std::setw(12) << timeIt([&]() { sink = nansum(m); }) << " ms" << std::endl;
+
+    MaskedMatrix<float> masked = MaskedMatrix<float>::maskNaN(m.duplicate());
+    std::cout << std::setw(24) << "masked max" << std::setw(12) << timeIt([&]() { sink = masked.max(); }) << " ms" << std::endl;
+    std::cout << std::setw(24) << "masked sum" << std::setw(12) << timeIt([&]() { sink = masked.sum(); }) << " ms" << std::endl;
+    std::cout << std::setw(24) << "masked sum(axis 1)" << std::setw(12) << timeIt([&]() { sink = masked.sum(1)[0]; }) << " ms" << std::endl;
+}
+
+/*
+ * Convolution: subMat windows, direct, FFT, separable and box filters
+ * The kernel size at which the FFT wins sets FFT_CROSSOVER (filters.h).
+ */
+static void benchFilters() {
+    const int n = 1024;
+    Matrix<float> m = randomMatrix(n, n);
+    std::cout << "== filters (" << n << "x" << n << ") ==" << std::endl;
+    std::cout << std::setw(8) << "kernel" << std::setw(12) << "subMat" << std::setw(12) << "direct"
+              << std::setw(12) << "fft" << std::setw(12) << "separable" << std::setw(12) << "box" << std::endl;
+    Matrix<float> out;
+    for (int k : {3, 7, 15, 23, 31, 47, 63}) {
+        Matrix<float> kernel(k, k, 1.0f / (k * k));
+        std::vector<float> kernel1d(k, 1.0f / k);
+        // Reference: one subMat copy per output element (interior only), timed on 64 rows
+        const int rows = 64;
+        double subMat = timeIt([&]() {
+            for (int i = 0; i < rows; i++) {
+                for (int j = 0; j + k <= n; j++) {
+                    Matrix<float> window = m.subMat(i, j, k, k);
+                    float sum = 0;
+                    for (int a = 0; a < k; a++) {
+                        for (int b = 0; b < k; b++) {
+                            sum += window(a, b) * kernel(a, b);
+                        }
+                    }
+                    out = Matrix<float>(1, 1, sum);
+                }
+            }
+        }, 1) * n / rows;
+        std::cout << std::setw(8) << k
+                  << std::setw(12) << subMat
+                  << std::setw(12) << timeIt([&]() { out = convolve2d(m, kernel, Boundary::Reflect, Window()); }, 1)
+                  << std::setw(12) << timeIt([&]() { out = convolve2dFFT(m, kernel, Boundary::Reflect); }, 1)
+                  << std::setw(12) << timeIt([&]() { out = convolveSeparable(m, kernel1d, kernel1d, Boundary::Reflect); })
+                  << std::setw(12) << timeIt([&]() { out = boxFilter(m, k / 2, k / 2, Boundary::Reflect); }) << std::endl;
+    }
+}
+
+static void benchPairwise() {
+    const int n = 2000;
+    const int d = 256;
+    Matrix<float> m = randomMatrix(n, d);
+    std::cout << "== pairwise (" << n << " variables of " << d << ") ==" << std::endl;
+    Matrix<float> out;
+    // cov of the rows chained from transpose, sum, subtract, dot and multiply
+    double chainedCov = timeIt([&]() {
+        Matrix<float> x = m.transpose();
+        std::vector<float> means = x.sum(1);
+        for (float& mean : means) {
+            mean /= d;
+        }
+        Matrix<float> broadcast(d, n);
+        for (int k = 0; k < d; k++) {
+            broadcast(k) = means;
+        }
+        Matrix<float> centered = x.subtract(broadcast);
+        out = centered.transpose().dot(centered).multiply(1.0f / (d - 1));
+    }, 1);
+    // Euclidean distances chained from multiply, sum, transpose and dot
+    double chainedCdist = timeIt([&]() {
+        std::vector<float> norms = m.multiply(m).sum(0);
+        Matrix<float> gram = m.dot(m.transpose());
+        out = Matrix<float>(n, n);
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) {
+                out(i, j) = std::sqrt(std::max(0.0f, norms[i] + norms[j] - 2 * gram(i, j)));
+            }
+        }
+    }, 1);
+    std::cout << "  cov        chained " << chainedCov << " ms, fused "
+              << timeIt([&]() { out = cov(m); }) << " ms" << std::endl;
+    std::cout << "  corrcoef   fused " << timeIt([&]() { out = corrcoef(m); }) << " ms" << std::endl;
+    std::cout << "  euclidean  chained " << chainedCdist << " ms, fused "
+              << timeIt([&]() { out = cdist(m, m, Metric::Euclidean); }) << " ms" << std::endl;
+    Matrix<float> other = m.duplicate();
+    std::cout << "  euclidean  not symmetric " << timeIt([&]() { out = cdist(m, other, Metric::Euclidean); })
+              << " ms" << std::endl;
+    std::cout << "  cosine     " << timeIt([&]() { out = cdist(m, m, Metric::Cosine); }) << " ms" << std::endl;
+    std::cout << "  manhattan  " << timeIt([&]() { out = cdist(m, m, Metric::Manhattan); }) << " ms" << std::endl;
+    double streamed = timeIt([&]() {
+        double checksum = 0;
+        cdist(m, m, Metric::Euclidean, [&checksum](int, int, const Matrix<float>& tile) { checksum += tile(0, 0); });
+        out = Matrix<float>(1, 1, static_cast<float>(checksum));
+    });
+    std::cout << "  euclidean  streamed by tiles " << streamed << " ms" << std::endl;
+}
+
+static void benchTiled() {
+    const int n = 2048;
+    const int tile = 512;
+    const std::size_t tileBytes = static_cast<std::size_t>(tile) * tile * sizeof(float);
+    Matrix<float> a = randomMatrix(n, n, 1);
+    Matrix<float> b = randomMatrix(n, n, 2);
+    TiledMatrix<float> ta = TiledMatrix<float>::fromMatrix(a, "/tmp/matrix_bench_a.bin", tile);
+    TiledMatrix<float> tb = TiledMatrix<float>::fromMatrix(b, "/tmp/matrix_bench_b.bin", tile);
+    std::cout << "== out-of-core (" << n << "x" << n << " float, tiles of " << tile << ") ==" << std::endl;
+    Matrix<float> out;
+    std::cout << "  in-memory dot " << timeIt([&]() { out = a.dot(b); }, 1) << " ms" << std::endl;
+    for (std::size_t tiles : {5, 12, 24, 64}) {
+        std::cout << "  dot, budget of " << std::setw(2) << tiles << " tiles "
+                  << timeIt([&]() { ta.dot(tb, "/tmp/matrix_bench_c.bin", tiles * tileBytes); }, 1) << " ms" << std::endl;
+    }
+    std::cout << "  in-memory transpose " << timeIt([&]() { out = a.transpose(); }) << " ms, tiled "
+              << timeIt([&]() { ta.transpose("/tmp/matrix_bench_c.bin"); }) << " ms" << std::endl;
+    float total = 0;
+    std::cout << "  in-memory sum " << timeIt([&]() { total += a.sum(); }) << " ms, tiled "
+              << timeIt([&]() { total += ta.sum(); }) << " ms" << std::endl;
+    std::remove("/tmp/matrix_bench_a.bin");
+    std::remove("/tmp/matrix_bench_b.bin");
+    std::remove("/tmp/matrix_bench_c.bin");
+}
+
+/*
+ * Concurrent binning: every thread adds counts at random positions of one
+ * matrix. Private matrices merged with += (the previous way) against atomic
+ * accumulate, sharded buffers and one batched scatterAdd.
+ */
+static void benchAccumulate() {
+    const int n = 1024;
+    const int threads = 8;
+    const int updates = 1 << 21;
+    std::vector<int> rows(updates);
+    std::vector<int> cols(updates);
+    std::mt19937 gen(5);
+    std::uniform_int_distribution<int> dist(0, n - 1);
+    for (int k = 0; k < updates; k++) {
+        rows[k] = dist(gen);
+        cols[k] = dist(gen);
+    }
+    auto parallel = [&](const std::function<void(int, int, int)>& f) {
+        std::vector<std::thread> pool;
+        for (int t = 0; t < threads; t++) {
+            pool.emplace_back(f, t, updates / threads * t, updates / threads * (t + 1));
+        }
+        for (std::thread& thread : pool) {
+            thread.join();
+        }
+    };
+    std::cout << "== accumulate (" << n << "x" << n << " int, " << updates << " updates, " << threads
+              << " threads) ==" << std::endl;
+    Matrix<int> counts;
+    double privateMs = timeIt([&]() {
+        std::vector<Matrix<int>> local(threads, Matrix<int>(n, n));
+        parallel([&](int t, int first, int last) {
+            for (int k = first; k < last; k++) {
+                local[t](rows[k], cols[k]) += 1;
+            }
+        });
+        counts = Matrix<int>(n, n);
+        for (Matrix<int>& m : local) {
+            counts += m;
+        }
+    }, 1);
+    std::cout << "  private matrices + merge " << privateMs << " ms (" << threads << " copies)" << std::endl;
+    std::cout << "  atomic accumulate        " << timeIt([&]() {
+        counts = Matrix<int>(n, n);
+        parallel([&](int, int first, int last) {
+            for (int k = first; k < last; k++) {
+                counts.accumulate(rows[k], cols[k], 1);
+            }
+        });
+    }, 1) << " ms" << std::endl;
+    for (int shards : {2, threads}) {
+        std::cout << "  sharded, " << shards << " shards        " << timeIt([&]() {
+            ShardedAccumulator<int> accumulator(n, n, threads, shards);
+            parallel([&](int t, int first, int last) {
+                ShardedAccumulator<int>::Shard& shard = accumulator.shard(t);
+                for (int k = first; k < last; k++) {
+                    shard.add(rows[k], cols[k], 1);
+                }
+            });
+            counts = accumulator.merge();
+        }, 1) << " ms" << std::endl;
+    }
+    std::vector<int> ones(updates, 1);
+    std::cout << "  scatterAdd               " << timeIt([&]() {
+        counts = Matrix<int>(n, n);
+        scatterAdd(counts, rows, cols, ones);
+    }, 1) << " ms" << std::endl;
+}
+
+/*
+ * Construction from (row, col, value) records: one put / operator() per
+ * record against the tiled radix partition of fromTriples and the builder.
+ */
+static void benchTriples() {
+    const int n = 4096;
+    const int records = 1 << 24;
+    std::vector<int> rows(records);
+    std::vector<int> cols(records);
+    std::vector<float> values(records, 1.0f);
+    std::mt19937 gen(6);
+    std::uniform_int_distribution<int> dist(0, n - 1);
+    for (int k = 0; k < records; k++) {
+        rows[k] = dist(gen);
+        cols[k] = dist(gen);
+    }
+    std::cout << "== triples (" << n << "x" << n << " float, " << records << " records) ==" << std::endl;
+    Matrix<float> m;
+    std::cout << "  put          " << timeIt([&]() {
+        m = Matrix<float>(n, n);
+        for (int k = 0; k < records; k++) {
+            m.put(rows[k], cols[k], m(rows[k], cols[k]) + values[k]);
+        }
+    }, 1) << " ms" << std::endl;
+    std::cout << "  operator()   " << timeIt([&]() {
+        m = Matrix<float>(n, n);
+        for (int k = 0; k < records; k++) {
+            m(rows[k], cols[k]) += values[k];
+        }
+    }, 1) << " ms" << std::endl;
+    std::cout << "  fromTriples  " << timeIt([&]() {
+        m = Matrix<float>::fromTriples(rows, cols, values, {n, n});
+    }, 1) << " ms" << std::endl;
+    std::cout << "  builder      " << timeIt([&]() {
+        TripletBuilder<float> builder(n, n);
+        for (int k = 0; k < records; k++) {
+            builder.add(rows[k], cols[k], values[k]);
+        }
+        m = builder.build();
+    }, 1) << " ms" << std::endl;
+}
+
+/*
+ * Reordering of rows and columns by a random permutation: one operator()
+ * per element against the row copies and column tiles of permutation.h,
+ * and the in-place cycle-following versions.
+ */
+static void benchPermute() {
+    const int n = 4096;
+    Matrix<float> m = randomMatrix(n, n, 7);
+    std::vector<int> perm(n);
+    for (int k = 0; k < n; k++) {
+        perm[k] = k;
+    }
+    std::shuffle(perm.begin(), perm.end(), std::mt19937(7));
+    std::cout << "== permute (" << n << "x" << n << " float) ==" << std::endl;
+    Matrix<float> result;
+    std::cout << "  loop rows+cols   " << timeIt([&]() {
+        result = Matrix<float>(n, n);
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) {
+                result(i, j) = m(perm[i], perm[j]);
+            }
+        }
+    }, 3) << " ms" << std::endl;
+    std::cout << "  permuteRows      " << timeIt([&]() { result = permutation::permuteRows(m, perm); }, 3) << " ms" << std::endl;
+    std::cout << "  permuteCols      " << timeIt([&]() { result = permutation::permuteCols(m, perm); }, 3) << " ms" << std::endl;
+    std::cout << "  rows+cols        " << timeIt([&]() {
+        result = permutation::permuteCols(permutation::permuteRows(m, perm), perm);
+    }, 3) << " ms" << std::endl;
+    result = m.duplicate();
+    std::cout << "  rows in place    " << timeIt([&]() { permutation::permuteRowsInPlace(result, perm); }, 3) << " ms" << std::endl;
+    std::cout << "  cols in place    " << timeIt([&]() { permutation::permuteColsInPlace(result, perm); }, 3) << " ms" << std::endl;
+}
+
+/*
+ * Assembly of a 4096x4096 matrix from 16 row bands or a 4x4 grid:
+ * push_back row by row against the single allocation of vstack and block.
+ */
+static void benchStack() {
+    const int n = 4096;
+    const int pieces = 16;
+    std::vector<Matrix<float>> bands;
+    for (int k = 0; k < pieces; k++) {
+        bands.push_back(randomMatrix(n / pieces, n, k));
+    }
+    Matrix<float> quarter = randomMatrix(n / 4, n / 4, 8);
+    std::vector<std::vector<Matrix<float>>> grid(4, std::vector<Matrix<float>>(4, quarter));
+    std::cout << "== stack (" << n << "x" << n << " float) ==" << std::endl;
+    Matrix<float> result;
+    std::cout << "  push_back  " << timeIt([&]() {
+        result = Matrix<float>();
+        for (const Matrix<float>& band : bands) {
+            for (int i = 0; i < band.getHeight(); i++) {
+                result.push_back(band(i));
+            }
+        }
+    }, 3) << " ms" << std::endl;
+    std::cout << "  vstack     " << timeIt([&]() { result = stacking::vstack(bands); }, 3) << " ms" << std::endl;
+    std::cout << "  block      " << timeIt([&]() { result = stacking::block(grid); }, 3) << " ms" << std::endl;
+    std::cout << "  tile       " << timeIt([&]() { result = stacking::tile(quarter, 4, 4); }, 3) << " ms" << std::endl;
+}
+
+/*
+ * The dispatched kernels under every instruction set variant the CPU
+ * supports (see dispatch.h).
+ */
+static void benchDispatch() {
+    const int n = 1024;
+    Matrix<float> a = randomMatrix(n, n, 9);
+    Matrix<float> b = randomMatrix(n, n, 10);
+    Matrix<double> big = randomMatrix(4096, 4096, 11).astype<double>();
+    std::cout << "== dispatch (" << n << "x" << n << " float dot, 4096x4096 double) ==" << std::endl;
+    dispatch::Isa initial = dispatch::active();
+    for (int i = 0; i < dispatch::ISA_COUNT; i++) {
+        dispatch::Isa isa = static_cast<dispatch::Isa>(i);
+        if (!dispatch::supported(isa)) {
+            continue;
+        }
+        dispatch::force(isa);
+        std::cout << "  " << std::setw(8) << std::left << dispatch::name(isa)
+                  << " dot " << timeIt([&]() { a.dot(b); }, 3) << " ms"
+                  << ", sum " << timeIt([&]() { big.sum(); }, 5) << " ms"
+                  << ", max " << timeIt([&]() { big.max(1); }, 5) << " ms"
+                  << ", exp " << timeIt([&]() { elementwise::exp(big); }, 3) << " ms"
+                  << ", transpose " << timeIt([&]() { big.transpose(); }, 3) << " ms" << std::endl;
+    }
+    dispatch::force(initial);
+}
+
+/*
+ * Contact counts: the int64 sums and products of the integer kernels on
+ * int, int16_t and uint8_t storage, against the wrapping Matrix<int> ones.
+ */
+static void benchInteger() {
+    const int n = 4096;
+    const int k = 512;
+    std::mt19937 gen(12);
+    std::uniform_int_distribution<int> dist(0, 200);
+    Matrix<int> counts(n, n);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            counts(i, j) = dist(gen);
+        }
+    }
+    Matrix<int16_t> counts16 = integer::narrow<int16_t>(counts);
+    Matrix<uint8_t> counts8 = integer::narrow<uint8_t>(counts);
+    Matrix<int> a = counts.subMat(0, 0, k, k);
+    Matrix<int16_t> a16 = counts16.subMat(0, 0, k, k);
+    Matrix<uint8_t> a8 = counts8.subMat(0, 0, k, k);
+    std::cout << "== integer (" << n << "x" << n << " sum, " << k << "x" << k << " dot) ==" << std::endl;
+    std::cout << "  Matrix<int>      sum " << timeIt([&]() { counts.sum(); }, 5) << " ms"
+              << ", dot " << timeIt([&]() { a.dot(a); }, 3) << " ms" << std::endl;
+    std::cout << "  integer int      sum " << timeIt([&]() { integer::sum(counts); }, 5) << " ms"
+              << ", dot " << timeIt([&]() { integer::dot(a, a); }, 3) << " ms" << std::endl;
+    std::cout << "  integer int16_t  sum " << timeIt([&]() { integer::sum(counts16); }, 5) << " ms"
+              << ", dot " << timeIt([&]() { integer::dot(a16, a16); }, 3) << " ms" << std::endl;
+    std::cout << "  integer uint8_t  sum " << timeIt([&]() { integer::sum(counts8); }, 5) << " ms"
+              << ", dot " << timeIt([&]() { integer::dot(a8, a8); }, 3) << " ms" << std::endl;
+    std::cout << "  add int16_t      wrap " << timeIt([&]() { integer::add(counts16, counts16, integer::Overflow::Wrap); }, 3)
+              << " ms, saturate " << timeIt([&]() { integer::add(counts16, counts16); }, 3) << " ms" << std::endl;
+    std::cout << "  divide           " << timeIt([&]() { integer::divide(counts, counts); }, 3) << " ms" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    std::string section = argc > 1 ? argv[1] : "all";
+    if (section == "all" || section == "summation") benchSummation();
+    if (section == "all" || section == "text") benchText();
+    if (section == "all" || section == "strassen") benchStrassen();
+    if (section == "all" || section == "gemv") benchGemv();
+    if (section == "all" || section == "balance") benchBalance();
+    if (section == "all" || section == "eigen") benchEigen();
+    if (section == "all" || section == "elementwise") benchElementwise();
+    if (section == "all" || section == "nan") benchNaN();
+    if (section == "all" || section == "filters") benchFilters();
+    if (section == "all" || section == "pairwise") benchPairwise();
+    if (section == "all" || section == "tiled") benchTiled();
+    if (section == "all" || section == "accumulate") benchAccumulate();
+    if (section == "all" || section == "triples") benchTriples();
+    if (section == "all" || section == "permute") benchPermute();
+    if (section == "all" || section == "stack") benchStack();
+    if (section == "all" || section == "dispatch") benchDispatch();
+    if (section == "all" || section == "integer") benchInteger();
+    return 0;
+}
@@ -0,0 +1,509 @@
+//
+// Symmetric eigen-decomposition and truncated SVD.
+//
+
+#include "decomposition.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <random>
+
+// Number of columns processed together by leftProduct
+static const int COLUMN_BLOCK = 256;
+// QL iterations allowed per eigenvalue before giving up
+static const int MAX_QL_ITERATIONS = 100;
+
+
+/*
+ * Householder reduction of the symmetric matrix v to a tridiagonal one
+ * On exit d is the diagonal, e the sub-diagonal (e[0] = 0) and v holds the
+ * accumulated orthogonal transformation (columns). EISPACK tred2.
+ */
+static void tridiagonalize(Matrix<double>& v, std::vector<double>& d, std::vector<double>& e) {
+    int n = v.getHeight();
+    // Row pointers taken once: the loops walk the columns, element access
+    // would check the sharing of v every time
+    std::vector<double*> a(n);
+    for (int i = 0; i < n; i++) {
+        a[i] = v(i).data();
+    }
+    for (int j = 0; j < n; j++) {
+        d[j] = a[n - 1][j];
+    }
+
+    for (int i = n - 1; i > 0; i--) {
+        double scale = 0;
+        double h = 0;
+        for (int k = 0; k < i; k++) {
+            scale += std::abs(d[k]);
+        }
+        if (scale == 0) {
+            e[i] = d[i - 1];
+            for (int j = 0; j < i; j++) {
+                d[j] = a[i - 1][j];
+                a[i][j] = 0;
+                a[j][i] = 0;
+            }
+        } else {
+            // Householder vector
+            for (int k = 0; k < i; k++) {
+                d[k] /= scale;
+                h += d[k] * d[k];
+            }
+            double f = d[i - 1];
+            double g = f > 0 ? -std::sqrt(h) : std::sqrt(h);
+            e[i] = scale * g;
+            h -= f * g;
+            d[i - 1] = f - g;
+            std::fill(e.begin(), e.begin() + i, 0.0);
+
+            // Apply the similarity transformation to the remaining columns
+            for (int j = 0; j < i; j++) {
+                f = d[j];
+                a[j][i] = f;
+                g = e[j] + a[j][j] * f;
+                for (int k = j + 1; k < i; k++) {
+                    g += a[k][j] * d[k];
+                    e[k] += a[k][j] * f;
+                }
+                e[j] = g;
+            }
+            f = 0;
+            for (int j = 0; j < i; j++) {
+                e[j] /= h;
+                f += e[j] * d[j];
+            }
+            double hh = f / (h + h);
+            for (int j = 0; j < i; j++) {
+                e[j] -= hh * d[j];
+            }
+            #pragma omp parallel for schedule(dynamic, 16) if(static_cast<long>(i) * i > PARALLEL_THRESHOLD)
+            for (int j = 0; j < i; j++) {
+                double fj = d[j];
+                double gj = e[j];
+                for (int k = j; k < i; k++) {
+                    a[k][j] -= fj * e[k] + gj * d[k];
+                }
+            }
+            for (int j = 0; j < i; j++) {
+                d[j] = a[i - 1][j];
+                a[i][j] = 0;
+            }
+        }
+        d[i] = h;
+    }
+
+    // Accumulate the transformations
+    for (int i = 0; i < n - 1; i++) {
+        a[n - 1][i] = a[i][i];
+        a[i][i] = 1;
+        double h = d[i + 1];
+        if (h != 0) {
+            for (int k = 0; k <= i; k++) {
+                d[k] = a[k][i + 1] / h;
+            }
+            #pragma omp parallel for schedule(static) if(static_cast<long>(i) * i > PARALLEL_THRESHOLD)
+            for (int j = 0; j <= i; j++) {
+                double g = 0;
+                for (int k = 0; k <= i; k++) {
+                    g += a[k][i + 1] * a[k][j];
+                }
+                for (int k = 0; k <= i; k++) {
+                    a[k][j] -= g * d[k];
+                }
+            }
+        }
+        for (int k = 0; k <= i; k++) {
+            a[k][i + 1] = 0;
+        }
+    }
+    for (int j = 0; j < n; j++) {
+        d[j] = a[n - 1][j];
+        a[n - 1][j] = 0;
+    }
+    if (n > 0) {
+        a[n - 1][n - 1] = 1;
+        e[0] = 0;
+    }
+}
+
+/*
+ * Eigenvalues d and eigenvectors z of a symmetric tridiagonal matrix by
+ * implicit QL iterations (EISPACK tql2). z holds a transformation applied
+ * on the left, one vector per row, so every rotation updates two
+ * contiguous rows. On entry e[i] is the element (i, i - 1).
+ */
+static void tridiagonalQL(std::vector<double>& d, std::vector<double>& e, Matrix<double>& z) {
+    int n = static_cast<int>(d.size());
+    int width = z.getWidth();
+    for (int i = 1; i < n; i++) {
+        e[i - 1] = e[i];
+    }
+    if (n > 0) {
+        e[n - 1] = 0;
+    }
+
+    double f = 0;
+    double largest = 0;
+    const double eps = std::numeric_limits<double>::epsilon();
+    for (int l = 0; l < n; l++) {
+        // Find a small sub-diagonal element
+        largest = std::max(largest, std::abs(d[l]) + std::abs(e[l]));
+        int m = l;
+        while (m < n - 1 && std::abs(e[m]) > eps * largest) {
+            m++;
+        }
+
+        int iteration = 0;
+        while (m > l && std::abs(e[l]) > eps * largest) {
+            if (++iteration > MAX_QL_ITERATIONS)
+                throw std::runtime_error("Eigenvalues did not converge.");
+
+            // Implicit shift
+            double g = d[l];
+            double p = (d[l + 1] - g) / (2 * e[l]);
+            double r = std::hypot(p, 1.0);
+            if (p < 0) {
+                r = -r;
+            }
+            d[l] = e[l] / (p + r);
+            d[l + 1] = e[l] * (p + r);
+            double dl1 = d[l + 1];
+            double h = g - d[l];
+            for (int i = l + 2; i < n; i++) {
+                d[i] -= h;
+            }
+            f += h;
+
+            // Implicit QL transformation
+            p = d[m];
+            double c = 1, c2 = 1, c3 = 1;
+            double el1 = e[l + 1];
+            double s = 0, s2 = 0;
+            for (int i = m - 1; i >= l; i--) {
+                c3 = c2;
+                c2 = c;
+                s2 = s;
+                g = c * e[i];
+                h = c * p;
+                r = std::hypot(p, e[i]);
+                e[i + 1] = s * r;
+                s = e[i] / r;
+                c = p / r;
+                p = c * d[i] - s * g;
+                d[i + 1] = h + s * (c * g + s * d[i]);
+
+                double* __restrict zi = z(i).data();
+                double* __restrict zi1 = z(i + 1).data();
+                for (int k = 0; k < width; k++) {
+                    double t = zi1[k];
+                    zi1[k] = s * zi[k] + c * t;
+                    zi[k] = c * zi[k] - s * t;
+                }
+            }
+            p = -s * s2 * c3 * el1 * e[l] / dl1;
+            e[l] = s * p;
+            d[l] = c * p;
+        }
+        d[l] += f;
+        e[l] = 0;
+    }
+}
+
+// Eigenpairs (d, rows of z) sorted by decreasing value, the k first ones converted to T
+template<typename T>
+static EigenDecomposition<T> sortedPairs(const std::vector<double>& d, const Matrix<double>& z, int k) {
+    std::vector<int> order(d.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&d](int a, int b) { return d[a] > d[b]; });
+
+    EigenDecomposition<T> result;
+    result.vectors = Matrix<T>(k, z.getWidth());
+    for (int i = 0; i < k; i++) {
+        result.values.push_back(static_cast<T>(d[order[i]]));
+        convertBulk(z(order[i]).data(), result.vectors(i).data(), z.getWidth());
+    }
+    return result;
+}
+
+template<typename T>
+EigenDecomposition<T> eigh(const Matrix<T>& m) {
+    if (m.getHeight() != m.getWidth())
+        throw std::invalid_argument("Matrix must be square.");
+
+    int n = m.getHeight();
+    Matrix<double> v = m.template astype<double>();
+    std::vector<double> d(n), e(n);
+    tridiagonalize(v, d, e);
+    // The eigenvectors are the columns of v times the ones of the tridiagonal matrix
+    Matrix<double> z = v.transpose();
+    tridiagonalQL(d, e, z);
+    return sortedPairs<T>(d, z, n);
+}
+
+
+/*
+ * Helpers of the truncated methods, vectors are rows of a Matrix<double>
+ */
+
+static double innerProduct(const double* a, const double* b, int n) {
+    return static_cast<double>(reduceDot(a, b, n, Summation::Naive));
+}
+
+// a -= coef * b
+static void subtractScaled(double* __restrict a, const double* __restrict b, double coef, int n) {
+    for (int i = 0; i < n; i++) {
+        a[i] -= coef * b[i];
+    }
+}
+
+// Makes row r orthogonal to the rows [0, r) of q and unit, classical Gram-Schmidt run twice
+static double orthonormalizeRow(Matrix<double>& q, int r) {
+    int n = q.getWidth();
+    double* row = q(r).data();
+    for (int pass = 0; pass < 2; pass++) {
+        std::vector<double> coefs(r);
+        #pragma omp parallel for schedule(static) if(static_cast<long>(r) * n > PARALLEL_THRESHOLD)
+        for (int i = 0; i < r; i++) {
+            coefs[i] = innerProduct(q(i).data(), row, n);
+        }
+        for (int i = 0; i < r; i++) {
+            subtractScaled(row, q(i).data(), coefs[i], n);
+        }
+    }
+    double norm = std::sqrt(innerProduct(row, row, n));
+    // A vector in the span of the previous ones is dropped
+    double inverse = norm > 1e-12 ? 1 / norm : 0;
+    for (int i = 0; i < n; i++) {
+        row[i] *= inverse;
+    }
+    return norm;
+}
+
+static void orthonormalizeRows(Matrix<double>& q) {
+    for (int r = 0; r < q.getHeight(); r++) {
+        orthonormalizeRow(q, r);
+    }
+}
+
+static Matrix<double> gaussianRows(int rows, int cols, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::normal_distribution<double> dist(0.0, 1.0);
+    Matrix<double> result(rows, cols);
+    for (int i = 0; i < rows; i++) {
+        double* row = result(i).data();
+        for (int j = 0; j < cols; j++) {
+            row[j] = dist(gen);
+        }
+    }
+    return result;
+}
+
+// (m x^T)^T for the rows x of xs: one pass over m for all the vectors
+template<typename T>
+static Matrix<double> rightProduct(const Matrix<T>& m, const Matrix<double>& xs) {
+    Matrix<T> xt = xs.transpose().template astype<T>();
+    return m.dot(xt, Summation::Widened).template astype<double>().transpose();
+}
+
+// xs m for the rows x of xs, i.e. (m^T x^T)^T without transposing m
+template<typename T>
+static Matrix<double> leftProduct(const Matrix<double>& xs, const Matrix<T>& m) {
+    int rows = m.getHeight();
+    int cols = m.getWidth();
+    int count = xs.getHeight();
+    Matrix<double> result(count, cols, 0.0);
+    #pragma omp parallel for schedule(static) if(static_cast<long>(rows) * cols * count > PARALLEL_THRESHOLD)
+    for (int start = 0; start < cols; start += COLUMN_BLOCK) {
+        int width = std::min(COLUMN_BLOCK, cols - start);
+        for (int i = 0; i < rows; i++) {
+            const T* row = m(i).data() + start;
+            for (int c = 0; c < count; c++) {
+                const double coef = xs(c, i);
+                double* __restrict out = result(c).data() + start;
+                for (int j = 0; j < width; j++) {
+                    out[j] += coef * static_cast<double>(row[j]);
+                }
+            }
+        }
+    }
+    return result;
+}
+
+template<typename T>
+static void checkRank(const Matrix<T>& m, int k) {
+    if (k < 1 || k > std::min(m.getHeight(), m.getWidth()))
+        throw std::invalid_argument("Number of components must be between 1 and the smallest dimension.");
+}
+
+template<typename T>
+EigenDecomposition<T> lanczos(const Matrix<T>& m, int k, double tolerance, int maxSteps, unsigned seed) {
+    if (m.getHeight() != m.getWidth())
+        throw std::invalid_argument("Matrix must be square.");
+    checkRank(m, k);
+
+    int n = m.getHeight();
+    int steps = std::min(n, maxSteps > 0 ? maxSteps : std::max(2 * k + 20, 40));
+    Matrix<double> q(steps, n, 0.0);
+    std::vector<double> alpha, beta;
+    std::vector<T> qt(n);
+    std::mt19937 gen(seed);
+    std::normal_distribution<double> dist(0.0, 1.0);
+
+    auto randomStart = [&](int j) {
+        double* row = q(j).data();
+        for (int i = 0; i < n; i++) {
+            row[i] = dist(gen);
+        }
+        return orthonormalizeRow(q, j) > 1e-12;
+    };
+    randomStart(0);
+
+    std::vector<double> d, e;
+    Matrix<double> z;
+    for (int j = 0; j < steps; j++) {
+        convertBulk(q(j).data(), qt.data(), n);
+        std::vector<T> w = m.dot(qt, Summation::Widened);
+        double* next = j + 1 < steps ? q(j + 1).data() : nullptr;
+        std::vector<double> wd(w.begin(), w.end());
+        alpha.push_back(innerProduct(wd.data(), q(j).data(), n));
+
+        // Ritz pairs of the tridiagonal matrix of the current basis
+        int size = j + 1;
+        d = alpha;
+        e.assign(size, 0.0);
+        for (int i = 1; i < size; i++) {
+            e[i] = beta[i - 1];
+        }
+        z = Matrix<double>(size, size, 0.0);
+        for (int i = 0; i < size; i++) {
+            z(i, i) = 1;
+        }
+
+        double residualNorm = 0;
+        if (next) {
+            std::copy(wd.begin(), wd.end(), next);
+            residualNorm = orthonormalizeRow(q, j + 1);
+        }
+        tridiagonalQL(d, e, z);
+        if (size < k && next) {
+            beta.push_back(residualNorm > 1e-12 ? residualNorm : 0);
+            if (residualNorm <= 1e-12) {
+                randomStart(j + 1);
+            }
+            continue;
+        }
+
+        // Residual of the Ritz pair i: |beta_j * last component of its vector|
+        std::vector<int> order(size);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&d](int a, int b) { return d[a] > d[b]; });
+        double scale = 0;
+        for (double value : d) {
+            scale = std::max(scale, std::abs(value));
+        }
+        bool converged = true;
+        for (int i = 0; i < k && i < size; i++) {
+            converged &= residualNorm * std::abs(z(order[i], j)) <= tolerance * scale;
+        }
+        if (converged || !next || residualNorm <= 1e-12) {
+            break;
+        }
+        beta.push_back(residualNorm);
+    }
+
+    // Ritz vectors: combinations of the basis vectors
+    int size = static_cast<int>(d.size());
+    Matrix<double> ritz(size, n, 0.0);
+    #pragma omp parallel for schedule(static) if(static_cast<long>(size) * size * n > PARALLEL_THRESHOLD)
+    for (int i = 0; i < size; i++) {
+        double* out = ritz(i).data();
+        for (int j = 0; j < size; j++) {
+            subtractScaled(out, q(j).data(), -z(i, j), n);
+        }
+    }
+    return sortedPairs<T>(d, ritz, std::min(k, size));
+}
+
+template<typename T>
+EigenDecomposition<T> randomizedEigh(const Matrix<T>& m, int k, int oversampling, int powerIterations, unsigned seed) {
+    if (m.getHeight() != m.getWidth())
+        throw std::invalid_argument("Matrix must be square.");
+    checkRank(m, k);
+
+    // Range of m: Q spans m^(q+1) Omega
+    int n = m.getHeight();
+    int l = std::min(n, k + std::max(oversampling, 0));
+    Matrix<double> q = gaussianRows(l, n, seed);
+    for (int p = 0; p <= powerIterations; p++) {
+        q = rightProduct(m, q);
+        orthonormalizeRows(q);
+    }
+
+    // Small symmetric problem B = Q^T m Q
+    Matrix<double> mq = rightProduct(m, q);
+    Matrix<double> b = mq.dot(q.transpose());
+    for (int i = 0; i < l; i++) {
+        for (int j = 0; j < i; j++) {
+            b(i, j) = b(j, i) = (b(i, j) + b(j, i)) / 2;
+        }
+    }
+    EigenDecomposition<double> small = eigh(b);
+    Matrix<double> vectors = small.vectors.dot(q);
+    return sortedPairs<T>(small.values, vectors, k);
+}
+
+template<typename T>
+SingularValueDecomposition<T> randomizedSvd(const Matrix<T>& m, int k, int oversampling, int powerIterations,
+                                            unsigned seed) {
+    checkRank(m, k);
+
+    // Range of m: Q spans (m m^T)^q m Omega, re-orthonormalized after every product
+    int rows = m.getHeight();
+    int cols = m.getWidth();
+    int l = std::min(std::min(rows, cols), k + std::max(oversampling, 0));
+    Matrix<double> q = rightProduct(m, gaussianRows(l, cols, seed));
+    orthonormalizeRows(q);
+    for (int p = 0; p < powerIterations; p++) {
+        Matrix<double> w = leftProduct(q, m);
+        orthonormalizeRows(w);
+        q = rightProduct(m, w);
+        orthonormalizeRows(q);
+    }
+
+    // B = Q^T m is l x cols, its left singular vectors are the eigenvectors of B B^T
+    Matrix<double> b = leftProduct(q, m);
+    Matrix<double> gram = b.dot(b.transpose());
+    EigenDecomposition<double> small = eigh(gram);
+    Matrix<double> u = small.vectors.dot(q);
+    Matrix<double> v = small.vectors.dot(b);
+
+    SingularValueDecomposition<T> result;
+    result.u = Matrix<T>(k, rows);
+    result.v = Matrix<T>(k, cols);
+    for (int i = 0; i < k; i++) {
+        double s = std::sqrt(std::max(small.values[i], 0.0));
+        double inverse = s > 0 ? 1 / s : 0;
+        double* row = v(i).data();
+        for (int j = 0; j < cols; j++) {
+            row[j] *= inverse;
+        }
+        result.s.push_back(static_cast<T>(s));
+        convertBulk(u(i).data(), result.u(i).data(), rows);
+        convertBulk(v(i).data(), result.v(i).data(), cols);
+    }
+    return result;
+}
+
+
+// Explicit instantiation
+template EigenDecomposition<float> eigh(const Matrix<float>& m);
+template EigenDecomposition<double> eigh(const Matrix<double>& m);
+template EigenDecomposition<float> lanczos(const Matrix<float>& m, int k, double tolerance, int maxSteps, unsigned seed);
+template EigenDecomposition<double> lanczos(const Matrix<double>& m, int k, double tolerance, int maxSteps, unsigned seed);
+template EigenDecomposition<float> randomizedEigh(const Matrix<float>& m, int k, int oversampling, int powerIterations, unsigned seed);
+template EigenDecomposition<double> randomizedEigh(const Matrix<double>& m, int k, int oversampling, int powerIterations, unsigned seed);
+template SingularValueDecomposition<float> randomizedSvd(const Matrix<float>& m, int k, int oversampling, int powerIterations, unsigned seed);
+template SingularValueDecomposition<double> randomizedSvd(const Matrix<double>& m, int k, int oversampling, int powerIterations, unsigned seed);
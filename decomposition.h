@@ -0,0 +1,68 @@
+//
+// Symmetric eigen-decomposition and truncated SVD.
+//
+
+#include <vector>
+
+#include "matrix.h"
+
+#ifndef DECOMPOSITION_H
+#define DECOMPOSITION_H
+
+
+/*
+ * Eigen-decomposition of a symmetric matrix
+ * values are sorted in decreasing order, vectors(i) is the unit eigenvector
+ * of values[i] (one eigenvector per row).
+ */
+template<typename T>
+struct EigenDecomposition {
+    std::vector<T> values;
+    Matrix<T> vectors;
+};
+
+/*
+ * Truncated singular value decomposition M ~ U^T diag(s) V
+ * s is sorted in decreasing order, u(i) and v(i) are the left and right
+ * singular vectors of s[i] (one vector per row).
+ */
+template<typename T>
+struct SingularValueDecomposition {
+    Matrix<T> u;
+    std::vector<T> s;
+    Matrix<T> v;
+};
+
+/*
+ * Full decomposition
+ * Householder reduction to a tridiagonal matrix then implicit QL iterations,
+ * computed in double. O(n^3): use the truncated methods for large inputs.
+ */
+template<typename T>
+EigenDecomposition<T> eigh(const Matrix<T>& m);
+
+/*
+ * Truncated decompositions (top k components)
+ * lanczos builds a Krylov basis with full reorthogonalization, one
+ * matrix-vector product per step, and stops when the k largest Ritz pairs
+ * have a residual below tolerance * |largest value| (or after maxSteps,
+ * 0 picks a default from k).
+ * randomizedEigh and randomizedSvd project the matrix on a random subspace
+ * of k + oversampling vectors refined by powerIterations passes (Halko,
+ * Martinsson & Tropp, 2011); every pass reads the matrix once for all the
+ * vectors. They are the fastest on matrices larger than memory bandwidth
+ * allows for many Lanczos steps, with a slightly lower accuracy.
+ */
+template<typename T>
+EigenDecomposition<T> lanczos(const Matrix<T>& m, int k, double tolerance=1e-8, int maxSteps=0, unsigned seed=42);
+
+template<typename T>
+EigenDecomposition<T> randomizedEigh(const Matrix<T>& m, int k, int oversampling=10, int powerIterations=2,
+                                     unsigned seed=42);
+
+template<typename T>
+SingularValueDecomposition<T> randomizedSvd(const Matrix<T>& m, int k, int oversampling=10, int powerIterations=2,
+                                            unsigned seed=42);
+
+
+#endif // DECOMPOSITION_H
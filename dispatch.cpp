@@ -0,0 +1,78 @@
+//
+// Runtime selection of the instruction set the hot kernels run with.
+//
+
+#include "dispatch.h"
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace dispatch {
+
+namespace detail {
+
+std::atomic<int> active{-1};
+
+// Variant named by MATRIX_ISA when it is set and supported, the best one otherwise
+int initialize() {
+    Isa isa = detect();
+    if (const char* requested = std::getenv("MATRIX_ISA")) {
+        for (int i = 0; i < ISA_COUNT; i++) {
+            if (std::strcmp(requested, name(static_cast<Isa>(i))) == 0 && supported(static_cast<Isa>(i))) {
+                isa = static_cast<Isa>(i);
+            }
+        }
+    }
+    int expected = -1;
+    active.compare_exchange_strong(expected, static_cast<int>(isa), std::memory_order_relaxed);
+    return active.load(std::memory_order_relaxed);
+}
+
+}
+
+const char* name(Isa isa) {
+    switch (isa) {
+        case Isa::Generic: return "generic";
+        case Isa::AVX2: return "avx2";
+        case Isa::AVX512: return "avx512";
+        default: return "unknown";
+    }
+}
+
+bool supported(Isa isa) {
+    switch (isa) {
+        case Isa::Generic:
+            return true;
+#if defined(MATRIX_DISPATCH)
+        case Isa::AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") &&
+                   __builtin_cpu_supports("bmi2") && __builtin_cpu_supports("f16c");
+        case Isa::AVX512:
+            return supported(Isa::AVX2) && __builtin_cpu_supports("avx512f") &&
+                   __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512dq") &&
+                   __builtin_cpu_supports("avx512vl") && __builtin_cpu_supports("avx512cd");
+#endif
+        default:
+            return false;
+    }
+}
+
+Isa detect() {
+    for (int i = ISA_COUNT - 1; i > 0; i--) {
+        if (supported(static_cast<Isa>(i))) {
+            return static_cast<Isa>(i);
+        }
+    }
+    return Isa::Generic;
+}
+
+void force(Isa isa) {
+    if (!supported(isa)) {
+        throw std::invalid_argument(std::string("Instruction set ") + name(isa) + " is not supported.");
+    }
+    detail::active.store(static_cast<int>(isa), std::memory_order_relaxed);
+}
+
+} // namespace dispatch
@@ -0,0 +1,93 @@
+//
+// Runtime selection of the instruction set the hot kernels run with.
+//
+
+#include <atomic>
+
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+// x86-64 builds carry AVX2 and AVX-512 variants of the hot kernels unless
+// built for the host CPU only (MATRIX_NATIVE in CMake)
+#if !defined(MATRIX_NO_DISPATCH) && defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define MATRIX_DISPATCH 1
+#endif
+
+/*
+ * Instruction set dispatch
+ * The kernels are compiled for the baseline target of the build and, on
+ * x86-64, again for AVX2 (x86-64-v3) and AVX-512 (x86-64-v4). run(f)
+ * calls f through a function built for the active instruction set: f and
+ * everything it calls are inlined there (flatten) and vectorized for it.
+ * The active instruction set is the best one the CPU supports (CPUID),
+ * chosen on first use. The MATRIX_ISA environment variable (generic, avx2
+ * or avx512) or force() select another one, to compare the variants on a
+ * single machine.
+ *
+ * The variants give the same results: the kernels fix their order of
+ * operations and the build turns off floating point contraction
+ * (-ffp-contract=off), so no multiply-add is fused in the wider variants.
+ * The one exception is the double exp, log, log1p and pow of the generic
+ * variant, which may call the C library instead (elementwise.h).
+ *
+ * Dispatched so far: Matrix dot (matrix and vector), dotTransposed, sum,
+ * cumuSum, max, min and transpose, add, subtract, multiply, divide and
+ * their compound operators, the elementwise functions and the integer
+ * kernels. run() costs a load and a
+ * branch, it is called once per row or tile rather than per element. The
+ * float16 conversions (half.h) switch on active() to their own F16C and
+ * AVX-512 functions instead.
+ */
+
+namespace dispatch {
+
+enum class Isa { Generic, AVX2, AVX512 };
+constexpr int ISA_COUNT = 3;
+
+// Name used by MATRIX_ISA: "generic", "avx2" or "avx512"
+const char* name(Isa isa);
+// Whether the CPU and this build can run the variant, Generic always can
+bool supported(Isa isa);
+// Best variant supported
+Isa detect();
+// Runs the variant from now on, throws std::invalid_argument if it is not supported
+void force(Isa isa);
+
+namespace detail {
+// Index of the active Isa, -1 until the first use
+extern std::atomic<int> active;
+int initialize();
+}
+
+inline Isa active() {
+    int isa = detail::active.load(std::memory_order_relaxed);
+    if (isa < 0) {
+        isa = detail::initialize();
+    }
+    return static_cast<Isa>(isa);
+}
+
+#if defined(MATRIX_DISPATCH)
+template<typename F>
+__attribute__((target("arch=x86-64-v3"), flatten)) void runAVX2(F& f) { f(); }
+template<typename F>
+__attribute__((target("arch=x86-64-v4,prefer-vector-width=256"), flatten)) void runAVX512(F& f) { f(); }
+#endif
+
+// Calls f() compiled for the active instruction set
+template<typename F>
+inline void run(F&& f) {
+#if defined(MATRIX_DISPATCH)
+    switch (active()) {
+        case Isa::AVX512: runAVX512(f); return;
+        case Isa::AVX2: runAVX2(f); return;
+        default: break;
+    }
+#endif
+    f();
+}
+
+}
+
+
+#endif // DISPATCH_H
@@ -0,0 +1,480 @@
+//
+// Matrices distributed over MPI ranks with a 2D block-cyclic layout.
+//
+
+#include "distributed_matrix.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+// File header, padded to HEADER_BYTES
+static const char MAGIC[8] = {'M', 'D', 'E', 'N', 'S', 'E', '0', '1'};
+static const int HEADER_BYTES = 64;
+
+namespace {
+
+struct Header {
+    char magic[8];
+    uint32_t elementSize;
+    int32_t rows;
+    int32_t cols;
+};
+
+template<typename T> struct MpiType;
+template<> struct MpiType<int> { static MPI_Datatype get() { return MPI_INT; } };
+template<> struct MpiType<float> { static MPI_Datatype get() { return MPI_FLOAT; } };
+template<> struct MpiType<double> { static MPI_Datatype get() { return MPI_DOUBLE; } };
+
+// MPI_MAX / MPI_MIN leave NaN to the implementation, this reduction propagates it like Matrix::max
+template<typename T, bool Greater>
+void combineExtremes(void* in, void* inout, int* length, MPI_Datatype*) {
+    const T* a = static_cast<const T*>(in);
+    T* b = static_cast<T*>(inout);
+    for (int i = 0; i < *length; i++) {
+        if (a[i] != a[i] || b[i] != b[i]) {
+            b[i] = std::numeric_limits<T>::quiet_NaN();
+        }
+        else if (Greater ? a[i] > b[i] : a[i] < b[i]) {
+            b[i] = a[i];
+        }
+    }
+}
+
+} // namespace
+
+
+/*
+ * Process grid
+ */
+
+ProcessGrid::ProcessGrid(MPI_Comm comm, int rows, int cols) : rows_(rows), cols_(cols) {
+    int size = 0;
+    MPI_Comm_size(comm, &size);
+    if (rows <= 0 || cols <= 0 || rows * cols != size)
+        throw std::invalid_argument("Grid size must match the number of ranks.");
+    MPI_Comm_dup(comm, &comm_);
+    MPI_Comm_rank(comm_, &rank_);
+    MPI_Comm_split(comm_, myRow(), myCol(), &rowComm_);
+    MPI_Comm_split(comm_, myCol(), myRow(), &colComm_);
+}
+
+ProcessGrid ProcessGrid::create(MPI_Comm comm) {
+    int size = 0;
+    MPI_Comm_size(comm, &size);
+    int rows = static_cast<int>(std::sqrt(static_cast<double>(size)));
+    while (size % rows != 0) {
+        rows--;
+    }
+    return ProcessGrid(comm, rows, size / rows);
+}
+
+ProcessGrid::~ProcessGrid() {
+    int finalized = 0;
+    MPI_Finalized(&finalized);
+    if (!finalized) {
+        for (MPI_Comm* c : {&rowComm_, &colComm_, &comm_}) {
+            if (*c != MPI_COMM_NULL) {
+                MPI_Comm_free(c);
+            }
+        }
+    }
+}
+
+
+/*
+ * Layout
+ */
+
+template<typename T>
+int DistributedMatrix<T>::localSize(int n, int block, int p, int procs) {
+    const int blocks = n / block;
+    int size = blocks / procs * block;
+    const int extra = blocks % procs;
+    if (p < extra) {
+        size += block;
+    }
+    else if (p == extra) {
+        size += n % block;
+    }
+    return size;
+}
+
+template<typename T>
+DistributedMatrix<T>::DistributedMatrix(const ProcessGrid& grid, int rows, int cols, int block)
+    : DistributedMatrix(grid, rows, cols, block, T(0)) {}
+
+template<typename T>
+DistributedMatrix<T>::DistributedMatrix(const ProcessGrid& grid, int rows, int cols, int block, T defaultValue)
+    : grid_(&grid), height_(rows), width_(cols), block_(block) {
+    if (rows < 0 || cols < 0 || block <= 0)
+        throw std::invalid_argument("Dimensions must be positive.");
+    local_ = Matrix<T>(localSize(rows, block, grid.myRow(), grid.getRows()),
+                       localSize(cols, block, grid.myCol(), grid.getCols()), defaultValue);
+}
+
+template<typename T>
+void DistributedMatrix<T>::checkSameLayout(const DistributedMatrix<T>& m) const {
+    if (grid_ != m.grid_ || block_ != m.block_)
+        throw std::invalid_argument("Matrices must share the grid and block size.");
+    if (height_ != m.height_ || width_ != m.width_)
+        throw std::invalid_argument("Matrix dimension must be the same.");
+}
+
+template<typename T>
+DistributedMatrix<T> DistributedMatrix<T>::fromMatrix(const ProcessGrid& grid, const Matrix<T>& m, int block) {
+    DistributedMatrix<T> result(grid, m.getHeight(), m.getWidth(), block);
+    for (int li = 0; li < result.local_.getHeight(); li++) {
+        const T* in = m(result.globalRow(li)).data();
+        T* out = result.local_(li).data();
+        // Local columns come by runs of block contiguous global columns
+        for (int lj = 0; lj < result.local_.getWidth(); lj += block) {
+            const int n = std::min(block, result.local_.getWidth() - lj);
+            std::copy(in + result.globalCol(lj), in + result.globalCol(lj) + n, out + lj);
+        }
+    }
+    return result;
+}
+
+template<typename T>
+Matrix<T> DistributedMatrix<T>::gather(int root) const {
+    const int P = grid_->getRows();
+    const int Q = grid_->getCols();
+    const int lr = local_.getHeight();
+    const int lc = local_.getWidth();
+    std::vector<T> buffer(static_cast<std::size_t>(lr) * lc);
+    for (int li = 0; li < lr; li++) {
+        std::copy(local_(li).begin(), local_(li).end(), buffer.begin() + static_cast<std::size_t>(li) * lc);
+    }
+    const bool isRoot = grid_->rank() == root;
+    std::vector<int> counts(isRoot ? P * Q : 0);
+    std::vector<int> offsets(isRoot ? P * Q : 0);
+    std::vector<T> all;
+    if (isRoot) {
+        int total = 0;
+        for (int r = 0; r < P * Q; r++) {
+            counts[r] = localSize(height_, block_, r / Q, P) * localSize(width_, block_, r % Q, Q);
+            offsets[r] = total;
+            total += counts[r];
+        }
+        all.resize(total);
+    }
+    MPI_Gatherv(buffer.data(), static_cast<int>(buffer.size()), MpiType<T>::get(), all.data(), counts.data(),
+                offsets.data(), MpiType<T>::get(), root, grid_->comm());
+    if (!isRoot) {
+        return Matrix<T>();
+    }
+    Matrix<T> result(height_, width_);
+    for (int r = 0; r < P * Q; r++) {
+        const int pr = r / Q;
+        const int pc = r % Q;
+        const int rows = localSize(height_, block_, pr, P);
+        const int cols = localSize(width_, block_, pc, Q);
+        const T* data = all.data() + offsets[r];
+        for (int li = 0; li < rows; li++) {
+            T* out = result(toGlobal(li, pr, P)).data();
+            for (int lj = 0; lj < cols; lj++) {
+                out[toGlobal(lj, pc, Q)] = data[static_cast<std::size_t>(li) * cols + lj];
+            }
+        }
+    }
+    return result;
+}
+
+
+/*
+ * Elementwise operations
+ */
+
+template<typename T>
+template<typename F>
+DistributedMatrix<T> DistributedMatrix<T>::elementwise(const DistributedMatrix<T>& m, F f) const {
+    checkSameLayout(m);
+    DistributedMatrix<T> result(*grid_, height_, width_, block_);
+    long work = static_cast<long>(local_.getHeight()) * local_.getWidth();
+    #pragma omp parallel for schedule(static) if(work > PARALLEL_THRESHOLD)
+    for (int i = 0; i < local_.getHeight(); i++) {
+        const T* a = local_(i).data();
+        const T* b = m.local_(i).data();
+        T* out = result.local_(i).data();
+        for (int j = 0; j < local_.getWidth(); j++) {
+            out[j] = f(a[j], b[j]);
+        }
+    }
+    return result;
+}
+
+template<typename T>
+DistributedMatrix<T> DistributedMatrix<T>::add(const DistributedMatrix<T>& m) const {
+    return elementwise(m, [](T a, T b) { return a + b; });
+}
+
+template<typename T>
+DistributedMatrix<T> DistributedMatrix<T>::subtract(const DistributedMatrix<T>& m) const {
+    return elementwise(m, [](T a, T b) { return a - b; });
+}
+
+template<typename T>
+DistributedMatrix<T> DistributedMatrix<T>::multiply(const DistributedMatrix<T>& m) const {
+    return elementwise(m, [](T a, T b) { return a * b; });
+}
+
+template<typename T>
+DistributedMatrix<T> DistributedMatrix<T>::divide(const DistributedMatrix<T>& m) const {
+    return elementwise(m, [](T a, T b) { return a / b; });
+}
+
+template<typename T>
+DistributedMatrix<T> DistributedMatrix<T>::multiply(const T& value) const {
+    return map([value](T a) { return a * value; });
+}
+
+
+/*
+ * SUMMA product
+ * The panels of step k + 1 are broadcast with MPI_Ibcast while the local
+ * product of step k runs.
+ */
+template<typename T>
+DistributedMatrix<T> DistributedMatrix<T>::dot(const DistributedMatrix<T>& m) const {
+    if (width_ != m.height_)
+        throw std::invalid_argument("Dot product not compatible.");
+    if (grid_ != m.grid_ || block_ != m.block_)
+        throw std::invalid_argument("Matrices must share the grid and block size.");
+    MATRIX_PROFILE(Dot, height_, m.width_, static_cast<long>(height_) * width_ * m.width_,
+                   sizeof(T) * static_cast<long>(local_.getHeight()) * m.local_.getWidth());
+    const int P = grid_->getRows();
+    const int Q = grid_->getCols();
+    DistributedMatrix<T> result(*grid_, height_, m.width_, block_, T(0));
+    const int lr = local_.getHeight();
+    const int lc = m.local_.getWidth();
+    const int steps = (width_ + block_ - 1) / block_;
+
+    // Panels of step k: A(:, k) is lr x w, B(k, :) is w x lc
+    std::vector<T> aPanel[2] = {std::vector<T>(static_cast<std::size_t>(lr) * block_),
+                                std::vector<T>(static_cast<std::size_t>(lr) * block_)};
+    std::vector<T> bPanel[2] = {std::vector<T>(static_cast<std::size_t>(block_) * lc),
+                                std::vector<T>(static_cast<std::size_t>(block_) * lc)};
+    MPI_Request requests[2][2];
+    auto post = [&](int k) {
+        const int w = std::min(block_, width_ - k * block_);
+        std::vector<T>& a = aPanel[k % 2];
+        std::vector<T>& b = bPanel[k % 2];
+        if (grid_->myCol() == k % Q) {
+            const int lj = k / Q * block_;
+            for (int i = 0; i < lr; i++) {
+                std::copy(local_(i).data() + lj, local_(i).data() + lj + w, a.data() + static_cast<std::size_t>(i) * w);
+            }
+        }
+        if (grid_->myRow() == k % P) {
+            const int li = k / P * block_;
+            for (int kk = 0; kk < w; kk++) {
+                std::copy(m.local_(li + kk).begin(), m.local_(li + kk).end(), b.data() + static_cast<std::size_t>(kk) * lc);
+            }
+        }
+        // rowComm ranks are the grid columns, colComm ranks the grid rows
+        MPI_Ibcast(a.data(), lr * w, MpiType<T>::get(), k % Q, grid_->rowComm(), &requests[k % 2][0]);
+        MPI_Ibcast(b.data(), w * lc, MpiType<T>::get(), k % P, grid_->colComm(), &requests[k % 2][1]);
+    };
+
+    if (steps > 0) {
+        post(0);
+    }
+    for (int k = 0; k < steps; k++) {
+        MPI_Waitall(2, requests[k % 2], MPI_STATUSES_IGNORE);
+        if (k + 1 < steps) {
+            post(k + 1);
+        }
+        const int w = std::min(block_, width_ - k * block_);
+        const T* a = aPanel[k % 2].data();
+        const T* b = bPanel[k % 2].data();
+        long work = static_cast<long>(lr) * w * lc;
+        #pragma omp parallel for schedule(static) if(work > PARALLEL_THRESHOLD)
+        for (int i = 0; i < lr; i++) {
+            T* __restrict c = result.local_(i).data();
+            for (int kk = 0; kk < w; kk++) {
+                const T aik = a[static_cast<std::size_t>(i) * w + kk];
+                const T* __restrict bRow = b + static_cast<std::size_t>(kk) * lc;
+                for (int j = 0; j < lc; j++) {
+                    c[j] += aik * bRow[j];
+                }
+            }
+        }
+    }
+    return result;
+}
+
+
+/*
+ * Reductions
+ * Each rank fills the entries of its rows (columns) of a full-length
+ * vector, the identity elsewhere, then MPI_Allreduce combines them.
+ */
+
+template<typename T>
+T DistributedMatrix<T>::sum() const {
+    using Wide = typename Widened<T>::type;
+    MATRIX_PROFILE(Sum, height_, width_, static_cast<long>(height_) * width_, 0);
+    Wide total = 0;
+    for (int i = 0; i < local_.getHeight(); i++) {
+        total += reduceSum(local_(i).data(), local_.getWidth(), Summation::Naive);
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &total, 1, MpiType<Wide>::get(), MPI_SUM, grid_->comm());
+    return static_cast<T>(total);
+}
+
+template<typename T>
+std::vector<T> DistributedMatrix<T>::sum(int axis) const {
+    using Wide = typename Widened<T>::type;
+    if (axis != 0 && axis != 1)
+        throw std::invalid_argument("Axis must be 0 or 1.");
+    MATRIX_PROFILE(Sum, height_, width_, static_cast<long>(height_) * width_, 0);
+    std::vector<Wide> sums(axis == 0 ? height_ : width_, Wide(0));
+    if (axis == 0) {
+        for (int i = 0; i < local_.getHeight(); i++) {
+            sums[globalRow(i)] = reduceSum(local_(i).data(), local_.getWidth(), Summation::Naive);
+        }
+    }
+    else {
+        for (int i = 0; i < local_.getHeight(); i++) {
+            const T* row = local_(i).data();
+            for (int j = 0; j < local_.getWidth(); j++) {
+                sums[globalCol(j)] += row[j];
+            }
+        }
+    }
+    MPI_Allreduce(MPI_IN_PLACE, sums.data(), static_cast<int>(sums.size()), MpiType<Wide>::get(), MPI_SUM,
+                  grid_->comm());
+    return std::vector<T>(sums.begin(), sums.end());
+}
+
+template<typename T>
+template<bool Greater>
+std::vector<T> DistributedMatrix<T>::extreme(int axis) const {
+    if (axis != 0 && axis != 1)
+        throw std::invalid_argument("Axis must be 0 or 1.");
+    if (height_ == 0 || width_ == 0)
+        throw std::out_of_range("Cannot reduce an empty matrix.");
+    const T identity = std::numeric_limits<T>::has_infinity
+        ? (Greater ? -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::infinity())
+        : (Greater ? std::numeric_limits<T>::lowest() : std::numeric_limits<T>::max());
+    std::vector<T> result(axis == 0 ? height_ : width_, identity);
+    if (local_.getHeight() > 0 && local_.getWidth() > 0) {
+        std::vector<T> partial = Greater ? local_.max(axis) : local_.min(axis);
+        for (int x = 0; x < static_cast<int>(partial.size()); x++) {
+            result[axis == 0 ? globalRow(x) : globalCol(x)] = partial[x];
+        }
+    }
+    MPI_Op op;
+    MPI_Op_create(&combineExtremes<T, Greater>, 1, &op);
+    MPI_Allreduce(MPI_IN_PLACE, result.data(), static_cast<int>(result.size()), MpiType<T>::get(), op,
+                  grid_->comm());
+    MPI_Op_free(&op);
+    return result;
+}
+
+template<typename T>
+std::vector<T> DistributedMatrix<T>::max(int axis) const {
+    MATRIX_PROFILE(Max, height_, width_, static_cast<long>(height_) * width_, 0);
+    return extreme<true>(axis);
+}
+
+template<typename T>
+std::vector<T> DistributedMatrix<T>::min(int axis) const {
+    MATRIX_PROFILE(Min, height_, width_, static_cast<long>(height_) * width_, 0);
+    return extreme<false>(axis);
+}
+
+
+/*
+ * Parallel I/O
+ * The darray type selects the blocks of this rank in the row-major file,
+ * in the order of the local matrix.
+ */
+
+template<typename T>
+static MPI_Datatype blockCyclicType(const ProcessGrid& grid, int rows, int cols, int block) {
+    int sizes[2] = {rows, cols};
+    int distributions[2] = {MPI_DISTRIBUTE_CYCLIC, MPI_DISTRIBUTE_CYCLIC};
+    int blocks[2] = {block, block};
+    int procs[2] = {grid.getRows(), grid.getCols()};
+    MPI_Datatype type;
+    MPI_Type_create_darray(grid.getRows() * grid.getCols(), grid.rank(), 2, sizes, distributions, blocks, procs,
+                           MPI_ORDER_C, MpiType<T>::get(), &type);
+    MPI_Type_commit(&type);
+    return type;
+}
+
+template<typename T>
+void DistributedMatrix<T>::write(const std::string& filePath) const {
+    MATRIX_PROFILE(DumpToProto, height_, width_, static_cast<long>(height_) * width_,
+                   sizeof(T) * static_cast<long>(local_.getHeight()) * local_.getWidth());
+    MPI_File file;
+    if (MPI_File_open(grid_->comm(), filePath.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL,
+                      &file) != MPI_SUCCESS)
+        throw std::runtime_error("Cannot open " + filePath + " for writing.");
+    MPI_File_set_size(file, 0);
+    if (grid_->rank() == 0) {
+        char header[HEADER_BYTES] = {};
+        Header h{};
+        std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+        h.elementSize = sizeof(T);
+        h.rows = height_;
+        h.cols = width_;
+        std::memcpy(header, &h, sizeof(h));
+        MPI_File_write_at(file, 0, header, HEADER_BYTES, MPI_BYTE, MPI_STATUS_IGNORE);
+    }
+    if (height_ > 0 && width_ > 0) {
+        const int lr = local_.getHeight();
+        const int lc = local_.getWidth();
+        std::vector<T> buffer(static_cast<std::size_t>(lr) * lc);
+        for (int i = 0; i < lr; i++) {
+            std::copy(local_(i).begin(), local_(i).end(), buffer.begin() + static_cast<std::size_t>(i) * lc);
+        }
+        MPI_Datatype type = blockCyclicType<T>(*grid_, height_, width_, block_);
+        MPI_File_set_view(file, HEADER_BYTES, MpiType<T>::get(), type, "native", MPI_INFO_NULL);
+        MPI_File_write_all(file, buffer.data(), static_cast<int>(buffer.size()), MpiType<T>::get(),
+                           MPI_STATUS_IGNORE);
+        MPI_Type_free(&type);
+    }
+    MPI_File_close(&file);
+}
+
+template<typename T>
+DistributedMatrix<T> DistributedMatrix<T>::read(const ProcessGrid& grid, const std::string& filePath, int block) {
+    MPI_File file;
+    if (MPI_File_open(grid.comm(), filePath.c_str(), MPI_MODE_RDONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS)
+        throw std::runtime_error("Cannot open " + filePath + " for reading.");
+    Header h{};
+    MPI_File_read_at_all(file, 0, &h, sizeof(h), MPI_BYTE, MPI_STATUS_IGNORE);
+    if (std::memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0 || h.elementSize != sizeof(T) || h.rows < 0 || h.cols < 0) {
+        MPI_File_close(&file);
+        throw std::runtime_error(filePath + " is not a distributed matrix of this element type.");
+    }
+    MATRIX_PROFILE(LoadFromProto, h.rows, h.cols, static_cast<long>(h.rows) * h.cols, 0);
+    DistributedMatrix<T> result(grid, h.rows, h.cols, block);
+    if (h.rows > 0 && h.cols > 0) {
+        const int lr = result.local_.getHeight();
+        const int lc = result.local_.getWidth();
+        std::vector<T> buffer(static_cast<std::size_t>(lr) * lc);
+        MPI_Datatype type = blockCyclicType<T>(grid, h.rows, h.cols, block);
+        MPI_File_set_view(file, HEADER_BYTES, MpiType<T>::get(), type, "native", MPI_INFO_NULL);
+        MPI_File_read_all(file, buffer.data(), static_cast<int>(buffer.size()), MpiType<T>::get(),
+                          MPI_STATUS_IGNORE);
+        MPI_Type_free(&type);
+        for (int i = 0; i < lr; i++) {
+            std::copy(buffer.begin() + static_cast<std::size_t>(i) * lc,
+                      buffer.begin() + static_cast<std::size_t>(i + 1) * lc, result.local_(i).begin());
+        }
+    }
+    MPI_File_close(&file);
+    return result;
+}
+
+
+// Explicit instantiation
+template class DistributedMatrix<int>;
+template class DistributedMatrix<float>;
+template class DistributedMatrix<double>;
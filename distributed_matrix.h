@@ -0,0 +1,157 @@
+//
+// Matrices distributed over MPI ranks with a 2D block-cyclic layout.
+// Built only with the CMake option MATRIX_MPI.
+//
+
+#include <string>
+#include <vector>
+
+#include <mpi.h>
+
+#include "matrix.h"
+
+#ifndef DISTRIBUTED_MATRIX_H
+#define DISTRIBUTED_MATRIX_H
+
+
+// Default distribution block (rows and columns)
+constexpr int DEFAULT_DISTRIBUTION_BLOCK = 64;
+
+/*
+ * ProcessGrid
+ * The ranks of comm arranged as a rows x cols grid in row-major order:
+ * rank r is at (r / cols, r % cols), the order MPI_Type_create_darray
+ * expects. rowComm holds the ranks of the same grid row, colComm those of
+ * the same grid column. create() picks the most square grid.
+ */
+class ProcessGrid {
+public:
+    ProcessGrid(MPI_Comm comm, int rows, int cols);
+    static ProcessGrid create(MPI_Comm comm=MPI_COMM_WORLD);
+    ProcessGrid(const ProcessGrid&) = delete;
+    ProcessGrid& operator=(const ProcessGrid&) = delete;
+    ~ProcessGrid();
+
+    [[nodiscard]] inline MPI_Comm comm() const { return comm_; }
+    [[nodiscard]] inline MPI_Comm rowComm() const { return rowComm_; }
+    [[nodiscard]] inline MPI_Comm colComm() const { return colComm_; }
+    [[nodiscard]] inline int rank() const { return rank_; }
+    [[nodiscard]] inline int getRows() const { return rows_; }
+    [[nodiscard]] inline int getCols() const { return cols_; }
+    [[nodiscard]] inline int myRow() const { return rank_ / cols_; }
+    [[nodiscard]] inline int myCol() const { return rank_ % cols_; }
+
+private:
+    MPI_Comm comm_ = MPI_COMM_NULL;
+    MPI_Comm rowComm_ = MPI_COMM_NULL;
+    MPI_Comm colComm_ = MPI_COMM_NULL;
+    int rank_ = 0;
+    int rows_ = 1;
+    int cols_ = 1;
+};
+
+/*
+ * DistributedMatrix class
+ * A rows x cols matrix cut in block x block blocks dealt block-cyclically
+ * over the process grid (ScaLAPACK layout): block (I, J) is owned by grid
+ * process (I % P, J % Q). Each rank stores its blocks as one local
+ * Matrix<T>, global element (i, j) at local
+ * ((i / block) / P * block + i % block, (j / block) / Q * block + j % block).
+ * The cyclic distribution balances the rows and columns of every rank
+ * whatever part of the matrix an operation touches.
+ *
+ * Every operation is collective: all the ranks of the grid must call it.
+ * Operands must share the grid, shape and block size.
+ *
+ * dot uses SUMMA: for each block column k of A (block row k of B), the
+ * owners broadcast their panel along the grid rows (columns), then every
+ * rank adds the product of the two panels to its local blocks of C. Only
+ * panels travel, never whole matrices.
+ *
+ * sum(axis), max(axis) and min(axis) reduce the local blocks, then
+ * combine the partial results of all the ranks with MPI_Allreduce: every
+ * rank gets the whole vector. Axis 0 gives one value per row, like Matrix.
+ *
+ * write() / read() use MPI-IO: each rank writes (reads) its own blocks of
+ * one file, described by MPI_Type_create_darray. The file is a 64-byte
+ * header followed by the matrix in row-major order, independent of the
+ * grid: it can be read back with another number of ranks.
+ */
+template<typename T>
+class DistributedMatrix {
+public:
+    DistributedMatrix(const ProcessGrid& grid, int rows, int cols, int block=DEFAULT_DISTRIBUTION_BLOCK);
+    DistributedMatrix(const ProcessGrid& grid, int rows, int cols, int block, T defaultValue);
+    DistributedMatrix(DistributedMatrix<T>&& m) noexcept = default;
+    DistributedMatrix(const DistributedMatrix<T>& m) = delete;
+
+    // Each rank keeps its blocks of m (every rank holds the whole m)
+    static DistributedMatrix<T> fromMatrix(const ProcessGrid& grid, const Matrix<T>& m,
+                                           int block=DEFAULT_DISTRIBUTION_BLOCK);
+    // The whole matrix on root, an empty matrix on the other ranks
+    Matrix<T> gather(int root=0) const;
+
+    // Inline getters
+    [[nodiscard]] inline int getHeight() const { return height_; }
+    [[nodiscard]] inline int getWidth() const { return width_; }
+    [[nodiscard]] inline std::pair<int, int> getShape() const { return std::make_pair(height_, width_); }
+    [[nodiscard]] inline int getBlock() const { return block_; }
+    [[nodiscard]] inline const ProcessGrid& getGrid() const { return *grid_; }
+    [[nodiscard]] inline Matrix<T>& local() { return local_; }
+    [[nodiscard]] inline const Matrix<T>& local() const { return local_; }
+
+    // Global index of a local row / column
+    [[nodiscard]] inline int globalRow(int li) const { return toGlobal(li, grid_->myRow(), grid_->getRows()); }
+    [[nodiscard]] inline int globalCol(int lj) const { return toGlobal(lj, grid_->myCol(), grid_->getCols()); }
+
+    // Elementwise operations, local to every rank
+    DistributedMatrix<T> add(const DistributedMatrix<T>& m) const;
+    DistributedMatrix<T> subtract(const DistributedMatrix<T>& m) const;
+    DistributedMatrix<T> multiply(const DistributedMatrix<T>& m) const;
+    DistributedMatrix<T> divide(const DistributedMatrix<T>& m) const;
+    DistributedMatrix<T> multiply(const T& value) const;
+    template<typename F> DistributedMatrix<T> map(F f) const;
+
+    DistributedMatrix<T> dot(const DistributedMatrix<T>& m) const;
+
+    T sum() const;
+    std::vector<T> sum(int axis) const;
+    std::vector<T> max(int axis) const;
+    std::vector<T> min(int axis) const;
+
+    void write(const std::string& filePath) const;
+    static DistributedMatrix<T> read(const ProcessGrid& grid, const std::string& filePath,
+                                     int block=DEFAULT_DISTRIBUTION_BLOCK);
+
+private:
+    // Number of rows (columns) of n owned by grid coordinate p out of procs (ScaLAPACK numroc)
+    static int localSize(int n, int block, int p, int procs);
+    inline int toGlobal(int l, int p, int procs) const { return (l / block_ * procs + p) * block_ + l % block_; }
+
+    void checkSameLayout(const DistributedMatrix<T>& m) const;
+    template<typename F> DistributedMatrix<T> elementwise(const DistributedMatrix<T>& m, F f) const;
+    template<bool Greater> std::vector<T> extreme(int axis) const;
+
+    const ProcessGrid* grid_;
+    Matrix<T> local_;
+    int height_ = 0;
+    int width_ = 0;
+    int block_ = DEFAULT_DISTRIBUTION_BLOCK;
+};
+
+template<typename T>
+template<typename F>
+DistributedMatrix<T> DistributedMatrix<T>::map(F f) const {
+    DistributedMatrix<T> result(*grid_, height_, width_, block_);
+    for (int i = 0; i < local_.getHeight(); i++) {
+        const T* in = local_(i).data();
+        T* out = result.local_(i).data();
+        for (int j = 0; j < local_.getWidth(); j++) {
+            out[j] = f(in[j]);
+        }
+    }
+    return result;
+}
+
+
+#endif // DISTRIBUTED_MATRIX_H
@@ -0,0 +1,481 @@
+//
+// Elementwise math functions, comparisons and selection.
+//
+
+#include "elementwise.h"
+#include "dispatch.h"
+#include "parallel.h"
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+
+/*
+ * Vectorizable kernels
+ * Only arithmetic and integer bit operations: no branch and no call, so
+ * every loop over them is vectorized. Floating point selects are bit masks
+ * (select below), a conditional expression is not if-converted under
+ * -ftrapping-math (the default). Constants are the ones of fdlibm / Cephes.
+ */
+
+namespace {
+
+template<typename F> struct Bits;
+template<> struct Bits<float> {
+    using Int = int32_t;
+    static constexpr int MANTISSA = 23;
+    static constexpr Int BIAS = 127;
+    static constexpr Int EXPONENT_MASK = 0xff;
+    static constexpr Int MANTISSA_MASK = 0x7fffff;
+    // Adding ROUND rounds to an integer held in the low bits of the mantissa
+    static constexpr float ROUND = 12582912.0f;
+};
+template<> struct Bits<double> {
+    using Int = int64_t;
+    static constexpr int MANTISSA = 52;
+    static constexpr Int BIAS = 1023;
+    static constexpr Int EXPONENT_MASK = 0x7ff;
+    static constexpr Int MANTISSA_MASK = 0xfffffffffffffLL;
+    static constexpr double ROUND = 6755399441055744.0;
+};
+
+template<typename F>
+inline typename Bits<F>::Int toBits(F x) {
+    typename Bits<F>::Int i;
+    std::memcpy(&i, &x, sizeof(F));
+    return i;
+}
+
+template<typename F>
+inline F fromBits(typename Bits<F>::Int i) {
+    F x;
+    std::memcpy(&x, &i, sizeof(F));
+    return x;
+}
+
+// 64-bit integer compares need SSE4.2 on x86: without it the double kernels
+// are not vectorized and the C library is faster. The AVX2 and AVX-512
+// variants of such a build still run them (see doubleKernels)
+#if defined(__x86_64__) && !defined(__SSE4_2__)
+constexpr bool BASELINE_DOUBLE_KERNELS = false;
+#else
+constexpr bool BASELINE_DOUBLE_KERNELS = true;
+#endif
+
+// condition ? a : b without a branch
+template<typename F>
+inline F select(bool condition, F a, F b) {
+    using Int = typename Bits<F>::Int;
+    Int mask = condition ? Int(-1) : Int(0);
+    return fromBits<F>((toBits(a) & mask) | (toBits(b) & ~mask));
+}
+
+// Type the kernels run in: float for single and half precision, double otherwise
+template<typename T> struct Compute { using type = double; };
+template<> struct Compute<float> { using type = float; };
+template<> struct Compute<bfloat16> { using type = float; };
+#if defined(MATRIX_HAS_FLOAT16)
+template<> struct Compute<float16> { using type = float; };
+#endif
+
+/*
+ * exp(x) = 2^n * exp(r), n = round(x / ln2), |r| <= ln2 / 2
+ * exp(r) is a Taylor polynomial (degree 7 in float, 13 in double) whose
+ * truncation error is below half an ULP. 2^n is built from two factors so
+ * that n = 128 (or 1024) is still representable.
+ */
+template<bool Library, typename F>
+inline F expKernel(F x) {
+    if constexpr (std::is_same<F, double>::value && Library) {
+        return std::exp(x);
+    }
+    using B = Bits<F>;
+    using Int = typename B::Int;
+    constexpr bool single = std::is_same<F, float>::value;
+    const F hi = single ? F(88.72283905206835) : F(709.782712893384);
+    const F lo = single ? F(-87.33654475055310898657) : F(-708.3964185322641);
+    const F log2e = F(1.44269504088896341);
+    const F ln2Hi = single ? F(0.693359375) : F(6.93147180369123816490e-01);
+    const F ln2Lo = single ? F(-2.12194440e-4) : F(1.90821492927058770002e-10);
+
+    F xc = select(x > hi, hi, x);
+    xc = select(xc < lo, lo, xc);
+    F t = xc * log2e + B::ROUND;
+    F n = t - B::ROUND;
+    Int ni = toBits(t) - toBits(B::ROUND);
+    F r = (xc - n * ln2Hi) - n * ln2Lo;
+
+    F p;
+    if constexpr (single) {
+        p = F(1) / 5040;
+        p = p * r + F(1) / 720;
+        p = p * r + F(1) / 120;
+        p = p * r + F(1) / 24;
+        p = p * r + F(1) / 6;
+        p = p * r + F(0.5);
+    } else {
+        p = F(1) / 6227020800.0;
+        p = p * r + F(1) / 479001600.0;
+        p = p * r + F(1) / 39916800.0;
+        p = p * r + F(1) / 3628800.0;
+        p = p * r + F(1) / 362880.0;
+        p = p * r + F(1) / 40320.0;
+        p = p * r + F(1) / 5040.0;
+        p = p * r + F(1) / 720.0;
+        p = p * r + F(1) / 120.0;
+        p = p * r + F(1) / 24.0;
+        p = p * r + F(1) / 6.0;
+        p = p * r + F(0.5);
+    }
+    p = p * r * r + r + F(1);
+
+    // n = half + (n - half), rounded in floating point: SSE2 has no 64-bit arithmetic shift
+    Int half = toBits(n * F(0.5) + B::ROUND) - toBits(B::ROUND);
+    F scale1 = fromBits<F>((half + B::BIAS) << B::MANTISSA);
+    F scale2 = fromBits<F>((ni - half + B::BIAS) << B::MANTISSA);
+    F value = p * scale1 * scale2;
+    value = select(x > hi, std::numeric_limits<F>::infinity(), value);
+    value = select(x < lo, F(0), value);
+    return value;
+}
+
+/*
+ * log(x) = e * ln2 + log(m), x = 2^e * m, sqrt(2)/2 <= m < sqrt(2)
+ * With f = m - 1 and s = f / (2 + f): log(m) = f - s * (f - R), R is the
+ * series of 2 atanh(s) / s - 2 (to s^8 in float, s^20 in double).
+ */
+template<bool Library, typename F>
+inline F logKernel(F x) {
+    if constexpr (std::is_same<F, double>::value && Library) {
+        return std::log(x);
+    }
+    using B = Bits<F>;
+    using Int = typename B::Int;
+    constexpr bool single = std::is_same<F, float>::value;
+    const F ln2Hi = single ? F(0.693359375) : F(6.93147180369123816490e-01);
+    const F ln2Lo = single ? F(-2.12194440e-4) : F(1.90821492927058770002e-10);
+    const F sqrt2 = F(1.41421356237309504880);
+
+    // Subnormal inputs are scaled to normal numbers first
+    bool tiny = x < std::numeric_limits<F>::min();
+    F scaled = x * fromBits<F>((B::BIAS + B::MANTISSA) << B::MANTISSA);
+    F xs = select(tiny, scaled, x);
+    Int ix = toBits(xs);
+    using UInt = typename std::make_unsigned<Int>::type;
+    Int e = static_cast<Int>((static_cast<UInt>(ix) >> B::MANTISSA) & B::EXPONENT_MASK) - B::BIAS;
+    e = tiny ? e - B::MANTISSA : e;
+    F m = fromBits<F>((ix & B::MANTISSA_MASK) | toBits(F(1)));
+    bool big = m > sqrt2;
+    F halved = m * F(0.5);
+    m = select(big, halved, m);
+    e = big ? e + 1 : e;
+
+    F f = m - F(1);
+    F s = f / (F(2) + f);
+    F z = s * s;
+    F r;
+    if constexpr (single) {
+        r = F(2) / 9;
+        r = r * z + F(2) / 7;
+        r = r * z + F(2) / 5;
+        r = r * z + F(2) / 3;
+    } else {
+        r = F(2) / 21;
+        r = r * z + F(2) / 19;
+        r = r * z + F(2) / 17;
+        r = r * z + F(2) / 15;
+        r = r * z + F(2) / 13;
+        r = r * z + F(2) / 11;
+        r = r * z + F(2) / 9;
+        r = r * z + F(2) / 7;
+        r = r * z + F(2) / 5;
+        r = r * z + F(2) / 3;
+    }
+    r *= z;
+    F hfsq = F(0.5) * f * f;
+    F logm = f - (hfsq - s * (hfsq + r));
+    // Integer to floating point through the rounding constant (no 64-bit conversion in SSE2)
+    F ef = fromBits<F>(toBits(B::ROUND) + e) - B::ROUND;
+    F value = ef * ln2Hi + (logm + ef * ln2Lo);
+
+    value = select(x == F(0), -std::numeric_limits<F>::infinity(), value);
+    value = select(x < F(0), std::numeric_limits<F>::quiet_NaN(), value);
+    value = select(x == std::numeric_limits<F>::infinity(), x, value);
+    value = select(x != x, x, value);
+    return value;
+}
+
+// log1p(x) = log(u) * x / (u - 1) with u = 1 + x rounded, exact when u == 1
+template<bool Library, typename F>
+inline F log1pKernel(F x) {
+    if constexpr (std::is_same<F, double>::value && Library) {
+        return std::log1p(x);
+    }
+    F u = F(1) + x;
+    F value = logKernel<Library>(u) * (x / (u - F(1)));
+    value = select(u == F(1), x, value);
+    value = select(x == std::numeric_limits<F>::infinity(), x, value);
+    return value;
+}
+
+/*
+ * Row by row application
+ * kernel(in, out, n, library) runs on the compute type; other types are
+ * converted one row at a time through a per-thread buffer. library is
+ * std::true_type where the double kernels call the C library instead.
+ */
+template<typename T, typename Kernel>
+Matrix<T> applyKernel(const Matrix<T>& m, Kernel kernel) {
+    using C = typename Compute<T>::type;
+    MATRIX_PROFILE(Elementwise, m.getHeight(), m.getWidth(), static_cast<long>(m.getHeight()) * m.getWidth(),
+                   sizeof(T) * m.getHeight() * m.getWidth());
+    int height = m.getHeight();
+    int width = m.getWidth();
+    Matrix<T> result(height, width);
+    const bool library = !elementwise::doubleKernels();
+    auto row = [&kernel, library](const C* in, C* out, int n) {
+        if (library) {
+            kernel(in, out, n, std::true_type());
+        } else {
+            kernel(in, out, n, std::false_type());
+        }
+    };
+    #pragma omp parallel if(static_cast<long>(height) * width > PARALLEL_THRESHOLD)
+    {
+        std::vector<C> in, out;
+        #pragma omp for schedule(static)
+        for (int i = 0; i < height; i++) {
+            if constexpr (std::is_same<T, C>::value) {
+                const T* src = m(i).data();
+                T* dst = result(i).data();
+                dispatch::run([&]() { row(src, dst, width); });
+            } else {
+                in.resize(width);
+                out.resize(width);
+                convertBulk(m(i).data(), in.data(), width);
+                dispatch::run([&]() { row(in.data(), out.data(), width); });
+                convertBulk(out.data(), result(i).data(), width);
+            }
+        }
+    }
+    return result;
+}
+
+// Comparison or selection producing one value per element
+template<typename R, typename T, typename F>
+Matrix<R> elementwiseMap(const Matrix<T>& m, F f) {
+    int height = m.getHeight();
+    int width = m.getWidth();
+    Matrix<R> result(height, width);
+    #pragma omp parallel for schedule(static) if(static_cast<long>(height) * width > PARALLEL_THRESHOLD)
+    for (int i = 0; i < height; i++) {
+        const T* __restrict in = m(i).data();
+        R* __restrict out = result(i).data();
+        for (int j = 0; j < width; j++) {
+            out[j] = f(in[j], i, j);
+        }
+    }
+    return result;
+}
+
+template<typename T, typename U>
+void checkShape(const Matrix<T>& a, const Matrix<U>& b) {
+    if (a.getShape() != b.getShape())
+        throw std::invalid_argument("Matrices must have the same shape.");
+}
+
+} // namespace
+
+
+namespace elementwise {
+
+bool doubleKernels() {
+    return BASELINE_DOUBLE_KERNELS || dispatch::active() != dispatch::Isa::Generic;
+}
+
+template<typename T>
+Matrix<T> exp(const Matrix<T>& m) {
+    return applyKernel(m, [](const auto* __restrict in, auto* __restrict out, int n, auto library) {
+        for (int j = 0; j < n; j++) {
+            out[j] = expKernel<decltype(library)::value>(in[j]);
+        }
+    });
+}
+
+template<typename T>
+Matrix<T> log(const Matrix<T>& m) {
+    return applyKernel(m, [](const auto* __restrict in, auto* __restrict out, int n, auto library) {
+        for (int j = 0; j < n; j++) {
+            out[j] = logKernel<decltype(library)::value>(in[j]);
+        }
+    });
+}
+
+template<typename T>
+Matrix<T> log1p(const Matrix<T>& m) {
+    return applyKernel(m, [](const auto* __restrict in, auto* __restrict out, int n, auto library) {
+        for (int j = 0; j < n; j++) {
+            out[j] = log1pKernel<decltype(library)::value>(in[j]);
+        }
+    });
+}
+
+/*
+ * x^y = exp(y * log|x|), negative x only have a real power for an integer
+ * exponent. pow(x, 0) = 1 for every x.
+ */
+template<typename T>
+Matrix<T> pow(const Matrix<T>& m, T exponent) {
+    using C = typename Compute<T>::type;
+    const C y = static_cast<C>(exponent);
+    if (y == C(0)) {
+        return Matrix<T>(m.getHeight(), m.getWidth(), T(1));
+    }
+    const bool integral = std::floor(y) == y;
+    const C sign = integral && std::fmod(y, C(2)) != C(0) ? C(-1) : C(1);
+    const C negative = integral ? sign : std::numeric_limits<C>::quiet_NaN();
+    return applyKernel(m, [y, negative](const C* __restrict in, C* __restrict out, int n, auto library) {
+        constexpr bool Library = decltype(library)::value;
+        for (int j = 0; j < n; j++) {
+            C x = in[j];
+            C value = expKernel<Library>(y * logKernel<Library>(std::abs(x)));
+            out[j] = select(x < C(0), negative * value, value);
+        }
+    });
+}
+
+template<typename T>
+Matrix<T> sqrt(const Matrix<T>& m) {
+    using C = typename Compute<T>::type;
+    return applyKernel(m, [](const C* __restrict in, C* __restrict out, int n, auto) {
+        // Not vectorized unless compiled with -fno-math-errno
+        for (int j = 0; j < n; j++) {
+            out[j] = std::sqrt(in[j]);
+        }
+    });
+}
+
+template<typename T>
+Matrix<T> abs(const Matrix<T>& m) {
+    if constexpr (std::is_unsigned<T>::value) {
+        return m.duplicate();
+    } else {
+        return m.map([](const T& x) { return x < T(0) ? T(-x) : x; });
+    }
+}
+
+template<typename T>
+Matrix<T> clip(const Matrix<T>& m, T lower, T upper) {
+    if (upper < lower)
+        throw std::invalid_argument("Lower bound must not be greater than upper bound.");
+    return m.map([lower, upper](const T& x) { return x < lower ? lower : (upper < x ? upper : x); });
+}
+
+template<typename T>
+Mask equal(const Matrix<T>& m, T value) {
+    return elementwiseMap<uint8_t>(m, [value](const T& x, int, int) { return static_cast<uint8_t>(x == value); });
+}
+
+template<typename T>
+Mask notEqual(const Matrix<T>& m, T value) {
+    return elementwiseMap<uint8_t>(m, [value](const T& x, int, int) { return static_cast<uint8_t>(x != value); });
+}
+
+template<typename T>
+Mask less(const Matrix<T>& m, T value) {
+    return elementwiseMap<uint8_t>(m, [value](const T& x, int, int) { return static_cast<uint8_t>(x < value); });
+}
+
+template<typename T>
+Mask lessEqual(const Matrix<T>& m, T value) {
+    return elementwiseMap<uint8_t>(m, [value](const T& x, int, int) { return static_cast<uint8_t>(x <= value); });
+}
+
+template<typename T>
+Mask greater(const Matrix<T>& m, T value) {
+    return elementwiseMap<uint8_t>(m, [value](const T& x, int, int) { return static_cast<uint8_t>(x > value); });
+}
+
+template<typename T>
+Mask greaterEqual(const Matrix<T>& m, T value) {
+    return elementwiseMap<uint8_t>(m, [value](const T& x, int, int) { return static_cast<uint8_t>(x >= value); });
+}
+
+template<typename T>
+Mask less(const Matrix<T>& a, const Matrix<T>& b) {
+    checkShape(a, b);
+    return elementwiseMap<uint8_t>(a, [&b](const T& x, int i, int j) { return static_cast<uint8_t>(x < b(i, j)); });
+}
+
+template<typename T>
+Mask greater(const Matrix<T>& a, const Matrix<T>& b) {
+    checkShape(a, b);
+    return elementwiseMap<uint8_t>(a, [&b](const T& x, int i, int j) { return static_cast<uint8_t>(x > b(i, j)); });
+}
+
+template<typename T>
+Mask equal(const Matrix<T>& a, const Matrix<T>& b) {
+    checkShape(a, b);
+    return elementwiseMap<uint8_t>(a, [&b](const T& x, int i, int j) { return static_cast<uint8_t>(x == b(i, j)); });
+}
+
+long count(const Mask& mask) {
+    long total = 0;
+    long work = static_cast<long>(mask.getHeight()) * mask.getWidth();
+    #pragma omp parallel for schedule(static) reduction(+:total) if(work > PARALLEL_THRESHOLD)
+    for (int i = 0; i < mask.getHeight(); i++) {
+        const uint8_t* row = mask(i).data();
+        long rowCount = 0;
+        for (int j = 0; j < mask.getWidth(); j++) {
+            rowCount += row[j] != 0;
+        }
+        total += rowCount;
+    }
+    return total;
+}
+
+template<typename T>
+Matrix<T> where(const Mask& mask, const Matrix<T>& a, const Matrix<T>& b) {
+    checkShape(mask, a);
+    checkShape(mask, b);
+    return elementwiseMap<T>(a, [&mask, &b](const T& x, int i, int j) { return mask(i, j) ? x : b(i, j); });
+}
+
+template<typename T>
+Matrix<T> where(const Mask& mask, const Matrix<T>& a, T b) {
+    checkShape(mask, a);
+    return elementwiseMap<T>(a, [&mask, b](const T& x, int i, int j) { return mask(i, j) ? x : b; });
+}
+
+
+// Explicit instantiation
+#define ELEMENTWISE_INSTANTIATE(T) \
+    template Matrix<T> exp(const Matrix<T>& m); \
+    template Matrix<T> log(const Matrix<T>& m); \
+    template Matrix<T> log1p(const Matrix<T>& m); \
+    template Matrix<T> pow(const Matrix<T>& m, T exponent); \
+    template Matrix<T> sqrt(const Matrix<T>& m); \
+    template Matrix<T> abs(const Matrix<T>& m); \
+    template Matrix<T> clip(const Matrix<T>& m, T lower, T upper); \
+    template Mask equal(const Matrix<T>& m, T value); \
+    template Mask notEqual(const Matrix<T>& m, T value); \
+    template Mask less(const Matrix<T>& m, T value); \
+    template Mask lessEqual(const Matrix<T>& m, T value); \
+    template Mask greater(const Matrix<T>& m, T value); \
+    template Mask greaterEqual(const Matrix<T>& m, T value); \
+    template Mask less(const Matrix<T>& a, const Matrix<T>& b); \
+    template Mask greater(const Matrix<T>& a, const Matrix<T>& b); \
+    template Mask equal(const Matrix<T>& a, const Matrix<T>& b); \
+    template Matrix<T> where(const Mask& mask, const Matrix<T>& a, const Matrix<T>& b); \
+    template Matrix<T> where(const Mask& mask, const Matrix<T>& a, T b);
+
+ELEMENTWISE_INSTANTIATE(int)
+ELEMENTWISE_INSTANTIATE(float)
+ELEMENTWISE_INSTANTIATE(double)
+ELEMENTWISE_INSTANTIATE(bfloat16)
+#if defined(MATRIX_HAS_FLOAT16)
+ELEMENTWISE_INSTANTIATE(float16)
+#endif
+
+} // namespace elementwise
@@ -0,0 +1,75 @@
+//
+// Elementwise math functions, comparisons and selection.
+//
+
+#include "matrix.h"
+
+#ifndef ELEMENTWISE_H
+#define ELEMENTWISE_H
+
+
+/*
+ * Elementwise functions
+ * Every function returns a new matrix and runs rows in parallel on large
+ * inputs. Types without a kernel (int, half precision) are computed in
+ * double or float and converted back, integer results are truncated.
+ *
+ * exp, log, log1p and pow use branch-free polynomial kernels that the
+ * compiler vectorizes. Maximum error against the long double result, over
+ * 100k random inputs per function and range in tests/elementwise_test.cc:
+ *   exp    float 1.1 ULP    double 1 ULP
+ *   log    float 1 ULP      double 1.3 ULP
+ *   log1p  float 2.5 ULP    double 2.5 ULP
+ *   pow    computed as exp(y * log(x)): the error grows with |y * log(x)|,
+ *          about 2 + |y * log(x)| ULP
+ * On x86 the double kernels need SSE4.2 (64-bit integer compares): the
+ * baseline x86-64 variant calls the C library instead (within 1 ULP), the
+ * AVX2 and AVX-512 variants (dispatch.h) run the kernels.
+ * exp results below the smallest normal number are flushed to zero.
+ * Special values follow the C library (log(0) = -inf, log(-1) = NaN,
+ * exp(inf) = inf). sqrt is correctly rounded.
+ */
+
+namespace elementwise {
+
+template<typename T> Matrix<T> exp(const Matrix<T>& m);
+template<typename T> Matrix<T> log(const Matrix<T>& m);
+template<typename T> Matrix<T> log1p(const Matrix<T>& m);
+template<typename T> Matrix<T> pow(const Matrix<T>& m, T exponent);
+template<typename T> Matrix<T> sqrt(const Matrix<T>& m);
+template<typename T> Matrix<T> abs(const Matrix<T>& m);
+template<typename T> Matrix<T> clip(const Matrix<T>& m, T lower, T upper);
+
+// Whether the double exp, log, log1p and pow run the kernels in the active
+// instruction set variant, false if they call the C library
+bool doubleKernels();
+
+/*
+ * Comparisons
+ * mask(i, j) is 1 where the comparison holds, 0 elsewhere (NaN compares
+ * false except for notEqual).
+ */
+template<typename T> Mask equal(const Matrix<T>& m, T value);
+template<typename T> Mask notEqual(const Matrix<T>& m, T value);
+template<typename T> Mask less(const Matrix<T>& m, T value);
+template<typename T> Mask lessEqual(const Matrix<T>& m, T value);
+template<typename T> Mask greater(const Matrix<T>& m, T value);
+template<typename T> Mask greaterEqual(const Matrix<T>& m, T value);
+template<typename T> Mask less(const Matrix<T>& a, const Matrix<T>& b);
+template<typename T> Mask greater(const Matrix<T>& a, const Matrix<T>& b);
+template<typename T> Mask equal(const Matrix<T>& a, const Matrix<T>& b);
+
+// Number of set elements
+long count(const Mask& mask);
+
+/*
+ * Selection
+ * result(i, j) = mask(i, j) ? a(i, j) : b(i, j) (or b)
+ */
+template<typename T> Matrix<T> where(const Mask& mask, const Matrix<T>& a, const Matrix<T>& b);
+template<typename T> Matrix<T> where(const Mask& mask, const Matrix<T>& a, T b);
+
+} // namespace elementwise
+
+
+#endif // ELEMENTWISE_H
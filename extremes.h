@@ -0,0 +1,215 @@
+//
+// Branch-free maximum and minimum kernels used by the Matrix reductions.
+//
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include "half.h"
+
+#ifndef EXTREMES_H
+#define EXTREMES_H
+
+/*
+ * Extremes
+ * GCC does not vectorize a float max or min reduction unless NaN and signed
+ * zeros are ignored (-ffast-math). float and double are instead compared
+ * through an integer key with the same ordering, which the compiler reduces
+ * with integer compare-and-blend instructions. Other types are compared in
+ * Accumulator<T>.
+ * Every step takes a skip mask (all bits set to skip the element) so masked
+ * and NaN elements are ignored without a branch (with a bitwise and for the
+ * sums, a blend is slower). NaN elements that are not
+ * skipped are counted apart and the result is NaN if there was one.
+ */
+
+namespace extremes {
+
+template<typename T, typename Enable=void>
+struct Order {
+    using Value = typename Accumulator<T>::type;
+    using Flag = int;
+
+    static inline Value key(T x) { return static_cast<Value>(x); }
+    static inline T value(Value v) { return static_cast<T>(v); }
+    static inline Flag isNaN(Value v) { return -static_cast<Flag>(v != v); }
+    static constexpr Value lowest() {
+        return std::numeric_limits<Value>::has_infinity ? -std::numeric_limits<Value>::infinity()
+                                                        : std::numeric_limits<Value>::lowest();
+    }
+    static constexpr Value highest() {
+        return std::numeric_limits<Value>::has_infinity ? std::numeric_limits<Value>::infinity()
+                                                        : std::numeric_limits<Value>::max();
+    }
+};
+
+// The key is the bit pattern with the magnitude bits flipped for negative
+// numbers: ordering the keys as signed integers orders the floats (with
+// -0 < +0), NaN keys are beyond the infinities
+template<typename F>
+struct Order<F, typename std::enable_if<std::is_floating_point<F>::value && sizeof(F) <= 8>::type> {
+    using Value = typename std::conditional<sizeof(F) == 4, int32_t, int64_t>::type;
+    using Flag = Value;
+    static constexpr int SHIFT = sizeof(Value) * 8 - 1;
+    static constexpr Value MAGNITUDE = std::numeric_limits<Value>::max();
+    static constexpr Value INFINITY_BITS = sizeof(F) == 4 ? Value(0x7f800000) : Value(0x7ff0000000000000LL);
+
+    static inline Value key(F x) {
+        Value bits;
+        std::memcpy(&bits, &x, sizeof(bits));
+        return bits ^ ((bits >> SHIFT) & MAGNITUDE);
+    }
+    static inline F value(Value v) {
+        Value bits = v ^ ((v >> SHIFT) & MAGNITUDE);
+        F x;
+        std::memcpy(&x, &bits, sizeof(x));
+        return x;
+    }
+    // The magnitude of the key is the one of the float for positive numbers
+    // and its complement for negative ones
+    static inline Flag isNaN(Value v) {
+        Value magnitude = v ^ ((v >> SHIFT) & MAGNITUDE);
+        return -static_cast<Flag>((magnitude & MAGNITUDE) > INFINITY_BITS);
+    }
+    static constexpr Value lowest() { return std::numeric_limits<Value>::min(); }
+    static constexpr Value highest() { return std::numeric_limits<Value>::max(); }
+};
+
+// x, or zero where skip is set (the masked sums)
+template<typename T>
+inline T clear(T x, typename Order<T>::Flag skip) {
+    if constexpr (std::is_floating_point<T>::value && sizeof(T) == sizeof(typename Order<T>::Flag)) {
+        typename Order<T>::Flag bits;
+        std::memcpy(&bits, &x, sizeof(bits));
+        bits &= ~skip;
+        std::memcpy(&x, &bits, sizeof(x));
+        return x;
+    } else {
+        return skip ? T(0) : x;
+    }
+}
+
+/*
+ * One step of a running maximum (Greater) or minimum: adds x unless skip is
+ * set (0 or all bits set). NaN is skipped if SkipNaN, counted in nan otherwise.
+ */
+template<bool Greater, bool SkipNaN, typename T>
+inline void step(typename Order<T>::Value& best, typename Order<T>::Flag& nan, typename Order<T>::Flag& found,
+                 T x, typename Order<T>::Flag skip) {
+    using O = Order<T>;
+    using Value = typename O::Value;
+    using Flag = typename O::Flag;
+    const Value identity = Greater ? O::lowest() : O::highest();
+    Value k = O::key(x);
+    Flag isNaN = O::isNaN(k);
+    if (SkipNaN) {
+        skip |= isNaN;
+    }
+    Value candidate;
+    if constexpr (std::is_integral<Value>::value && sizeof(Value) == sizeof(Flag)) {
+        candidate = (k & ~skip) | (identity & skip);
+    } else {
+        candidate = skip ? identity : k;
+    }
+    best = (Greater ? candidate > best : candidate < best) ? candidate : best;
+    nan |= isNaN & ~skip;
+    found |= ~skip;
+}
+
+// NaN (0 for integer types) if nothing was added or a NaN was not skipped
+template<typename T>
+inline T result(typename Order<T>::Value best, typename Order<T>::Flag nan, typename Order<T>::Flag found) {
+    if (nan || !found) {
+        return static_cast<T>(std::numeric_limits<typename Accumulator<T>::type>::quiet_NaN());
+    }
+    return Order<T>::value(best);
+}
+
+// Running extreme of a sequence
+template<bool Greater, typename T>
+struct Extreme {
+    using O = Order<T>;
+    typename O::Value best = Greater ? O::lowest() : O::highest();
+    typename O::Flag nan = 0;
+    typename O::Flag found = 0;
+
+    template<bool SkipNaN>
+    inline void add(T x, typename O::Flag skip) {
+        step<Greater, SkipNaN>(best, nan, found, x, skip);
+    }
+
+    inline void merge(const Extreme& other) {
+        best = (Greater ? other.best > best : other.best < best) ? other.best : best;
+        nan |= other.nan;
+        found |= other.found;
+    }
+
+    inline T result() const {
+        return extremes::result<T>(best, nan, found);
+    }
+};
+
+// Extreme of data[j] for j in [0, n) where skip(j) is 0
+template<bool Greater, bool SkipNaN, typename T, typename Skip>
+inline Extreme<Greater, T> reduce(const T* data, int n, Skip skip) {
+    Extreme<Greater, T> e;
+    for (int j = 0; j < n; j++) {
+        e.template add<SkipNaN>(data[j], skip(j));
+    }
+    return e;
+}
+
+// Same without skip mask
+template<bool Greater, bool SkipNaN, typename T>
+inline Extreme<Greater, T> reduce(const T* data, int n) {
+    return reduce<Greater, SkipNaN>(data, n, [](int) { return typename Order<T>::Flag(0); });
+}
+
+/*
+ * Running extremes of w columns, fed one row at a time
+ * The state is kept as one array per field so the row loop is vectorized.
+ */
+template<bool Greater, typename T>
+class Columns {
+public:
+    using O = Order<T>;
+    using Flag = typename O::Flag;
+
+    explicit Columns(int w) : best_(w, Greater ? O::lowest() : O::highest()), nan_(w, 0), found_(w, 0) {}
+
+    template<bool SkipNaN>
+    inline void add(const T* row) {
+        add<SkipNaN>(row, [](int) { return Flag(0); });
+    }
+
+    // skip(k) is the skip mask of row[k]
+    template<bool SkipNaN, typename Skip>
+    inline void add(const T* row, Skip skip) {
+        typename O::Value* best = best_.data();
+        Flag* nan = nan_.data();
+        Flag* found = found_.data();
+        int w = static_cast<int>(best_.size());
+        for (int k = 0; k < w; k++) {
+            step<Greater, SkipNaN>(best[k], nan[k], found[k], row[k], skip(k));
+        }
+    }
+
+    inline void result(T* out) const {
+        for (std::size_t k = 0; k < best_.size(); k++) {
+            out[k] = extremes::result<T>(best_[k], nan_[k], found_[k]);
+        }
+    }
+
+private:
+    std::vector<typename O::Value> best_;
+    std::vector<Flag> nan_;
+    std::vector<Flag> found_;
+};
+
+} // namespace extremes
+
+
+#endif // EXTREMES_H
@@ -0,0 +1,553 @@
+//
+// 2D convolution and sliding-window filters.
+//
+
+#include "filters.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+
+// Number of output columns computed together: the tile, its input row and
+// margin stay in L1
+static const int COLUMN_TILE = 1024;
+
+
+// Position read for p in a dimension of size n, -1 for a zero
+static inline int boundaryIndex(int p, int n, Boundary boundary) {
+    if (p >= 0 && p < n) {
+        return p;
+    }
+    switch (boundary) {
+        case Boundary::Zero:
+            return -1;
+        case Boundary::Nearest:
+            return p < 0 ? 0 : n - 1;
+        case Boundary::Reflect:
+        default: {
+            // Period 2n: a b c d | d c b a
+            int period = 2 * n;
+            p %= period;
+            if (p < 0) {
+                p += period;
+            }
+            return p < n ? p : period - 1 - p;
+        }
+    }
+}
+
+// Window with its size resolved, checked against the matrix
+static Window resolve(const Window& window, int height, int width) {
+    Window w = window;
+    if (w.height < 0) {
+        w.height = height - w.row;
+    }
+    if (w.width < 0) {
+        w.width = width - w.col;
+    }
+    if (w.row < 0 || w.col < 0 || w.height < 0 || w.width < 0 || w.row + w.height > height || w.col + w.width > width)
+        throw std::out_of_range("Window outside of the matrix.");
+    return w;
+}
+
+// out[x] = row[start + x] for x in [0, n), the boundary mode applied outside of [0, width)
+template<typename T, typename A>
+static void loadRow(const T* row, int width, int start, int n, Boundary boundary, A* out) {
+    int first = std::min(std::max(0, -start), n);
+    int last = std::max(first, std::min(n, width - start));
+    for (int x = 0; x < first; x++) {
+        int c = boundaryIndex(start + x, width, boundary);
+        out[x] = c < 0 ? A(0) : static_cast<A>(row[c]);
+    }
+    for (int x = first; x < last; x++) {
+        out[x] = static_cast<A>(row[start + x]);
+    }
+    for (int x = last; x < n; x++) {
+        int c = boundaryIndex(start + x, width, boundary);
+        out[x] = c < 0 ? A(0) : static_cast<A>(row[c]);
+    }
+}
+
+
+/*
+ * Direct convolution
+ * For every output row and column tile, each kernel row loads the input row
+ * it reads (margin included) once, then every kernel element is an axpy of
+ * that row on the tile.
+ */
+template<typename T>
+static Matrix<T> convolveDirect(const Matrix<T>& m, const Matrix<T>& kernel, Boundary boundary, const Window& w) {
+    using Acc = typename Accumulator<T>::type;
+    const int kh = kernel.getHeight();
+    const int kw = kernel.getWidth();
+    const int ch = kh / 2;
+    const int cw = kw / 2;
+    Matrix<T> result(w.height, w.width);
+    long work = static_cast<long>(w.height) * w.width * kh * kw;
+
+    #pragma omp parallel if(work > PARALLEL_THRESHOLD)
+    {
+        std::vector<Acc> input(COLUMN_TILE + kw - 1);
+        std::vector<Acc> acc(COLUMN_TILE);
+        #pragma omp for schedule(static)
+        for (int i = 0; i < w.height; i++) {
+            for (int t = 0; t < w.width; t += COLUMN_TILE) {
+                const int n = std::min(COLUMN_TILE, w.width - t);
+                std::fill(acc.begin(), acc.begin() + n, Acc(0));
+                for (int a = 0; a < kh; a++) {
+                    const int r = boundaryIndex(w.row + i - a + ch, m.getHeight(), boundary);
+                    if (r < 0) {
+                        continue;
+                    }
+                    loadRow(m(r).data(), m.getWidth(), w.col + t - (kw - 1 - cw), n + kw - 1, boundary, input.data());
+                    const T* kernelRow = kernel(a).data();
+                    for (int b = 0; b < kw; b++) {
+                        const Acc k = static_cast<Acc>(kernelRow[b]);
+                        const Acc* in = input.data() + (kw - 1 - b);
+                        Acc* out = acc.data();
+                        for (int j = 0; j < n; j++) {
+                            out[j] += k * in[j];
+                        }
+                    }
+                }
+                T* out = result(i).data() + t;
+                for (int j = 0; j < n; j++) {
+                    out[j] = static_cast<T>(acc[j]);
+                }
+            }
+        }
+    }
+    return result;
+}
+
+
+/*
+ * FFT
+ * Iterative radix-2 transform on separate real and imaginary arrays. Every
+ * butterfly is applied to a batch of interleaved sequences at once, so the
+ * inner loops are contiguous and vectorized whatever the level. The
+ * twiddles of every level are contiguous:
+ * twiddle[half + k] = exp(-2 pi i k / (2 half)).
+ */
+namespace {
+
+// Number of sequences transformed together, 16 doubles are two cache lines
+const int FFT_BATCH = 16;
+
+class FFT {
+public:
+    explicit FFT(int n) : n_(n), reversed_(n), cos_(n), sin_(n) {
+        int bits = 0;
+        while ((1 << bits) < n) {
+            bits++;
+        }
+        for (int i = 0; i < n; i++) {
+            int r = 0;
+            for (int b = 0; b < bits; b++) {
+                r |= ((i >> b) & 1) << (bits - 1 - b);
+            }
+            reversed_[i] = r;
+        }
+        const double pi = std::acos(-1.0);
+        for (int half = 1; half < n; half *= 2) {
+            for (int k = 0; k < half; k++) {
+                cos_[half + k] = std::cos(pi * k / half);
+                sin_[half + k] = -std::sin(pi * k / half);
+            }
+        }
+    }
+
+    /*
+     * Transforms count sequences: element k of sequence v is at k * stride + v
+     * Unnormalized, the inverse transform is scaled by n.
+     */
+    void transform(double* re, double* im, long stride, int count, bool inverse) const {
+        for (int k = 0; k < n_; k++) {
+            int r = reversed_[k];
+            if (r > k) {
+                std::swap_ranges(re + k * stride, re + k * stride + count, re + r * stride);
+                std::swap_ranges(im + k * stride, im + k * stride + count, im + r * stride);
+            }
+        }
+        const double sign = inverse ? -1.0 : 1.0;
+        for (int half = 1; half < n_; half *= 2) {
+            for (int start = 0; start < n_; start += 2 * half) {
+                for (int k = 0; k < half; k++) {
+                    const double wr = cos_[half + k];
+                    const double wi = sign * sin_[half + k];
+                    double* __restrict ar = re + (start + k) * stride;
+                    double* __restrict ai = im + (start + k) * stride;
+                    double* __restrict br = re + (start + k + half) * stride;
+                    double* __restrict bi = im + (start + k + half) * stride;
+                    for (int v = 0; v < count; v++) {
+                        const double tr = wr * br[v] - wi * bi[v];
+                        const double ti = wr * bi[v] + wi * br[v];
+                        br[v] = ar[v] - tr;
+                        bi[v] = ai[v] - ti;
+                        ar[v] += tr;
+                        ai[v] += ti;
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    int n_;
+    std::vector<int> reversed_;
+    std::vector<double> cos_;
+    std::vector<double> sin_;
+};
+
+/*
+ * 2D transform of a rows x cols grid, row p starting at p * stride
+ * Columns are transformed in place by blocks of FFT_BATCH; rows are
+ * transposed by blocks into a buffer to be transformed the same way.
+ */
+void transform2d(std::vector<double>& re, std::vector<double>& im, int rows, int cols, long stride, bool inverse) {
+    FFT rowFFT(cols);
+    FFT colFFT(rows);
+    long work = static_cast<long>(rows) * cols;
+    #pragma omp parallel if(work > PARALLEL_THRESHOLD)
+    {
+        std::vector<double> bufferRe(static_cast<std::size_t>(cols) * FFT_BATCH);
+        std::vector<double> bufferIm(static_cast<std::size_t>(cols) * FFT_BATCH);
+        #pragma omp for schedule(static)
+        for (int p0 = 0; p0 < rows; p0 += FFT_BATCH) {
+            const int count = std::min(FFT_BATCH, rows - p0);
+            for (int v = 0; v < count; v++) {
+                const double* rowRe = re.data() + (p0 + v) * stride;
+                const double* rowIm = im.data() + (p0 + v) * stride;
+                for (int q = 0; q < cols; q++) {
+                    bufferRe[q * FFT_BATCH + v] = rowRe[q];
+                    bufferIm[q * FFT_BATCH + v] = rowIm[q];
+                }
+            }
+            rowFFT.transform(bufferRe.data(), bufferIm.data(), FFT_BATCH, count, inverse);
+            for (int v = 0; v < count; v++) {
+                double* rowRe = re.data() + (p0 + v) * stride;
+                double* rowIm = im.data() + (p0 + v) * stride;
+                for (int q = 0; q < cols; q++) {
+                    rowRe[q] = bufferRe[q * FFT_BATCH + v];
+                    rowIm[q] = bufferIm[q * FFT_BATCH + v];
+                }
+            }
+        }
+
+        #pragma omp for schedule(static)
+        for (int q0 = 0; q0 < cols; q0 += FFT_BATCH) {
+            colFFT.transform(re.data() + q0, im.data() + q0, stride, std::min(FFT_BATCH, cols - q0), inverse);
+        }
+    }
+}
+
+// Doubles added to the rows of the grid: a power of two stride would map a
+// column onto a few cache sets
+const int FFT_ROW_PADDING = 8;
+
+int nextPowerOfTwo(int n) {
+    int p = 1;
+    while (p < n) {
+        p *= 2;
+    }
+    return p;
+}
+
+} // namespace
+
+
+/*
+ * FFT convolution
+ * The window and its margin (in) and the kernel are real: they are packed
+ * as the real and imaginary parts of one grid, so a single forward transform
+ * gives both spectra through the symmetry Z(-k) = conj(Z(k)) of real inputs.
+ * The grid is at least (h + kh - 1) x (w + kw - 1) so the circular wrap does
+ * not reach the output elements.
+ */
+template<typename T>
+Matrix<T> convolve2dFFT(const Matrix<T>& m, const Matrix<T>& kernel, Boundary boundary, const Window& window) {
+    const int kh = kernel.getHeight();
+    const int kw = kernel.getWidth();
+    if (kh == 0 || kw == 0)
+        throw std::invalid_argument("Kernel must not be empty.");
+    Window w = resolve(window, m.getHeight(), m.getWidth());
+    MATRIX_PROFILE(Convolve, w.height, w.width, static_cast<long>(w.height) * w.width, 0);
+    if (w.height == 0 || w.width == 0) {
+        // Nothing to read, boundaryIndex needs a non-empty matrix
+        return Matrix<T>(w.height, w.width);
+    }
+    const int ch = kh / 2;
+    const int cw = kw / 2;
+    const int inRows = w.height + kh - 1;
+    const int inCols = w.width + kw - 1;
+    const int rows = nextPowerOfTwo(inRows);
+    const int cols = nextPowerOfTwo(inCols);
+    const long stride = cols + FFT_ROW_PADDING;
+    const long size = static_cast<long>(rows) * cols;
+
+    std::vector<double> re(rows * stride, 0.0);
+    std::vector<double> im(rows * stride, 0.0);
+    #pragma omp parallel for schedule(static) if(static_cast<long>(inRows) * inCols > PARALLEL_THRESHOLD)
+    for (int p = 0; p < inRows; p++) {
+        int r = boundaryIndex(w.row - (kh - 1 - ch) + p, m.getHeight(), boundary);
+        if (r >= 0) {
+            loadRow(m(r).data(), m.getWidth(), w.col - (kw - 1 - cw), inCols, boundary, re.data() + p * stride);
+        }
+    }
+    for (int a = 0; a < kh; a++) {
+        for (int b = 0; b < kw; b++) {
+            im[a * stride + b] = static_cast<double>(kernel(a, b));
+        }
+    }
+
+    transform2d(re, im, rows, cols, stride, false);
+
+    // Y(k) = In(k) * K(k) with In = (Z(k) + conj(Z(-k))) / 2 and
+    // K = (Z(k) - conj(Z(-k))) / 2i, written for k and -k at once
+    #pragma omp parallel for schedule(static) if(size > PARALLEL_THRESHOLD)
+    for (int u = 0; u < rows; u++) {
+        const int nu = (rows - u) % rows;
+        for (int v = 0; v < cols; v++) {
+            const int nv = (cols - v) % cols;
+            const long k = u * stride + v;
+            const long nk = nu * stride + nv;
+            if (nk < k) {
+                continue;
+            }
+            const double zr = re[k], zi = im[k], nzr = re[nk], nzi = im[nk];
+            const double inR = 0.5 * (zr + nzr), inI = 0.5 * (zi - nzi);
+            const double kR = 0.5 * (zi + nzi), kI = -0.5 * (zr - nzr);
+            const double yr = inR * kR - inI * kI;
+            const double yi = inR * kI + inI * kR;
+            re[k] = yr;
+            im[k] = yi;
+            re[nk] = yr;
+            im[nk] = -yi;
+        }
+    }
+
+    transform2d(re, im, rows, cols, stride, true);
+
+    Matrix<T> result(w.height, w.width);
+    const double scale = 1.0 / static_cast<double>(size);
+    for (int i = 0; i < w.height; i++) {
+        const double* row = re.data() + (i + kh - 1) * stride + (kw - 1);
+        T* out = result(i).data();
+        for (int j = 0; j < w.width; j++) {
+            out[j] = static_cast<T>(row[j] * scale);
+        }
+    }
+    return result;
+}
+
+template<typename T>
+Matrix<T> convolve2d(const Matrix<T>& m, const Matrix<T>& kernel, Boundary boundary, const Window& window) {
+    if (kernel.getHeight() == 0 || kernel.getWidth() == 0)
+        throw std::invalid_argument("Kernel must not be empty.");
+    if (static_cast<long>(kernel.getHeight()) * kernel.getWidth() >= FFT_CROSSOVER) {
+        return convolve2dFFT(m, kernel, boundary, window);
+    }
+    Window w = resolve(window, m.getHeight(), m.getWidth());
+    MATRIX_PROFILE(Convolve, w.height, w.width, static_cast<long>(w.height) * w.width, 0);
+    if (w.height == 0 || w.width == 0) {
+        return Matrix<T>(w.height, w.width);
+    }
+    return convolveDirect(m, kernel, boundary, w);
+}
+
+
+/*
+ * Separable convolution
+ * The horizontal pass filters every input row read by the window (margin
+ * included) into tmp, the vertical pass combines kh rows of tmp per output
+ * row. Both passes are axpy over contiguous rows.
+ */
+template<typename T>
+Matrix<T> convolveSeparable(const Matrix<T>& m, const std::vector<T>& columnKernel, const std::vector<T>& rowKernel,
+                            Boundary boundary, const Window& window) {
+    using Acc = typename Accumulator<T>::type;
+    const int kh = static_cast<int>(columnKernel.size());
+    const int kw = static_cast<int>(rowKernel.size());
+    if (kh == 0 || kw == 0)
+        throw std::invalid_argument("Kernels must not be empty.");
+    Window w = resolve(window, m.getHeight(), m.getWidth());
+    MATRIX_PROFILE(Convolve, w.height, w.width, static_cast<long>(w.height) * w.width, 0);
+    if (w.height == 0 || w.width == 0) {
+        return Matrix<T>(w.height, w.width);
+    }
+    const int ch = kh / 2;
+    const int cw = kw / 2;
+    const int tmpRows = w.height + kh - 1;
+    long work = static_cast<long>(tmpRows) * w.width * (kh + kw);
+
+    // tmp row p is the horizontal pass of input row w.row - (kh - 1 - ch) + p
+    std::vector<Acc> tmp(static_cast<std::size_t>(tmpRows) * w.width, Acc(0));
+    Matrix<T> result(w.height, w.width);
+    #pragma omp parallel if(work > PARALLEL_THRESHOLD)
+    {
+        std::vector<Acc> input(w.width + kw - 1);
+        #pragma omp for schedule(static)
+        for (int p = 0; p < tmpRows; p++) {
+            int r = boundaryIndex(w.row - (kh - 1 - ch) + p, m.getHeight(), boundary);
+            if (r < 0) {
+                continue;
+            }
+            loadRow(m(r).data(), m.getWidth(), w.col - (kw - 1 - cw), w.width + kw - 1, boundary, input.data());
+            Acc* out = tmp.data() + static_cast<std::size_t>(p) * w.width;
+            for (int b = 0; b < kw; b++) {
+                const Acc k = static_cast<Acc>(rowKernel[b]);
+                const Acc* in = input.data() + (kw - 1 - b);
+                for (int j = 0; j < w.width; j++) {
+                    out[j] += k * in[j];
+                }
+            }
+        }
+
+        std::vector<Acc> acc(w.width);
+        #pragma omp for schedule(static)
+        for (int i = 0; i < w.height; i++) {
+            std::fill(acc.begin(), acc.end(), Acc(0));
+            for (int a = 0; a < kh; a++) {
+                const Acc k = static_cast<Acc>(columnKernel[a]);
+                const Acc* in = tmp.data() + static_cast<std::size_t>(i + kh - 1 - a) * w.width;
+                for (int j = 0; j < w.width; j++) {
+                    acc[j] += k * in[j];
+                }
+            }
+            T* out = result(i).data();
+            for (int j = 0; j < w.width; j++) {
+                out[j] = static_cast<T>(acc[j]);
+            }
+        }
+    }
+    return result;
+}
+
+template<typename T>
+Matrix<T> gaussianFilter(const Matrix<T>& m, double sigma, Boundary boundary, const Window& window, double truncate) {
+    if (!(sigma > 0) || !(truncate > 0))
+        throw std::invalid_argument("Sigma and truncate must be positive.");
+    const int radius = static_cast<int>(std::ceil(truncate * sigma));
+    std::vector<double> weights(2 * radius + 1);
+    double total = 0;
+    for (int x = -radius; x <= radius; x++) {
+        weights[x + radius] = std::exp(-0.5 * x * x / (sigma * sigma));
+        total += weights[x + radius];
+    }
+    std::vector<T> kernel(weights.size());
+    for (std::size_t x = 0; x < weights.size(); x++) {
+        kernel[x] = static_cast<T>(weights[x] / total);
+    }
+    return convolveSeparable(m, kernel, kernel, boundary, window);
+}
+
+
+/*
+ * Summed-area tables
+ * The rows are prefix-summed in parallel, then added to the previous row of
+ * the table (a vectorized pass over the columns).
+ */
+template<typename Wide, typename LoadRow>
+static void buildTable(int height, int width, LoadRow loadRow, std::vector<Wide>& table) {
+    const std::size_t stride = static_cast<std::size_t>(width) + 1;
+    table.assign((static_cast<std::size_t>(height) + 1) * stride, Wide(0));
+    long work = static_cast<long>(height) * width;
+    #pragma omp parallel if(work > PARALLEL_THRESHOLD)
+    {
+        std::vector<Wide> values(width);
+        #pragma omp for schedule(static)
+        for (int i = 0; i < height; i++) {
+            loadRow(i, values.data());
+            Wide* row = table.data() + (i + 1) * stride;
+            Wide running = 0;
+            for (int j = 0; j < width; j++) {
+                running += values[j];
+                row[j + 1] = running;
+            }
+        }
+    }
+    for (int i = 1; i < height; i++) {
+        const Wide* previous = table.data() + i * stride;
+        Wide* row = table.data() + (i + 1) * stride;
+        for (std::size_t j = 1; j < stride; j++) {
+            row[j] += previous[j];
+        }
+    }
+}
+
+template<class T>
+SummedAreaTable<T>::SummedAreaTable(const Matrix<T>& m) : height_(m.getHeight()), width_(m.getWidth()) {
+    buildTable(height_, width_, [&m, this](int i, Wide* out) {
+        const T* row = m(i).data();
+        for (int j = 0; j < width_; j++) {
+            out[j] = static_cast<Wide>(row[j]);
+        }
+    }, table_);
+}
+
+template<class T>
+typename SummedAreaTable<T>::Wide SummedAreaTable<T>::sum(int top, int left, int height, int width) const {
+    int r0 = std::min(std::max(top, 0), height_);
+    int r1 = std::min(std::max(top + height, 0), height_);
+    int c0 = std::min(std::max(left, 0), width_);
+    int c1 = std::min(std::max(left + width, 0), width_);
+    if (r1 <= r0 || c1 <= c0) {
+        return Wide(0);
+    }
+    return at(r1, c1) - at(r0, c1) - at(r1, c0) + at(r0, c0);
+}
+
+template<typename T>
+Matrix<T> boxFilter(const Matrix<T>& m, int radiusH, int radiusW, Boundary boundary, const Window& window) {
+    using Wide = typename Widened<T>::type;
+    if (radiusH < 0 || radiusW < 0)
+        throw std::invalid_argument("Radius must be positive.");
+    Window w = resolve(window, m.getHeight(), m.getWidth());
+    MATRIX_PROFILE(Convolve, w.height, w.width, static_cast<long>(w.height) * w.width, 0);
+    if (w.height == 0 || w.width == 0) {
+        return Matrix<T>(w.height, w.width);
+    }
+    const int sizeH = 2 * radiusH + 1;
+    const int sizeW = 2 * radiusW + 1;
+    const int rows = w.height + sizeH - 1;
+    const int cols = w.width + sizeW - 1;
+
+    // Table of the window and its margin, the boundary mode applied
+    std::vector<Wide> table;
+    buildTable(rows, cols, [&](int p, Wide* out) {
+        int r = boundaryIndex(w.row - radiusH + p, m.getHeight(), boundary);
+        if (r < 0) {
+            std::fill(out, out + cols, Wide(0));
+        } else {
+            loadRow(m(r).data(), m.getWidth(), w.col - radiusW, cols, boundary, out);
+        }
+    }, table);
+
+    const std::size_t stride = static_cast<std::size_t>(cols) + 1;
+    const Wide scale = Wide(1) / static_cast<Wide>(static_cast<long>(sizeH) * sizeW);
+    Matrix<T> result(w.height, w.width);
+    #pragma omp parallel for schedule(static) if(static_cast<long>(w.height) * w.width > PARALLEL_THRESHOLD)
+    for (int i = 0; i < w.height; i++) {
+        const Wide* top = table.data() + i * stride;
+        const Wide* bottom = table.data() + (i + sizeH) * stride;
+        T* out = result(i).data();
+        for (int j = 0; j < w.width; j++) {
+            out[j] = static_cast<T>((bottom[j + sizeW] - top[j + sizeW] - bottom[j] + top[j]) * scale);
+        }
+    }
+    return result;
+}
+
+
+// Explicit instantiation (filters need a floating point type)
+#define FILTERS_INSTANTIATE(T) \
+    template Matrix<T> convolve2d(const Matrix<T>& m, const Matrix<T>& kernel, Boundary boundary, const Window& window); \
+    template Matrix<T> convolve2dFFT(const Matrix<T>& m, const Matrix<T>& kernel, Boundary boundary, const Window& window); \
+    template Matrix<T> convolveSeparable(const Matrix<T>& m, const std::vector<T>& columnKernel, \
+                                         const std::vector<T>& rowKernel, Boundary boundary, const Window& window); \
+    template Matrix<T> gaussianFilter(const Matrix<T>& m, double sigma, Boundary boundary, const Window& window, \
+                                      double truncate); \
+    template Matrix<T> boxFilter(const Matrix<T>& m, int radiusH, int radiusW, Boundary boundary, const Window& window); \
+    template class SummedAreaTable<T>;
+
+FILTERS_INSTANTIATE(float)
+FILTERS_INSTANTIATE(double)
@@ -0,0 +1,113 @@
+//
+// 2D convolution and sliding-window filters.
+//
+
+#include <vector>
+
+#include "matrix.h"
+
+#ifndef FILTERS_H
+#define FILTERS_H
+
+
+// Kernel size (in elements) from which convolve2d switches to the FFT (see bench/matrix_bench.cc)
+constexpr int FFT_CROSSOVER = 2048;
+
+/*
+ * Boundary modes
+ * Value of the elements outside of the matrix, for a row (or column) d c b a:
+ *   Zero    : 0 0 0 0 | d c b a | 0 0 0 0
+ *   Reflect : a b c d | d c b a | a b c d  (mirrored, edge repeated)
+ *   Nearest : d d d d | d c b a | a a a a
+ */
+enum class Boundary { Zero, Reflect, Nearest };
+
+/*
+ * Output window
+ * The filters compute rows [row, row + height) and columns [col, col + width)
+ * of the full result, reading the neighbours of the window from the whole
+ * matrix: a tile of a large matrix is filtered in place, without subMat
+ * copies, and the boundary mode only applies at the edges of the matrix.
+ * A negative height or width extends the window to the end of the matrix.
+ */
+struct Window {
+    int row = 0;
+    int col = 0;
+    int height = -1;
+    int width = -1;
+};
+
+/*
+ * Convolution
+ * result(i, j) = sum kernel(a, b) * m(i - a + kh / 2, j - b + kw / 2), the
+ * kernel is centered on kernel(kh / 2, kw / 2) and flipped (symmetric kernels
+ * give the correlation). Rows are processed in parallel, in column tiles that
+ * stay in cache; kernels of FFT_CROSSOVER elements or more use convolve2dFFT.
+ * convolve2dFFT transforms the window and its margin once, in double, so its
+ * cost does not depend on the kernel size (rounding error ~1e-15 relative to
+ * the largest input for double, below float precision for float).
+ */
+template<typename T>
+Matrix<T> convolve2d(const Matrix<T>& m, const Matrix<T>& kernel, Boundary boundary=Boundary::Zero,
+                     const Window& window=Window());
+
+template<typename T>
+Matrix<T> convolve2dFFT(const Matrix<T>& m, const Matrix<T>& kernel, Boundary boundary=Boundary::Zero,
+                        const Window& window=Window());
+
+/*
+ * Separable filters
+ * Convolution with the outer product of columnKernel (along the rows, i.e.
+ * vertical) and rowKernel (horizontal), as two 1D passes: O(kh + kw) per
+ * element instead of O(kh * kw).
+ * gaussianFilter uses a normalized kernel of radius ceil(truncate * sigma).
+ */
+template<typename T>
+Matrix<T> convolveSeparable(const Matrix<T>& m, const std::vector<T>& columnKernel, const std::vector<T>& rowKernel,
+                            Boundary boundary=Boundary::Zero, const Window& window=Window());
+
+template<typename T>
+Matrix<T> gaussianFilter(const Matrix<T>& m, double sigma, Boundary boundary=Boundary::Reflect,
+                         const Window& window=Window(), double truncate=4.0);
+
+/*
+ * Box filter
+ * Mean over the (2 * radiusH + 1) x (2 * radiusW + 1) window centered on each
+ * element, elements outside of the matrix following the boundary mode (with
+ * Zero they count as zeros). Computed from a summed-area table: O(1) per
+ * element whatever the radius.
+ */
+template<typename T>
+Matrix<T> boxFilter(const Matrix<T>& m, int radiusH, int radiusW, Boundary boundary=Boundary::Reflect,
+                    const Window& window=Window());
+
+/*
+ * Summed-area table
+ * sum(top, left, height, width) is the sum of the rectangle in O(1), the part
+ * outside of the matrix counts as zero. Windows that are unions or
+ * differences of rectangles (donut, lower-left, ...) are a few lookups.
+ * Sums are accumulated in Widened<T>.
+ */
+template<typename T>
+class SummedAreaTable {
+public:
+    using Wide = typename Widened<T>::type;
+
+    explicit SummedAreaTable(const Matrix<T>& m);
+
+    [[nodiscard]] inline int getHeight() const { return height_; }
+    [[nodiscard]] inline int getWidth() const { return width_; }
+
+    Wide sum(int top, int left, int height, int width) const;
+
+private:
+    // table_[i * (width_ + 1) + j] is the sum of the rows [0, i) and columns [0, j)
+    inline Wide at(int i, int j) const { return table_[static_cast<std::size_t>(i) * (width_ + 1) + j]; }
+
+    std::vector<Wide> table_;
+    int height_ = 0;
+    int width_ = 0;
+};
+
+
+#endif // FILTERS_H
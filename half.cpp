@@ -0,0 +1,132 @@
+//
+// Bulk conversion kernels for half-precision element types.
+//
+
+#include "half.h"
+#include "dispatch.h"
+
+#if defined(MATRIX_DISPATCH) || defined(__F16C__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+
+#if defined(MATRIX_HAS_FLOAT16)
+
+namespace {
+
+void toFloatScalar(const float16* src, float* dst, std::size_t i, std::size_t n) {
+    for (; i < n; ++i) {
+        dst[i] = static_cast<float>(src[i]);
+    }
+}
+
+void fromFloatScalar(const float* src, float16* dst, std::size_t i, std::size_t n) {
+    for (; i < n; ++i) {
+        dst[i] = float16(src[i]);
+    }
+}
+
+// The F16C and AVX-512 loops carry their own target so that the default
+// build compiles them too, convertBulk picks one at run time (dispatch.h)
+#if defined(MATRIX_DISPATCH) || defined(__F16C__) || defined(__AVX512F__)
+__attribute__((target("avx,f16c")))
+std::size_t toFloatF16C(const float16* src, float* dst, std::size_t i, std::size_t n) {
+    for (; i + 8 <= n; i += 8) {
+        __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+    }
+    return i;
+}
+
+__attribute__((target("avx,f16c")))
+std::size_t fromFloatF16C(const float* src, float16* dst, std::size_t i, std::size_t n) {
+    for (; i + 8 <= n; i += 8) {
+        __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), h);
+    }
+    return i;
+}
+#endif
+
+#if defined(MATRIX_DISPATCH) || defined(__AVX512F__)
+__attribute__((target("avx512f")))
+std::size_t toFloatAVX512(const float16* src, float* dst, std::size_t i, std::size_t n) {
+    for (; i + 16 <= n; i += 16) {
+        __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        _mm512_storeu_ps(dst + i, _mm512_cvtph_ps(h));
+    }
+    return i;
+}
+
+__attribute__((target("avx512f")))
+std::size_t fromFloatAVX512(const float* src, float16* dst, std::size_t i, std::size_t n) {
+    for (; i + 16 <= n; i += 16) {
+        __m256i h = _mm512_cvtps_ph(_mm512_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), h);
+    }
+    return i;
+}
+#endif
+
+// Instruction set of the conversions: the active one in a dispatched build,
+// else the one the library is compiled for
+dispatch::Isa conversionIsa() {
+#if defined(MATRIX_DISPATCH)
+    dispatch::Isa isa = dispatch::active();
+    if (isa != dispatch::Isa::Generic) {
+        return isa;
+    }
+#endif
+#if defined(__AVX512F__)
+    return dispatch::Isa::AVX512;
+#elif defined(__F16C__)
+    return dispatch::Isa::AVX2;
+#else
+    return dispatch::Isa::Generic;
+#endif
+}
+
+}
+
+void convertBulk(const float16* src, float* dst, std::size_t n) {
+    std::size_t i = 0;
+    switch (conversionIsa()) {
+#if defined(MATRIX_DISPATCH) || defined(__AVX512F__)
+        case dispatch::Isa::AVX512: i = toFloatAVX512(src, dst, i, n); [[fallthrough]];
+#endif
+#if defined(MATRIX_DISPATCH) || defined(__F16C__) || defined(__AVX512F__)
+        case dispatch::Isa::AVX2: i = toFloatF16C(src, dst, i, n); break;
+#endif
+        default: break;
+    }
+    toFloatScalar(src, dst, i, n);
+}
+
+void convertBulk(const float* src, float16* dst, std::size_t n) {
+    std::size_t i = 0;
+    switch (conversionIsa()) {
+#if defined(MATRIX_DISPATCH) || defined(__AVX512F__)
+        case dispatch::Isa::AVX512: i = fromFloatAVX512(src, dst, i, n); [[fallthrough]];
+#endif
+#if defined(MATRIX_DISPATCH) || defined(__F16C__) || defined(__AVX512F__)
+        case dispatch::Isa::AVX2: i = fromFloatF16C(src, dst, i, n); break;
+#endif
+        default: break;
+    }
+    fromFloatScalar(src, dst, i, n);
+}
+
+#endif
+
+// bf16 <-> fp32 is a pure bit shift, these loops are auto-vectorized
+void convertBulk(const bfloat16* src, float* dst, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) {
+        dst[i] = bfloat16::toFloat(src[i].bits);
+    }
+}
+
+void convertBulk(const float* src, bfloat16* dst, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) {
+        dst[i].bits = bfloat16::fromFloat(src[i]);
+    }
+}
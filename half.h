@@ -0,0 +1,123 @@
+//
+// Half-precision element types (fp16 / bf16) for compact Matrix storage.
+//
+
+#include <complex>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <ostream>
+#include <type_traits>
+
+#ifndef HALF_H
+#define HALF_H
+
+/*
+ * Half precision types
+ * Both types are 16 bits wide and only used for storage: every arithmetic
+ * operation goes through float, so a Matrix<float16> or Matrix<bfloat16>
+ * uses half the memory of a Matrix<float> while computing in fp32.
+ */
+
+#if defined(__FLT16_MAX__)
+#define MATRIX_HAS_FLOAT16 1
+
+// IEEE 754 binary16 (1 sign, 5 exponent, 10 mantissa bits)
+struct float16 {
+    _Float16 value = 0;
+
+    float16() = default;
+    float16(float f) : value(static_cast<_Float16>(f)) {}
+    inline operator float() const { return static_cast<float>(value); }
+
+    inline float16& operator+=(float f) { value = static_cast<_Float16>(static_cast<float>(value) + f); return *this; }
+    inline float16& operator-=(float f) { value = static_cast<_Float16>(static_cast<float>(value) - f); return *this; }
+    inline float16& operator*=(float f) { value = static_cast<_Float16>(static_cast<float>(value) * f); return *this; }
+    inline float16& operator/=(float f) { value = static_cast<_Float16>(static_cast<float>(value) / f); return *this; }
+};
+
+static_assert(sizeof(float16) == 2, "float16 must be 16 bits wide.");
+#endif
+
+// Brain floating point (1 sign, 8 exponent, 7 mantissa bits), same range as float
+struct bfloat16 {
+    uint16_t bits = 0;
+
+    bfloat16() = default;
+    bfloat16(float f) : bits(fromFloat(f)) {}
+    inline operator float() const { return toFloat(bits); }
+
+    inline bfloat16& operator+=(float f) { bits = fromFloat(toFloat(bits) + f); return *this; }
+    inline bfloat16& operator-=(float f) { bits = fromFloat(toFloat(bits) - f); return *this; }
+    inline bfloat16& operator*=(float f) { bits = fromFloat(toFloat(bits) * f); return *this; }
+    inline bfloat16& operator/=(float f) { bits = fromFloat(toFloat(bits) / f); return *this; }
+
+    // Round to nearest even, NaN stays a (quiet) NaN
+    static inline uint16_t fromFloat(float f) {
+        uint32_t u;
+        std::memcpy(&u, &f, sizeof(u));
+        if ((u & 0x7fffffffu) > 0x7f800000u) {
+            return static_cast<uint16_t>((u >> 16) | 0x0040u);
+        }
+        u += 0x7fffu + ((u >> 16) & 1u);
+        return static_cast<uint16_t>(u >> 16);
+    }
+
+    static inline float toFloat(uint16_t b) {
+        uint32_t u = static_cast<uint32_t>(b) << 16;
+        float f;
+        std::memcpy(&f, &u, sizeof(f));
+        return f;
+    }
+};
+
+static_assert(sizeof(bfloat16) == 2, "bfloat16 must be 16 bits wide.");
+
+#if defined(MATRIX_HAS_FLOAT16)
+inline std::ostream& operator<<(std::ostream &flux, const float16& h) { return flux << static_cast<float>(h); }
+#endif
+inline std::ostream& operator<<(std::ostream &flux, const bfloat16& h) { return flux << static_cast<float>(h); }
+
+
+/*
+ * Accumulator type
+ * Type used to accumulate reductions (sum, dot, ...) of elements of type T.
+ * Half precision types accumulate in float.
+ */
+
+template<typename T> struct Accumulator { using type = T; };
+#if defined(MATRIX_HAS_FLOAT16)
+template<> struct Accumulator<float16> { using type = float; };
+#endif
+template<> struct Accumulator<bfloat16> { using type = float; };
+
+// Complex elements: no ordering (max, min), two components per element
+template<typename T> struct IsComplex : std::false_type {};
+template<typename F> struct IsComplex<std::complex<F>> : std::true_type {};
+
+
+/*
+ * Bulk conversion
+ * Convert n contiguous elements from src to dst.
+ * The float16 overloads convert with F16C or AVX-512 instructions when the
+ * active instruction set has them (dispatch.h), or when the library is
+ * compiled for a target that does. Both round to nearest even like the
+ * scalar conversion, so every variant gives the same bits.
+ */
+
+template<typename From, typename To>
+inline void convertBulk(const From* src, To* dst, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) {
+        dst[i] = static_cast<To>(src[i]);
+    }
+}
+
+#if defined(MATRIX_HAS_FLOAT16)
+void convertBulk(const float16* src, float* dst, std::size_t n);
+void convertBulk(const float* src, float16* dst, std::size_t n);
+#endif
+void convertBulk(const bfloat16* src, float* dst, std::size_t n);
+void convertBulk(const float* src, bfloat16* dst, std::size_t n);
+
+
+#endif // HALF_H
@@ -0,0 +1,340 @@
+//
+// Integer matrices: overflow-safe sums and products, saturating arithmetic, floating division.
+//
+
+#include "integer.h"
+#include "dispatch.h"
+#include "parallel.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+
+// Columns summed together by sum(m, 1), their int64 sums stay in L1
+static const int COLUMN_BLOCK = 1024;
+
+namespace integer {
+
+namespace {
+
+/*
+ * Accumulation
+ * Partial is the type the SIMD lanes accumulate in, BLOCK the number of
+ * elements summed before the lanes are flushed into the 64-bit total. 8 and
+ * 16 bit values and 8 bit products are below 2^16 in absolute value, 2^15 of
+ * them fit in an int32. Everything else is accumulated in uint64_t: the
+ * additions wrap modulo 2^64 instead of overflowing, and the total converted
+ * to Wide<T> is exact whenever the result fits in it. Products of 16 and
+ * 32 bit values are exact in Product (int64_t, or uint64_t for unsigned
+ * elements), those of 64 bit values are computed modulo 2^64.
+ */
+template<typename T>
+struct SumPartial {
+    using type = typename std::conditional<sizeof(T) <= 2, int32_t, uint64_t>::type;
+    static constexpr std::size_t BLOCK = sizeof(T) <= 2 ? std::size_t(1) << 15 : ~std::size_t(0);
+};
+
+template<typename T>
+struct DotPartial {
+    using type = typename std::conditional<sizeof(T) == 1, int32_t, uint64_t>::type;
+    using Product = typename std::conditional<sizeof(T) == 1, int32_t,
+                    typename std::conditional<std::is_signed<T>::value && sizeof(T) <= 4, int64_t, uint64_t>::type>::type;
+    static constexpr std::size_t BLOCK = sizeof(T) == 1 ? std::size_t(1) << 15 : ~std::size_t(0);
+};
+
+// Integer additions are associative, the plain loop leaves the compiler
+// free to vectorize the reduction (the lanes of summation.h spill here)
+template<typename Partial, std::size_t BLOCK, typename F>
+inline uint64_t blockedSum(std::size_t n, F f) {
+    uint64_t total = 0;
+    for (std::size_t begin = 0; begin < n; begin += std::min(BLOCK, n - begin)) {
+        const std::size_t end = begin + std::min(BLOCK, n - begin);
+        Partial partial = 0;
+        for (std::size_t i = begin; i < end; i++) {
+            partial += f(i);
+        }
+        total += static_cast<uint64_t>(partial);
+    }
+    return total;
+}
+
+template<typename T>
+inline uint64_t rowSum(const T* x, std::size_t n) {
+    using Partial = typename SumPartial<T>::type;
+    return blockedSum<Partial, SumPartial<T>::BLOCK>(n, [&](std::size_t i) { return static_cast<Partial>(x[i]); });
+}
+
+template<typename T>
+inline uint64_t rowDot(const T* a, const T* b, std::size_t n) {
+    using Partial = typename DotPartial<T>::type;
+    using Product = typename DotPartial<T>::Product;
+    return blockedSum<Partial, DotPartial<T>::BLOCK>(n, [&](std::size_t i) {
+        return static_cast<Partial>(static_cast<Product>(a[i]) * static_cast<Product>(b[i]));
+    });
+}
+
+// Value clamped to the range of T, every integer type used here fits in int64
+template<typename T, typename W>
+inline T clamp(W value) {
+    static_assert(sizeof(W) < 8 || std::is_signed<W>::value, "uint64 values are not clamped");
+    const int64_t low = static_cast<int64_t>(std::numeric_limits<T>::min());
+    const int64_t high = static_cast<int64_t>(std::numeric_limits<T>::max());
+    return static_cast<T>(std::min(std::max(static_cast<int64_t>(value), low), high));
+}
+
+// Saturating operations: computed in int64 for types up to 32 bits, which
+// vectorizes, with the overflow builtins for 64 bit types
+template<typename T>
+inline T addSaturated(T a, T b) {
+    if (sizeof(T) < 8) {
+        return clamp<T>(static_cast<int64_t>(a) + static_cast<int64_t>(b));
+    }
+    T result;
+    if (__builtin_add_overflow(a, b, &result)) {
+        return (std::is_signed<T>::value && a < T(0)) ? std::numeric_limits<T>::min() : std::numeric_limits<T>::max();
+    }
+    return result;
+}
+
+template<typename T>
+inline T subtractSaturated(T a, T b) {
+    if (sizeof(T) < 8) {
+        return clamp<T>(static_cast<int64_t>(a) - static_cast<int64_t>(b));
+    }
+    T result;
+    if (__builtin_sub_overflow(a, b, &result)) {
+        return (!std::is_signed<T>::value || a < T(0)) ? std::numeric_limits<T>::min() : std::numeric_limits<T>::max();
+    }
+    return result;
+}
+
+template<typename T>
+inline T multiplySaturated(T a, T b) {
+    if (sizeof(T) < 4 || (sizeof(T) == 4 && std::is_signed<T>::value)) {
+        return clamp<T>(static_cast<int64_t>(a) * static_cast<int64_t>(b));
+    }
+    T result;
+    if (__builtin_mul_overflow(a, b, &result)) {
+        return (std::is_signed<T>::value && (a < T(0)) != (b < T(0))) ? std::numeric_limits<T>::min()
+                                                                         : std::numeric_limits<T>::max();
+    }
+    return result;
+}
+
+// Wrapping operations, in the unsigned type so that signed overflow is defined
+template<typename T>
+inline T wrap(uint64_t value) {
+    return static_cast<T>(static_cast<typename std::make_unsigned<T>::type>(value));
+}
+
+inline void checkSameShape(int aHeight, int aWidth, int bHeight, int bWidth) {
+    if (aHeight != bHeight || aWidth != bWidth) {
+        throw std::invalid_argument("Matrix dimension must be the same.");
+    }
+}
+
+// result(i, j) = f(a(i, j), b(i, j)), each row through dispatch::run
+template<typename R, typename T, typename F>
+Matrix<R> combine(const Matrix<T>& a, const Matrix<T>& b, F f) {
+    checkSameShape(a.getHeight(), a.getWidth(), b.getHeight(), b.getWidth());
+    const int height = a.getHeight();
+    const int width = a.getWidth();
+    Matrix<R> result(height, width);
+    #pragma omp parallel for schedule(static) if(static_cast<long>(height) * width > PARALLEL_THRESHOLD)
+    for (int i = 0; i < height; i++) {
+        const T* x = a(i).data();
+        const T* y = b(i).data();
+        R* out = result(i).data();
+        dispatch::run([&]() {
+            for (int j = 0; j < width; j++) {
+                out[j] = f(x[j], y[j]);
+            }
+        });
+    }
+    return result;
+}
+
+template<typename R, typename T, typename F>
+Matrix<R> transform(const Matrix<T>& m, F f) {
+    const int height = m.getHeight();
+    const int width = m.getWidth();
+    Matrix<R> result(height, width);
+    #pragma omp parallel for schedule(static) if(static_cast<long>(height) * width > PARALLEL_THRESHOLD)
+    for (int i = 0; i < height; i++) {
+        const T* x = m(i).data();
+        R* out = result(i).data();
+        dispatch::run([&]() {
+            for (int j = 0; j < width; j++) {
+                out[j] = f(x[j]);
+            }
+        });
+    }
+    return result;
+}
+
+}
+
+template<typename T>
+Wide<T> sum(const Matrix<T>& m) {
+    const int height = m.getHeight();
+    const int width = m.getWidth();
+    MATRIX_PROFILE(Sum, height, width, static_cast<long>(height) * width, 0);
+    uint64_t total = 0;
+    #pragma omp parallel for schedule(static) reduction(+:total) if(static_cast<long>(height) * width > PARALLEL_THRESHOLD)
+    for (int i = 0; i < height; i++) {
+        const T* row = m(i).data();
+        uint64_t rowTotal = 0;
+        dispatch::run([&]() { rowTotal = rowSum(row, width); });
+        total += rowTotal;
+    }
+    return static_cast<Wide<T>>(total);
+}
+
+template<typename T>
+std::vector<Wide<T>> sum(const Matrix<T>& m, int axis) {
+    const int height = m.getHeight();
+    const int width = m.getWidth();
+    MATRIX_PROFILE(Sum, height, width, static_cast<long>(height) * width, 0);
+    const long work = static_cast<long>(height) * width;
+    if (axis == 0) {
+        std::vector<Wide<T>> result(height);
+        #pragma omp parallel for schedule(static) if(work > PARALLEL_THRESHOLD)
+        for (int i = 0; i < height; i++) {
+            const T* row = m(i).data();
+            dispatch::run([&]() { result[i] = static_cast<Wide<T>>(rowSum(row, width)); });
+        }
+        return result;
+    }
+    else if (axis == 1) {
+        // Column blocks, every row is added to the 64-bit sums of the block
+        std::vector<uint64_t> sums(width, 0);
+        #pragma omp parallel for schedule(static) if(work > PARALLEL_THRESHOLD)
+        for (int j = 0; j < width; j += COLUMN_BLOCK) {
+            const int end = std::min(j + COLUMN_BLOCK, width);
+            uint64_t* out = sums.data();
+            dispatch::run([&]() {
+                for (int i = 0; i < height; i++) {
+                    const T* row = m(i).data();
+                    for (int k = j; k < end; k++) {
+                        out[k] += static_cast<uint64_t>(row[k]);
+                    }
+                }
+            });
+        }
+        return std::vector<Wide<T>>(sums.begin(), sums.end());
+    }
+    else {
+        throw std::invalid_argument("Axis must be 0 or 1.");
+    }
+}
+
+template<typename T>
+Matrix<Wide<T>> dot(const Matrix<T>& a, const Matrix<T>& b) {
+    const int height = a.getHeight();
+    const int inner = a.getWidth();
+    const int width = b.getWidth();
+    MATRIX_PROFILE(Dot, height, width, static_cast<long>(height) * inner * width,
+                   sizeof(Wide<T>) * static_cast<long>(height) * width + sizeof(T) * static_cast<long>(inner) * width);
+    if (inner != b.getHeight()) {
+        throw std::invalid_argument("Dot product not compatible.");
+    }
+
+    // As in Matrix::dot, every output element reduces two contiguous arrays
+    Matrix<T> bt = b.transpose();
+    Matrix<Wide<T>> result(height, width);
+    #pragma omp parallel for schedule(static) if(static_cast<long>(height) * inner * width > PARALLEL_THRESHOLD)
+    for (int i = 0; i < height; i++) {
+        const T* row = a(i).data();
+        Wide<T>* out = result(i).data();
+        dispatch::run([&]() {
+            for (int j = 0; j < width; j++) {
+                out[j] = static_cast<Wide<T>>(rowDot(row, bt(j).data(), inner));
+            }
+        });
+    }
+    return result;
+}
+
+template<typename T>
+Matrix<T> add(const Matrix<T>& a, const Matrix<T>& b, Overflow mode) {
+    MATRIX_PROFILE(Add, a.getHeight(), a.getWidth(), static_cast<long>(a.getHeight()) * a.getWidth(),
+                   3 * sizeof(T) * a.getHeight() * a.getWidth());
+    if (mode == Overflow::Saturate) {
+        return combine<T>(a, b, [](T x, T y) { return addSaturated(x, y); });
+    }
+    return combine<T>(a, b, [](T x, T y) { return wrap<T>(static_cast<uint64_t>(x) + static_cast<uint64_t>(y)); });
+}
+
+template<typename T>
+Matrix<T> subtract(const Matrix<T>& a, const Matrix<T>& b, Overflow mode) {
+    MATRIX_PROFILE(Subtract, a.getHeight(), a.getWidth(), static_cast<long>(a.getHeight()) * a.getWidth(),
+                   3 * sizeof(T) * a.getHeight() * a.getWidth());
+    if (mode == Overflow::Saturate) {
+        return combine<T>(a, b, [](T x, T y) { return subtractSaturated(x, y); });
+    }
+    return combine<T>(a, b, [](T x, T y) { return wrap<T>(static_cast<uint64_t>(x) - static_cast<uint64_t>(y)); });
+}
+
+template<typename T>
+Matrix<T> multiply(const Matrix<T>& m, T value, Overflow mode) {
+    MATRIX_PROFILE(Multiply, m.getHeight(), m.getWidth(), static_cast<long>(m.getHeight()) * m.getWidth(),
+                   2 * sizeof(T) * m.getHeight() * m.getWidth());
+    if (mode == Overflow::Saturate) {
+        return transform<T>(m, [value](T x) { return multiplySaturated(x, value); });
+    }
+    return transform<T>(m, [value](T x) { return wrap<T>(static_cast<uint64_t>(x) * static_cast<uint64_t>(value)); });
+}
+
+template<typename R, typename T>
+Matrix<R> divide(const Matrix<T>& a, const Matrix<T>& b) {
+    MATRIX_PROFILE(Divide, a.getHeight(), a.getWidth(), static_cast<long>(a.getHeight()) * a.getWidth(),
+                   (2 * sizeof(T) + sizeof(R)) * a.getHeight() * a.getWidth());
+    return combine<R>(a, b, [](T x, T y) { return static_cast<R>(x) / static_cast<R>(y); });
+}
+
+template<typename R, typename T>
+Matrix<R> divide(const Matrix<T>& m, T value) {
+    MATRIX_PROFILE(Divide, m.getHeight(), m.getWidth(), static_cast<long>(m.getHeight()) * m.getWidth(),
+                   (sizeof(T) + sizeof(R)) * m.getHeight() * m.getWidth());
+    const R divisor = static_cast<R>(value);
+    return transform<R>(m, [divisor](T x) { return static_cast<R>(x) / divisor; });
+}
+
+template<typename To, typename From>
+Matrix<To> narrow(const Matrix<From>& m, Overflow mode) {
+    MATRIX_PROFILE(AsType, m.getHeight(), m.getWidth(), static_cast<long>(m.getHeight()) * m.getWidth(),
+                   sizeof(To) * m.getHeight() * m.getWidth());
+    if (mode == Overflow::Saturate) {
+        return transform<To>(m, [](From x) { return clamp<To>(x); });
+    }
+    return transform<To>(m, [](From x) { return static_cast<To>(x); });
+}
+
+
+// Explicit instantiation
+#define INTEGER_INSTANTIATE(T) \
+    template Wide<T> sum(const Matrix<T>& m); \
+    template std::vector<Wide<T>> sum(const Matrix<T>& m, int axis); \
+    template Matrix<Wide<T>> dot(const Matrix<T>& a, const Matrix<T>& b); \
+    template Matrix<T> add(const Matrix<T>& a, const Matrix<T>& b, Overflow mode); \
+    template Matrix<T> subtract(const Matrix<T>& a, const Matrix<T>& b, Overflow mode); \
+    template Matrix<T> multiply(const Matrix<T>& m, T value, Overflow mode); \
+    template Matrix<float> divide<float, T>(const Matrix<T>& a, const Matrix<T>& b); \
+    template Matrix<double> divide<double, T>(const Matrix<T>& a, const Matrix<T>& b); \
+    template Matrix<float> divide<float, T>(const Matrix<T>& m, T value); \
+    template Matrix<double> divide<double, T>(const Matrix<T>& m, T value); \
+    INTEGER_NARROW(int8_t, T) INTEGER_NARROW(int16_t, T) INTEGER_NARROW(int, T) INTEGER_NARROW(int64_t, T) \
+    INTEGER_NARROW(uint8_t, T) INTEGER_NARROW(uint16_t, T) INTEGER_NARROW(uint32_t, T)
+
+#define INTEGER_NARROW(To, From) \
+    template Matrix<To> narrow<To, From>(const Matrix<From>& m, Overflow mode);
+
+INTEGER_INSTANTIATE(int8_t)
+INTEGER_INSTANTIATE(int16_t)
+INTEGER_INSTANTIATE(int)
+INTEGER_INSTANTIATE(int64_t)
+INTEGER_INSTANTIATE(uint8_t)
+INTEGER_INSTANTIATE(uint16_t)
+INTEGER_INSTANTIATE(uint32_t)
+
+} // namespace integer
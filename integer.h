@@ -0,0 +1,68 @@
+//
+// Integer matrices: overflow-safe sums and products, saturating arithmetic, floating division.
+//
+
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "matrix.h"
+
+#ifndef INTEGER_H
+#define INTEGER_H
+
+
+/*
+ * Integer kernels
+ * Matrix<int>::sum() and dot() return int and wrap around past 2^31. The
+ * functions below return Wide<T> results instead: int64_t, or uint64_t for
+ * unsigned elements. The accumulation is done modulo 2^64 in unsigned
+ * arithmetic (no undefined overflow), so a result is exact whenever its
+ * true value fits in Wide<T>, whatever the intermediate sums. Otherwise it
+ * is reduced modulo 2^64. Sums of up to 2^32 elements of up to 32 bits
+ * always fit.
+ *
+ * The accumulation stays narrow as long as it cannot overflow: 8 and 16
+ * bit elements are summed in int32 lanes over blocks short enough to be
+ * safe, then the block sums are added in 64 bits. The compiler turns these
+ * loops into widening SIMD adds and multiplies (pmaddwd-like for the 8 bit
+ * products), in the variant of the active instruction set (dispatch.h).
+ *
+ * Overflow::Saturate clamps every result to the range of the element type
+ * instead of wrapping around, like the saturating SIMD instructions.
+ * divide returns a floating point matrix instead of truncating.
+ *
+ * int8_t, int16_t, uint8_t and uint16_t matrices keep low counts in a
+ * quarter or half of the memory of an int matrix. narrow converts to them
+ * with saturation, astype converts back.
+ */
+
+namespace integer {
+
+enum class Overflow { Wrap, Saturate };
+
+// Type of the sums and products of T elements
+template<typename T> using Wide = typename std::conditional<std::is_signed<T>::value, int64_t, uint64_t>::type;
+
+// Sum of all the elements
+template<typename T> Wide<T> sum(const Matrix<T>& m);
+// One sum per row (axis 0) or per column (axis 1)
+template<typename T> std::vector<Wide<T>> sum(const Matrix<T>& m, int axis);
+// Matrix product accumulated in 64 bits
+template<typename T> Matrix<Wide<T>> dot(const Matrix<T>& a, const Matrix<T>& b);
+
+template<typename T> Matrix<T> add(const Matrix<T>& a, const Matrix<T>& b, Overflow mode=Overflow::Saturate);
+template<typename T> Matrix<T> subtract(const Matrix<T>& a, const Matrix<T>& b, Overflow mode=Overflow::Saturate);
+template<typename T> Matrix<T> multiply(const Matrix<T>& m, T value, Overflow mode=Overflow::Saturate);
+
+// Elementwise a / b in R (float or double), x / 0 gives an infinity or NaN
+template<typename R=double, typename T> Matrix<R> divide(const Matrix<T>& a, const Matrix<T>& b);
+template<typename R=double, typename T> Matrix<R> divide(const Matrix<T>& m, T value);
+
+// Conversion to another integer type, values out of its range are clamped or wrapped
+template<typename To, typename From> Matrix<To> narrow(const Matrix<From>& m, Overflow mode=Overflow::Saturate);
+
+}
+
+
+#endif // INTEGER_H
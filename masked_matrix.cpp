@@ -0,0 +1,689 @@
+//
+// Matrix with masked elements, and NaN-skipping reductions.
+//
+
+#include "masked_matrix.h"
+#include "extremes.h"
+#include "parallel.h"
+#include <algorithm>
+#include <bitset>
+
+// Number of columns processed together by the column-wise reductions, a
+// multiple of 64 so that every block starts on a mask word
+static const int COLUMN_BLOCK = 256;
+
+// Bit l of a 32-bit word: testing the bits against a table rather than
+// shifting by a variable amount lets the expansion below be vectorized
+static const uint32_t BIT[32] = {
+    1u << 0, 1u << 1, 1u << 2, 1u << 3, 1u << 4, 1u << 5, 1u << 6, 1u << 7,
+    1u << 8, 1u << 9, 1u << 10, 1u << 11, 1u << 12, 1u << 13, 1u << 14, 1u << 15,
+    1u << 16, 1u << 17, 1u << 18, 1u << 19, 1u << 20, 1u << 21, 1u << 22, 1u << 23,
+    1u << 24, 1u << 25, 1u << 26, 1u << 27, 1u << 28, 1u << 29, 1u << 30, 1u << 31,
+};
+
+static inline int wordCount(int width) {
+    return (width + 63) / 64;
+}
+
+static long popcount(const uint64_t* words, int n) {
+    long count = 0;
+    for (int b = 0; b < n; b++) {
+        count += static_cast<long>(std::bitset<64>(words[b]).count());
+    }
+    return count;
+}
+
+// skip[j] = all bits set where bit j is set, for the 64 * n bits of words
+template<typename Flag>
+static void expand(const uint64_t* words, int n, Flag* skip) {
+    for (int b = 0; b < n; b++) {
+        const uint32_t low = static_cast<uint32_t>(words[b]);
+        const uint32_t high = static_cast<uint32_t>(words[b] >> 32);
+        Flag* out = skip + 64 * b;
+        for (int l = 0; l < 32; l++) {
+            out[l] = -static_cast<Flag>((low & BIT[l]) != 0);
+        }
+        for (int l = 0; l < 32; l++) {
+            out[32 + l] = -static_cast<Flag>((high & BIT[l]) != 0);
+        }
+    }
+}
+
+// sum / count, NaN (0 for integer types) when count is zero
+template<typename T, typename S>
+static T mean(S sum, long count) {
+    if (count == 0) {
+        return static_cast<T>(std::numeric_limits<typename Accumulator<T>::type>::quiet_NaN());
+    }
+    return static_cast<T>(static_cast<double>(sum) / static_cast<double>(count));
+}
+
+/*
+ * Column sums of the rows [startH, startH+h) over w columns
+ * row(i) returns the function giving the value to add for each column of row
+ * i (zero for the skipped elements). Same policies as the Matrix column sums.
+ */
+template<typename T, typename Row>
+static void columnSums(int startH, int h, int w, Summation mode, typename Widened<T>::type* out, Row row) {
+    using Acc = typename Accumulator<T>::type;
+    using Wide = typename Widened<T>::type;
+
+    if (mode == Summation::Pairwise && h > static_cast<int>(summation::PAIRWISE_BLOCK)) {
+        int half = h / 2;
+        std::vector<Wide> left(w, 0);
+        std::vector<Wide> right(w, 0);
+        columnSums<T>(startH, half, w, mode, left.data(), row);
+        columnSums<T>(startH + half, h - half, w, mode, right.data(), row);
+        for (int k = 0; k < w; k++) {
+            out[k] += left[k] + right[k];
+        }
+    }
+    else if (mode == Summation::Kahan) {
+        std::vector<Acc> sum(w, 0);
+        std::vector<Acc> comp(w, 0);
+        for (int i = startH; i < startH + h; i++) {
+            auto value = row(i);
+            for (int k = 0; k < w; k++) {
+                summation::compensatedAdd(sum[k], comp[k], static_cast<Acc>(value(k)));
+            }
+        }
+        for (int k = 0; k < w; k++) {
+            out[k] += static_cast<Wide>(sum[k]) + static_cast<Wide>(comp[k]);
+        }
+    }
+    else if (mode == Summation::Widened) {
+        for (int i = startH; i < startH + h; i++) {
+            auto value = row(i);
+            for (int k = 0; k < w; k++) {
+                out[k] += static_cast<Wide>(value(k));
+            }
+        }
+    }
+    else {
+        std::vector<Acc> sum(w, 0);
+        for (int i = startH; i < startH + h; i++) {
+            auto value = row(i);
+            for (int k = 0; k < w; k++) {
+                sum[k] += static_cast<Acc>(value(k));
+            }
+        }
+        for (int k = 0; k < w; k++) {
+            out[k] += static_cast<Wide>(sum[k]);
+        }
+    }
+}
+
+
+/*
+ * Constructors
+ * Bits beyond the width in the last word of a row are always zero.
+ */
+
+template<class T>
+MaskedMatrix<T>::MaskedMatrix(Matrix<T>&& data) : data_(std::move(data)) {
+    words_ = wordCount(data_.getWidth());
+    bits_.assign(static_cast<std::size_t>(data_.getHeight()) * words_, 0);
+}
+
+template<class T>
+MaskedMatrix<T>::MaskedMatrix(Matrix<T>&& data, const Mask& mask) : MaskedMatrix(std::move(data)) {
+    if (mask.getShape() != data_.getShape())
+        throw std::invalid_argument("Mask shape must be the same as the matrix shape.");
+    int width = getWidth();
+    #pragma omp parallel for schedule(static) if(static_cast<long>(getHeight()) * width > PARALLEL_THRESHOLD)
+    for (int i = 0; i < getHeight(); i++) {
+        const uint8_t* row = mask(i).data();
+        uint64_t* words = bits_.data() + static_cast<std::size_t>(i) * words_;
+        for (int j = 0; j < width; j++) {
+            words[j >> 6] |= static_cast<uint64_t>(row[j] != 0) << (j & 63);
+        }
+    }
+}
+
+template<class T>
+MaskedMatrix<T> MaskedMatrix<T>::maskNaN(Matrix<T>&& data) {
+    MaskedMatrix<T> result(std::move(data));
+    int width = result.getWidth();
+    #pragma omp parallel for schedule(static) if(static_cast<long>(result.getHeight()) * width > PARALLEL_THRESHOLD)
+    for (int i = 0; i < result.getHeight(); i++) {
+        const T* row = result.data()(i).data();
+        uint64_t* words = result.bits_.data() + static_cast<std::size_t>(i) * result.words_;
+        for (int j = 0; j < width; j++) {
+            words[j >> 6] |= static_cast<uint64_t>(row[j] != row[j]) << (j & 63);
+        }
+    }
+    return result;
+}
+
+
+/*
+ * Methods
+ */
+
+template<class T>
+void MaskedMatrix<T>::mask(int h, int w) {
+    if (h < 0 || h >= getHeight() || w < 0 || w >= getWidth())
+        throw std::out_of_range("Index out of bounds.");
+    bits_[static_cast<std::size_t>(h) * words_ + (w >> 6)] |= uint64_t(1) << (w & 63);
+}
+
+template<class T>
+void MaskedMatrix<T>::unmask(int h, int w) {
+    if (h < 0 || h >= getHeight() || w < 0 || w >= getWidth())
+        throw std::out_of_range("Index out of bounds.");
+    bits_[static_cast<std::size_t>(h) * words_ + (w >> 6)] &= ~(uint64_t(1) << (w & 63));
+}
+
+template<class T>
+void MaskedMatrix<T>::maskRow(int h) {
+    if (h < 0 || h >= getHeight())
+        throw std::out_of_range("Index out of bounds.");
+    uint64_t* words = bits_.data() + static_cast<std::size_t>(h) * words_;
+    std::fill(words, words + words_, ~uint64_t(0));
+    if (getWidth() % 64 != 0) {
+        words[words_ - 1] = (uint64_t(1) << (getWidth() % 64)) - 1;
+    }
+}
+
+template<class T>
+void MaskedMatrix<T>::maskCol(int w) {
+    if (w < 0 || w >= getWidth())
+        throw std::out_of_range("Index out of bounds.");
+    for (int i = 0; i < getHeight(); i++) {
+        bits_[static_cast<std::size_t>(i) * words_ + (w >> 6)] |= uint64_t(1) << (w & 63);
+    }
+}
+
+template<class T>
+long MaskedMatrix<T>::maskedInRow(int h) const {
+    return popcount(bits_.data() + static_cast<std::size_t>(h) * words_, words_);
+}
+
+template<class T>
+long MaskedMatrix<T>::count() const {
+    return static_cast<long>(getHeight()) * getWidth() - popcount(bits_.data(), static_cast<int>(bits_.size()));
+}
+
+template<class T>
+std::vector<long> MaskedMatrix<T>::count(int axis) const {
+    int height = getHeight();
+    int width = getWidth();
+    if (axis == 0) {
+        std::vector<long> result(height);
+        for (int i = 0; i < height; i++) {
+            result[i] = width - maskedInRow(i);
+        }
+        return result;
+    }
+    else if (axis == 1) {
+        // The masked elements add -1 to the count of their column
+        std::vector<long> result(width, height);
+        std::vector<int> skip(64 * words_);
+        for (int i = 0; i < height; i++) {
+            expand(bits_.data() + static_cast<std::size_t>(i) * words_, words_, skip.data());
+            for (int j = 0; j < width; j++) {
+                result[j] += skip[j];
+            }
+        }
+        return result;
+    }
+    else {
+        throw std::invalid_argument("Axis must be 0 or 1.");
+    }
+}
+
+template<class T>
+Mask MaskedMatrix<T>::getMask() const {
+    Mask result(getHeight(), getWidth());
+    for (int i = 0; i < getHeight(); i++) {
+        const uint64_t* words = bits_.data() + static_cast<std::size_t>(i) * words_;
+        uint8_t* row = result(i).data();
+        for (int j = 0; j < getWidth(); j++) {
+            row[j] = static_cast<uint8_t>((words[j >> 6] >> (j & 63)) & 1);
+        }
+    }
+    return result;
+}
+
+template<class T>
+Matrix<T> MaskedMatrix<T>::filled(const T& value) const {
+    using Flag = typename extremes::Order<T>::Flag;
+    int height = getHeight();
+    int width = getWidth();
+    Matrix<T> result(height, width);
+    #pragma omp parallel if(static_cast<long>(height) * width > PARALLEL_THRESHOLD)
+    {
+        std::vector<Flag> skip(64 * words_);
+        #pragma omp for schedule(static)
+        for (int i = 0; i < height; i++) {
+            const T* row = data_(i).data();
+            T* out = result(i).data();
+            expand(bits_.data() + static_cast<std::size_t>(i) * words_, words_, skip.data());
+            for (int j = 0; j < width; j++) {
+                out[j] = skip[j] ? value : row[j];
+            }
+        }
+    }
+    return result;
+}
+
+
+/*
+ * Reductions
+ * A row without masked element is reduced like in Matrix, a fully masked
+ * one is skipped, the others are blended with their expanded mask.
+ */
+
+// Extreme of the unmasked elements of a row whose mask is words
+template<bool Greater, typename T, typename Flag>
+static extremes::Extreme<Greater, T> rowExtreme(const T* row, const uint64_t* words, int width, Flag* skip) {
+    int n = wordCount(width);
+    long masked = popcount(words, n);
+    if (masked == 0) {
+        return extremes::reduce<Greater, false>(row, width);
+    }
+    if (masked == width) {
+        return extremes::Extreme<Greater, T>();
+    }
+    expand(words, n, skip);
+    return extremes::reduce<Greater, false>(row, width, [skip](int j) { return skip[j]; });
+}
+
+// Sum of the unmasked elements of a row whose mask is words
+template<typename T, typename Flag>
+static typename Widened<T>::type rowSum(const T* row, const uint64_t* words, int width, Summation mode, Flag* skip) {
+    int n = wordCount(width);
+    long masked = popcount(words, n);
+    if (masked == 0) {
+        return reduceSum(row, width, mode);
+    }
+    if (masked == width) {
+        return 0;
+    }
+    expand(words, n, skip);
+    return reduce<T>(width, mode, [row, skip](std::size_t j) { return extremes::clear(row[j], skip[j]); });
+}
+
+template<class T>
+template<bool Greater>
+T MaskedMatrix<T>::extreme() const {
+    using Flag = typename extremes::Order<T>::Flag;
+    int height = getHeight();
+    int width = getWidth();
+    if (height == 0 || width == 0)
+        throw std::out_of_range("Cannot reduce an empty matrix.");
+
+    std::vector<extremes::Extreme<Greater, T>> rowExtremes(height);
+    #pragma omp parallel if(static_cast<long>(height) * width > PARALLEL_THRESHOLD)
+    {
+        std::vector<Flag> skip(64 * words_);
+        #pragma omp for schedule(static)
+        for (int i = 0; i < height; i++) {
+            rowExtremes[i] = rowExtreme<Greater>(data_(i).data(), bits_.data() + static_cast<std::size_t>(i) * words_,
+                                                 width, skip.data());
+        }
+    }
+    for (int i = 1; i < height; i++) {
+        rowExtremes[0].merge(rowExtremes[i]);
+    }
+    return rowExtremes[0].result();
+}
+
+template<class T>
+template<bool Greater>
+std::vector<T> MaskedMatrix<T>::extreme(int axis) const {
+    using Flag = typename extremes::Order<T>::Flag;
+    int height = getHeight();
+    int width = getWidth();
+    long work = static_cast<long>(height) * width;
+    if (axis == 0) {
+        if (height > 0 && width == 0)
+            throw std::out_of_range("Cannot reduce an empty row.");
+        std::vector<T> result(height);
+        #pragma omp parallel if(work > PARALLEL_THRESHOLD)
+        {
+            std::vector<Flag> skip(64 * words_);
+            #pragma omp for schedule(static)
+            for (int i = 0; i < height; i++) {
+                result[i] = rowExtreme<Greater>(data_(i).data(), bits_.data() + static_cast<std::size_t>(i) * words_,
+                                                width, skip.data()).result();
+            }
+        }
+        return result;
+    }
+    else if (axis == 1) {
+        if (width > 0 && height == 0)
+            throw std::out_of_range("Cannot reduce an empty column.");
+        std::vector<T> result(width);
+        #pragma omp parallel for schedule(static) if(work > PARALLEL_THRESHOLD)
+        for (int j = 0; j < width; j += COLUMN_BLOCK) {
+            int w = std::min(COLUMN_BLOCK, width - j);
+            int n = wordCount(w);
+            Flag skip[COLUMN_BLOCK];
+            extremes::Columns<Greater, T> columns(w);
+            for (int i = 0; i < height; i++) {
+                const uint64_t* words = bits_.data() + static_cast<std::size_t>(i) * words_ + j / 64;
+                if (popcount(words, n) == 0) {
+                    columns.template add<false>(data_(i).data() + j);
+                } else {
+                    expand(words, n, skip);
+                    columns.template add<false>(data_(i).data() + j, [&skip](int k) { return skip[k]; });
+                }
+            }
+            columns.result(result.data() + j);
+        }
+        return result;
+    }
+    else {
+        throw std::invalid_argument("Axis must be 0 or 1.");
+    }
+}
+
+template<class T>
+T MaskedMatrix<T>::max() const {
+    MATRIX_PROFILE(Max, getHeight(), getWidth(), static_cast<long>(getHeight()) * getWidth(), 0);
+    return extreme<true>();
+}
+
+template<class T>
+std::vector<T> MaskedMatrix<T>::max(int axis) const {
+    MATRIX_PROFILE(Max, getHeight(), getWidth(), static_cast<long>(getHeight()) * getWidth(), 0);
+    return extreme<true>(axis);
+}
+
+template<class T>
+T MaskedMatrix<T>::min() const {
+    MATRIX_PROFILE(Min, getHeight(), getWidth(), static_cast<long>(getHeight()) * getWidth(), 0);
+    return extreme<false>();
+}
+
+template<class T>
+std::vector<T> MaskedMatrix<T>::min(int axis) const {
+    MATRIX_PROFILE(Min, getHeight(), getWidth(), static_cast<long>(getHeight()) * getWidth(), 0);
+    return extreme<false>(axis);
+}
+
+template<class T>
+T MaskedMatrix<T>::sum(Summation mode) const {
+    MATRIX_PROFILE(Sum, getHeight(), getWidth(), static_cast<long>(getHeight()) * getWidth(), 0);
+    using Flag = typename extremes::Order<T>::Flag;
+    using Wide = typename Widened<T>::type;
+    int height = getHeight();
+    std::vector<Wide> rowSums(height);
+    #pragma omp parallel if(static_cast<long>(height) * getWidth() > PARALLEL_THRESHOLD)
+    {
+        std::vector<Flag> skip(64 * words_);
+        #pragma omp for schedule(static)
+        for (int i = 0; i < height; i++) {
+            rowSums[i] = rowSum(data_(i).data(), bits_.data() + static_cast<std::size_t>(i) * words_, getWidth(), mode,
+                                skip.data());
+        }
+    }
+    return static_cast<T>(reduceSum(rowSums.data(), rowSums.size(), mode));
+}
+
+template<class T>
+std::vector<T> MaskedMatrix<T>::sum(int axis, Summation mode) const {
+    MATRIX_PROFILE(Sum, getHeight(), getWidth(), static_cast<long>(getHeight()) * getWidth(), 0);
+    using Flag = typename extremes::Order<T>::Flag;
+    using Wide = typename Widened<T>::type;
+    int height = getHeight();
+    int width = getWidth();
+    long work = static_cast<long>(height) * width;
+    if (axis == 0) {
+        std::vector<T> result(height);
+        #pragma omp parallel if(work > PARALLEL_THRESHOLD)
+        {
+            std::vector<Flag> skip(64 * words_);
+            #pragma omp for schedule(static)
+            for (int i = 0; i < height; i++) {
+                result[i] = static_cast<T>(rowSum(data_(i).data(), bits_.data() + static_cast<std::size_t>(i) * words_,
+                                                  width, mode, skip.data()));
+            }
+        }
+        return result;
+    }
+    else if (axis == 1) {
+        std::vector<Wide> acc(width, 0);
+        #pragma omp parallel for schedule(static) if(work > PARALLEL_THRESHOLD)
+        for (int j = 0; j < width; j += COLUMN_BLOCK) {
+            int w = std::min(COLUMN_BLOCK, width - j);
+            Flag skip[COLUMN_BLOCK];
+            auto row = [&](int i) {
+                const T* data = data_(i).data() + j;
+                expand(bits_.data() + static_cast<std::size_t>(i) * words_ + j / 64, wordCount(w), skip);
+                const Flag* s = skip;
+                return [data, s](int k) { return extremes::clear(data[k], s[k]); };
+            };
+            columnSums<T>(0, height, w, mode, acc.data() + j, row);
+        }
+        return std::vector<T>(acc.begin(), acc.end());
+    }
+    else {
+        throw std::invalid_argument("Axis must be 0 or 1.");
+    }
+}
+
+template<class T>
+T MaskedMatrix<T>::mean(Summation mode) const {
+    return ::mean<T>(sum(mode), count());
+}
+
+template<class T>
+std::vector<T> MaskedMatrix<T>::mean(int axis, Summation mode) const {
+    std::vector<T> sums = sum(axis, mode);
+    std::vector<long> counts = count(axis);
+    for (std::size_t k = 0; k < sums.size(); k++) {
+        sums[k] = ::mean<T>(sums[k], counts[k]);
+    }
+    return sums;
+}
+
+
+/*
+ * NaN-skipping reductions
+ * NaN is replaced by the identity of the reduction in the inner loops
+ * (x == x is false only for NaN, and always true for integer types).
+ */
+
+template<typename T>
+T nansum(const Matrix<T>& m, Summation mode) {
+    MATRIX_PROFILE(Sum, m.getHeight(), m.getWidth(), static_cast<long>(m.getHeight()) * m.getWidth(), 0);
+    using Acc = typename Accumulator<T>::type;
+    using Wide = typename Widened<T>::type;
+    int width = m.getWidth();
+    std::vector<Wide> rowSums(m.getHeight());
+    #pragma omp parallel for schedule(static) if(static_cast<long>(m.getHeight()) * width > PARALLEL_THRESHOLD)
+    for (int i = 0; i < m.getHeight(); i++) {
+        const T* row = m(i).data();
+        rowSums[i] = reduce<T>(width, mode, [row](std::size_t j) {
+            Acc x = static_cast<Acc>(row[j]);
+            return x == x ? x : Acc(0);
+        });
+    }
+    return static_cast<T>(reduceSum(rowSums.data(), rowSums.size(), mode));
+}
+
+template<typename T>
+std::vector<T> nansum(const Matrix<T>& m, int axis, Summation mode) {
+    MATRIX_PROFILE(Sum, m.getHeight(), m.getWidth(), static_cast<long>(m.getHeight()) * m.getWidth(), 0);
+    using Acc = typename Accumulator<T>::type;
+    using Wide = typename Widened<T>::type;
+    int height = m.getHeight();
+    int width = m.getWidth();
+    long work = static_cast<long>(height) * width;
+    if (axis == 0) {
+        std::vector<T> result(height);
+        #pragma omp parallel for schedule(static) if(work > PARALLEL_THRESHOLD)
+        for (int i = 0; i < height; i++) {
+            const T* row = m(i).data();
+            result[i] = static_cast<T>(reduce<T>(width, mode, [row](std::size_t j) {
+                Acc x = static_cast<Acc>(row[j]);
+                return x == x ? x : Acc(0);
+            }));
+        }
+        return result;
+    }
+    else if (axis == 1) {
+        std::vector<Wide> acc(width, 0);
+        #pragma omp parallel for schedule(static) if(work > PARALLEL_THRESHOLD)
+        for (int j = 0; j < width; j += COLUMN_BLOCK) {
+            int w = std::min(COLUMN_BLOCK, width - j);
+            auto row = [&m, j](int i) {
+                const T* data = m(i).data() + j;
+                return [data](int k) {
+                    Acc x = static_cast<Acc>(data[k]);
+                    return x == x ? x : Acc(0);
+                };
+            };
+            columnSums<T>(0, height, w, mode, acc.data() + j, row);
+        }
+        return std::vector<T>(acc.begin(), acc.end());
+    }
+    else {
+        throw std::invalid_argument("Axis must be 0 or 1.");
+    }
+}
+
+template<bool Greater, typename T>
+static T nanExtreme(const Matrix<T>& m) {
+    int height = m.getHeight();
+    int width = m.getWidth();
+    if (height == 0 || width == 0)
+        throw std::out_of_range("Cannot reduce an empty matrix.");
+    std::vector<extremes::Extreme<Greater, T>> rowExtremes(height);
+    #pragma omp parallel for schedule(static) if(static_cast<long>(height) * width > PARALLEL_THRESHOLD)
+    for (int i = 0; i < height; i++) {
+        rowExtremes[i] = extremes::reduce<Greater, true>(m(i).data(), width);
+    }
+    for (int i = 1; i < height; i++) {
+        rowExtremes[0].merge(rowExtremes[i]);
+    }
+    return rowExtremes[0].result();
+}
+
+template<bool Greater, typename T>
+static std::vector<T> nanExtreme(const Matrix<T>& m, int axis) {
+    int height = m.getHeight();
+    int width = m.getWidth();
+    long work = static_cast<long>(height) * width;
+    if (axis == 0) {
+        std::vector<T> result(height);
+        #pragma omp parallel for schedule(static) if(work > PARALLEL_THRESHOLD)
+        for (int i = 0; i < height; i++) {
+            result[i] = extremes::reduce<Greater, true>(m(i).data(), width).result();
+        }
+        return result;
+    }
+    else if (axis == 1) {
+        std::vector<T> result(width);
+        #pragma omp parallel for schedule(static) if(work > PARALLEL_THRESHOLD)
+        for (int j = 0; j < width; j += COLUMN_BLOCK) {
+            int w = std::min(COLUMN_BLOCK, width - j);
+            extremes::Columns<Greater, T> columns(w);
+            for (int i = 0; i < height; i++) {
+                columns.template add<true>(m(i).data() + j);
+            }
+            columns.result(result.data() + j);
+        }
+        return result;
+    }
+    else {
+        throw std::invalid_argument("Axis must be 0 or 1.");
+    }
+}
+
+template<typename T>
+T nanmax(const Matrix<T>& m) {
+    MATRIX_PROFILE(Max, m.getHeight(), m.getWidth(), static_cast<long>(m.getHeight()) * m.getWidth(), 0);
+    return nanExtreme<true>(m);
+}
+
+template<typename T>
+std::vector<T> nanmax(const Matrix<T>& m, int axis) {
+    MATRIX_PROFILE(Max, m.getHeight(), m.getWidth(), static_cast<long>(m.getHeight()) * m.getWidth(), 0);
+    return nanExtreme<true>(m, axis);
+}
+
+template<typename T>
+T nanmin(const Matrix<T>& m) {
+    MATRIX_PROFILE(Min, m.getHeight(), m.getWidth(), static_cast<long>(m.getHeight()) * m.getWidth(), 0);
+    return nanExtreme<false>(m);
+}
+
+template<typename T>
+std::vector<T> nanmin(const Matrix<T>& m, int axis) {
+    MATRIX_PROFILE(Min, m.getHeight(), m.getWidth(), static_cast<long>(m.getHeight()) * m.getWidth(), 0);
+    return nanExtreme<false>(m, axis);
+}
+
+// Number of elements that are not NaN in every row (axis 0) or column (axis 1)
+template<typename T>
+static std::vector<long> numbers(const Matrix<T>& m, int axis) {
+    using Acc = typename Accumulator<T>::type;
+    int height = m.getHeight();
+    int width = m.getWidth();
+    std::vector<long> result(axis == 0 ? height : width, 0);
+    if (axis == 0) {
+        #pragma omp parallel for schedule(static) if(static_cast<long>(height) * width > PARALLEL_THRESHOLD)
+        for (int i = 0; i < height; i++) {
+            const T* row = m(i).data();
+            result[i] = summation::naiveSum<int>(width, [row](std::size_t j) {
+                Acc x = static_cast<Acc>(row[j]);
+                return static_cast<int>(x == x);
+            });
+        }
+    } else {
+        std::vector<int> counts(width, 0);
+        for (int i = 0; i < height; i++) {
+            const T* row = m(i).data();
+            for (int j = 0; j < width; j++) {
+                Acc x = static_cast<Acc>(row[j]);
+                counts[j] += static_cast<int>(x == x);
+            }
+        }
+        std::copy(counts.begin(), counts.end(), result.begin());
+    }
+    return result;
+}
+
+template<typename T>
+T nanmean(const Matrix<T>& m, Summation mode) {
+    std::vector<long> counts = numbers(m, 0);
+    long count = 0;
+    for (long c : counts) {
+        count += c;
+    }
+    return mean<T>(nansum(m, mode), count);
+}
+
+template<typename T>
+std::vector<T> nanmean(const Matrix<T>& m, int axis, Summation mode) {
+    std::vector<T> sums = nansum(m, axis, mode);
+    std::vector<long> counts = numbers(m, axis);
+    for (std::size_t k = 0; k < sums.size(); k++) {
+        sums[k] = mean<T>(sums[k], counts[k]);
+    }
+    return sums;
+}
+
+
+// Explicit instantiation
+#define MASKED_MATRIX_INSTANTIATE(T) \
+    template class MaskedMatrix<T>; \
+    template T nansum(const Matrix<T>& m, Summation mode); \
+    template std::vector<T> nansum(const Matrix<T>& m, int axis, Summation mode); \
+    template T nanmax(const Matrix<T>& m); \
+    template std::vector<T> nanmax(const Matrix<T>& m, int axis); \
+    template T nanmin(const Matrix<T>& m); \
+    template std::vector<T> nanmin(const Matrix<T>& m, int axis); \
+    template T nanmean(const Matrix<T>& m, Summation mode); \
+    template std::vector<T> nanmean(const Matrix<T>& m, int axis, Summation mode);
+
+MASKED_MATRIX_INSTANTIATE(int)
+MASKED_MATRIX_INSTANTIATE(float)
+MASKED_MATRIX_INSTANTIATE(double)
+#if defined(MATRIX_HAS_FLOAT16)
+MASKED_MATRIX_INSTANTIATE(float16)
+#endif
+MASKED_MATRIX_INSTANTIATE(bfloat16)
@@ -0,0 +1,102 @@
+//
+// Matrix with masked elements, and NaN-skipping reductions.
+//
+
+#include <cstdint>
+#include <vector>
+#include <utility>
+#include <stdexcept>
+
+#include "matrix.h"
+
+#ifndef MASKED_MATRIX_H
+#define MASKED_MATRIX_H
+
+
+/*
+ * MaskedMatrix class
+ * A matrix and a mask of the same shape. A set bit masks the element, whose
+ * value is kept but ignored by the reductions (it can be anything, NaN
+ * included). Every row of the mask is packed in 64-bit words: counting the
+ * masked elements is a popcount per word, and the rows without any (or with
+ * only) masked elements are found by scanning the words.
+ * In the reductions, the words of a partly masked row are expanded into one
+ * lane mask per element that blends the element with the identity of the
+ * reduction, so the inner loops have no branch and are vectorized.
+ *
+ * Reductions follow Matrix: sum, max and min of a row (axis 0) or of a
+ * column (axis 1). Unmasked NaN propagate to max and min. The extreme or the
+ * mean of a fully masked row, column or matrix is NaN (0 for integer types),
+ * the extreme of an empty one throws std::out_of_range like in Matrix.
+ */
+
+template<typename T>
+class MaskedMatrix {
+public:
+    MaskedMatrix() = default;
+    // Nothing masked
+    explicit MaskedMatrix(Matrix<T>&& data);
+    // Masked where mask is non zero
+    MaskedMatrix(Matrix<T>&& data, const Mask& mask);
+    // Masked where the data is NaN
+    static MaskedMatrix<T> maskNaN(Matrix<T>&& data);
+
+    // Inline element access
+    inline const T& operator()(int h, int w) const { return data_(h, w); }
+    inline T& operator()(int h, int w) { return data_(h, w); }
+    inline bool isMasked(int h, int w) const { return (bits_[h * words_ + (w >> 6)] >> (w & 63)) & 1; }
+
+    // Inline getters
+    [[nodiscard]] inline int getHeight() const { return data_.getHeight(); }
+    [[nodiscard]] inline int getWidth() const { return data_.getWidth(); }
+    [[nodiscard]] inline std::pair<int, int> getShape() const { return data_.getShape(); }
+    [[nodiscard]] inline const Matrix<T>& data() const { return data_; }
+
+    // Methods
+    void mask(int h, int w);
+    void unmask(int h, int w);
+    void maskRow(int h);
+    void maskCol(int w);
+    long count() const;                         // unmasked elements
+    std::vector<long> count(int axis) const;
+    Mask getMask() const;
+    Matrix<T> filled(const T& value) const;     // masked elements replaced by value
+
+    // Maths operations on the unmasked elements
+    T max() const;
+    std::vector<T> max(int axis) const;
+    T min() const;
+    std::vector<T> min(int axis) const;
+    T sum(Summation mode=Summation::Naive) const;
+    std::vector<T> sum(int axis, Summation mode=Summation::Naive) const;
+    T mean(Summation mode=Summation::Naive) const;
+    std::vector<T> mean(int axis, Summation mode=Summation::Naive) const;
+
+private:
+    template<bool Greater> T extreme() const;
+    template<bool Greater> std::vector<T> extreme(int axis) const;
+    long maskedInRow(int h) const;
+
+    Matrix<T> data_;
+    std::vector<uint64_t> bits_;
+    int words_ = 0;                              // words per row
+};
+
+
+/*
+ * NaN-skipping reductions
+ * Same as the Matrix reductions, NaN elements are left out. nanmax, nanmin
+ * and nanmean of a row, column or matrix without any number give NaN.
+ * nansum of an integer matrix is sum.
+ */
+template<typename T> T nansum(const Matrix<T>& m, Summation mode=Summation::Naive);
+template<typename T> std::vector<T> nansum(const Matrix<T>& m, int axis, Summation mode=Summation::Naive);
+template<typename T> T nanmax(const Matrix<T>& m);
+template<typename T> std::vector<T> nanmax(const Matrix<T>& m, int axis);
+template<typename T> T nanmin(const Matrix<T>& m);
+template<typename T> std::vector<T> nanmin(const Matrix<T>& m, int axis);
+template<typename T> T nanmean(const Matrix<T>& m, Summation mode=Summation::Naive);
+template<typename T> std::vector<T> nanmean(const Matrix<T>& m, int axis, Summation mode=Summation::Naive);
+
+
+#endif // MASKED_MATRIX_H
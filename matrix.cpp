@@ -3,9 +3,40 @@
 //
 
 #include "matrix.h"
+#include "dispatch.h"
+#include "extremes.h"
+#include "strassen.h"
+#include "textio.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cstring>
+#include <exception>
 #include <fstream>
 #include <sstream>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Number of columns processed together by the column-wise reductions
+static const int COLUMN_BLOCK = 256;
+// Side of the square tiles copied by transpose
+static const int TRANSPOSE_TILE = 64;
+
+// Number of threads used by the parallel loops
+static inline int maxThreads() {
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
 /*
  * Matrix class
  * A core is a 2D array of elements of type T
@@ -13,7 +44,8 @@
  * The first vector represents the rows, the second the columns
  * The core is stored in row-major order
  * The core is templated to allow different types of elements
- * The core is moveable and copyable
+ * The core is moveable and copyable, copies share the rows until one of
+ * them is modified (see matrix.h)
  */
 
 /*
@@ -22,16 +54,15 @@
 
 // Default constructor
 template<class T>
-Matrix<T>::Matrix(){
+Matrix<T>::Matrix() : array_(emptyRows()) {
     this->height_ = 0;
     this->width_ = 0;
-    this->array_ = std::vector<std::vector<T>>();
 }
 
 // Constructor with specified size
 template<class T>
 Matrix<T>::Matrix(int rows, int cols){
-    this->array_.resize(rows, std::vector<T>(cols));
+    this->array_ = std::make_shared<Rows>(rows, std::vector<T>(cols));
     this->height_ = rows;
     this->width_ = cols;
 }
@@ -41,15 +72,15 @@ template<class T>
 Matrix<T>::Matrix(int rows, int cols, T defaultValue){
     this->height_ = rows;
     this->width_ = cols;
-    this->array_ = std::vector<std::vector<T>>(rows, std::vector<T>(cols, defaultValue));
+    this->array_ = std::make_shared<Rows>(rows, std::vector<T>(cols, defaultValue));
 }
 
 // Constructor from a vector of vectors
 template<class T>
-Matrix<T>::Matrix(const std::vector<std::vector<T>>& array_){
-    this->height_ = array_.size();
-    this->width_ = this->height_ > 0 ? array_[0].size() : 0;
-    this->array_ = array_;
+Matrix<T>::Matrix(const std::vector<std::vector<T>>& rows){
+    this->height_ = rows.size();
+    this->width_ = this->height_ > 0 ? rows[0].size() : 0;
+    this->array_ = std::make_shared<Rows>(rows);
 }
 
 
@@ -59,61 +90,80 @@ Matrix<T>::Matrix(Matrix<T>&& other) noexcept{
     this->height_ = other.height_;
     this->width_ = other.width_;
     this->array_ = std::move(other.array_);
+    other.array_ = emptyRows();
     other.height_ = 0;
     other.width_ = 0;
 }
 
+// Copy constructor, O(1): the rows are shared until one of the matrices is modified
+template<class T>
+Matrix<T>::Matrix(const Matrix<T>& other) noexcept : array_(other.array_) {
+    this->height_ = other.height_;
+    this->width_ = other.width_;
+}
+
 
 // Move constructor (std::vector<std::vector<T>>&& m)
 template<class T>
-Matrix<T>::Matrix(std::vector<std::vector<T>>&& other) noexcept{
+Matrix<T>::Matrix(std::vector<std::vector<T>>&& other){
     this->height_ = other.size();
     this->width_ = this->height_ > 0 ? other[0].size() : 0;
-    this->array_ = std::move(other);
+    this->array_ = std::make_shared<Rows>(std::move(other));
     other.clear();
 }
 
 
+/*
+ * Copy-on-write storage
+ */
+
+// Shared by the empty and moved-from matrices, so that they never allocate
+template<class T>
+const std::shared_ptr<typename Matrix<T>::Rows>& Matrix<T>::emptyRows() {
+    static const std::shared_ptr<Rows> empty = std::make_shared<Rows>();
+    return empty;
+}
+
+// Slow path of detach(): the rows are shared, this matrix gets its own copy
+template<class T>
+void Matrix<T>::copyRows() {
+    MATRIX_PROFILE(Duplicate, height_, width_, static_cast<long>(height_) * width_, sizeof(T) * height_ * width_);
+    this->array_ = std::make_shared<Rows>(*this->array_);
+}
+
+
 /*
  * Methods
  */
 
 template <class T>
 void Matrix<T>::clear(){
-    for (auto& row : this->array_) {
-        row.clear();
-    }
-    this->array_.clear();
+    this->array_ = emptyRows();
     this->height_ = 0;
     this->width_ = 0;
 }
 
+// O(1), the elements are copied by the first modification of either matrix
 template <class T>
 Matrix<T> Matrix<T>::duplicate() const{
-    Matrix<T> newMatrix(height_, width_);
-    // Copy the data from the current matrix to newMatrix
-    for (int i = 0; i < height_; ++i) {
-        for (int j = 0; j < width_; ++j) {
-            newMatrix(i, j) = (*this)(i, j);
-        }
-    }
-    return newMatrix;
+    return Matrix<T>(*this);
 }
 
 template<class T>
 void Matrix<T>::erase(int index, int axis) {
+    detach();
     if (axis == 0) {
         if (index < 0 || index >= this->height_) {
             throw std::out_of_range("Index out of bounds for row deletion.");
         }
-        this->array_.erase(this->array_.begin() + index);
+        this->array_->erase(this->array_->begin() + index);
         this->height_--;
     } else if (axis == 1) {
         if (index < 0 || index >= this->width_) {
             throw std::out_of_range("Index out of bounds for column deletion.");
         }
         for (size_t i = 0; i < this->height_; ++i) {
-            this->array_[i].erase(this->array_[i].begin() + index);
+            (*this->array_)[i].erase((*this->array_)[i].begin() + index);
         }
         this->width_--;
     } else {
@@ -123,7 +173,8 @@ void Matrix<T>::erase(int index, int axis) {
 
 template <class T>
 void Matrix<T>::fill(const T& value) {
-    for (auto &row : array_) {
+    detach();
+    for (auto &row : *array_) {
         std::fill(row.begin(), row.end(), value);
     }
 }
@@ -135,7 +186,7 @@ std::vector<T> Matrix<T>::getCol(int col) {
     }
     std::vector<T> column;
     column.reserve(this->height_);
-    for (const auto& row : this->array_) {
+    for (const auto& row : *this->array_) {
         column.push_back(row.at(col));
     }
     return column;
@@ -148,14 +199,28 @@ std::vector<T> Matrix<T>::getCol(int col) const {
     }
     std::vector<T> column;
     column.reserve(this->height_);
-    for (const auto& row : this->array_) {
+    for (const auto& row : *this->array_) {
         column.push_back(row.at(col));
     }
     return column;
 }
 
+// Elements (i, i + offset), offset > 0 is above the main diagonal
+template<class T>
+std::vector<T> Matrix<T>::diagonal(int offset) const {
+    int first = std::max(0, -offset);
+    int last = std::min(this->height_, this->width_ - offset);
+    std::vector<T> result;
+    result.reserve(std::max(0, last - first));
+    for (int i = first; i < last; i++) {
+        result.push_back((*this->array_)[i][i + offset]);
+    }
+    return result;
+}
+
 template<class T>
 void Matrix<T>::insert(int index, const std::vector<T>& newData, int axis) {
+    detach();
     if (axis == 0) {
         if (newData.size() != this->width_ && this->width_ != 0) {
             throw std::invalid_argument("Row size does not match the number of columns.");
@@ -163,7 +228,7 @@ void Matrix<T>::insert(int index, const std::vector<T>& newData, int axis) {
         if (index < 0 || index > this->height_) {
             throw std::out_of_range("Index out of bounds for row insertion.");
         }
-        this->array_.insert(this->array_.begin() + index, newData);
+        this->array_->insert(this->array_->begin() + index, newData);
         this->height_++;
         if (this->width_ == 0) {
             this->width_ = newData.size();
@@ -176,7 +241,7 @@ void Matrix<T>::insert(int index, const std::vector<T>& newData, int axis) {
             throw std::out_of_range("Index out of bounds for column insertion.");
         }
         for (size_t i = 0; i < this->height_; ++i) {
-            this->array_[i].insert(this->array_[i].begin() + index, newData[i]);
+            (*this->array_)[i].insert((*this->array_)[i].begin() + index, newData[i]);
         }
         this->width_++;
     } else {
@@ -186,18 +251,19 @@ void Matrix<T>::insert(int index, const std::vector<T>& newData, int axis) {
 
 template<class T>
 void Matrix<T>::pop_back(int axis) {
+    detach();
     if (axis == 0) {
         if (this->height_ == 0) {
             throw std::out_of_range("Cannot pop from an empty matrix.");
         }
-        this->array_.pop_back();
+        this->array_->pop_back();
         this->height_--;
     } else if (axis == 1) {
         if (this->width_ == 0) {
             throw std::out_of_range("Cannot pop from an empty matrix.");
         }
         for (size_t i = 0; i < this->height_; ++i) {
-            this->array_[i].pop_back();
+            (*this->array_)[i].pop_back();
         }
         this->width_--;
     } else {
@@ -207,37 +273,57 @@ void Matrix<T>::pop_back(int axis) {
 
 template <class T>
 void Matrix<T>::print(std::ostream &flux) const {
+    MATRIX_PROFILE(Print, height_, width_, static_cast<long>(height_) * width_, 0);
+    int precision = static_cast<int>(flux.precision());
+    char buffer[textio::MAX_CHARS];
     std::vector<int> maxLength(width_, 0);
-    std::stringstream ss;
 
-    for (int i = 0; i < height_; i++) {
+    // First pass: width of each column
+    #pragma omp parallel if(static_cast<long>(height_) * width_ > PARALLEL_THRESHOLD)
+    {
+        char local[textio::MAX_CHARS];
+        std::vector<int> localLength(width_, 0);
+        #pragma omp for schedule(static) nowait
+        for (int i = 0; i < height_; i++) {
+            for (int j = 0; j < width_; j++) {
+                char* end = textio::formatValue(local, local + textio::MAX_CHARS, (*array_)[i][j], precision);
+                localLength[j] = std::max(localLength[j], static_cast<int>(end - local));
+            }
+        }
+        #pragma omp critical
         for (int j = 0; j < width_; j++) {
-            ss << array_[i][j];
-            maxLength[j] = std::max(maxLength[j], static_cast<int>(ss.str().size()));
-            ss.str(std::string());
+            maxLength[j] = std::max(maxLength[j], localLength[j]);
         }
     }
 
+    // Second pass: every line is formatted in a single pre-sized buffer
+    std::size_t lineSize = 1;
+    for (int j = 0; j < width_; j++) {
+        lineSize += maxLength[j] + 1;
+    }
+    std::string line(lineSize, ' ');
     for (int i = 0; i < height_; i++) {
+        std::fill(line.begin(), line.end(), ' ');
+        char* out = &line[0];
         for (int j = 0; j < width_; j++) {
-            ss << array_[i][j];
-            flux << array_[i][j];
-            for (int k = 0; k < maxLength[j] - static_cast<int>(ss.str().size()) + 1; k++) {
-                flux << " ";
-            }
-            ss.str(std::string());
+            char* end = textio::formatValue(buffer, buffer + textio::MAX_CHARS, (*array_)[i][j], precision);
+            std::copy(buffer, end, out);
+            out += maxLength[j] + 1;
         }
-        flux << std::endl;
+        *out = '\n';
+        flux.write(line.data(), static_cast<std::streamsize>(lineSize));
     }
+    flux.flush();
 }
 
 template<class T>
 void Matrix<T>::push_back(const std::vector<T>& newData, int axis) {
+    detach();
     if (axis == 0) {
         if (newData.size() != this->width_ && this->width_ != 0) {
             throw std::invalid_argument("Row size does not match the number of columns.");
         }
-        this->array_.push_back(newData);
+        this->array_->push_back(newData);
         this->height_++;
         if (this->width_ == 0) {
             this->width_ = newData.size();
@@ -247,7 +333,7 @@ void Matrix<T>::push_back(const std::vector<T>& newData, int axis) {
             throw std::invalid_argument("Column size does not match the number of rows.");
         }
         for (size_t i = 0; i < this->height_; ++i) {
-            this->array_[i].push_back(newData[i]);
+            (*this->array_)[i].push_back(newData[i]);
         }
         this->width_++;
     } else {
@@ -260,34 +346,55 @@ void Matrix<T>::put(int h, int w, const T& value){
     if(!(h>=0 && h<height_ && w>=0 && w<width_))
         throw std::invalid_argument("Index out of bounds.");
 
-    array_[h][w] = value;
+    mutableRows()[h][w] = value;
 }
 
 template <class T>
 void Matrix<T>::reserve(int rows, int cols) {
-    this->array_.reserve(rows);
-    for (auto& row : this->array_) {
+    detach();
+    this->array_->reserve(rows);
+    for (auto& row : *this->array_) {
         row.reserve(cols);
     }
 }
 
 template <class T>
 void Matrix<T>::resize(int rows) {
-    this->array_.resize(rows);
-    this->height_ = rows;
+    resize(rows, this->width_);
 }
 
+/*
+ * Rows keep their buffer when the matrix is not shared: shrinking never
+ * reallocates and growing reallocates only the rows over capacity (see
+ * reserve). A shared matrix gets new rows holding only what is kept.
+ * New elements are zero.
+ */
 template <class T>
 void Matrix<T>::resize(int rows, int cols) {
-    std::vector<std::vector<T>> newarray_(rows, std::vector<T>(cols));
-
-    for (int i = 0; i < std::min(rows, this->height_); i++) {
-        for (int j = 0; j < std::min(cols, this->width_); j++) {
-            newarray_[i][j] = this->array_[i][j];
+    if (rows < 0 || cols < 0) {
+        throw std::invalid_argument("Dimensions must be positive.");
+    }
+    const int kept = std::min(rows, this->height_);
+    if (this->array_.use_count() != 1) {
+        MATRIX_PROFILE(Duplicate, rows, cols, static_cast<long>(rows) * cols, sizeof(T) * rows * cols);
+        auto newRows = std::make_shared<Rows>(rows, std::vector<T>(cols));
+        const int copied = std::min(cols, this->width_);
+        #pragma omp parallel for schedule(static) if(static_cast<long>(kept) * copied > PARALLEL_THRESHOLD)
+        for (int i = 0; i < kept; i++) {
+            std::copy_n((*this->array_)[i].begin(), copied, (*newRows)[i].begin());
+        }
+        this->array_ = std::move(newRows);
+    }
+    else {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        this->array_->resize(rows, std::vector<T>(cols));
+        if (cols != this->width_) {
+            #pragma omp parallel for schedule(static) if(static_cast<long>(kept) * cols > PARALLEL_THRESHOLD)
+            for (int i = 0; i < kept; i++) {
+                (*this->array_)[i].resize(cols);
+            }
         }
     }
-
-    this->array_ = newarray_;
     this->height_ = rows;
     this->width_ = cols;
 }
@@ -295,13 +402,14 @@ void Matrix<T>::resize(int rows, int cols) {
 
 template <class T>
 Matrix<T> Matrix<T>::subMat(int startH, int startW, int h, int w) const{
+    MATRIX_PROFILE(SubMat, h, w, static_cast<long>(h) * w, sizeof(T) * h * w);
     if(!(startH>=0 && startH+h<=height_ && startW>=0 && startW+w<=width_))
         throw std::invalid_argument("Index out of bounds");
 
     Matrix<T> result(h,w);
     for (int i=startH ; i<startH+h ; i++){
         for (int j=startW ; j<startW+w ; j++){
-            result.array_[i-startH][j-startW] = array_[i][j];
+            (*result.array_)[i-startH][j-startW] = (*array_)[i][j];
         }
     }
     return result;
@@ -315,281 +423,601 @@ Matrix<T> Matrix<T>::subMat(int startH, int startW, int h, int w) const{
 
 template <class T>
 Matrix<T> Matrix<T>::add(const Matrix& m) const{
+    MATRIX_PROFILE(Add, height_, width_, static_cast<long>(height_) * width_, sizeof(T) * height_ * width_);
     if(!(height_==m.height_ && width_==m.width_))
         throw std::invalid_argument("Matrix dimension must be the same.");
 
     Matrix result(height_, width_);
-    for (int i=0 ; i<height_ ; i++){
-        for (int j=0 ; j<width_ ; j++){
-            result.array_[i][j] = array_[i][j] + m.array_[i][j];
+    dispatch::run([&]() {
+        for (int i=0 ; i<height_ ; i++){
+            const T* a = (*array_)[i].data();
+            const T* b = (*m.array_)[i].data();
+            T* out = (*result.array_)[i].data();
+            for (int j=0 ; j<width_ ; j++){
+                out[j] = a[j] + b[j];
+            }
         }
-    }
+    });
 
     return result;
 }
 
 template <class T>
 Matrix<T> Matrix<T>::subtract(const Matrix& m) const{
+    MATRIX_PROFILE(Subtract, height_, width_, static_cast<long>(height_) * width_, sizeof(T) * height_ * width_);
     if(!(height_==m.height_ && width_==m.width_))
         throw std::invalid_argument("Matrix dimension must be the same.");
 
     Matrix result(height_, width_);
-    for (int i=0 ; i<height_ ; i++){
-        for (int j=0 ; j<width_ ; j++){
-            result.array_[i][j] = array_[i][j] - m.array_[i][j];
+    dispatch::run([&]() {
+        for (int i=0 ; i<height_ ; i++){
+            const T* a = (*array_)[i].data();
+            const T* b = (*m.array_)[i].data();
+            T* out = (*result.array_)[i].data();
+            for (int j=0 ; j<width_ ; j++){
+                out[j] = a[j] - b[j];
+            }
         }
-    }
+    });
     return result;
 }
 
 template <class T>
 Matrix<T> Matrix<T>::multiply(const T& value) const{
-    Matrix result(array_);
-    for (int i=0 ; i<height_ ; i++){
-        for (int j=0 ; j<width_ ; j++){
-            result.array_[i][j] *= value;
+    MATRIX_PROFILE(Multiply, height_, width_, static_cast<long>(height_) * width_, sizeof(T) * height_ * width_);
+    Matrix result(height_, width_);
+    dispatch::run([&]() {
+        for (int i=0 ; i<height_ ; i++){
+            const T* a = (*array_)[i].data();
+            T* out = (*result.array_)[i].data();
+            for (int j=0 ; j<width_ ; j++){
+                out[j] = a[j] * value;
+            }
         }
-    }
+    });
 
     return result;
 }
 
 template <class T>
 Matrix<T> Matrix<T>::multiply(const std::vector<T>& v) const{
+    MATRIX_PROFILE(Multiply, height_, width_, static_cast<long>(height_) * width_, sizeof(T) * height_ * width_);
     if(this->width_!=v.size())
         throw std::invalid_argument("Vector size must be the same as the core width_.");
 
     Matrix result(this->height_, this->width_);
-    for (int i=0 ; i<this->height_ ; i++){
-        for (int j=0 ; j<this->width_ ; j++){
-            result.array_[i][j] = this->array_[i][j] * v[j];
+    dispatch::run([&]() {
+        for (int i=0 ; i<this->height_ ; i++){
+            const T* a = (*this->array_)[i].data();
+            T* out = (*result.array_)[i].data();
+            for (int j=0 ; j<this->width_ ; j++){
+                out[j] = a[j] * v[j];
+            }
         }
-    }
+    });
     return result;
 }
 
 template <class T>
 Matrix<T> Matrix<T>::multiply(const Matrix& m) const{
+    MATRIX_PROFILE(Multiply, height_, width_, static_cast<long>(height_) * width_, sizeof(T) * height_ * width_);
     if(!(height_==m.height_ && width_==m.width_))
         throw std::invalid_argument("Matrix dimension must be the same.");
 
     Matrix result(height_, width_);
 
-    for (int i=0 ; i<height_ ; i++){
-        for (int j=0 ; j<width_ ; j++){
-            result.array_[i][j] = array_[i][j] * m.array_[i][j];
+    dispatch::run([&]() {
+        for (int i=0 ; i<height_ ; i++){
+            const T* a = (*array_)[i].data();
+            const T* b = (*m.array_)[i].data();
+            T* out = (*result.array_)[i].data();
+            for (int j=0 ; j<width_ ; j++){
+                out[j] = a[j] * b[j];
+            }
         }
-    }
+    });
     return result;
 }
 
 template <class T>
 Matrix<T> Matrix<T>::divide(const T& value) const{
-    Matrix result(array_);
-    for (int i=0 ; i<height_ ; i++){
-        for (int j=0 ; j<width_ ; j++){
-            result.array_[i][j] /= value;
+    MATRIX_PROFILE(Divide, height_, width_, static_cast<long>(height_) * width_, sizeof(T) * height_ * width_);
+    Matrix result(height_, width_);
+    dispatch::run([&]() {
+        for (int i=0 ; i<height_ ; i++){
+            const T* a = (*array_)[i].data();
+            T* out = (*result.array_)[i].data();
+            for (int j=0 ; j<width_ ; j++){
+                out[j] = a[j] / value;
+            }
         }
-    }
+    });
 
     return result;
 }
 
 template <class T>
 Matrix<T> Matrix<T>::divide(const std::vector<T>& v) const{
+    MATRIX_PROFILE(Divide, height_, width_, static_cast<long>(height_) * width_, sizeof(T) * height_ * width_);
     if(this->width_!=v.size())
         throw std::invalid_argument("Vector size must be the same as the core width_.");
 
     Matrix result(this->height_, this->width_);
-    for (int i=0 ; i<this->height_ ; i++){
-        for (int j=0 ; j<this->width_ ; j++){
-            result.array_[i][j] = this->array_[i][j] / v[j];
+    dispatch::run([&]() {
+        for (int i=0 ; i<this->height_ ; i++){
+            const T* a = (*this->array_)[i].data();
+            T* out = (*result.array_)[i].data();
+            for (int j=0 ; j<this->width_ ; j++){
+                out[j] = a[j] / v[j];
+            }
         }
-    }
+    });
     return result;
 }
 
 template <class T>
 Matrix<T> Matrix<T>::divide(const Matrix& m) const{
+    MATRIX_PROFILE(Divide, height_, width_, static_cast<long>(height_) * width_, sizeof(T) * height_ * width_);
     if(!(height_==m.height_ && width_==m.width_))
         throw std::invalid_argument("Matrix dimension must be the same.");
 
     Matrix result(height_, width_);
 
-    for (int i=0 ; i<height_ ; i++){
-        for (int j=0 ; j<width_ ; j++){
-            result.array_[i][j] = array_[i][j] / m.array_[i][j];
+    dispatch::run([&]() {
+        for (int i=0 ; i<height_ ; i++){
+            const T* a = (*array_)[i].data();
+            const T* b = (*m.array_)[i].data();
+            T* out = (*result.array_)[i].data();
+            for (int j=0 ; j<width_ ; j++){
+                out[j] = a[j] / b[j];
+            }
         }
-    }
+    });
     return result;
 }
 
 template <class T>
-Matrix<T> Matrix<T>::dot(const Matrix& m) const{
+Matrix<T> Matrix<T>::dot(const Matrix& m, Summation mode) const{
+    MATRIX_PROFILE(Dot, height_, m.width_, static_cast<long>(height_) * width_ * m.width_,
+                   sizeof(T) * (static_cast<long>(height_) * m.width_ + static_cast<long>(m.height_) * m.width_));
     if(this->width_ != m.height_)
         throw std::invalid_argument("Dot product not compatible.");
 
-    T w=0;
+    // The columns of m are made contiguous so every output element is the
+    // reduction of two contiguous arrays
+    Matrix<T> mt = m.transpose();
     int mwidth_ = m.width_;
+    long work = static_cast<long>(this->height_) * mwidth_ * this->width_;
 
     Matrix<T> result(this->height_, mwidth_);
+    #pragma omp parallel for schedule(static) if(work > PARALLEL_THRESHOLD)
     for (int i=0 ; i<this->height_ ; i++){
-        for (int j=0 ; j<mwidth_ ; j++){
-            for (int h=0 ; h<this->width_ ; h++){
-                w += this->array_[i][h]*m.array_[h][j];
+        const T* row = (*this->array_)[i].data();
+        T* out = (*result.array_)[i].data();
+        dispatch::run([&]() {
+            for (int j=0 ; j<mwidth_ ; j++){
+                out[j] = static_cast<T>(reduceDot(row, (*mt.array_)[j].data(), this->width_, mode));
             }
-            result.array_[i][j] = w;
-            w=0;
-        }
+        });
+    }
+
+    return result;
+}
+
+/*
+ * Strassen-Winograd product
+ * O(n^2.81) instead of O(n^3), the sub-products smaller than crossover use
+ * the classical kernel. The computation is done in Accumulator<T> (the
+ * Modular type for integers) on contiguous copies of both operands. The error bound is weaker than the
+ * classical one (it grows with the number of recursion levels).
+ */
+template <class T>
+Matrix<T> Matrix<T>::dotStrassen(const Matrix& m, int crossover) const{
+    if(this->width_ != m.height_)
+        throw std::invalid_argument("Dot product not compatible.");
+    MATRIX_PROFILE(Dot, height_, m.width_, static_cast<long>(height_) * width_ * m.width_,
+                   sizeof(T) * static_cast<long>(height_) * m.width_);
+
+    using Acc = typename Modular<typename Accumulator<T>::type>::type;
+    strassen::Buffer<Acc> a(this->height_, this->width_);
+    strassen::Buffer<Acc> b(m.height_, m.width_);
+    strassen::Buffer<Acc> c(this->height_, m.width_);
+    for (int i=0 ; i<this->height_ ; i++){
+        convertBulk((*this->array_)[i].data(), a.view.row(i), this->width_);
     }
+    for (int i=0 ; i<m.height_ ; i++){
+        convertBulk((*m.array_)[i].data(), b.view.row(i), m.width_);
+    }
+
+    #pragma omp parallel
+    #pragma omp single
+    strassen::multiply(a.view, b.view, c.view, std::max(1, crossover), 2);
 
+    Matrix<T> result(this->height_, m.width_);
+    for (int i=0 ; i<this->height_ ; i++){
+        convertBulk(c.view.row(i), (*result.array_)[i].data(), m.width_);
+    }
     return result;
 }
 
 template <class T>
 Matrix<T> Matrix<T>::transpose() const{
+    MATRIX_PROFILE(Transpose, height_, width_, static_cast<long>(height_) * width_, sizeof(T) * height_ * width_);
     Matrix<T> result(width_, height_);
 
-    for (int i=0 ; i<width_ ; i++){
-        for (int j=0 ; j<height_ ; j++){
-            result.array_[i][j] = array_[j][i];
+    // Tiles of result rows, the reads of a tile stay within TRANSPOSE_TILE source rows
+    #pragma omp parallel for schedule(static) if(static_cast<long>(height_) * width_ > PARALLEL_THRESHOLD)
+    for (int i0=0 ; i0<width_ ; i0+=TRANSPOSE_TILE){
+        int i1 = std::min(width_, i0 + TRANSPOSE_TILE);
+        for (int j0=0 ; j0<height_ ; j0+=TRANSPOSE_TILE){
+            int j1 = std::min(height_, j0 + TRANSPOSE_TILE);
+            dispatch::run([&]() {
+                for (int i=i0 ; i<i1 ; i++){
+                    T* out = (*result.array_)[i].data();
+                    for (int j=j0 ; j<j1 ; j++){
+                        out[j] = (*array_)[j][i];
+                    }
+                }
+            });
         }
     }
     return result;
 }
 
-template <class T>
-T Matrix<T>::max() const{
-    T max = array_[0][0];
-    for (int i=0 ; i<height_ ; i++){
-        for (int j=0 ; j<width_ ; j++){
-            if(array_[i][j]>max){
-                max = array_[i][j];
-            }
-        }
+/*
+ * Extremes
+ * NaN propagates: the result is NaN as soon as one of the reduced elements is
+ * NaN (nanmax and nanmin in masked_matrix.h skip them instead). See
+ * extremes.h for the vectorized kernel.
+ */
+template<bool Greater, typename T>
+static T extreme(const std::vector<std::vector<T>>& array, int height, int width) {
+    if (height == 0 || width == 0)
+        throw std::out_of_range("Cannot reduce an empty matrix.");
+    std::vector<extremes::Extreme<Greater, T>> rowExtremes(height);
+    #pragma omp parallel for schedule(static) if(static_cast<long>(height) * width > PARALLEL_THRESHOLD)
+    for (int i=0 ; i<height ; i++){
+        dispatch::run([&]() { rowExtremes[i] = extremes::reduce<Greater, false>(array[i].data(), width); });
     }
-    return max;
+    for (int i=1 ; i<height ; i++){
+        rowExtremes[0].merge(rowExtremes[i]);
+    }
+    return rowExtremes[0].result();
 }
 
-template<typename T>
-std::vector<T> Matrix<T>::max(int axis) const {
-    std::vector<T> maxElements;
+template<bool Greater, typename T>
+static std::vector<T> extreme(const std::vector<std::vector<T>>& array, int height, int width, int axis) {
+    long work = static_cast<long>(height) * width;
     if (axis == 0) {
-        for (const auto& row : array_) {
-            maxElements.push_back(*std::max_element(row.begin(), row.end()));
+        if (height > 0 && width == 0)
+            throw std::out_of_range("Cannot reduce an empty row.");
+        std::vector<T> result(height);
+        #pragma omp parallel for schedule(static) if(work > PARALLEL_THRESHOLD)
+        for (int i=0 ; i<height ; i++){
+            dispatch::run([&]() { result[i] = extremes::reduce<Greater, false>(array[i].data(), width).result(); });
         }
-    } else if (axis == 1) {
-        for (int j = 0; j < width_; ++j) {
-            T colMax = array_[0][j];
-            for (int i = 0; i < height_; ++i) {
-                if (array_[i][j] > colMax) {
-                    colMax = array_[i][j];
+        return result;
+    }
+    else if (axis == 1) {
+        if (width > 0 && height == 0)
+            throw std::out_of_range("Cannot reduce an empty column.");
+        std::vector<T> result(width);
+        #pragma omp parallel for schedule(static) if(work > PARALLEL_THRESHOLD)
+        for (int j=0 ; j<width ; j+=COLUMN_BLOCK){
+            int w = std::min(COLUMN_BLOCK, width - j);
+            extremes::Columns<Greater, T> columns(w);
+            dispatch::run([&]() {
+                for (int i=0 ; i<height ; i++){
+                    columns.template add<false>(array[i].data() + j);
                 }
-            }
-            maxElements.push_back(colMax);
+            });
+            columns.result(result.data() + j);
         }
+        return result;
+    }
+    else {
+        throw std::invalid_argument("Axis must be 0 or 1.");
     }
-    return maxElements;
 }
 
 template <class T>
-T Matrix<T>::min() const{
-    T min = array_[0][0];
-    for (int i=0 ; i<height_ ; i++){
-        for (int j=0 ; j<width_ ; j++){
-            if(array_[i][j]<min){
-                min = array_[i][j];
-            }
-        }
+T Matrix<T>::max() const{
+    MATRIX_PROFILE(Max, height_, width_, static_cast<long>(height_) * width_, 0);
+    if constexpr (IsComplex<T>::value) {
+        throw std::invalid_argument("Complex numbers are not ordered.");
+    }
+    else {
+        return extreme<true>(*array_, height_, width_);
+    }
+}
+
+template<typename T>
+std::vector<T> Matrix<T>::max(int axis) const {
+    MATRIX_PROFILE(Max, height_, width_, static_cast<long>(height_) * width_, 0);
+    if constexpr (IsComplex<T>::value) {
+        throw std::invalid_argument("Complex numbers are not ordered.");
+    }
+    else {
+        return extreme<true>(*array_, height_, width_, axis);
     }
-    return min;
 }
 
+template <class T>
+T Matrix<T>::min() const{
+    MATRIX_PROFILE(Min, height_, width_, static_cast<long>(height_) * width_, 0);
+    if constexpr (IsComplex<T>::value) {
+        throw std::invalid_argument("Complex numbers are not ordered.");
+    }
+    else {
+        return extreme<false>(*array_, height_, width_);
+    }
+}
 
 template<typename T>
 std::vector<T> Matrix<T>::min(int axis) const {
-    std::vector<T> minElements;
-    if (axis == 0) {
-        for (const auto& row : array_) {
-            minElements.push_back(*std::min_element(row.begin(), row.end()));
-        }
-    } else if (axis == 1) {
-        for (int j = 0; j < width_; ++j) {
-            T colMin = array_[0][j];
-            for (int i = 0; i < height_; ++i) {
-                if (array_[i][j] < colMin) {
-                    colMin = array_[i][j];
-                }
-            }
-            minElements.push_back(colMin);
-        }
+    MATRIX_PROFILE(Min, height_, width_, static_cast<long>(height_) * width_, 0);
+    if constexpr (IsComplex<T>::value) {
+        throw std::invalid_argument("Complex numbers are not ordered.");
+    }
+    else {
+        return extreme<false>(*array_, height_, width_, axis);
     }
-    return minElements;
 }
 
 template <class T>
-T Matrix<T>::sum() const{
-    T sum = 0;
+T Matrix<T>::sum(Summation mode) const{
+    MATRIX_PROFILE(Sum, height_, width_, static_cast<long>(height_) * width_, 0);
+    using Wide = typename Widened<T>::type;
+    std::vector<Wide> rowSums(this->height_);
+    long work = static_cast<long>(this->height_) * this->width_;
+
+    #pragma omp parallel for schedule(static) if(work > PARALLEL_THRESHOLD)
     for (int i=0 ; i<this->height_ ; i++){
-        for (int j=0 ; j<this->width_ ; j++){
-            sum += this->array_[i][j];
+        dispatch::run([&]() { rowSums[i] = reduceSum((*this->array_)[i].data(), this->width_, mode); });
+    }
+    return static_cast<T>(reduceSum(rowSums.data(), rowSums.size(), mode));
+}
+
+/*
+ * Column sums of the rows [startH, startH+h) over the columns [startW, endW)
+ * The columns are the inner loop so every policy is vectorized across them.
+ * When weights is given, row i is scaled by weights[i] (v^T M).
+ */
+template<class T>
+static void columnSums(const std::vector<std::vector<T>>& array, int startH, int h, int startW, int endW,
+                       Summation mode, typename Widened<T>::type* out, const T* weights=nullptr) {
+    using Acc = typename Accumulator<T>::type;
+    using Wide = typename Widened<T>::type;
+    int w = endW - startW;
+
+    if constexpr (std::is_integral<Acc>::value) {
+        using U = typename Modular<Acc>::type;
+        std::vector<U> sum(w, 0);
+        for (int i=startH ; i<startH+h ; i++){
+            const T* row = array[i].data() + startW;
+            const U weight = weights ? static_cast<U>(weights[i]) : U(1);
+            for (int j=0 ; j<w ; j++){
+                sum[j] += weight * static_cast<U>(row[j]);
+            }
+        }
+        for (int j=0 ; j<w ; j++){
+            out[j] = static_cast<Wide>(static_cast<U>(out[j]) + sum[j]);
+        }
+    }
+    else if (mode == Summation::Pairwise && h > static_cast<int>(summation::PAIRWISE_BLOCK)) {
+        int half = h / 2;
+        std::vector<Wide> left(w, 0);
+        std::vector<Wide> right(w, 0);
+        columnSums(array, startH, half, startW, endW, mode, left.data(), weights);
+        columnSums(array, startH + half, h - half, startW, endW, mode, right.data(), weights);
+        for (int j=0 ; j<w ; j++){
+            out[j] += left[j] + right[j];
+        }
+    }
+    else if (mode == Summation::Kahan) {
+        std::vector<Acc> sum(w, 0);
+        std::vector<Acc> comp(w, 0);
+        for (int i=startH ; i<startH+h ; i++){
+            const T* row = array[i].data() + startW;
+            const Acc weight = weights ? static_cast<Acc>(weights[i]) : Acc(1);
+            for (int j=0 ; j<w ; j++){
+                summation::compensatedAdd(sum[j], comp[j], static_cast<Acc>(weight * static_cast<Acc>(row[j])));
+            }
+        }
+        for (int j=0 ; j<w ; j++){
+            out[j] += static_cast<Wide>(sum[j]) + static_cast<Wide>(comp[j]);
+        }
+    }
+    else if (mode == Summation::Widened) {
+        for (int i=startH ; i<startH+h ; i++){
+            const T* row = array[i].data() + startW;
+            const Wide weight = weights ? static_cast<Wide>(weights[i]) : Wide(1);
+            for (int j=0 ; j<w ; j++){
+                out[j] += weight * static_cast<Wide>(row[j]);
+            }
+        }
+    }
+    else {
+        std::vector<Acc> sum(w, 0);
+        for (int i=startH ; i<startH+h ; i++){
+            const T* row = array[i].data() + startW;
+            const Acc weight = weights ? static_cast<Acc>(weights[i]) : Acc(1);
+            for (int j=0 ; j<w ; j++){
+                sum[j] += weight * static_cast<Acc>(row[j]);
+            }
+        }
+        for (int j=0 ; j<w ; j++){
+            out[j] += static_cast<Wide>(sum[j]);
         }
     }
-    return sum;
 }
 
 template <class T>
-std::vector<T> Matrix<T>::sum(int axis) const{
+std::vector<T> Matrix<T>::sum(int axis, Summation mode) const{
+    MATRIX_PROFILE(Sum, height_, width_, static_cast<long>(height_) * width_, 0);
+    using Wide = typename Widened<T>::type;
+    long work = static_cast<long>(this->height_) * this->width_;
     if(axis==0){
-        std::vector<T> result(this->height_, 0);
+        std::vector<T> result(this->height_);
+        #pragma omp parallel for schedule(static) if(work > PARALLEL_THRESHOLD)
         for (int i=0 ; i<this->height_ ; i++){
-            for (int j=0 ; j<this->width_ ; j++){
-                result[i] += this->array_[i][j];
-            }
+            dispatch::run([&]() { result[i] = static_cast<T>(reduceSum((*this->array_)[i].data(), this->width_, mode)); });
         }
         return result;
     }
     else if(axis==1){
-        std::vector<T> result(this->width_, 0);
-        for (int i=0 ; i<this->width_ ; i++){
-            for (int j=0 ; j<this->height_ ; j++){
-                result[i] += this->array_[j][i];
-            }
+        std::vector<Wide> acc(this->width_, 0);
+        #pragma omp parallel for schedule(static) if(work > PARALLEL_THRESHOLD)
+        for (int j=0 ; j<this->width_ ; j+=COLUMN_BLOCK){
+            int endW = std::min(j + COLUMN_BLOCK, this->width_);
+            dispatch::run([&]() { columnSums(*this->array_, 0, this->height_, j, endW, mode, acc.data() + j); });
         }
-        return result;
+        return std::vector<T>(acc.begin(), acc.end());
     }
     else{
         throw std::invalid_argument("Axis must be 0 or 1.");
     }
 }
 
+/*
+ * Matrix-vector products
+ * M v reduces every row against v, v^T M accumulates the rows scaled by v
+ * into column blocks. Neither of them materializes the transpose.
+ */
+template <class T>
+std::vector<T> Matrix<T>::dot(const std::vector<T>& v, Summation mode) const{
+    MATRIX_PROFILE(Dot, height_, 1, static_cast<long>(height_) * width_, sizeof(T) * height_);
+    if(static_cast<int>(v.size()) != this->width_)
+        throw std::invalid_argument("Vector size must be the same as the matrix width.");
+
+    long work = static_cast<long>(this->height_) * this->width_;
+    std::vector<T> result(this->height_);
+    #pragma omp parallel for schedule(static) if(work > PARALLEL_THRESHOLD)
+    for (int i=0 ; i<this->height_ ; i++){
+        dispatch::run([&]() { result[i] = static_cast<T>(reduceDot((*this->array_)[i].data(), v.data(), this->width_, mode)); });
+    }
+    return result;
+}
+
+template <class T>
+std::vector<T> Matrix<T>::dotTransposed(const std::vector<T>& v, Summation mode) const{
+    MATRIX_PROFILE(Dot, 1, width_, static_cast<long>(height_) * width_, sizeof(T) * width_);
+    if(static_cast<int>(v.size()) != this->height_)
+        throw std::invalid_argument("Vector size must be the same as the matrix height.");
+
+    using Wide = typename Widened<T>::type;
+    long work = static_cast<long>(this->height_) * this->width_;
+    int columnBlocks = (this->width_ + COLUMN_BLOCK - 1) / COLUMN_BLOCK;
+    // Too few column blocks to feed every thread: the rows are split as well
+    // and the partial results are added at the end
+    int rowChunks = 1;
+    if (work > PARALLEL_THRESHOLD && columnBlocks < maxThreads()) {
+        rowChunks = std::min(maxThreads(), std::max(1, this->height_ / COLUMN_BLOCK));
+    }
+    int chunkHeight = (this->height_ + rowChunks - 1) / std::max(rowChunks, 1);
+
+    std::vector<Wide> partial(static_cast<long>(rowChunks) * this->width_, 0);
+    #pragma omp parallel for collapse(2) schedule(static) if(work > PARALLEL_THRESHOLD)
+    for (int c=0 ; c<rowChunks ; c++){
+        for (int b=0 ; b<columnBlocks ; b++){
+            int startH = c * chunkHeight;
+            int h = std::min(chunkHeight, this->height_ - startH);
+            int startW = b * COLUMN_BLOCK;
+            int endW = std::min(startW + COLUMN_BLOCK, this->width_);
+            if (h > 0) {
+                dispatch::run([&]() {
+                    columnSums(*this->array_, startH, h, startW, endW, mode,
+                               partial.data() + static_cast<long>(c) * this->width_ + startW, v.data());
+                });
+            }
+        }
+    }
+
+    std::vector<T> result(this->width_);
+    for (int j=0 ; j<this->width_ ; j++){
+        typename Modular<Wide>::type total = 0;
+        for (int c=0 ; c<rowChunks ; c++){
+            total += static_cast<typename Modular<Wide>::type>(partial[static_cast<long>(c) * this->width_ + j]);
+        }
+        result[j] = static_cast<T>(total);
+    }
+    return result;
+}
+
+/*
+ * Running sum used by cumuSum
+ * A prefix sum has no pairwise form, the Pairwise policy is compensated
+ * like the Kahan one.
+ */
+template<class T>
+struct RunningSum {
+    using Acc = typename Accumulator<T>::type;
+    using Wide = typename Widened<T>::type;
+
+    Summation mode;
+    Acc sum = 0;
+    Acc comp = 0;
+    Wide wide = 0;
+    typename Modular<Acc>::type modular = 0;
+
+    explicit RunningSum(Summation m) : mode(m) {}
+
+    inline T add(const T& value) {
+        // Integer sums are exact, every policy is the naive one
+        if constexpr (std::is_integral<Acc>::value) {
+            modular += static_cast<typename Modular<Acc>::type>(value);
+            return static_cast<T>(modular);
+        }
+        switch (mode) {
+            case Summation::Widened:
+                wide += static_cast<Wide>(value);
+                return static_cast<T>(wide);
+            case Summation::Kahan:
+            case Summation::Pairwise:
+                summation::compensatedAdd(sum, comp, static_cast<Acc>(value));
+                return static_cast<T>(sum + comp);
+            case Summation::Naive:
+            default:
+                sum += static_cast<Acc>(value);
+                return static_cast<T>(sum);
+        }
+    }
+};
+
 template <class T>
-Matrix<T> Matrix<T>::cumuSum(int axis) const{
+Matrix<T> Matrix<T>::cumuSum(int axis, Summation mode) const{
+    MATRIX_PROFILE(CumuSum, height_, width_, static_cast<long>(height_) * width_, sizeof(T) * height_ * width_);
+    long work = static_cast<long>(this->height_) * this->width_;
     if(axis==0){
         Matrix<T> result(this->height_, this->width_);
-        for (int i=0 ; i<this->height_ ; i++){
-            for (int j=0 ; j<this->width_ ; j++){
-                if(i==0){
-                    result.array_[i][j] = this->array_[i][j];
+        #pragma omp parallel for schedule(static) if(work > PARALLEL_THRESHOLD)
+        for (int j=0 ; j<this->width_ ; j+=COLUMN_BLOCK){
+            int endW = std::min(j + COLUMN_BLOCK, this->width_);
+            std::vector<RunningSum<T>> running(endW - j, RunningSum<T>(mode));
+            dispatch::run([&]() {
+                for (int i=0 ; i<this->height_ ; i++){
+                    const T* row = (*this->array_)[i].data() + j;
+                    T* out = (*result.array_)[i].data() + j;
+                    for (int k=0 ; k<endW-j ; k++){
+                        out[k] = running[k].add(row[k]);
+                    }
                 }
-                else{
-                    result.array_[i][j] = this->array_[i][j] + result.array_[i-1][j];
-                }
-            }
+            });
         }
         return result;
     }
     else if(axis==1){
         Matrix<T> result(this->height_, this->width_);
-        for (int i=0 ; i<this->width_ ; i++){
-            for (int j=0 ; j<this->height_ ; j++){
-                if(i==0){
-                    result.array_[j][i] = this->array_[j][i];
-                }
-                else{
-                    result.array_[j][i] = this->array_[j][i] + result.array_[j][i-1];
+        #pragma omp parallel for schedule(static) if(work > PARALLEL_THRESHOLD)
+        for (int i=0 ; i<this->height_ ; i++){
+            const T* row = (*this->array_)[i].data();
+            T* out = (*result.array_)[i].data();
+            dispatch::run([&]() {
+                RunningSum<T> running(mode);
+                for (int j=0 ; j<this->width_ ; j++){
+                    out[j] = running.add(row[j]);
                 }
-            }
+            });
         }
         return result;
     }
@@ -610,7 +1038,7 @@ bool Matrix<T>::operator==(const Matrix& m){
     if(height_==m.height_ && width_==m.width_){
         for (int i=0 ; i<height_ ; i++){
             for (int j=0 ; j<width_ ; j++){
-                if(array_[i][j]!=m.array_[i][j]){
+                if((*array_)[i][j]!=(*m.array_)[i][j]){
                     return false;
                 }
             }
@@ -627,107 +1055,151 @@ bool Matrix<T>::operator!=(const Matrix& m){
 
 template <class T>
 Matrix<T>& Matrix<T>::operator+=(const Matrix<T>& m) {
+    MATRIX_PROFILE(Compound, height_, width_, static_cast<long>(height_) * width_, 0);
     if (height_ != m.height_ || width_ != m.width_) {
         throw std::invalid_argument("Matrix dimensions must be the same.");
     }
 
-    for (int i = 0; i < height_; ++i) {
-        for (int j = 0; j < width_; ++j) {
-            this->array_[i][j] += m.array_[i][j];
+    detach();
+    dispatch::run([&]() {
+        for (int i=0 ; i<height_ ; i++){
+            T* row = (*array_)[i].data();
+            const T* b = (*m.array_)[i].data();
+            for (int j=0 ; j<width_ ; j++){
+                row[j] += b[j];
+            }
         }
-    }
+    });
 
     return *this;
 }
 
 template <class T>
 Matrix<T>& Matrix<T>::operator-=(const Matrix& m){
+    MATRIX_PROFILE(Compound, height_, width_, static_cast<long>(height_) * width_, 0);
     if (height_ != m.height_ || width_ != m.width_) {
         throw std::invalid_argument("Matrix dimensions must be the same.");
     }
 
-    for (int i = 0; i < height_; ++i) {
-        for (int j = 0; j < width_; ++j) {
-            this->array_[i][j] -= m.array_[i][j];
+    detach();
+    dispatch::run([&]() {
+        for (int i=0 ; i<height_ ; i++){
+            T* row = (*array_)[i].data();
+            const T* b = (*m.array_)[i].data();
+            for (int j=0 ; j<width_ ; j++){
+                row[j] -= b[j];
+            }
         }
-    }
+    });
 
     return *this;
 }
 
 template <class T>
 Matrix<T>& Matrix<T>::operator*=(const T &s){
-    for (int i=0 ; i<height_ ; i++){
-        for (int j=0 ; j<width_ ; j++){
-            this->array_[i][j] *= s;
+    MATRIX_PROFILE(Compound, height_, width_, static_cast<long>(height_) * width_, 0);
+    detach();
+    dispatch::run([&]() {
+        for (int i=0 ; i<height_ ; i++){
+            T* row = (*array_)[i].data();
+            for (int j=0 ; j<width_ ; j++){
+                row[j] *= s;
+            }
         }
-    }
+    });
 
     return *this;
 }
 
 template <class T>
 Matrix<T>& Matrix<T>::operator*=(const std::vector<T>& v){
+    MATRIX_PROFILE(Compound, height_, width_, static_cast<long>(height_) * width_, 0);
     if(this->width_!=v.size())
         throw std::invalid_argument("Vector size must be the same as the core width_.");
 
-    for (int i=0 ; i<this->height_ ; i++){
-        for (int j=0 ; j<this->width_ ; j++){
-            this->array_[i][j] *= v[j];
+    detach();
+    dispatch::run([&]() {
+        for (int i=0 ; i<this->height_ ; i++){
+            T* row = (*array_)[i].data();
+            for (int j=0 ; j<this->width_ ; j++){
+                row[j] *= v[j];
+            }
         }
-    }
+    });
     return *this;
 }
 
 
 template <class T>
 Matrix<T>& Matrix<T>::operator*=(const Matrix& m){
+    MATRIX_PROFILE(Compound, height_, width_, static_cast<long>(height_) * width_, 0);
     if(!(height_==m.height_ && width_==m.width_))
         throw std::invalid_argument("Matrix dimension must be the same.");
 
-    for (int i=0 ; i<height_ ; i++){
-        for (int j=0 ; j<width_ ; j++){
-            this->array_[i][j] *= m.array_[i][j];
+    detach();
+    dispatch::run([&]() {
+        for (int i=0 ; i<height_ ; i++){
+            T* row = (*array_)[i].data();
+            const T* b = (*m.array_)[i].data();
+            for (int j=0 ; j<width_ ; j++){
+                row[j] *= b[j];
+            }
         }
-    }
+    });
     return *this;
 }
 
 
 template <class T>
 Matrix<T>& Matrix<T>::operator/=(const T &s){
-    for (int i=0 ; i<height_ ; i++){
-        for (int j=0 ; j<width_ ; j++){
-            this->array_[i][j] /= s;
+    MATRIX_PROFILE(Compound, height_, width_, static_cast<long>(height_) * width_, 0);
+    detach();
+    dispatch::run([&]() {
+        for (int i=0 ; i<height_ ; i++){
+            T* row = (*array_)[i].data();
+            for (int j=0 ; j<width_ ; j++){
+                row[j] /= s;
+            }
         }
-    }
+    });
 
     return *this;
 }
 
 template <class T>
 Matrix<T>& Matrix<T>::operator/=(const std::vector<T>& v){
+    MATRIX_PROFILE(Compound, height_, width_, static_cast<long>(height_) * width_, 0);
     if(this->width_!=v.size())
         throw std::invalid_argument("Vector size must be the same as the core width_.");
 
-    for (int i=0 ; i<this->height_ ; i++){
-        for (int j=0 ; j<this->width_ ; j++){
-            this->array_[i][j] /= v[j];
+    detach();
+    dispatch::run([&]() {
+        for (int i=0 ; i<this->height_ ; i++){
+            T* row = (*array_)[i].data();
+            for (int j=0 ; j<this->width_ ; j++){
+                row[j] /= v[j];
+            }
         }
-    }
+    });
     return *this;
 }
 
 template <class T>
 Matrix<T>& Matrix<T>::operator/=(const Matrix& m){
+    MATRIX_PROFILE(Compound, height_, width_, static_cast<long>(height_) * width_, 0);
     if(!(height_==m.height_ && width_==m.width_))
         throw std::invalid_argument("Matrix dimension must be the same.");
 
-    for (int i=0 ; i<height_ ; i++){
-        for (int j=0 ; j<width_ ; j++){
-            this->array_[i][j] /= m.array_[i][j];
+    detach();
+    dispatch::run([&]() {
+        for (int i=0 ; i<height_ ; i++){
+            T* row = (*array_)[i].data();
+            const T* b = (*m.array_)[i].data();
+            for (int j=0 ; j<width_ ; j++){
+                row[j] /= b[j];
+            }
         }
-    }
+    });
     return *this;
 }
 
@@ -736,25 +1208,34 @@ template<class T>
 Matrix<T>& Matrix<T>::operator=(Matrix<T>&& other) noexcept {
     if (this != &other) {
         this->array_ = std::move(other.array_);
+        other.array_ = emptyRows();
         this->height_ = other.height_;
         this->width_ = other.width_;
     }
     return *this;
 }
 
+template<class T>
+Matrix<T>& Matrix<T>::operator=(const Matrix<T>& other) noexcept {
+    this->array_ = other.array_;
+    this->height_ = other.height_;
+    this->width_ = other.width_;
+    return *this;
+}
+
 template<class T>
 Matrix<T>& Matrix<T>::operator=(const std::vector<std::vector<T>>& m) {
-    this->array_ = m;
+    this->array_ = std::make_shared<Rows>(m);
     this->height_ = m.size();
     this->width_ = m[0].size();
     return *this;
 }
 
 template<class T>
-Matrix<T>& Matrix<T>::operator=(std::vector<std::vector<T>>&& v) noexcept {
+Matrix<T>& Matrix<T>::operator=(std::vector<std::vector<T>>&& v) {
     this->height_ = v.size();
     this->width_ = v[0].size();
-    this->array_ = std::move(v);
+    this->array_ = std::make_shared<Rows>(std::move(v));
 
     v.clear();
 
@@ -768,6 +1249,7 @@ Matrix<T>& Matrix<T>::operator=(std::vector<std::vector<T>>&& v) noexcept {
 
 template<class T>
 void Matrix<T>::dumpToProto(const std::string& filePath) const {
+    MATRIX_PROFILE(DumpToProto, height_, width_, static_cast<long>(height_) * width_, sizeof(double) * height_ * width_);
     protoMatrix protoMat;
     MatrixToProto(*this, protoMat);
     std::ofstream outFile(filePath, std::ios::binary);
@@ -777,11 +1259,184 @@ void Matrix<T>::dumpToProto(const std::string& filePath) const {
 
 template<class T>
 Matrix<T> Matrix<T>::loadFromProto(const std::string& filePath) {
+    MATRIX_PROFILE(LoadFromProto, 0, 0, 0, 0);
     protoMatrix loadedProtoMat;
     std::ifstream inFile(filePath, std::ios::binary);
     loadedProtoMat.ParseFromIstream(&inFile);
     inFile.close();
-    return ProtoToMatrix<T>(loadedProtoMat);
+    Matrix<T> result = ProtoToMatrix<T>(loadedProtoMat);
+    MATRIX_PROFILE_SHAPE(result.height_, result.width_, static_cast<long>(result.height_) * result.width_,
+                         sizeof(T) * result.height_ * result.width_);
+    return result;
+}
+
+/*
+ * CSV / TSV text files
+ * Values are written with the shortest representation that reads back to
+ * the same value. Reading maps the file in memory and parses it in parallel,
+ * each thread handles a chunk of whole lines.
+ */
+
+template<class T>
+void Matrix<T>::toCSV(const std::string& filePath, char delimiter) const {
+    MATRIX_PROFILE(ToCSV, height_, width_, static_cast<long>(height_) * width_, 0);
+    std::ofstream outFile(filePath, std::ios::binary);
+    if (!outFile) {
+        throw std::runtime_error("Cannot open " + filePath + " for writing.");
+    }
+
+    // Rows are formatted in parallel by blocks and written in order
+    const int blockRows = 256;
+    std::vector<std::string> blocks(maxThreads());
+    for (int start = 0; start < height_; start += blockRows * static_cast<int>(blocks.size())) {
+        #pragma omp parallel for schedule(static, 1) if(static_cast<long>(height_) * width_ > PARALLEL_THRESHOLD)
+        for (int b = 0; b < static_cast<int>(blocks.size()); b++) {
+            std::string& text = blocks[b];
+            text.clear();
+            int first = start + b * blockRows;
+            int last = std::min(first + blockRows, height_);
+            char buffer[textio::MAX_CHARS];
+            for (int i = first; i < last; i++) {
+                for (int j = 0; j < width_; j++) {
+                    char* end = textio::formatValue(buffer, buffer + textio::MAX_CHARS, (*array_)[i][j], -1);
+                    text.append(buffer, end);
+                    text.push_back(j + 1 < width_ ? delimiter : '\n');
+                }
+            }
+        }
+        for (const auto& text : blocks) {
+            outFile.write(text.data(), static_cast<std::streamsize>(text.size()));
+        }
+    }
+    outFile.flush();
+    if (!outFile) {
+        throw std::runtime_error("Cannot write " + filePath + ".");
+    }
+}
+
+// Length of a line without its line ending
+static inline const char* lineEnd(const char* begin, const char* end) {
+    const char* eol = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+    if (eol == nullptr) {
+        eol = end;
+    }
+    if (eol > begin && eol[-1] == '\r') {
+        --eol;
+    }
+    return eol;
+}
+
+template<class T>
+Matrix<T> Matrix<T>::fromCSV(const std::string& filePath, char delimiter) {
+    MATRIX_PROFILE(FromCSV, 0, 0, 0, 0);
+    int fd = ::open(filePath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open " + filePath + " for reading.");
+    }
+    struct stat st{};
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Cannot stat " + filePath + ".");
+    }
+    std::size_t size = static_cast<std::size_t>(st.st_size);
+    if (size == 0) {
+        ::close(fd);
+        return Matrix<T>();
+    }
+    void* mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        throw std::runtime_error("Cannot map " + filePath + " in memory.");
+    }
+    ::madvise(mapped, size, MADV_SEQUENTIAL);
+    const char* text = static_cast<const char*>(mapped);
+    const char* textEnd = text + size;
+
+    // The first line gives the number of columns
+    const char* firstEol = lineEnd(text, textEnd);
+    int width = firstEol > text ? 1 + static_cast<int>(std::count(text, firstEol, delimiter)) : 0;
+
+    // Split the text in chunks of whole lines
+    int nChunks = std::max(1, 4 * maxThreads());
+    std::vector<const char*> bounds(nChunks + 1, textEnd);
+    bounds[0] = text;
+    for (int c = 1; c < nChunks; c++) {
+        const char* p = std::max(bounds[c - 1], text + size / nChunks * c);
+        const char* eol = p < textEnd ? static_cast<const char*>(std::memchr(p, '\n', textEnd - p)) : nullptr;
+        bounds[c] = eol == nullptr ? textEnd : eol + 1;
+    }
+
+    // Count the (non empty) lines of every chunk to know where its rows start
+    std::vector<int> firstRow(nChunks + 1, 0);
+    #pragma omp parallel for schedule(static)
+    for (int c = 0; c < nChunks; c++) {
+        int lines = 0;
+        for (const char* p = bounds[c]; p < bounds[c + 1];) {
+            const char* eol = lineEnd(p, bounds[c + 1]);
+            lines += eol > p ? 1 : 0;
+            const char* next = static_cast<const char*>(std::memchr(eol, '\n', bounds[c + 1] - eol));
+            p = next == nullptr ? bounds[c + 1] : next + 1;
+        }
+        firstRow[c + 1] = lines;
+    }
+    for (int c = 0; c < nChunks; c++) {
+        firstRow[c + 1] += firstRow[c];
+    }
+
+    Matrix<T> result(firstRow[nChunks], width);
+    MATRIX_PROFILE_SHAPE(firstRow[nChunks], width, static_cast<long>(firstRow[nChunks]) * width,
+                         sizeof(T) * firstRow[nChunks] * width);
+    std::vector<std::exception_ptr> errors(nChunks);
+    #pragma omp parallel for schedule(dynamic)
+    for (int c = 0; c < nChunks; c++) {
+        try {
+            int row = firstRow[c];
+            for (const char* p = bounds[c]; p < bounds[c + 1];) {
+                const char* eol = lineEnd(p, bounds[c + 1]);
+                if (eol > p) {
+                    T* out = (*result.array_)[row].data();
+                    int col = 0;
+                    const char* field = p;
+                    while (true) {
+                        if (col >= width) {
+                            throw std::runtime_error("Too many values on line " + std::to_string(row + 1) + ".");
+                        }
+                        const char* end = textio::parseValue(field, eol, out[col]);
+                        if (end == nullptr) {
+                            throw std::runtime_error("Invalid value on line " + std::to_string(row + 1) + ".");
+                        }
+                        while (end < eol && *end == ' ') {
+                            ++end;
+                        }
+                        col++;
+                        if (end == eol) {
+                            break;
+                        }
+                        if (*end != delimiter) {
+                            throw std::runtime_error("Invalid value on line " + std::to_string(row + 1) + ".");
+                        }
+                        field = end + 1;
+                    }
+                    if (col != width) {
+                        throw std::runtime_error("Too few values on line " + std::to_string(row + 1) + ".");
+                    }
+                    row++;
+                }
+                const char* next = static_cast<const char*>(std::memchr(eol, '\n', bounds[c + 1] - eol));
+                p = next == nullptr ? bounds[c + 1] : next + 1;
+            }
+        } catch (...) {
+            errors[c] = std::current_exception();
+        }
+    }
+    ::munmap(mapped, size);
+
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+    return result;
 }
 
 template<class T>
@@ -790,7 +1445,13 @@ void MatrixToProto(const Matrix<T>& matrix, protoMatrix& protoMat) {
     protoMat.set_width(matrix.getWidth());
     for (int i = 0; i < matrix.getHeight(); ++i) {
         for (int j = 0; j < matrix.getWidth(); ++j) {
-            protoMat.add_data(static_cast<double>(matrix(i, j)));
+            if constexpr (IsComplex<T>::value) {
+                protoMat.add_data(static_cast<double>(matrix(i, j).real()));
+                protoMat.add_imaginary(static_cast<double>(matrix(i, j).imag()));
+            }
+            else {
+                protoMat.add_data(static_cast<double>(matrix(i, j)));
+            }
         }
     }
 }
@@ -798,21 +1459,77 @@ void MatrixToProto(const Matrix<T>& matrix, protoMatrix& protoMat) {
 template<class T>
 Matrix<T> ProtoToMatrix(const protoMatrix& protoMat) {
     Matrix<T> matrix(protoMat.height(), protoMat.width());
-    int index = 0;
-    for (int i = 0; i < protoMat.height(); ++i) {
-        for (int j = 0; j < protoMat.width(); ++j) {
-            matrix.put(i, j, static_cast<T>(protoMat.data(index++)));
+    auto element = [&protoMat](int k) {
+        if constexpr (IsComplex<T>::value) {
+            using F = typename T::value_type;
+            return T(static_cast<F>(protoMat.data(k)), k < protoMat.imaginary_size() ? static_cast<F>(protoMat.imaginary(k)) : F(0));
+        }
+        else {
+            return static_cast<T>(protoMat.data(k));
         }
+    };
+    int index = 0;
+    switch (protoMat.storage()) {
+        case protoMatrix::SYMMETRIC:
+        case protoMatrix::LOWER_TRIANGULAR:
+            for (int i = 0; i < protoMat.height(); ++i) {
+                for (int j = 0; j <= i; ++j) {
+                    T value = element(index++);
+                    matrix.put(i, j, value);
+                    if (protoMat.storage() == protoMatrix::SYMMETRIC) {
+                        matrix.put(j, i, value);
+                    }
+                }
+            }
+            break;
+        case protoMatrix::UPPER_TRIANGULAR:
+            for (int i = 0; i < protoMat.height(); ++i) {
+                for (int j = i; j < protoMat.width(); ++j) {
+                    matrix.put(i, j, element(index++));
+                }
+            }
+            break;
+        case protoMatrix::BANDED:
+            for (int d = -protoMat.lower(); d <= protoMat.upper(); ++d) {
+                for (int i = std::max(0, -d); i < std::min(protoMat.height(), protoMat.width() - d); ++i) {
+                    matrix.put(i, i + d, element(index++));
+                }
+            }
+            break;
+        default:
+            for (int i = 0; i < protoMat.height(); ++i) {
+                for (int j = 0; j < protoMat.width(); ++j) {
+                    matrix.put(i, j, element(index++));
+                }
+            }
     }
     return matrix;
 }
 
-// Explicit instantiation of the template class
-template class Matrix<int>;
-template class Matrix<float>;
-template class Matrix<double>;
-
-template void MatrixToProto<int>(const Matrix<int>& matrix, protoMatrix& protoMat);
-template Matrix<int> ProtoToMatrix<int>(const protoMatrix& protoMat);
-template void MatrixToProto<double>(const Matrix<double>& matrix, protoMatrix& protoMat);
-template Matrix<double> ProtoToMatrix<double>(const protoMatrix& protoMat);
+// Explicit instantiation of the template class, every type is instantiated where it is used in header-only mode
+#if !defined(MATRIX_HEADER_ONLY)
+#define MATRIX_INSTANTIATE(T) \
+    template class Matrix<T>; \
+    template void MatrixToProto<T>(const Matrix<T>& matrix, protoMatrix& protoMat); \
+    template Matrix<T> ProtoToMatrix<T>(const protoMatrix& protoMat);
+
+MATRIX_INSTANTIATE(int)
+MATRIX_INSTANTIATE(float)
+MATRIX_INSTANTIATE(double)
+MATRIX_INSTANTIATE(int64_t)
+MATRIX_INSTANTIATE(uint32_t)
+MATRIX_INSTANTIATE(uint64_t)
+MATRIX_INSTANTIATE(std::complex<float>)
+MATRIX_INSTANTIATE(std::complex<double>)
+// Low counts, and boolean masks for uint8_t
+MATRIX_INSTANTIATE(int8_t)
+MATRIX_INSTANTIATE(int16_t)
+MATRIX_INSTANTIATE(uint8_t)
+MATRIX_INSTANTIATE(uint16_t)
+
+// Half precision storage, computations are done in float
+#if defined(MATRIX_HAS_FLOAT16)
+MATRIX_INSTANTIATE(float16)
+#endif
+MATRIX_INSTANTIATE(bfloat16)
+#endif // MATRIX_HEADER_ONLY
@@ -2,16 +2,43 @@
 // Created by nicolas on 23/12/23.
 //
 
+#include <atomic>
+#include <memory>
 #include <vector>
 #include <utility>
 #include <stdexcept>
 
 #include "./proto/matrix.pb.h"
+#include "atomic_add.h"
+#include "half.h"
+#include "parallel.h"
+#include "profiling.h"
+#include "summation.h"
 
 #ifndef MATRIX_H
 #define MATRIX_H
 
 
+// Size below which dotStrassen uses the classical product (see bench/matrix_bench.cc)
+constexpr int STRASSEN_CROSSOVER = 256;
+
+// How the values given for the same element are combined (see triples.h)
+enum class Combine { Sum, Max, Min, Last };
+
+/*
+ * Matrix class
+ * Copies share their rows (copy-on-write): the copy constructor, the copy
+ * assignment and duplicate() are O(1). The elements are copied by the first
+ * modification of a shared matrix: a non-const accessor, put, fill, a
+ * compound operator or any other modifying method. The reference count is
+ * atomic, copies can be handed to other threads.
+ * A reference or pointer obtained from a non-const accessor stays valid
+ * until the matrix is copied: kernels take the row pointers once instead
+ * of paying the sharing check on every element. Call detach() once before
+ * modifying a shared matrix from several threads at once, or a matrix
+ * whose last other copies were dropped by other threads without another
+ * synchronization (join, lock) with this one.
+ */
 template<typename T>
 class Matrix {
 public:
@@ -19,26 +46,46 @@ public:
     Matrix(int row, int cols);
     Matrix(int rows, int cols, T defaultValue);
     Matrix(Matrix<T>&& m) noexcept ;
-    explicit Matrix(std::vector<std::vector<T>>&& m) noexcept ;
+    Matrix(const Matrix<T>& m) noexcept ;
+    explicit Matrix(std::vector<std::vector<T>>&& m);
     explicit Matrix(const std::vector<std::vector<T>>& m);
 
-    // Prevent copying (deleted copy constructor and assignment operator)
-    Matrix(const Matrix<T>& m) = delete;
-
     virtual ~Matrix() = default;
 
     /*
      * Inline element access functions for performance
+     * The non-const ones make the rows unique first (see detach)
      */
-    inline T& operator()(int h, int w) { return array_[h][w];}
-    inline const T& operator()(int h, int w) const { return array_[h][w];}
-    inline std::vector<T>& operator()(int h) { if (h < 0) {h += height_ ;} return array_[h];}
-    inline const std::vector<T>& operator()(int h) const { if (h < 0) {h += height_ ;} return array_[h];}
+    inline T& operator()(int h, int w) { return mutableRows()[h][w];}
+    inline const T& operator()(int h, int w) const { return (*array_)[h][w];}
+    inline std::vector<T>& operator()(int h) { if (h < 0) {h += height_ ;} return mutableRows()[h];}
+    inline const std::vector<T>& operator()(int h) const { if (h < 0) {h += height_ ;} return (*array_)[h];}
+
+    inline T& get(int h, int w) { return mutableRows()[h][w];}
+    inline const T& get(int h, int w) const { return (*array_)[h][w];}
+    inline std::vector<T>& get(int h) { if (h < 0) {h += height_ ;} return mutableRows()[h];}
+    inline const std::vector<T>& get(int h) const { if (h < 0) {h += height_ ;} return (*array_)[h];}
+
+    // Atomic m(h, w) += value, safe to call from several threads (see accumulation.h).
+    // It never detaches: the rows must not be shared, call detach() once before
+    // the threads start, a shared matrix throws std::logic_error
+    inline void accumulate(int h, int w, const T& value) {
+        if (isShared())
+            throw std::logic_error("Shared matrix, call detach() before accumulating.");
+        atomicAdd(&(*array_)[h][w], value);
+    }
 
-    inline T& get(int h, int w) { return array_[h][w];}
-    inline const T& get(int h, int w) const { return array_[h][w];}
-    inline std::vector<T>& get(int h) { if (h < 0) {h += height_ ;} return array_[h];}
-    inline const std::vector<T>& get(int h) const { if (h < 0) {h += height_ ;} return array_[h];}
+    // Copies the rows if another matrix shares them
+    inline void detach() {
+        if (array_.use_count() != 1) {
+            copyRows();
+        }
+        // Pairs with the release of the last other owner: its reads happen before our writes.
+        // Issued once per modifying method, the element accessors only check the count
+        std::atomic_thread_fence(std::memory_order_acquire);
+    }
+    // Whether another matrix shares the rows
+    [[nodiscard]] inline bool isShared() const { return array_.use_count() != 1; }
 
     // Inline getters
     [[nodiscard]] inline int getHeight() const { return height_; }
@@ -52,6 +99,7 @@ public:
     void fill(const T& value);
     std::vector<T> getCol(int col);
     std::vector<T> getCol(int col) const;
+    std::vector<T> diagonal(int offset=0) const;
     void insert(int index, const std::vector<T>& newData, int axis=0);
     void pop_back(int axis=0);
     void print(std::ostream &flux) const;
@@ -61,6 +109,9 @@ public:
     void resize(int rows);
     void resize(int rows, int cols);
     Matrix<T> subMat(int startH, int startW, int h, int w) const;
+    template<typename U> Matrix<U> astype() const;
+    template<typename F> Matrix<T> map(F f) const;
+    template<typename F> Matrix<T>& mapInPlace(F f);
 
     // Maths operations
     Matrix<T> add(const Matrix<T>& m) const;
@@ -71,16 +122,21 @@ public:
     Matrix<T> divide(const T& value) const;
     Matrix<T> divide(const std::vector<T>& v) const;
     Matrix<T> divide(const Matrix<T>& m) const;
-    Matrix<T> dot(const Matrix<T>& m) const;
+    Matrix<T> dot(const Matrix<T>& m, Summation mode=Summation::Naive) const;
+    std::vector<T> dot(const std::vector<T>& v, Summation mode=Summation::Naive) const;            // M v
+    std::vector<T> dotTransposed(const std::vector<T>& v, Summation mode=Summation::Naive) const;  // v^T M
+    Matrix<T> dotStrassen(const Matrix<T>& m, int crossover=STRASSEN_CROSSOVER) const;
     Matrix<T> transpose() const;
 
+    // NaN propagates to max and min (nanmax and nanmin in masked_matrix.h skip it),
+    // reducing an empty matrix, row or column throws, and so does a complex matrix
     T max() const;
     std::vector<T> max(int axis) const;
     T min() const;
     std::vector<T> min(int axis) const;
-    T sum() const;
-    std::vector<T> sum(int axis) const;
-    Matrix<T> cumuSum(int axis) const;
+    T sum(Summation mode=Summation::Naive) const;
+    std::vector<T> sum(int axis, Summation mode=Summation::Naive) const;
+    Matrix<T> cumuSum(int axis, Summation mode=Summation::Naive) const;
 
     // Operators
     bool operator==(const Matrix<T>& m);
@@ -93,22 +149,94 @@ public:
     Matrix<T>& operator/=(const T &s);
     Matrix<T>& operator/=(const std::vector<T>& v);
     Matrix<T>& operator/=(const Matrix<T>& m);
-    Matrix<T>& operator=(const Matrix<T>& m) = delete;
+    Matrix<T>& operator=(const Matrix<T>& m) noexcept;
     Matrix<T>& operator=(const std::vector<std::vector<T>>& m);
     Matrix<T>& operator=(Matrix<T>&& m) noexcept;
-    Matrix<T>& operator=(std::vector<std::vector<T>>&& v) noexcept;
+    Matrix<T>& operator=(std::vector<std::vector<T>>&& v);
 
     // Serialization & deserialization
     void dumpToProto(const std::string& filePath) const;
     static Matrix<T> loadFromProto(const std::string& filePath);
+    void toCSV(const std::string& filePath, char delimiter=',') const;
+    static Matrix<T> fromCSV(const std::string& filePath, char delimiter=',');
+    // Matrix of the given shape with m(rows[k], cols[k]) = values[k], zero elsewhere (see triples.h)
+    static Matrix<T> fromTriples(const std::vector<int>& rows, const std::vector<int>& cols,
+                                 const std::vector<T>& values, std::pair<int, int> shape,
+                                 Combine combine=Combine::Sum);
 
 
 private:
-    std::vector<std::vector<T>> array_;
+    using Rows = std::vector<std::vector<T>>;
+
+    inline Rows& mutableRows() {
+        if (array_.use_count() != 1) {
+            copyRows();
+        }
+        return *array_;
+    }
+    void copyRows();
+    static const std::shared_ptr<Rows>& emptyRows();
+
+    // Never null, shared by copies until one of them is modified
+    std::shared_ptr<Rows> array_;
     int height_ = 0;
     int width_ = 0;
 };
 
+/*
+ * Type conversion
+ * Each row is converted with a bulk kernel (see half.h)
+ */
+
+template<typename T>
+template<typename U>
+Matrix<U> Matrix<T>::astype() const {
+    MATRIX_PROFILE(AsType, height_, width_, static_cast<long>(height_) * width_, sizeof(U) * height_ * width_);
+    Matrix<U> result(height_, width_);
+    for (int i = 0; i < height_; i++) {
+        convertBulk((*array_)[i].data(), result(i).data(), static_cast<std::size_t>(width_));
+    }
+    return result;
+}
+
+/*
+ * Elementwise function
+ * f is called on every element, rows in parallel on large matrices. The
+ * vectorized math functions are in elementwise.h.
+ */
+
+template<typename T>
+template<typename F>
+Matrix<T> Matrix<T>::map(F f) const {
+    Matrix<T> result(height_, width_);
+    #pragma omp parallel for schedule(static) if(static_cast<long>(height_) * width_ > PARALLEL_THRESHOLD)
+    for (int i = 0; i < height_; i++) {
+        const T* __restrict in = (*array_)[i].data();
+        T* __restrict out = (*result.array_)[i].data();
+        for (int j = 0; j < width_; j++) {
+            out[j] = f(in[j]);
+        }
+    }
+    return result;
+}
+
+template<typename T>
+template<typename F>
+Matrix<T>& Matrix<T>::mapInPlace(F f) {
+    detach();
+    #pragma omp parallel for schedule(static) if(static_cast<long>(height_) * width_ > PARALLEL_THRESHOLD)
+    for (int i = 0; i < height_; i++) {
+        T* row = (*array_)[i].data();
+        for (int j = 0; j < width_; j++) {
+            row[j] = f(row[j]);
+        }
+    }
+    return *this;
+}
+
+// Boolean mask, one byte per element (see elementwise.h)
+using Mask = Matrix<uint8_t>;
+
 template <class T> inline Matrix<T> operator+(const Matrix<T>& a, const Matrix<T>& b) { return a.add(b); };
 template <class T> inline Matrix<T> operator-(const Matrix<T>& a, const Matrix<T>& b) { return a.subtract(b); };
 template <class T> inline Matrix<T> operator*(const Matrix<T>& a, const Matrix<T>& b) { return a.multiply(b); };
@@ -132,5 +260,30 @@ template<typename T>
 Matrix<T> ProtoToMatrix(const protoMatrix& protoMat);
 
 
+/*
+ * Element types
+ * The library is compiled for int, int64_t, uint32_t, uint64_t, int8_t,
+ * int16_t, uint8_t, uint16_t, float, double, std::complex<float>,
+ * std::complex<double> and the half precision types. Integer sums are
+ * exact whatever the summation policy, so they always run the naive
+ * kernel. Sums, cumulative sums and dot products are computed in unsigned
+ * arithmetic (Modular in summation.h) and converted back to T: they wrap
+ * around modulo 2^bits of T, without the undefined behaviour of a signed
+ * overflow. integer::sum and integer::dot return exact 64-bit results.
+ * Complex matrices have no max or min (they throw std::invalid_argument),
+ * their text form is re+imj and their proto form keeps the imaginary parts
+ * in a field of their own. Proto data are doubles, int64_t values beyond
+ * 2^53 are rounded.
+ *
+ * Header-only mode: defining MATRIX_HEADER_ONLY in the translation units
+ * that include this header (the matrix_header_only CMake target does it)
+ * compiles the definitions there, for any element type and with inlining
+ * across the calls. The library itself is still linked for the other
+ * modules and must be compiled without it.
+ */
+#if defined(MATRIX_HEADER_ONLY)
+#include "matrix.cpp"
+#endif
+
 
 #endif // MATRIX_H
@@ -0,0 +1,398 @@
+//
+// Symmetric and triangular matrices stored as one packed triangle.
+//
+
+#include "packed_matrix.h"
+#include "parallel.h"
+#include <algorithm>
+#include <fstream>
+
+// Number of right-hand side columns solved together by TriangularMatrix::solve
+static const int COLUMN_BLOCK = 256;
+
+/*
+ * Helpers shared by both classes
+ */
+
+static inline long packedSize(int n) { return static_cast<long>(n) * (n + 1) / 2; }
+
+static void checkSquare(int height, int width) {
+    if (height != width)
+        throw std::invalid_argument("Matrix must be square.");
+}
+
+template<class T>
+static void writePacked(const std::vector<T>& data, int n, protoMatrix::Storage storage, const std::string& filePath) {
+    protoMatrix protoMat;
+    protoMat.set_height(n);
+    protoMat.set_width(n);
+    protoMat.set_storage(storage);
+    protoMat.mutable_data()->Reserve(static_cast<int>(data.size()));
+    for (const T& value : data) {
+        protoMat.add_data(static_cast<double>(value));
+    }
+    std::ofstream outFile(filePath, std::ios::binary);
+    protoMat.SerializeToOstream(&outFile);
+    outFile.close();
+}
+
+static protoMatrix readProto(const std::string& filePath) {
+    protoMatrix protoMat;
+    std::ifstream inFile(filePath, std::ios::binary);
+    protoMat.ParseFromIstream(&inFile);
+    inFile.close();
+    return protoMat;
+}
+
+
+/*
+ * SymmetricMatrix
+ */
+
+template<class T>
+SymmetricMatrix<T>::SymmetricMatrix(int n) : data_(packedSize(n)), n_(n) {}
+
+template<class T>
+SymmetricMatrix<T>::SymmetricMatrix(int n, T defaultValue) : data_(packedSize(n), defaultValue), n_(n) {}
+
+template<class T>
+SymmetricMatrix<T>::SymmetricMatrix(const Matrix<T>& m) {
+    checkSquare(m.getHeight(), m.getWidth());
+    n_ = m.getHeight();
+    data_.resize(packedSize(n_));
+    for (int i = 0; i < n_; i++) {
+        std::copy(m(i).begin(), m(i).begin() + i + 1, data_.begin() + index(i, 0));
+    }
+}
+
+template<class T>
+void SymmetricMatrix<T>::fill(const T& value) {
+    std::fill(data_.begin(), data_.end(), value);
+}
+
+template<class T>
+Matrix<T> SymmetricMatrix<T>::toMatrix() const {
+    Matrix<T> result(n_, n_);
+    std::vector<T*> rows(n_);
+    for (int i = 0; i < n_; i++) {
+        rows[i] = result(i).data();
+    }
+    for (int i = 0; i < n_; i++) {
+        const T* row = data_.data() + index(i, 0);
+        for (int j = 0; j <= i; j++) {
+            rows[i][j] = row[j];
+            rows[j][i] = row[j];
+        }
+    }
+    return result;
+}
+
+template<class T>
+Matrix<T> SymmetricMatrix<T>::dot(const Matrix<T>& m) const {
+    if (n_ != m.getHeight())
+        throw std::invalid_argument("Dot product not compatible.");
+
+    // Row i of the result is sum_j S(i, j) * M(j), the packed row i gives
+    // S(i, j) for j <= i and column i of the packed triangle the rest
+    using Acc = typename Accumulator<T>::type;
+    int width = m.getWidth();
+    long work = static_cast<long>(n_) * n_ * width;
+    Matrix<T> result(n_, width);
+
+    #pragma omp parallel if(work > PARALLEL_THRESHOLD)
+    {
+        std::vector<Acc> acc(width);
+        #pragma omp for schedule(dynamic, 16)
+        for (int i = 0; i < n_; i++) {
+            std::fill(acc.begin(), acc.end(), Acc(0));
+            for (int j = 0; j < n_; j++) {
+                const Acc s = static_cast<Acc>((*this)(i, j));
+                const T* row = m(j).data();
+                for (int k = 0; k < width; k++) {
+                    acc[k] += s * static_cast<Acc>(row[k]);
+                }
+            }
+            std::copy(acc.begin(), acc.end(), result(i).begin());
+        }
+    }
+    return result;
+}
+
+template<class T>
+SymmetricMatrix<T> SymmetricMatrix<T>::syrk(const Matrix<T>& a) {
+    // Only the lower triangle of A * A^T is computed: half of the products
+    int n = a.getHeight();
+    int k = a.getWidth();
+    long work = static_cast<long>(n) * n * k / 2;
+    SymmetricMatrix<T> result(n);
+
+    #pragma omp parallel for schedule(dynamic, 16) if(work > PARALLEL_THRESHOLD)
+    for (int i = 0; i < n; i++) {
+        T* out = result.data_.data() + index(i, 0);
+        for (int j = 0; j <= i; j++) {
+            out[j] = static_cast<T>(reduceDot(a(i).data(), a(j).data(), k, Summation::Naive));
+        }
+    }
+    return result;
+}
+
+template<class T>
+T SymmetricMatrix<T>::max() const {
+    if (data_.empty())
+        throw std::out_of_range("Empty matrix.");
+    return *std::max_element(data_.begin(), data_.end());
+}
+
+template<class T>
+T SymmetricMatrix<T>::min() const {
+    if (data_.empty())
+        throw std::out_of_range("Empty matrix.");
+    return *std::min_element(data_.begin(), data_.end());
+}
+
+template<class T>
+T SymmetricMatrix<T>::sum(Summation mode) const {
+    // Every off-diagonal element is counted twice
+    using Wide = typename Widened<T>::type;
+    Wide packed = reduceSum(data_.data(), data_.size(), mode);
+    Wide diagonal = reduce<T>(n_, mode, [this](std::size_t i) { return data_[index(i, i)]; });
+    return static_cast<T>(2 * packed - diagonal);
+}
+
+template<class T>
+std::vector<T> SymmetricMatrix<T>::sum(int axis) const {
+    if (axis != 0 && axis != 1)
+        throw std::invalid_argument("Axis must be 0 or 1.");
+
+    // One pass over the packed triangle: S(i, j) adds to row i and row j
+    using Acc = typename Accumulator<T>::type;
+    std::vector<Acc> acc(n_, 0);
+    #pragma omp parallel if(static_cast<long>(data_.size()) > PARALLEL_THRESHOLD)
+    {
+        std::vector<Acc> local(n_, 0);
+        #pragma omp for schedule(dynamic, 64) nowait
+        for (int i = 0; i < n_; i++) {
+            const T* row = data_.data() + index(i, 0);
+            Acc rowSum = 0;
+            for (int j = 0; j < i; j++) {
+                rowSum += static_cast<Acc>(row[j]);
+                local[j] += static_cast<Acc>(row[j]);
+            }
+            local[i] += rowSum + static_cast<Acc>(row[i]);
+        }
+        #pragma omp critical
+        for (int i = 0; i < n_; i++) {
+            acc[i] += local[i];
+        }
+    }
+    return std::vector<T>(acc.begin(), acc.end());
+}
+
+template<class T>
+void SymmetricMatrix<T>::dumpToProto(const std::string& filePath) const {
+    MATRIX_PROFILE(DumpToProto, n_, n_, static_cast<long>(data_.size()), sizeof(double) * data_.size());
+    writePacked(data_, n_, protoMatrix::SYMMETRIC, filePath);
+}
+
+template<class T>
+SymmetricMatrix<T> SymmetricMatrix<T>::loadFromProto(const std::string& filePath) {
+    protoMatrix protoMat = readProto(filePath);
+    if (protoMat.storage() != protoMatrix::SYMMETRIC) {
+        return SymmetricMatrix<T>(Matrix<T>::loadFromProto(filePath));
+    }
+    checkSquare(protoMat.height(), protoMat.width());
+    SymmetricMatrix<T> result(protoMat.height());
+    for (long i = 0; i < static_cast<long>(result.data_.size()); i++) {
+        result.data_[i] = static_cast<T>(protoMat.data(static_cast<int>(i)));
+    }
+    return result;
+}
+
+
+/*
+ * TriangularMatrix
+ */
+
+template<class T>
+TriangularMatrix<T>::TriangularMatrix(int n, Triangle triangle)
+    : data_(packedSize(n)), n_(n), triangle_(triangle) {}
+
+template<class T>
+TriangularMatrix<T>::TriangularMatrix(int n, Triangle triangle, T defaultValue)
+    : data_(packedSize(n), defaultValue), n_(n), triangle_(triangle) {}
+
+template<class T>
+TriangularMatrix<T>::TriangularMatrix(const Matrix<T>& m, Triangle triangle) : triangle_(triangle) {
+    checkSquare(m.getHeight(), m.getWidth());
+    n_ = m.getHeight();
+    data_.resize(packedSize(n_));
+    for (int i = 0; i < n_; i++) {
+        if (triangle_ == Triangle::Lower) {
+            std::copy(m(i).begin(), m(i).begin() + i + 1, data_.begin() + index(i, 0));
+        } else {
+            std::copy(m(i).begin() + i, m(i).end(), data_.begin() + index(i, i));
+        }
+    }
+}
+
+template<class T>
+void TriangularMatrix<T>::fill(const T& value) {
+    std::fill(data_.begin(), data_.end(), value);
+}
+
+template<class T>
+Matrix<T> TriangularMatrix<T>::toMatrix() const {
+    Matrix<T> result(n_, n_, T(0));
+    for (int i = 0; i < n_; i++) {
+        int first = triangle_ == Triangle::Lower ? 0 : i;
+        int last = triangle_ == Triangle::Lower ? i + 1 : n_;
+        std::copy(data_.begin() + index(i, first), data_.begin() + index(i, first) + (last - first),
+                  result(i).begin() + first);
+    }
+    return result;
+}
+
+template<class T>
+TriangularMatrix<T> TriangularMatrix<T>::transpose() const {
+    Triangle other = triangle_ == Triangle::Lower ? Triangle::Upper : Triangle::Lower;
+    TriangularMatrix<T> result(n_, other);
+    for (int i = 0; i < n_; i++) {
+        int first = triangle_ == Triangle::Lower ? 0 : i;
+        int last = triangle_ == Triangle::Lower ? i + 1 : n_;
+        for (int j = first; j < last; j++) {
+            result.data_[result.index(j, i)] = data_[index(i, j)];
+        }
+    }
+    return result;
+}
+
+template<class T>
+Matrix<T> TriangularMatrix<T>::dot(const Matrix<T>& m) const {
+    if (n_ != m.getHeight())
+        throw std::invalid_argument("Dot product not compatible.");
+
+    // Row i of the result only combines the rows of M inside the triangle
+    using Acc = typename Accumulator<T>::type;
+    int width = m.getWidth();
+    long work = static_cast<long>(n_) * n_ * width / 2;
+    Matrix<T> result(n_, width);
+
+    #pragma omp parallel if(work > PARALLEL_THRESHOLD)
+    {
+        std::vector<Acc> acc(width);
+        #pragma omp for schedule(dynamic, 16)
+        for (int i = 0; i < n_; i++) {
+            std::fill(acc.begin(), acc.end(), Acc(0));
+            int first = triangle_ == Triangle::Lower ? 0 : i;
+            int last = triangle_ == Triangle::Lower ? i + 1 : n_;
+            const T* packedRow = data_.data() + index(i, first);
+            for (int j = first; j < last; j++) {
+                const Acc t = static_cast<Acc>(packedRow[j - first]);
+                const T* row = m(j).data();
+                for (int k = 0; k < width; k++) {
+                    acc[k] += t * static_cast<Acc>(row[k]);
+                }
+            }
+            std::copy(acc.begin(), acc.end(), result(i).begin());
+        }
+    }
+    return result;
+}
+
+template<class T>
+Matrix<T> TriangularMatrix<T>::solve(const Matrix<T>& b) const {
+    if (n_ != b.getHeight())
+        throw std::invalid_argument("Right-hand side height must match the matrix size.");
+    for (int i = 0; i < n_; i++) {
+        if (data_[index(i, i)] == T(0))
+            throw std::invalid_argument("Singular triangular matrix.");
+    }
+
+    // Forward (lower) or backward (upper) substitution, row by row; the
+    // columns of B are independent and solved in parallel blocks
+    using Acc = typename Accumulator<T>::type;
+    int width = b.getWidth();
+    long work = static_cast<long>(n_) * n_ * width / 2;
+    Matrix<T> x(n_, width);
+
+    #pragma omp parallel for schedule(static) if(work > PARALLEL_THRESHOLD)
+    for (int c = 0; c < width; c += COLUMN_BLOCK) {
+        int endC = std::min(c + COLUMN_BLOCK, width);
+        std::vector<Acc> acc(endC - c);
+        for (int step = 0; step < n_; step++) {
+            int i = triangle_ == Triangle::Lower ? step : n_ - 1 - step;
+            for (int k = c; k < endC; k++) {
+                acc[k - c] = static_cast<Acc>(b(i, k));
+            }
+            int first = triangle_ == Triangle::Lower ? 0 : i + 1;
+            int last = triangle_ == Triangle::Lower ? i : n_;
+            for (int j = first; j < last; j++) {
+                const Acc t = static_cast<Acc>(data_[index(i, j)]);
+                const T* row = x(j).data();
+                for (int k = c; k < endC; k++) {
+                    acc[k - c] -= t * static_cast<Acc>(row[k]);
+                }
+            }
+            const Acc diagonal = static_cast<Acc>(data_[index(i, i)]);
+            T* out = x(i).data();
+            for (int k = c; k < endC; k++) {
+                out[k] = static_cast<T>(acc[k - c] / diagonal);
+            }
+        }
+    }
+    return x;
+}
+
+template<class T>
+T TriangularMatrix<T>::max() const {
+    if (data_.empty())
+        throw std::out_of_range("Empty matrix.");
+    T result = *std::max_element(data_.begin(), data_.end());
+    // The implicit zeros of the other triangle
+    return n_ > 1 && result < T(0) ? T(0) : result;
+}
+
+template<class T>
+T TriangularMatrix<T>::min() const {
+    if (data_.empty())
+        throw std::out_of_range("Empty matrix.");
+    T result = *std::min_element(data_.begin(), data_.end());
+    return n_ > 1 && T(0) < result ? T(0) : result;
+}
+
+template<class T>
+T TriangularMatrix<T>::sum(Summation mode) const {
+    return static_cast<T>(reduceSum(data_.data(), data_.size(), mode));
+}
+
+template<class T>
+void TriangularMatrix<T>::dumpToProto(const std::string& filePath) const {
+    MATRIX_PROFILE(DumpToProto, n_, n_, static_cast<long>(data_.size()), sizeof(double) * data_.size());
+    writePacked(data_, n_, triangle_ == Triangle::Lower ? protoMatrix::LOWER_TRIANGULAR : protoMatrix::UPPER_TRIANGULAR,
+                filePath);
+}
+
+template<class T>
+TriangularMatrix<T> TriangularMatrix<T>::loadFromProto(const std::string& filePath) {
+    protoMatrix protoMat = readProto(filePath);
+    if (protoMat.storage() == protoMatrix::LOWER_TRIANGULAR || protoMat.storage() == protoMatrix::UPPER_TRIANGULAR) {
+        checkSquare(protoMat.height(), protoMat.width());
+        Triangle triangle = protoMat.storage() == protoMatrix::LOWER_TRIANGULAR ? Triangle::Lower : Triangle::Upper;
+        TriangularMatrix<T> result(protoMat.height(), triangle);
+        for (long i = 0; i < static_cast<long>(result.data_.size()); i++) {
+            result.data_[i] = static_cast<T>(protoMat.data(static_cast<int>(i)));
+        }
+        return result;
+    }
+    throw std::invalid_argument("The file does not contain a triangular matrix.");
+}
+
+
+// Explicit instantiation of the template classes
+template class SymmetricMatrix<int>;
+template class SymmetricMatrix<float>;
+template class SymmetricMatrix<double>;
+
+template class TriangularMatrix<int>;
+template class TriangularMatrix<float>;
+template class TriangularMatrix<double>;
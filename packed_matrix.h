@@ -0,0 +1,137 @@
+//
+// Symmetric and triangular matrices stored as one packed triangle.
+//
+
+#include <vector>
+#include <utility>
+#include <stdexcept>
+
+#include "matrix.h"
+
+#ifndef PACKED_MATRIX_H
+#define PACKED_MATRIX_H
+
+
+/*
+ * SymmetricMatrix class
+ * A square n x n matrix with S(i, j) == S(j, i). Only the lower triangle is
+ * stored, packed row by row: element (i, j) with j <= i is at i*(i+1)/2 + j.
+ * This halves the memory and the work of the reductions.
+ */
+
+template<typename T>
+class SymmetricMatrix {
+public:
+    SymmetricMatrix() = default;
+    explicit SymmetricMatrix(int n);
+    SymmetricMatrix(int n, T defaultValue);
+    // Keep the lower triangle of a square matrix
+    explicit SymmetricMatrix(const Matrix<T>& m);
+
+    /*
+     * Inline element access, (h, w) and (w, h) are the same element
+     */
+    inline T& operator()(int h, int w) { return h >= w ? data_[index(h, w)] : data_[index(w, h)]; }
+    inline const T& operator()(int h, int w) const { return h >= w ? data_[index(h, w)] : data_[index(w, h)]; }
+
+    // Inline getters
+    [[nodiscard]] inline int getHeight() const { return n_; }
+    [[nodiscard]] inline int getWidth() const { return n_; }
+    [[nodiscard]] inline std::pair<int, int> getShape() const { return std::make_pair(n_, n_); }
+    [[nodiscard]] inline const std::vector<T>& packed() const { return data_; }
+
+    // Methods
+    void fill(const T& value);
+    Matrix<T> toMatrix() const;
+
+    // Maths operations
+    Matrix<T> dot(const Matrix<T>& m) const;                       // SYMM: S * M
+    static SymmetricMatrix<T> syrk(const Matrix<T>& a);            // SYRK: A * A^T
+    T max() const;
+    T min() const;
+    T sum(Summation mode=Summation::Naive) const;
+    std::vector<T> sum(int axis) const;                            // rows and columns sums are equal
+
+    // Serialization & deserialization (only the lower triangle is written)
+    void dumpToProto(const std::string& filePath) const;
+    static SymmetricMatrix<T> loadFromProto(const std::string& filePath);
+
+private:
+    static inline long index(int h, int w) { return static_cast<long>(h) * (h + 1) / 2 + w; }
+
+    std::vector<T> data_;
+    int n_ = 0;
+};
+
+
+/*
+ * TriangularMatrix class
+ * A square n x n lower or upper triangular matrix, the other triangle is
+ * zero and not stored. The stored triangle is packed row by row.
+ */
+
+enum class Triangle { Lower, Upper };
+
+template<typename T>
+class TriangularMatrix {
+public:
+    TriangularMatrix() = default;
+    TriangularMatrix(int n, Triangle triangle);
+    TriangularMatrix(int n, Triangle triangle, T defaultValue);
+    // Keep the given triangle of a square matrix
+    TriangularMatrix(const Matrix<T>& m, Triangle triangle);
+
+    /*
+     * Inline element access
+     * The const accessor returns zero outside of the triangle, the mutable
+     * one throws since those elements are not stored.
+     */
+    inline bool contains(int h, int w) const { return triangle_ == Triangle::Lower ? w <= h : w >= h; }
+    inline T operator()(int h, int w) const { return contains(h, w) ? data_[index(h, w)] : T(0); }
+    inline T& operator()(int h, int w) {
+        if (!contains(h, w))
+            throw std::out_of_range("Element outside of the stored triangle.");
+        return data_[index(h, w)];
+    }
+
+    // Inline getters
+    [[nodiscard]] inline int getHeight() const { return n_; }
+    [[nodiscard]] inline int getWidth() const { return n_; }
+    [[nodiscard]] inline std::pair<int, int> getShape() const { return std::make_pair(n_, n_); }
+    [[nodiscard]] inline Triangle getTriangle() const { return triangle_; }
+    [[nodiscard]] inline const std::vector<T>& packed() const { return data_; }
+
+    // Methods
+    void fill(const T& value);
+    Matrix<T> toMatrix() const;
+    TriangularMatrix<T> transpose() const;
+
+    // Maths operations
+    Matrix<T> dot(const Matrix<T>& m) const;      // TRMM: T * M
+    Matrix<T> solve(const Matrix<T>& b) const;    // TRSM: X such that T * X = B
+    T max() const;
+    T min() const;
+    T sum(Summation mode=Summation::Naive) const;
+
+    // Serialization & deserialization (only the stored triangle is written)
+    void dumpToProto(const std::string& filePath) const;
+    static TriangularMatrix<T> loadFromProto(const std::string& filePath);
+
+private:
+    inline long index(int h, int w) const {
+        if (triangle_ == Triangle::Lower) {
+            return static_cast<long>(h) * (h + 1) / 2 + w;
+        }
+        return static_cast<long>(h) * n_ - static_cast<long>(h) * (h - 1) / 2 + (w - h);
+    }
+
+    std::vector<T> data_;
+    int n_ = 0;
+    Triangle triangle_ = Triangle::Lower;
+};
+
+template <class T> inline std::ostream& operator<<(std::ostream &flux, const SymmetricMatrix<T>& m) { m.toMatrix().print(flux); return flux; }
+template <class T> inline std::ostream& operator<<(std::ostream &flux, const TriangularMatrix<T>& m) { m.toMatrix().print(flux); return flux; }
+
+
+#endif // PACKED_MATRIX_H
@@ -0,0 +1,407 @@
+//
+// Covariance, correlation and distance matrices between rows or columns.
+//
+
+#include "pairwise.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// Outputs computed together by the kernel: KERNEL_ROWS x KERNEL_COLS
+// accumulators stay in registers
+static const int KERNEL_ROWS = 4;
+static const int KERNEL_COLS = 8;
+// Columns of the source transposed together when packing with axis 1
+static const int PACK_BLOCK = 64;
+// Euclidean distances with d^2 < CLOSE_RATIO (|x|^2 + |y|^2) are recomputed
+// directly, bounding the relative error of d^2 to about eps / CLOSE_RATIO
+static const double CLOSE_RATIO = 1.0 / 1024;
+
+
+namespace {
+
+// Variables packed as contiguous rows of length elements
+template<typename A>
+struct Packed {
+    std::vector<A> data;
+    int rows = 0;
+    int length = 0;
+
+    inline A* row(int i) { return data.data() + static_cast<std::size_t>(i) * length; }
+    inline const A* row(int i) const { return data.data() + static_cast<std::size_t>(i) * length; }
+};
+
+// Products for the dot-based kernels, absolute differences for Manhattan
+struct Product {
+    template<typename A> inline A operator()(A x, A y) const { return x * y; }
+};
+
+struct AbsoluteDifference {
+    template<typename A> inline A operator()(A x, A y) const { return std::abs(x - y); }
+};
+
+} // namespace
+
+
+// Rows (axis 0) or columns (axis 1) of m as contiguous rows
+template<typename A, typename T>
+static Packed<A> pack(const Matrix<T>& m, int axis) {
+    if (axis != 0 && axis != 1)
+        throw std::invalid_argument("Axis must be 0 or 1.");
+    const int h = m.getHeight();
+    const int w = m.getWidth();
+    Packed<A> p;
+    p.rows = axis == 0 ? h : w;
+    p.length = axis == 0 ? w : h;
+    p.data.resize(static_cast<std::size_t>(p.rows) * p.length);
+    long work = static_cast<long>(h) * w;
+    if (axis == 0) {
+        #pragma omp parallel for schedule(static) if(work > PARALLEL_THRESHOLD)
+        for (int i = 0; i < h; i++) {
+            const T* in = m(i).data();
+            A* out = p.row(i);
+            for (int j = 0; j < w; j++) {
+                out[j] = static_cast<A>(in[j]);
+            }
+        }
+    }
+    else {
+        // Blocks of PACK_BLOCK columns: the rows written stay in cache while
+        // the source is read row by row
+        #pragma omp parallel for schedule(static) if(work > PARALLEL_THRESHOLD)
+        for (int j0 = 0; j0 < w; j0 += PACK_BLOCK) {
+            const int j1 = std::min(j0 + PACK_BLOCK, w);
+            for (int i = 0; i < h; i++) {
+                const T* in = m(i).data();
+                for (int j = j0; j < j1; j++) {
+                    p.row(j)[i] = static_cast<A>(in[j]);
+                }
+            }
+        }
+    }
+    return p;
+}
+
+// Subtracts its mean from every variable
+template<typename A>
+static void center(Packed<A>& p) {
+    #pragma omp parallel for schedule(static) if(static_cast<long>(p.rows) * p.length > PARALLEL_THRESHOLD)
+    for (int i = 0; i < p.rows; i++) {
+        A* row = p.row(i);
+        const A mean = static_cast<A>(reduceSum(row, p.length, Summation::Pairwise) / p.length);
+        for (int k = 0; k < p.length; k++) {
+            row[k] -= mean;
+        }
+    }
+}
+
+// Scales every variable to unit norm, zero variables become NaN
+template<typename A>
+static void normalize(Packed<A>& p) {
+    #pragma omp parallel for schedule(static) if(static_cast<long>(p.rows) * p.length > PARALLEL_THRESHOLD)
+    for (int i = 0; i < p.rows; i++) {
+        A* row = p.row(i);
+        const auto norm = std::sqrt(reduceDot(row, row, p.length, Summation::Pairwise));
+        const auto scale = norm > 0 ? 1 / norm : std::numeric_limits<decltype(norm)>::quiet_NaN();
+        for (int k = 0; k < p.length; k++) {
+            row[k] = static_cast<A>(row[k] * scale);
+        }
+    }
+}
+
+// Squared norm of every variable
+template<typename A>
+static std::vector<A> squaredNorms(const Packed<A>& p) {
+    std::vector<A> norms(p.rows);
+    for (int i = 0; i < p.rows; i++) {
+        norms[i] = static_cast<A>(reduceDot(p.row(i), p.row(i), p.length, Summation::Pairwise));
+    }
+    return norms;
+}
+
+/*
+ * out[r][c] = sum op(a[r][k], columns[k * ld + c]) for a block of
+ * KERNEL_ROWS x KERNEL_COLS outputs, accumulated in registers: every a[r][k]
+ * is broadcast against KERNEL_COLS contiguous elements (the classical
+ * product of strassen.h, blocked in both dimensions).
+ */
+template<typename A, typename Op>
+static inline void kernel(const A* const* a, const A* columns, int ld, int n, Op op,
+                          A out[KERNEL_ROWS][KERNEL_COLS]) {
+    A acc[KERNEL_ROWS][KERNEL_COLS] = {};
+    for (int k = 0; k < n; k++) {
+        const A* y = columns + static_cast<std::size_t>(k) * ld;
+        for (int r = 0; r < KERNEL_ROWS; r++) {
+            const A x = a[r][k];
+            // Vectorized over c: left alone, GCC vectorizes the k loop with transposes
+            #pragma omp simd
+            for (int c = 0; c < KERNEL_COLS; c++) {
+                acc[r][c] += op(x, y[c]);
+            }
+        }
+    }
+    for (int r = 0; r < KERNEL_ROWS; r++) {
+        for (int c = 0; c < KERNEL_COLS; c++) {
+            out[r][c] = acc[r][c];
+        }
+    }
+}
+
+/*
+ * Tile of rows [i0, i0 + h) and columns [j0, j0 + w) written to out at
+ * (oi, oj), finish(i, j, value) turning the reduction into the result.
+ * columns holds the variables j0 to j0 + w of b transposed, ld (a multiple
+ * of KERNEL_COLS, zero padded) elements per row. A diagonal tile of a
+ * symmetric result only computes its upper part and mirrors it.
+ */
+template<typename A, typename T, typename Op, typename Finish>
+static void computeTile(const Packed<A>& a, const std::vector<A>& columns, int ld, int i0, int h, int j0, int w,
+                        bool diagonal, Op op, Finish finish, Matrix<T>& out, int oi, int oj) {
+    const int blocks = (h + KERNEL_ROWS - 1) / KERNEL_ROWS;
+    long work = static_cast<long>(h) * w * a.length;
+    #pragma omp parallel for schedule(dynamic) if(work > PARALLEL_THRESHOLD)
+    for (int block = 0; block < blocks; block++) {
+        const int r0 = block * KERNEL_ROWS;
+        const int count = std::min(KERNEL_ROWS, h - r0);
+        // Missing rows of the last block repeat its last row, their result is dropped
+        const A* rows[KERNEL_ROWS];
+        for (int r = 0; r < KERNEL_ROWS; r++) {
+            rows[r] = a.row(i0 + r0 + std::min(r, count - 1));
+        }
+        A values[KERNEL_ROWS][KERNEL_COLS];
+        for (int c0 = diagonal ? r0 - r0 % KERNEL_COLS : 0; c0 < w; c0 += KERNEL_COLS) {
+            kernel(rows, columns.data() + c0, ld, a.length, op, values);
+            const int width = std::min(KERNEL_COLS, w - c0);
+            for (int r = 0; r < count; r++) {
+                T* row = out(oi + r0 + r).data() + oj + c0;
+                for (int c = 0; c < width; c++) {
+                    row[c] = finish(i0 + r0 + r, j0 + c0 + c, values[r][c]);
+                }
+            }
+        }
+    }
+    if (diagonal) {
+        const Matrix<T>& upper = out;
+        for (int i = 1; i < h; i++) {
+            T* row = out(oi + i).data() + oj;
+            for (int j = 0; j < i; j++) {
+                row[j] = upper(oi + j, oj + i);
+            }
+        }
+    }
+}
+
+/*
+ * Computes the a.rows x b.rows result tile by tile, into result or through
+ * writer. Symmetric results skip the tiles below the diagonal: they are
+ * mirrored into result, not written to writer.
+ */
+template<typename A, typename T, typename Op, typename Finish>
+static void forEachTile(const Packed<A>& a, const Packed<A>& b, bool symmetric, int tile, Op op, Finish finish,
+                        Matrix<T>* result, const TileWriter<T>* writer) {
+    if (tile <= 0)
+        throw std::invalid_argument("Tile size must be positive.");
+    Matrix<T> buffer;
+    std::vector<A> columns;
+    for (int i0 = 0; i0 < a.rows; i0 += tile) {
+        const int h = std::min(tile, a.rows - i0);
+        for (int j0 = symmetric ? i0 : 0; j0 < b.rows; j0 += tile) {
+            const int w = std::min(tile, b.rows - j0);
+            const bool diagonal = symmetric && i0 == j0;
+            const int ld = (w + KERNEL_COLS - 1) / KERNEL_COLS * KERNEL_COLS;
+            columns.assign(static_cast<std::size_t>(b.length) * ld, A(0));
+            for (int j = 0; j < w; j++) {
+                const A* variable = b.row(j0 + j);
+                for (int k = 0; k < b.length; k++) {
+                    columns[static_cast<std::size_t>(k) * ld + j] = variable[k];
+                }
+            }
+            if (result != nullptr) {
+                computeTile(a, columns, ld, i0, h, j0, w, diagonal, op, finish, *result, i0, j0);
+            }
+            else {
+                if (buffer.getShape() != std::make_pair(h, w)) {
+                    buffer = Matrix<T>(h, w);
+                }
+                computeTile(a, columns, ld, i0, h, j0, w, diagonal, op, finish, buffer, 0, 0);
+                (*writer)(i0, j0, buffer);
+            }
+        }
+    }
+    if (result != nullptr && symmetric) {
+        #pragma omp parallel for schedule(dynamic, 16) if(static_cast<long>(a.rows) * a.rows > PARALLEL_THRESHOLD)
+        for (int i = tile; i < a.rows; i++) {
+            const int end = i - i % tile;
+            for (int j = 0; j < end; j++) {
+                (*result)(i, j) = (*result)(j, i);
+            }
+        }
+    }
+}
+
+
+/*
+ * Covariance and correlation
+ * Centered (and for the correlation unit norm) variables, the result is
+ * their Gram matrix.
+ */
+template<typename T>
+static void covariance(const Matrix<T>& m, int axis, int ddof, bool correlation, int tile,
+                       Matrix<T>* result, const TileWriter<T>* writer) {
+    using A = typename Accumulator<T>::type;
+    Packed<A> p = pack<A>(m, axis);
+    MATRIX_PROFILE(Pairwise, p.rows, p.rows, static_cast<long>(p.rows) * p.rows * p.length,
+                   sizeof(A) * p.data.size());
+    center(p);
+    if (correlation) {
+        normalize(p);
+        auto finish = [](int i, int j, A value) {
+            if (std::isnan(value)) {
+                return static_cast<T>(value);
+            }
+            return static_cast<T>(i == j ? A(1) : std::min(A(1), std::max(A(-1), value)));
+        };
+        forEachTile(p, p, true, tile, Product(), finish, result, writer);
+    }
+    else {
+        if (p.length - ddof <= 0)
+            throw std::invalid_argument("ddof must be smaller than the number of observations.");
+        const A scale = A(1) / static_cast<A>(p.length - ddof);
+        auto finish = [scale](int, int, A value) { return static_cast<T>(value * scale); };
+        forEachTile(p, p, true, tile, Product(), finish, result, writer);
+    }
+}
+
+template<typename T>
+Matrix<T> cov(const Matrix<T>& m, int axis, int ddof) {
+    const int n = axis == 1 ? m.getWidth() : m.getHeight();
+    Matrix<T> result(n, n);
+    covariance(m, axis, ddof, false, PAIRWISE_TILE, &result, static_cast<const TileWriter<T>*>(nullptr));
+    return result;
+}
+
+template<typename T>
+void cov(const Matrix<T>& m, int axis, int ddof, const TileWriter<T>& writer, int tile) {
+    covariance(m, axis, ddof, false, tile, static_cast<Matrix<T>*>(nullptr), &writer);
+}
+
+template<typename T>
+Matrix<T> corrcoef(const Matrix<T>& m, int axis) {
+    const int n = axis == 1 ? m.getWidth() : m.getHeight();
+    Matrix<T> result(n, n);
+    covariance(m, axis, 0, true, PAIRWISE_TILE, &result, static_cast<const TileWriter<T>*>(nullptr));
+    return result;
+}
+
+template<typename T>
+void corrcoef(const Matrix<T>& m, int axis, const TileWriter<T>& writer, int tile) {
+    covariance(m, axis, 0, true, tile, static_cast<Matrix<T>*>(nullptr), &writer);
+}
+
+
+/*
+ * Distances
+ * Euclidean: both operands are shifted by the column means of a, then
+ * d^2 = |x|^2 + |y|^2 - 2 x.y. Its absolute error is about
+ * eps (|x|^2 + |y|^2): close pairs (d^2 below CLOSE_RATIO of that) are
+ * recomputed as sum (x - y)^2. Cosine: unit norm rows,
+ * d = 1 - x.y. The self distances of cdist(a, a) are exactly zero.
+ */
+template<typename T>
+static void distances(const Matrix<T>& a, const Matrix<T>& b, Metric metric, int tile,
+                      Matrix<T>* result, const TileWriter<T>* writer) {
+    using A = typename Accumulator<T>::type;
+    if (a.getWidth() != b.getWidth())
+        throw std::invalid_argument("Matrices must have the same width.");
+    const bool self = &a == &b;
+    Packed<A> pa = pack<A>(a, 0);
+    Packed<A> pb = self ? Packed<A>() : pack<A>(b, 0);
+    Packed<A>& other = self ? pa : pb;
+    MATRIX_PROFILE(Pairwise, pa.rows, other.rows, static_cast<long>(pa.rows) * other.rows * pa.length,
+                   sizeof(A) * (pa.data.size() + pb.data.size()));
+
+    if (metric == Metric::Euclidean) {
+        using Wide = typename Widened<T>::type;
+        std::vector<Wide> sums(pa.length, Wide(0));
+        for (int i = 0; i < pa.rows; i++) {
+            const A* row = pa.row(i);
+            for (int k = 0; k < pa.length; k++) {
+                sums[k] += row[k];
+            }
+        }
+        std::vector<A> shift(pa.length);
+        for (int k = 0; k < pa.length; k++) {
+            shift[k] = pa.rows > 0 ? static_cast<A>(sums[k] / pa.rows) : A(0);
+        }
+        for (Packed<A>* p : {&pa, &pb}) {
+            #pragma omp parallel for schedule(static) if(static_cast<long>(p->rows) * p->length > PARALLEL_THRESHOLD)
+            for (int i = 0; i < p->rows; i++) {
+                A* row = p->row(i);
+                for (int k = 0; k < p->length; k++) {
+                    row[k] -= shift[k];
+                }
+            }
+        }
+        const std::vector<A> normsA = squaredNorms(pa);
+        const std::vector<A> normsB = self ? std::vector<A>() : squaredNorms(pb);
+        const std::vector<A>& normsOther = self ? normsA : normsB;
+        auto finish = [&pa, &other, &normsA, &normsOther, self](int i, int j, A value) {
+            if (self && i == j) {
+                return T(0);
+            }
+            const A scale = normsA[i] + normsOther[j];
+            A squared = scale - 2 * value;
+            if (squared < scale * CLOSE_RATIO) {
+                const A* x = pa.row(i);
+                const A* y = other.row(j);
+                squared = summation::naiveSum<A>(pa.length, [x, y](std::size_t k) { return (x[k] - y[k]) * (x[k] - y[k]); });
+            }
+            return static_cast<T>(std::sqrt(std::max(A(0), squared)));
+        };
+        forEachTile(pa, other, self, tile, Product(), finish, result, writer);
+    }
+    else if (metric == Metric::Cosine) {
+        normalize(pa);
+        if (!self) {
+            normalize(pb);
+        }
+        auto finish = [self](int i, int j, A value) {
+            if (self && i == j && !std::isnan(value)) {
+                return T(0);
+            }
+            return static_cast<T>(A(1) - value);
+        };
+        forEachTile(pa, other, self, tile, Product(), finish, result, writer);
+    }
+    else {
+        auto finish = [](int, int, A value) { return static_cast<T>(value); };
+        forEachTile(pa, other, self, tile, AbsoluteDifference(), finish, result, writer);
+    }
+}
+
+template<typename T>
+Matrix<T> cdist(const Matrix<T>& a, const Matrix<T>& b, Metric metric) {
+    Matrix<T> result(a.getHeight(), b.getHeight());
+    distances(a, b, metric, PAIRWISE_TILE, &result, static_cast<const TileWriter<T>*>(nullptr));
+    return result;
+}
+
+template<typename T>
+void cdist(const Matrix<T>& a, const Matrix<T>& b, Metric metric, const TileWriter<T>& writer, int tile) {
+    distances(a, b, metric, tile, static_cast<Matrix<T>*>(nullptr), &writer);
+}
+
+
+// Explicit instantiation (the results need a floating point type)
+#define PAIRWISE_INSTANTIATE(T) \
+    template Matrix<T> cov(const Matrix<T>& m, int axis, int ddof); \
+    template void cov(const Matrix<T>& m, int axis, int ddof, const TileWriter<T>& writer, int tile); \
+    template Matrix<T> corrcoef(const Matrix<T>& m, int axis); \
+    template void corrcoef(const Matrix<T>& m, int axis, const TileWriter<T>& writer, int tile); \
+    template Matrix<T> cdist(const Matrix<T>& a, const Matrix<T>& b, Metric metric); \
+    template void cdist(const Matrix<T>& a, const Matrix<T>& b, Metric metric, const TileWriter<T>& writer, \
+                        int tile);
+
+PAIRWISE_INSTANTIATE(float)
+PAIRWISE_INSTANTIATE(double)
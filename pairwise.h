@@ -0,0 +1,81 @@
+//
+// Covariance, correlation and distance matrices between rows or columns.
+//
+
+#include <functional>
+
+#include "matrix.h"
+
+#ifndef PAIRWISE_H
+#define PAIRWISE_H
+
+
+// Rows and columns of the output computed (and streamed) together
+constexpr int PAIRWISE_TILE = 256;
+
+/*
+ * Distance metrics
+ *   Euclidean : sqrt(sum (x - y)^2)
+ *   Cosine    : 1 - x.y / (|x| |y|), NaN if x or y is zero
+ *   Manhattan : sum |x - y|
+ */
+enum class Metric { Euclidean, Cosine, Manhattan };
+
+// Receives the tile of rows [row, row + tile.getHeight()) and columns [col, col + tile.getWidth()).
+// Declared through a struct so T is deduced from the matrices and a lambda can be passed
+template<typename T>
+struct TileWriterOf {
+    using type = std::function<void(int row, int col, const Matrix<T>& tile)>;
+};
+template<typename T>
+using TileWriter = typename TileWriterOf<T>::type;
+
+/*
+ * Pairwise kernels
+ * Every output element is a reduction over a pair of variables: the rows of
+ * m with axis 0 (result h x h) or its columns with axis 1 (result w x w),
+ * like sum(axis). cdist compares the rows of a with the rows of b.
+ *
+ * The variables are packed once into contiguous rows of Accumulator<T>, the
+ * preprocessing folded into the packing: centered for cov, centered and
+ * scaled to unit norm for corrcoef, scaled to unit norm for cosine. The
+ * output is then a product of the packed operand with its transpose,
+ * computed by tiles of PAIRWISE_TILE x PAIRWISE_TILE with a register
+ * blocked kernel (4 x 8 outputs per pass). Euclidean distances use
+ * |x|^2 + |y|^2 - 2 x.y after shifting both operands by the mean of a
+ * (the distances do not change, the cancellation does), close pairs are
+ * recomputed directly. Manhattan sums |x - y| directly.
+ *
+ * cov, corrcoef and cdist(a, a) are symmetric: only the tiles on and above
+ * the diagonal are computed. cdist detects the self comparison when a and
+ * b are the same object.
+ *
+ * The overloads taking a TileWriter never hold the whole output: each tile
+ * is passed to the writer once computed, in row-major order of tiles. For
+ * symmetric results only the tiles on and above the diagonal are written
+ * (tile (j, i) is the transpose of tile (i, j)).
+ *
+ * cov divides by n - ddof. corrcoef is clipped to [-1, 1], a variable of
+ * zero variance gives NaN.
+ */
+template<typename T>
+Matrix<T> cov(const Matrix<T>& m, int axis=0, int ddof=1);
+
+template<typename T>
+void cov(const Matrix<T>& m, int axis, int ddof, const TileWriter<T>& writer, int tile=PAIRWISE_TILE);
+
+template<typename T>
+Matrix<T> corrcoef(const Matrix<T>& m, int axis=0);
+
+template<typename T>
+void corrcoef(const Matrix<T>& m, int axis, const TileWriter<T>& writer, int tile=PAIRWISE_TILE);
+
+template<typename T>
+Matrix<T> cdist(const Matrix<T>& a, const Matrix<T>& b, Metric metric=Metric::Euclidean);
+
+template<typename T>
+void cdist(const Matrix<T>& a, const Matrix<T>& b, Metric metric, const TileWriter<T>& writer,
+           int tile=PAIRWISE_TILE);
+
+
+#endif // PAIRWISE_H
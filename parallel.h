@@ -0,0 +1,12 @@
+//
+// Size above which the loops of the library are run in parallel.
+//
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+// Number of scalar operations above which a loop is run in parallel (OpenMP
+// if clauses), shared by every module so that they switch at the same size
+constexpr long PARALLEL_THRESHOLD = 1L << 15;
+
+#endif // PARALLEL_H
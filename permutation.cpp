@@ -0,0 +1,278 @@
+//
+// Row and column permutations, gather (take, select) and scatter.
+//
+
+#include "permutation.h"
+#include "parallel.h"
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace permutation {
+
+namespace {
+
+// Throws unless perm holds every index of [0, n) exactly once
+void checkPermutation(const std::vector<int>& perm, int n) {
+    if (static_cast<long>(perm.size()) != n) {
+        throw std::invalid_argument("Not a permutation.");
+    }
+    std::vector<bool> seen(n, false);
+    for (int p : perm) {
+        if (p < 0 || p >= n || seen[p]) {
+            throw std::invalid_argument("Not a permutation.");
+        }
+        seen[p] = true;
+    }
+}
+
+// Indices with the negative ones counted from the end, throws if one is out of [0, n)
+std::vector<int> normalize(const std::vector<int>& indices, int n) {
+    std::vector<int> result(indices);
+    for (int& i : result) {
+        if (i < 0) {
+            i += n;
+        }
+        if (i < 0 || i >= n) {
+            throw std::out_of_range("Index out of bounds.");
+        }
+    }
+    return result;
+}
+
+inline void checkAxis(int axis) {
+    if (axis != 0 && axis != 1) {
+        throw std::invalid_argument("Axis must be 0 or 1.");
+    }
+}
+
+// Row i of the result is row indices[i] of m
+template<typename T>
+Matrix<T> gatherRows(const Matrix<T>& m, const std::vector<int>& indices) {
+    const int height = static_cast<int>(indices.size());
+    const int width = m.getWidth();
+    MATRIX_PROFILE(Gather, height, width, static_cast<long>(height) * width, 2 * sizeof(T) * height * width);
+    if (height == 0 || width == 0) {
+        return Matrix<T>(height, width);
+    }
+    Matrix<T> result(height, width);
+    #pragma omp parallel for schedule(static) if(static_cast<long>(height) * width > PARALLEL_THRESHOLD)
+    for (int i = 0; i < height; i++) {
+        const std::vector<T>& in = m(indices[i]);
+        std::copy(in.begin(), in.end(), result(i).begin());
+    }
+    return result;
+}
+
+// Column j of the result is column indices[j] of m, by tiles (see permutation.h)
+template<typename T>
+Matrix<T> gatherCols(const Matrix<T>& m, const std::vector<int>& indices) {
+    const int height = m.getHeight();
+    const int width = static_cast<int>(indices.size());
+    MATRIX_PROFILE(Gather, height, width, static_cast<long>(height) * width, 2 * sizeof(T) * height * width);
+    if (height == 0 || width == 0) {
+        return Matrix<T>(height, width);
+    }
+    Matrix<T> result(height, width);
+    const int rowTiles = (height + GATHER_TILE_ROWS - 1) / GATHER_TILE_ROWS;
+    const int colTiles = (width + GATHER_TILE_COLS - 1) / GATHER_TILE_COLS;
+    const int* index = indices.data();
+    #pragma omp parallel for collapse(2) schedule(static) if(static_cast<long>(height) * width > PARALLEL_THRESHOLD)
+    for (int rt = 0; rt < rowTiles; rt++) {
+        for (int ct = 0; ct < colTiles; ct++) {
+            const int i1 = std::min(height, (rt + 1) * GATHER_TILE_ROWS);
+            const int j0 = ct * GATHER_TILE_COLS;
+            const int j1 = std::min(width, j0 + GATHER_TILE_COLS);
+            for (int i = rt * GATHER_TILE_ROWS; i < i1; i++) {
+                const T* __restrict in = m(i).data();
+                T* __restrict out = result(i).data();
+                for (int j = j0; j < j1; j++) {
+                    out[j] = in[index[j]];
+                }
+            }
+        }
+    }
+    return result;
+}
+
+}
+
+
+template<typename T>
+Matrix<T> permuteRows(const Matrix<T>& m, const std::vector<int>& perm) {
+    checkPermutation(perm, m.getHeight());
+    return gatherRows(m, perm);
+}
+
+template<typename T>
+Matrix<T> permuteCols(const Matrix<T>& m, const std::vector<int>& perm) {
+    checkPermutation(perm, m.getWidth());
+    return gatherCols(m, perm);
+}
+
+template<typename T>
+void permuteRowsInPlace(Matrix<T>& m, const std::vector<int>& perm) {
+    const int height = m.getHeight();
+    checkPermutation(perm, height);
+    MATRIX_PROFILE(Gather, height, m.getWidth(), height, sizeof(std::vector<T>) * height);
+    m.detach();
+    // Along a cycle the row of the start moves forward one swap at a time
+    std::vector<bool> done(height, false);
+    for (int start = 0; start < height; start++) {
+        if (done[start]) {
+            continue;
+        }
+        done[start] = true;
+        for (int i = start; perm[i] != start; i = perm[i]) {
+            std::swap(m(i), m(perm[i]));
+            done[perm[i]] = true;
+        }
+    }
+}
+
+template<typename T>
+void permuteColsInPlace(Matrix<T>& m, const std::vector<int>& perm) {
+    const int height = m.getHeight();
+    const int width = m.getWidth();
+    checkPermutation(perm, width);
+    MATRIX_PROFILE(Gather, height, width, static_cast<long>(height) * width, 2 * sizeof(T) * height * width);
+
+    // Cycles of length 2 or more, one after the other: c0, perm[c0], perm[perm[c0]], ...
+    std::vector<int> cycles;
+    std::vector<int> starts;
+    std::vector<bool> done(width, false);
+    for (int start = 0; start < width; start++) {
+        if (done[start] || perm[start] == start) {
+            continue;
+        }
+        starts.push_back(static_cast<int>(cycles.size()));
+        for (int j = start; !done[j]; j = perm[j]) {
+            cycles.push_back(j);
+            done[j] = true;
+        }
+    }
+    starts.push_back(static_cast<int>(cycles.size()));
+    if (cycles.empty()) {
+        return;
+    }
+
+    m.detach();
+    const int nCycles = static_cast<int>(starts.size()) - 1;
+    #pragma omp parallel for schedule(static) if(static_cast<long>(height) * width > PARALLEL_THRESHOLD)
+    for (int i = 0; i < height; i++) {
+        T* row = m(i).data();
+        for (int c = 0; c < nCycles; c++) {
+            const int* cycle = cycles.data() + starts[c];
+            const int last = starts[c + 1] - starts[c] - 1;
+            T first = row[cycle[0]];
+            for (int k = 0; k < last; k++) {
+                row[cycle[k]] = row[cycle[k + 1]];
+            }
+            row[cycle[last]] = first;
+        }
+    }
+}
+
+template<typename T>
+Matrix<T> take(const Matrix<T>& m, const std::vector<int>& indices, int axis) {
+    checkAxis(axis);
+    if (axis == 0) {
+        return gatherRows(m, normalize(indices, m.getHeight()));
+    }
+    return gatherCols(m, normalize(indices, m.getWidth()));
+}
+
+template<typename T>
+Matrix<T> select(const Matrix<T>& m, const std::vector<bool>& mask, int axis) {
+    checkAxis(axis);
+    const int n = axis == 0 ? m.getHeight() : m.getWidth();
+    if (static_cast<long>(mask.size()) != n) {
+        throw std::invalid_argument("Matrix dimension must be the same.");
+    }
+    std::vector<int> indices;
+    for (int k = 0; k < n; k++) {
+        if (mask[k]) {
+            indices.push_back(k);
+        }
+    }
+    return axis == 0 ? gatherRows(m, indices) : gatherCols(m, indices);
+}
+
+template<typename T>
+void scatter(const Matrix<T>& source, const std::vector<int>& indices, Matrix<T>& target, int axis) {
+    checkAxis(axis);
+    const int n = static_cast<int>(indices.size());
+    if (axis == 0 ? source.getHeight() != n || source.getWidth() != target.getWidth()
+                  : source.getWidth() != n || source.getHeight() != target.getHeight()) {
+        throw std::invalid_argument("Matrix dimension must be the same.");
+    }
+    const int height = source.getHeight();
+    const int width = source.getWidth();
+    MATRIX_PROFILE(Gather, height, width, static_cast<long>(height) * width, 2 * sizeof(T) * height * width);
+    if (n == 0 || height == 0 || width == 0) {
+        return;
+    }
+    target.detach();
+
+    if (axis == 0) {
+        std::vector<int> index = normalize(indices, target.getHeight());
+        // Only the last row written to a target row is copied, so the rows can be copied in any order
+        std::vector<int> last(target.getHeight(), -1);
+        for (int k = 0; k < n; k++) {
+            last[index[k]] = k;
+        }
+        #pragma omp parallel for schedule(static) if(static_cast<long>(n) * width > PARALLEL_THRESHOLD)
+        for (int k = 0; k < n; k++) {
+            if (last[index[k]] == k) {
+                const std::vector<T>& in = source(k);
+                std::copy(in.begin(), in.end(), target(index[k]).begin());
+            }
+        }
+        return;
+    }
+
+    // Every row is written by one thread, in the order of indices
+    std::vector<int> index = normalize(indices, target.getWidth());
+    const int* to = index.data();
+    #pragma omp parallel for schedule(static) if(static_cast<long>(height) * n > PARALLEL_THRESHOLD)
+    for (int rt = 0; rt < (height + GATHER_TILE_ROWS - 1) / GATHER_TILE_ROWS; rt++) {
+        const int i1 = std::min(height, (rt + 1) * GATHER_TILE_ROWS);
+        for (int j0 = 0; j0 < n; j0 += GATHER_TILE_COLS) {
+            const int j1 = std::min(n, j0 + GATHER_TILE_COLS);
+            for (int i = rt * GATHER_TILE_ROWS; i < i1; i++) {
+                const T* __restrict in = source(i).data();
+                T* __restrict out = target(i).data();
+                for (int j = j0; j < j1; j++) {
+                    out[to[j]] = in[j];
+                }
+            }
+        }
+    }
+}
+
+std::vector<int> inverse(const std::vector<int>& perm) {
+    const int n = static_cast<int>(perm.size());
+    checkPermutation(perm, n);
+    std::vector<int> result(n);
+    for (int i = 0; i < n; i++) {
+        result[perm[i]] = i;
+    }
+    return result;
+}
+
+
+// Explicit instantiation
+#define PERMUTATION_INSTANTIATE(T) \
+    template Matrix<T> permuteRows(const Matrix<T>& m, const std::vector<int>& perm); \
+    template Matrix<T> permuteCols(const Matrix<T>& m, const std::vector<int>& perm); \
+    template void permuteRowsInPlace(Matrix<T>& m, const std::vector<int>& perm); \
+    template void permuteColsInPlace(Matrix<T>& m, const std::vector<int>& perm); \
+    template Matrix<T> take(const Matrix<T>& m, const std::vector<int>& indices, int axis); \
+    template Matrix<T> select(const Matrix<T>& m, const std::vector<bool>& mask, int axis); \
+    template void scatter(const Matrix<T>& source, const std::vector<int>& indices, Matrix<T>& target, int axis);
+
+PERMUTATION_INSTANTIATE(int)
+PERMUTATION_INSTANTIATE(float)
+PERMUTATION_INSTANTIATE(double)
+
+} // namespace permutation
@@ -0,0 +1,59 @@
+//
+// Row and column permutations, gather (take, select) and scatter.
+//
+
+#include <vector>
+
+#include "matrix.h"
+
+#ifndef PERMUTATION_H
+#define PERMUTATION_H
+
+
+// Columns of the tiles copied by the column gathers, a tile of a row stays in L1
+constexpr int GATHER_TILE_COLS = 1024;
+// Rows of the tiles copied by the column gathers
+constexpr int GATHER_TILE_ROWS = 32;
+
+/*
+ * Reordering and selection of rows and columns.
+ * A permutation perm maps the result to the source: row i of
+ * permuteRows(m, perm) is row perm[i] of m. perm must hold every index of
+ * the axis exactly once, otherwise std::invalid_argument is thrown.
+ * Indices given to take and scatter may repeat and may be negative
+ * (counted from the end, like operator()), out of range ones throw
+ * std::out_of_range. axis 0 works on rows, axis 1 on columns.
+ *
+ * Rows are gathered by copying whole rows in parallel. Columns are
+ * gathered by tiles of GATHER_TILE_ROWS x GATHER_TILE_COLS: the random
+ * reads of a tile stay within a few source rows that remain in cache.
+ *
+ * The in-place versions follow the cycles of the permutation instead of
+ * copying the matrix: permuteRowsInPlace swaps row buffers and moves no
+ * element, permuteColsInPlace lists the cycles once (one int per column)
+ * and applies them to the rows in parallel.
+ * An empty selection keeps the other dimension: no row of an n-column
+ * matrix is a 0 x n matrix.
+ */
+
+namespace permutation {
+
+template<typename T> Matrix<T> permuteRows(const Matrix<T>& m, const std::vector<int>& perm);
+template<typename T> Matrix<T> permuteCols(const Matrix<T>& m, const std::vector<int>& perm);
+template<typename T> void permuteRowsInPlace(Matrix<T>& m, const std::vector<int>& perm);
+template<typename T> void permuteColsInPlace(Matrix<T>& m, const std::vector<int>& perm);
+
+// The rows (axis 0) or columns (axis 1) at indices, in that order
+template<typename T> Matrix<T> take(const Matrix<T>& m, const std::vector<int>& indices, int axis=0);
+// The rows (axis 0) or columns (axis 1) whose mask is true, mask has one entry per row or column
+template<typename T> Matrix<T> select(const Matrix<T>& m, const std::vector<bool>& mask, int axis=0);
+// Inverse of take: row (or column) k of source is written at indices[k] of target, the last one wins on repeats
+template<typename T> void scatter(const Matrix<T>& source, const std::vector<int>& indices, Matrix<T>& target, int axis=0);
+
+// perm such that permuteRows(permuteRows(m, p), inverse(p)) == m
+std::vector<int> inverse(const std::vector<int>& perm);
+
+}
+
+
+#endif // PERMUTATION_H
@@ -0,0 +1,175 @@
+//
+// Per-operation counters for the Matrix hot paths.
+//
+
+#include "profiling.h"
+
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace profiling {
+
+namespace {
+
+constexpr int OP_COUNT = static_cast<int>(Op::Count);
+
+struct ThreadCounters {
+    OpCounters ops[OP_COUNT];
+};
+
+// Every thread registers its counters once, they are kept until the end of
+// the program so the counters of finished threads are still exported
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadCounters>> threads;
+};
+
+Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+ThreadCounters& threadCounters() {
+    thread_local ThreadCounters* counters = nullptr;
+    if (counters == nullptr) {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.threads.push_back(std::make_unique<ThreadCounters>());
+        counters = reg.threads.back().get();
+    }
+    return *counters;
+}
+
+inline void add(std::atomic<uint64_t>& counter, uint64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+inline int bucket(uint64_t nanoseconds) {
+    int b = 0;
+    while (nanoseconds > 1 && b < HISTOGRAM_BUCKETS - 1) {
+        nanoseconds >>= 1;
+        b++;
+    }
+    return b;
+}
+
+} // namespace
+
+const char* opName(Op op) {
+    switch (op) {
+        case Op::Add: return "add";
+        case Op::Subtract: return "subtract";
+        case Op::Multiply: return "multiply";
+        case Op::Divide: return "divide";
+        case Op::Dot: return "dot";
+        case Op::Transpose: return "transpose";
+        case Op::SubMat: return "subMat";
+        case Op::Duplicate: return "duplicate";
+        case Op::AsType: return "astype";
+        case Op::Sum: return "sum";
+        case Op::Max: return "max";
+        case Op::Min: return "min";
+        case Op::CumuSum: return "cumuSum";
+        case Op::Compound: return "compoundAssignment";
+        case Op::Print: return "print";
+        case Op::DumpToProto: return "dumpToProto";
+        case Op::LoadFromProto: return "loadFromProto";
+        case Op::ToCSV: return "toCSV";
+        case Op::FromCSV: return "fromCSV";
+        case Op::Balance: return "balance";
+        case Op::Elementwise: return "elementwise";
+        case Op::Convolve: return "convolve";
+        case Op::Pairwise: return "pairwise";
+        case Op::Gather: return "gather";
+        case Op::Concat: return "concat";
+        default: return "unknown";
+    }
+}
+
+void record(Op op, uint64_t rows, uint64_t cols, uint64_t elements, uint64_t bytes, uint64_t nanoseconds) {
+    OpCounters& c = threadCounters().ops[static_cast<int>(op)];
+    add(c.calls, 1);
+    add(c.elements, elements);
+    add(c.bytes, bytes);
+    add(c.nanoseconds, nanoseconds);
+    add(c.histogram[bucket(nanoseconds)], 1);
+    if (rows * cols > c.maxElements.load(std::memory_order_relaxed)) {
+        c.maxElements.store(rows * cols, std::memory_order_relaxed);
+        c.maxRows.store(rows, std::memory_order_relaxed);
+        c.maxCols.store(cols, std::memory_order_relaxed);
+    }
+}
+
+std::string toJSON() {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+
+    std::ostringstream json;
+    json << "{";
+    bool first = true;
+    for (int o = 0; o < OP_COUNT; o++) {
+        uint64_t calls = 0, elements = 0, bytes = 0, nanoseconds = 0;
+        uint64_t maxElements = 0, maxRows = 0, maxCols = 0;
+        uint64_t histogram[HISTOGRAM_BUCKETS] = {};
+        for (const auto& thread : reg.threads) {
+            const OpCounters& c = thread->ops[o];
+            calls += c.calls.load(std::memory_order_relaxed);
+            elements += c.elements.load(std::memory_order_relaxed);
+            bytes += c.bytes.load(std::memory_order_relaxed);
+            nanoseconds += c.nanoseconds.load(std::memory_order_relaxed);
+            if (c.maxElements.load(std::memory_order_relaxed) > maxElements) {
+                maxElements = c.maxElements.load(std::memory_order_relaxed);
+                maxRows = c.maxRows.load(std::memory_order_relaxed);
+                maxCols = c.maxCols.load(std::memory_order_relaxed);
+            }
+            for (int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+                histogram[b] += c.histogram[b].load(std::memory_order_relaxed);
+            }
+        }
+        if (calls == 0) {
+            continue;
+        }
+
+        json << (first ? "" : ",") << "\"" << opName(static_cast<Op>(o)) << "\":{"
+             << "\"calls\":" << calls
+             << ",\"elements\":" << elements
+             << ",\"bytes_allocated\":" << bytes
+             << ",\"total_ns\":" << nanoseconds
+             << ",\"largest_shape\":[" << maxRows << "," << maxCols << "]"
+             << ",\"histogram_log2_ns\":[";
+        int last = HISTOGRAM_BUCKETS - 1;
+        while (last > 0 && histogram[last] == 0) {
+            last--;
+        }
+        for (int b = 0; b <= last; b++) {
+            json << (b ? "," : "") << histogram[b];
+        }
+        json << "]}";
+        first = false;
+    }
+    json << "}";
+    return json.str();
+}
+
+void reset() {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for (const auto& thread : reg.threads) {
+        for (auto& c : thread->ops) {
+            c.calls.store(0, std::memory_order_relaxed);
+            c.elements.store(0, std::memory_order_relaxed);
+            c.bytes.store(0, std::memory_order_relaxed);
+            c.nanoseconds.store(0, std::memory_order_relaxed);
+            c.maxElements.store(0, std::memory_order_relaxed);
+            c.maxRows.store(0, std::memory_order_relaxed);
+            c.maxCols.store(0, std::memory_order_relaxed);
+            for (auto& h : c.histogram) {
+                h.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+}
+
+} // namespace profiling
@@ -0,0 +1,102 @@
+//
+// Opt-in per-operation counters for the Matrix hot paths.
+// Build with -DMATRIX_PROFILING (CMake option MATRIX_PROFILING) to enable
+// them, otherwise MATRIX_PROFILE expands to nothing.
+//
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#ifndef PROFILING_H
+#define PROFILING_H
+
+namespace profiling {
+
+enum class Op {
+    Add, Subtract, Multiply, Divide, Dot, Transpose, SubMat, Duplicate, AsType,
+    Sum, Max, Min, CumuSum, Compound, Print,
+    DumpToProto, LoadFromProto, ToCSV, FromCSV, Balance, Elementwise, Convolve, Pairwise, Gather, Concat,
+    Count
+};
+
+// Wall time histogram buckets, bucket b holds durations in [2^b, 2^(b+1)) ns
+constexpr int HISTOGRAM_BUCKETS = 40;
+
+/*
+ * Counters of one operation for one thread
+ * A thread only writes its own counters, so relaxed load + store is enough
+ * and no read-modify-write is needed. Readers only see slightly stale values.
+ */
+struct OpCounters {
+    std::atomic<uint64_t> calls{0};
+    std::atomic<uint64_t> elements{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> nanoseconds{0};
+    std::atomic<uint64_t> maxElements{0};
+    std::atomic<uint64_t> maxRows{0};
+    std::atomic<uint64_t> maxCols{0};
+    std::atomic<uint64_t> histogram[HISTOGRAM_BUCKETS] = {};
+};
+
+const char* opName(Op op);
+
+// Record one call of op on the calling thread
+void record(Op op, uint64_t rows, uint64_t cols, uint64_t elements, uint64_t bytes, uint64_t nanoseconds);
+
+// Counters of all the threads, merged, as a JSON object keyed by operation
+std::string toJSON();
+
+// Reset the counters of all the threads, call it while no operation runs
+void reset();
+
+// Times its scope and records it on destruction
+class ScopedOp {
+public:
+    ScopedOp(Op op, long rows, long cols, long elements, std::size_t bytes)
+        : op_(op), rows_(rows), cols_(cols), elements_(elements), bytes_(bytes),
+          start_(std::chrono::steady_clock::now()) {}
+
+    ~ScopedOp() {
+        auto elapsed = std::chrono::steady_clock::now() - start_;
+        record(op_, rows_, cols_, elements_, bytes_,
+               std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+
+    // For operations whose shape is only known at the end (loading a file)
+    void setShape(long rows, long cols, long elements, std::size_t bytes) {
+        rows_ = rows;
+        cols_ = cols;
+        elements_ = elements;
+        bytes_ = bytes;
+    }
+
+    ScopedOp(const ScopedOp&) = delete;
+    ScopedOp& operator=(const ScopedOp&) = delete;
+
+private:
+    Op op_;
+    long rows_;
+    long cols_;
+    long elements_;
+    std::size_t bytes_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+} // namespace profiling
+
+
+#if defined(MATRIX_PROFILING)
+#define MATRIX_PROFILE(op, rows, cols, elements, bytes) \
+    profiling::ScopedOp matrixProfileScope_(profiling::Op::op, (rows), (cols), (elements), (bytes))
+#define MATRIX_PROFILE_SHAPE(rows, cols, elements, bytes) \
+    matrixProfileScope_.setShape((rows), (cols), (elements), (bytes))
+#else
+#define MATRIX_PROFILE(op, rows, cols, elements, bytes) ((void)0)
+#define MATRIX_PROFILE_SHAPE(rows, cols, elements, bytes) ((void)0)
+#endif
+
+
+#endif // PROFILING_H
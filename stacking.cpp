@@ -0,0 +1,145 @@
+//
+// Concatenation, stacking, block assembly and tiling of matrices.
+//
+
+#include "stacking.h"
+#include "parallel.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace stacking {
+
+template<typename T>
+Matrix<T> block(const std::vector<std::vector<Matrix<T>>>& grid) {
+    // Non-empty pieces of every grid row, with the height and width of the row
+    std::vector<std::vector<const Matrix<T>*>> rows;
+    std::vector<int> heights;
+    int width = -1;
+    // Shape of the result if no piece has elements
+    long emptyHeight = 0;
+    long emptyWidth = 0;
+    for (const auto& gridRow : grid) {
+        std::vector<const Matrix<T>*> pieces;
+        long rowWidth = 0;
+        int emptyRowHeight = 0;
+        long emptyRowWidth = 0;
+        for (const Matrix<T>& piece : gridRow) {
+            emptyRowHeight = std::max(emptyRowHeight, piece.getHeight());
+            emptyRowWidth += piece.getWidth();
+            if (piece.getHeight() == 0 || piece.getWidth() == 0) {
+                continue;
+            }
+            if (!pieces.empty() && piece.getHeight() != pieces.front()->getHeight()) {
+                throw std::invalid_argument("Matrix dimension must be the same.");
+            }
+            pieces.push_back(&piece);
+            rowWidth += piece.getWidth();
+        }
+        emptyHeight += emptyRowHeight;
+        emptyWidth = std::max(emptyWidth, emptyRowWidth);
+        if (pieces.empty()) {
+            continue;
+        }
+        if (width != -1 && rowWidth != width) {
+            throw std::invalid_argument("Matrix dimension must be the same.");
+        }
+        width = static_cast<int>(rowWidth);
+        heights.push_back(pieces.front()->getHeight());
+        rows.push_back(std::move(pieces));
+    }
+    long height = 0;
+    for (int h : heights) {
+        height += h;
+    }
+    MATRIX_PROFILE(Concat, static_cast<int>(height), width, height * std::max(width, 0),
+                   2 * sizeof(T) * height * std::max(width, 0));
+    if (height == 0) {
+        return Matrix<T>(static_cast<int>(emptyHeight), static_cast<int>(emptyWidth));
+    }
+
+    // Grid row and row within it of every row of the result
+    std::vector<int> gridRow(height);
+    std::vector<int> localRow(height);
+    for (int r = 0, i = 0; r < static_cast<int>(rows.size()); r++) {
+        for (int k = 0; k < heights[r]; k++, i++) {
+            gridRow[i] = r;
+            localRow[i] = k;
+        }
+    }
+
+    Matrix<T> result(static_cast<int>(height), width);
+    #pragma omp parallel for schedule(static) if(height * width > PARALLEL_THRESHOLD)
+    for (int i = 0; i < static_cast<int>(height); i++) {
+        T* out = result(i).data();
+        for (const Matrix<T>* piece : rows[gridRow[i]]) {
+            const std::vector<T>& in = (*piece)(localRow[i]);
+            out = std::copy(in.begin(), in.end(), out);
+        }
+    }
+    return result;
+}
+
+template<typename T>
+Matrix<T> vstack(const std::vector<Matrix<T>>& pieces) {
+    std::vector<std::vector<Matrix<T>>> grid;
+    grid.reserve(pieces.size());
+    for (const Matrix<T>& piece : pieces) {
+        grid.push_back({piece});
+    }
+    return block(grid);
+}
+
+template<typename T>
+Matrix<T> hstack(const std::vector<Matrix<T>>& pieces) {
+    return block(std::vector<std::vector<Matrix<T>>>{pieces});
+}
+
+template<typename T>
+Matrix<T> concat(const std::vector<Matrix<T>>& pieces, int axis) {
+    if (axis == 0) {
+        return vstack(pieces);
+    }
+    if (axis == 1) {
+        return hstack(pieces);
+    }
+    throw std::invalid_argument("Axis must be 0 or 1.");
+}
+
+template<typename T>
+Matrix<T> tile(const Matrix<T>& m, int rowReps, int colReps) {
+    if (rowReps < 0 || colReps < 0) {
+        throw std::invalid_argument("Dimensions must be positive.");
+    }
+    const long height = static_cast<long>(m.getHeight()) * rowReps;
+    const long width = static_cast<long>(m.getWidth()) * colReps;
+    MATRIX_PROFILE(Concat, static_cast<int>(height), static_cast<int>(width), height * width,
+                   sizeof(T) * (height * width + static_cast<long>(m.getHeight()) * m.getWidth()));
+    if (height == 0 || width == 0) {
+        return Matrix<T>(static_cast<int>(height), static_cast<int>(width));
+    }
+    Matrix<T> result(static_cast<int>(height), static_cast<int>(width));
+    #pragma omp parallel for schedule(static) if(height * width > PARALLEL_THRESHOLD)
+    for (int i = 0; i < static_cast<int>(height); i++) {
+        const std::vector<T>& in = m(i % m.getHeight());
+        T* out = result(i).data();
+        for (int r = 0; r < colReps; r++) {
+            out = std::copy(in.begin(), in.end(), out);
+        }
+    }
+    return result;
+}
+
+
+// Explicit instantiation
+#define STACKING_INSTANTIATE(T) \
+    template Matrix<T> concat(const std::vector<Matrix<T>>& pieces, int axis); \
+    template Matrix<T> vstack(const std::vector<Matrix<T>>& pieces); \
+    template Matrix<T> hstack(const std::vector<Matrix<T>>& pieces); \
+    template Matrix<T> block(const std::vector<std::vector<Matrix<T>>>& grid); \
+    template Matrix<T> tile(const Matrix<T>& m, int rowReps, int colReps);
+
+STACKING_INSTANTIATE(int)
+STACKING_INSTANTIATE(float)
+STACKING_INSTANTIATE(double)
+
+} // namespace stacking
@@ -0,0 +1,62 @@
+//
+// Concatenation, stacking, block assembly and tiling of matrices.
+//
+
+#include <initializer_list>
+#include <vector>
+
+#include "matrix.h"
+
+#ifndef STACKING_H
+#define STACKING_H
+
+
+/*
+ * Assembly of a matrix from pieces
+ * The shape of the result is computed first and the result allocated
+ * once, then its rows are filled in parallel, each row by bulk copies of
+ * the row segments of its pieces. Growing a matrix with push_back or
+ * insert instead reallocates and copies it again at every step.
+ *
+ * block lays out a grid of pieces: the pieces of a grid row have the same
+ * height, the grid rows have the same total width (their pieces may be cut
+ * at different columns). Empty pieces (no rows or no columns) are skipped,
+ * other mismatches throw std::invalid_argument. A result without elements
+ * keeps the shape of its empty pieces: stacking 0 x 5 matrices gives a
+ * 0 x 5 matrix, as in permutation.h.
+ *
+ * Passing a matrix costs no copy (see copy-on-write in matrix.h), the
+ * braced lists {a, b} and {{a, b}, {c, d}} are accepted directly.
+ */
+
+namespace stacking {
+
+// axis 0 puts the pieces one below the other, axis 1 side by side
+template<typename T> Matrix<T> concat(const std::vector<Matrix<T>>& pieces, int axis=0);
+template<typename T> Matrix<T> vstack(const std::vector<Matrix<T>>& pieces);
+template<typename T> Matrix<T> hstack(const std::vector<Matrix<T>>& pieces);
+template<typename T> Matrix<T> block(const std::vector<std::vector<Matrix<T>>>& grid);
+// m repeated rowReps times vertically and colReps times horizontally
+template<typename T> Matrix<T> tile(const Matrix<T>& m, int rowReps, int colReps);
+
+template<typename T>
+inline Matrix<T> concat(std::initializer_list<Matrix<T>> pieces, int axis=0) {
+    return concat(std::vector<Matrix<T>>(pieces), axis);
+}
+template<typename T>
+inline Matrix<T> vstack(std::initializer_list<Matrix<T>> pieces) { return vstack(std::vector<Matrix<T>>(pieces)); }
+template<typename T>
+inline Matrix<T> hstack(std::initializer_list<Matrix<T>> pieces) { return hstack(std::vector<Matrix<T>>(pieces)); }
+template<typename T>
+inline Matrix<T> block(std::initializer_list<std::initializer_list<Matrix<T>>> grid) {
+    std::vector<std::vector<Matrix<T>>> rows;
+    for (const auto& row : grid) {
+        rows.emplace_back(row);
+    }
+    return block(rows);
+}
+
+}
+
+
+#endif // STACKING_H
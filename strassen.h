@@ -0,0 +1,158 @@
+//
+// Strassen-Winograd matrix multiplication on contiguous row-major buffers.
+//
+
+#include <algorithm>
+#include <vector>
+
+#ifndef STRASSEN_H
+#define STRASSEN_H
+
+namespace strassen {
+
+// Strided view on a row-major buffer
+template<typename A>
+struct View {
+    A* data;
+    int rows;
+    int cols;
+    int ld;
+
+    inline A* row(int i) const { return data + static_cast<long>(i) * ld; }
+    inline View block(int i, int j, int h, int w) const { return View{row(i) + j, h, w, ld}; }
+};
+
+// Contiguous buffer owning its elements
+template<typename A>
+struct Buffer {
+    std::vector<A> storage;
+    View<A> view;
+
+    Buffer(int rows, int cols) : storage(static_cast<long>(rows) * cols, A(0)),
+                                 view{storage.data(), rows, cols, cols} {}
+};
+
+template<typename A>
+inline void add(const View<A>& a, const View<A>& b, const View<A>& out) {
+    for (int i = 0; i < out.rows; i++) {
+        const A* ra = a.row(i);
+        const A* rb = b.row(i);
+        A* ro = out.row(i);
+        for (int j = 0; j < out.cols; j++) {
+            ro[j] = ra[j] + rb[j];
+        }
+    }
+}
+
+template<typename A>
+inline void subtract(const View<A>& a, const View<A>& b, const View<A>& out) {
+    for (int i = 0; i < out.rows; i++) {
+        const A* ra = a.row(i);
+        const A* rb = b.row(i);
+        A* ro = out.row(i);
+        for (int j = 0; j < out.cols; j++) {
+            ro[j] = ra[j] - rb[j];
+        }
+    }
+}
+
+template<typename A>
+inline void copy(const View<A>& a, const View<A>& out) {
+    for (int i = 0; i < a.rows; i++) {
+        std::copy(a.row(i), a.row(i) + a.cols, out.row(i));
+    }
+}
+
+// out = a * b with the classical algorithm (i-k-j order, vectorized over j)
+template<typename A>
+void classical(const View<A>& a, const View<A>& b, const View<A>& out) {
+    for (int i = 0; i < out.rows; i++) {
+        A* __restrict ro = out.row(i);
+        std::fill(ro, ro + out.cols, A(0));
+        const A* ra = a.row(i);
+        for (int k = 0; k < a.cols; k++) {
+            const A aik = ra[k];
+            const A* __restrict rb = b.row(k);
+            for (int j = 0; j < out.cols; j++) {
+                ro[j] += aik * rb[j];
+            }
+        }
+    }
+}
+
+/*
+ * out = a * b
+ * Products whose smallest dimension is at most crossover use the classical
+ * kernel. Odd dimensions are padded with a zero row / column. The seven
+ * sub-products of the first levels run as parallel tasks.
+ */
+template<typename A>
+void multiply(const View<A>& a, const View<A>& b, const View<A>& out, int crossover, int taskDepth) {
+    int m = a.rows;
+    int k = a.cols;
+    int n = b.cols;
+    if (std::min(m, std::min(k, n)) <= crossover) {
+        classical(a, b, out);
+        return;
+    }
+
+    if ((m | k | n) & 1) {
+        int pm = m + (m & 1);
+        int pk = k + (k & 1);
+        int pn = n + (n & 1);
+        Buffer<A> pa(pm, pk);
+        Buffer<A> pb(pk, pn);
+        Buffer<A> pc(pm, pn);
+        copy(a, pa.view);
+        copy(b, pb.view);
+        multiply(pa.view, pb.view, pc.view, crossover, taskDepth);
+        copy(pc.view.block(0, 0, m, n), out);
+        return;
+    }
+
+    int hm = m / 2;
+    int hk = k / 2;
+    int hn = n / 2;
+    View<A> a11 = a.block(0, 0, hm, hk), a12 = a.block(0, hk, hm, hk);
+    View<A> a21 = a.block(hm, 0, hm, hk), a22 = a.block(hm, hk, hm, hk);
+    View<A> b11 = b.block(0, 0, hk, hn), b12 = b.block(0, hn, hk, hn);
+    View<A> b21 = b.block(hk, 0, hk, hn), b22 = b.block(hk, hn, hk, hn);
+    View<A> c11 = out.block(0, 0, hm, hn), c12 = out.block(0, hn, hm, hn);
+    View<A> c21 = out.block(hm, 0, hm, hn), c22 = out.block(hm, hn, hm, hn);
+
+    // Winograd form: 7 products and 15 additions
+    Buffer<A> s1(hm, hk), s2(hm, hk), s3(hm, hk), s4(hm, hk);
+    Buffer<A> t1(hk, hn), t2(hk, hn), t3(hk, hn), t4(hk, hn);
+    add(a21, a22, s1.view);
+    subtract(s1.view, a11, s2.view);
+    subtract(a11, a21, s3.view);
+    subtract(a12, s2.view, s4.view);
+    subtract(b12, b11, t1.view);
+    subtract(b22, t1.view, t2.view);
+    subtract(b22, b12, t3.view);
+    subtract(t2.view, b21, t4.view);
+
+    Buffer<A> p1(hm, hn), p2(hm, hn), p3(hm, hn), p4(hm, hn), p5(hm, hn), p6(hm, hn), p7(hm, hn);
+    const View<A>* lhs[7] = {&a11, &a12, &s4.view, &a22, &s1.view, &s2.view, &s3.view};
+    const View<A>* rhs[7] = {&b11, &b21, &b22, &t4.view, &t1.view, &t2.view, &t3.view};
+    const View<A>* products[7] = {&p1.view, &p2.view, &p3.view, &p4.view, &p5.view, &p6.view, &p7.view};
+    for (int p = 0; p < 7; p++) {
+        #pragma omp task if(taskDepth > 0) default(shared) firstprivate(p)
+        multiply(*lhs[p], *rhs[p], *products[p], crossover, taskDepth - 1);
+    }
+    #pragma omp taskwait
+
+    // u2 = p1 + p6, u3 = u2 + p7, u4 = u2 + p5
+    add(p1.view, p2.view, c11);
+    add(p1.view, p6.view, p6.view);
+    add(p6.view, p7.view, p7.view);
+    add(p6.view, p5.view, p6.view);
+    add(p6.view, p3.view, c12);
+    subtract(p7.view, p4.view, c21);
+    add(p7.view, p5.view, c22);
+}
+
+} // namespace strassen
+
+
+#endif // STRASSEN_H
@@ -0,0 +1,166 @@
+//
+// Summation policies used by the Matrix reductions (sum, cumuSum, dot).
+//
+
+#include <cmath>
+#include <complex>
+#include <cstdlib>
+#include <cstddef>
+#include <type_traits>
+
+#include "half.h"
+
+#ifndef SUMMATION_H
+#define SUMMATION_H
+
+/*
+ * Summation policy
+ * Naive    : accumulate in Accumulator<T>, fastest, error grows in O(n)
+ * Pairwise : recursive halving over blocks, error grows in O(log n)
+ * Kahan    : compensated (Kahan-Neumaier) summation, error independent of n
+ * Widened  : accumulate in a wider type (float -> double)
+ * Every policy keeps several independent accumulators so the inner loops
+ * can be vectorized. Do not compile with -ffast-math, it removes the
+ * compensation of the Kahan policy.
+ */
+
+enum class Summation { Naive, Pairwise, Kahan, Widened };
+
+template<typename T> struct Widened { using type = typename Accumulator<T>::type; };
+template<> struct Widened<float> { using type = double; };
+#if defined(MATRIX_HAS_FLOAT16)
+template<> struct Widened<float16> { using type = double; };
+#endif
+template<> struct Widened<bfloat16> { using type = double; };
+template<> struct Widened<std::complex<float>> { using type = std::complex<double>; };
+
+// Integer reductions run in an unsigned type and are converted back, so they
+// wrap around modulo 2^bits instead of overflowing (undefined for signed
+// types). It is at least unsigned int: narrower operands would be promoted
+// to int before a multiplication.
+template<typename T, bool = std::is_integral<T>::value> struct Modular { using type = T; };
+template<typename T> struct Modular<T, true> { using type = decltype(std::make_unsigned_t<T>() + 0u); };
+
+
+namespace summation {
+
+// Number of independent accumulators in the inner loops
+constexpr std::size_t LANES = 8;
+// Below this size the pairwise policy sums sequentially
+constexpr std::size_t PAIRWISE_BLOCK = 128;
+
+// Compensated step on a (sum, compensation) pair. TwoSum gives the exact
+// rounding error of sum + x like Neumaier's algorithm, but without a branch
+template<typename A>
+inline void compensatedAdd(A& sum, A& comp, A x) {
+    A t = sum + x;
+    A v = t - sum;
+    comp += (sum - (t - v)) + (x - v);
+    sum = t;
+}
+
+// Sum of f(i) for i in [0, n), f returns the value to add in type A
+template<typename A, typename F>
+inline A naiveSum(std::size_t n, F f) {
+    A acc[LANES] = {};
+    std::size_t i = 0;
+    for (; i + LANES <= n; i += LANES) {
+        for (std::size_t l = 0; l < LANES; ++l) {
+            acc[l] += f(i + l);
+        }
+    }
+    for (; i < n; ++i) {
+        acc[0] += f(i);
+    }
+    A total = 0;
+    for (std::size_t l = 0; l < LANES; ++l) {
+        total += acc[l];
+    }
+    return total;
+}
+
+template<typename A, typename F>
+inline A pairwiseSum(std::size_t begin, std::size_t n, F f) {
+    if (n <= PAIRWISE_BLOCK) {
+        return naiveSum<A>(n, [&](std::size_t i) { return f(begin + i); });
+    }
+    std::size_t half = (n / 2 + LANES - 1) / LANES * LANES;
+    return pairwiseSum<A>(begin, half, f) + pairwiseSum<A>(begin + half, n - half, f);
+}
+
+template<typename A, typename F>
+inline A kahanSum(std::size_t n, F f) {
+    A sum[LANES] = {};
+    A comp[LANES] = {};
+    std::size_t i = 0;
+    for (; i + LANES <= n; i += LANES) {
+        for (std::size_t l = 0; l < LANES; ++l) {
+            compensatedAdd(sum[l], comp[l], f(i + l));
+        }
+    }
+    for (; i < n; ++i) {
+        compensatedAdd(sum[0], comp[0], f(i));
+    }
+    A total = 0;
+    A totalComp = 0;
+    for (std::size_t l = 0; l < LANES; ++l) {
+        compensatedAdd(total, totalComp, sum[l]);
+        totalComp += comp[l];
+    }
+    return total + totalComp;
+}
+
+} // namespace summation
+
+
+/*
+ * Reduce n values with the given policy
+ * f(i) returns the i-th value; the result is in the widened type so that
+ * partial sums (e.g. per row) can be combined without losing precision.
+ */
+
+template<typename T, typename F>
+typename Widened<T>::type reduce(std::size_t n, Summation mode, F f) {
+    using Acc = typename Accumulator<T>::type;
+    using Wide = typename Widened<T>::type;
+    // Integer sums are exact in any order, every policy is the naive one
+    if constexpr (std::is_integral<Acc>::value) {
+        using U = typename Modular<Wide>::type;
+        return static_cast<Wide>(summation::naiveSum<U>(n, [&](std::size_t i) { return static_cast<U>(f(i)); }));
+    }
+    switch (mode) {
+        case Summation::Pairwise:
+            return summation::pairwiseSum<Acc>(0, n, [&](std::size_t i) { return static_cast<Acc>(f(i)); });
+        case Summation::Kahan:
+            return summation::kahanSum<Acc>(n, [&](std::size_t i) { return static_cast<Acc>(f(i)); });
+        case Summation::Widened:
+            return summation::naiveSum<Wide>(n, [&](std::size_t i) { return static_cast<Wide>(f(i)); });
+        case Summation::Naive:
+        default:
+            return summation::naiveSum<Acc>(n, [&](std::size_t i) { return static_cast<Acc>(f(i)); });
+    }
+}
+
+// Sum of the n elements pointed by data
+template<typename T>
+typename Widened<T>::type reduceSum(const T* data, std::size_t n, Summation mode) {
+    return reduce<T>(n, mode, [data](std::size_t i) { return data[i]; });
+}
+
+// Inner product of the n elements pointed by a and b
+template<typename T>
+typename Widened<T>::type reduceDot(const T* a, const T* b, std::size_t n, Summation mode) {
+    using Acc = typename Accumulator<T>::type;
+    if constexpr (std::is_integral<Acc>::value) {
+        using U = typename Modular<Acc>::type;
+        return reduce<T>(n, mode, [a, b](std::size_t i) { return static_cast<U>(a[i]) * static_cast<U>(b[i]); });
+    }
+    if (mode == Summation::Widened) {
+        using Wide = typename Widened<T>::type;
+        return reduce<T>(n, mode, [a, b](std::size_t i) { return static_cast<Wide>(a[i]) * static_cast<Wide>(b[i]); });
+    }
+    return reduce<T>(n, mode, [a, b](std::size_t i) { return static_cast<Acc>(a[i]) * static_cast<Acc>(b[i]); });
+}
+
+
+#endif // SUMMATION_H
@@ -0,0 +1,113 @@
+#include "gtest/gtest.h"
+#include "../accumulation.h"
+
+#include <random>
+#include <thread>
+
+TEST(AccumulationTest, AtomicAccumulate) {
+    Matrix<int> counts(4, 5);
+    Matrix<double> weights(4, 5);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&counts, &weights, t]() {
+            for (int k = 0; k < 20000; k++) {
+                counts.accumulate(k % 4, (k + t) % 5, 1);
+                weights.accumulate(k % 4, (k + t) % 5, 0.5);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(counts.sum(), 80000);
+    EXPECT_EQ(weights.sum(), 40000.0);
+    for (int j = 0; j < 5; j++) {
+        EXPECT_EQ(counts.sum(1)[j], 16000);
+    }
+}
+
+// A live copy: accumulate throws until the matrix is detached, then leaves the copy untouched
+TEST(AccumulationTest, AtomicAccumulateWithCopy) {
+    Matrix<int> counts(4, 5, 1);
+    Matrix<int> snapshot = counts;
+    EXPECT_THROW(counts.accumulate(0, 0, 1), std::logic_error);
+    counts.detach();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; t++) {
+        threads.emplace_back([&counts, t]() {
+            for (int k = 0; k < 10000; k++) {
+                counts.accumulate(k % 4, (k + t) % 5, 1);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(counts.sum(), 20 + 80000);
+    EXPECT_TRUE(snapshot == Matrix<int>(4, 5, 1));
+}
+
+TEST(AccumulationTest, ShardedAccumulator) {
+    const int rows = 300;
+    const int cols = 7;
+    // 6 threads on 4 shards: shards 0 and 1 are shared by two threads
+    ShardedAccumulator<double> accumulator(rows, cols, 6, 4);
+    EXPECT_EQ(accumulator.shardCount(), 4);
+    EXPECT_THROW(accumulator.shard(6), std::out_of_range);
+
+    Matrix<double> expected(rows, cols);
+    for (int t = 0; t < 6; t++) {
+        for (int k = 0; k < 1000; k++) {
+            expected(k % 50 + 50 * t, (k * 3 + t) % cols) += 0.25 * (t + 1);
+        }
+    }
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 6; t++) {
+        threads.emplace_back([&accumulator, t]() {
+            ShardedAccumulator<double>::Shard& shard = accumulator.shard(t);
+            for (int k = 0; k < 1000; k++) {
+                shard.add(k % 50 + 50 * t, (k * 3 + t) % cols, 0.25 * (t + 1));
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    // Only the touched blocks of 64 rows are allocated
+    EXPECT_LT(accumulator.allocatedBlocks(), static_cast<std::size_t>(4 * 5));
+
+    Matrix<double> merged = accumulator.merge();
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++) {
+            ASSERT_EQ(merged(i, j), expected(i, j));
+        }
+    }
+    EXPECT_EQ(accumulator.allocatedBlocks(), 0u);
+    EXPECT_EQ(accumulator.merge().sum(), 0.0);
+}
+
+TEST(AccumulationTest, ScatterAdd) {
+    std::mt19937 gen(3);
+    std::uniform_int_distribution<int> row(0, 39);
+    std::uniform_int_distribution<int> col(0, 24);
+    std::vector<int> rows(5000);
+    std::vector<int> cols(5000);
+    std::vector<int> values(5000);
+    Matrix<int> m(40, 25, 1);
+    Matrix<int> expected(40, 25, 1);
+    for (int k = 0; k < 5000; k++) {
+        rows[k] = row(gen);
+        cols[k] = col(gen);
+        values[k] = k % 7 - 3;
+        expected(rows[k], cols[k]) += values[k];
+    }
+    Matrix<int> snapshot = m;
+    scatterAdd(m, rows, cols, values);
+    EXPECT_TRUE(m == expected);
+    EXPECT_EQ(snapshot.sum(), 1000);
+
+    rows[10] = 40;
+    EXPECT_THROW(scatterAdd(m, rows, cols, values), std::out_of_range);
+    values.pop_back();
+    EXPECT_THROW(scatterAdd(m, rows, cols, values), std::invalid_argument);
+}
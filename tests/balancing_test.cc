@@ -0,0 +1,98 @@
+#include "gtest/gtest.h"
+#include "../balancing.h"
+
+#include <cmath>
+
+// Symmetric positive matrix with a decaying diagonal profile and uneven bin coverage
+static Matrix<double> contactMatrix(int n) {
+    Matrix<double> m(n, n);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j <= i; j++) {
+            double value = (1 + (i % 7) + (j % 5)) * (1 + (i * j) % 3) / (1.0 + i - j);
+            m(i, j) = value;
+            m(j, i) = value;
+        }
+    }
+    return m;
+}
+
+static void expectBias(const Matrix<double>& raw, const Matrix<double>& balanced, const BalanceResult& result) {
+    int n = raw.getHeight();
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            if (!result.masked[i] && !result.masked[j]) {
+                EXPECT_NEAR(balanced(i, j), raw(i, j) / (result.bias[i] * result.bias[j]), 1e-9 * raw(i, j));
+            }
+        }
+    }
+}
+
+TEST(BalancingTest, ICEEqualizesRowSums) {
+    Matrix<double> raw = contactMatrix(60);
+    Matrix<double> m = raw.duplicate();
+    BalanceOptions options;
+    options.tolerance = 1e-8;
+    BalanceResult result = balanceICE(m, options);
+
+    EXPECT_TRUE(result.converged);
+    EXPECT_EQ(result.residuals.size(), static_cast<std::size_t>(result.iterations) + 1);
+    EXPECT_LT(result.residuals.back(), result.residuals.front());
+    std::vector<double> sums = m.sum(0);
+    for (int i = 1; i < 60; i++) {
+        EXPECT_NEAR(sums[i], sums[0], 1e-6 * sums[0]);
+    }
+    expectBias(raw, m, result);
+}
+
+TEST(BalancingTest, KRGivesUnitRowSums) {
+    Matrix<double> raw = contactMatrix(80);
+    Matrix<double> m = raw.duplicate();
+    BalanceResult result = balanceKR(m);
+
+    EXPECT_TRUE(result.converged);
+    EXPECT_LT(result.iterations, 50);
+    EXPECT_LT(result.residuals.back(), 1e-5);
+    for (double s : m.sum(0)) {
+        EXPECT_NEAR(s, 1.0, 1e-5);
+    }
+    expectBias(raw, m, result);
+}
+
+TEST(BalancingTest, Masking) {
+    Matrix<double> raw = contactMatrix(40);
+    // Bin 5 is empty, bin 7 is masked by the caller
+    for (int j = 0; j < 40; j++) {
+        raw(5, j) = raw(j, 5) = 0;
+    }
+    BalanceOptions options;
+    options.mask.assign(40, false);
+    options.mask[7] = true;
+    options.ignoreDiagonals = 1;
+
+    for (bool kr : {false, true}) {
+        Matrix<double> m = raw.duplicate();
+        BalanceResult result = kr ? balanceKR(m, options) : balanceICE(m, options);
+        EXPECT_TRUE(result.converged);
+        EXPECT_TRUE(result.masked[5]);
+        EXPECT_TRUE(result.masked[7]);
+        EXPECT_TRUE(std::isnan(result.bias[7]));
+        std::vector<double> sums = m.sum(0);
+        EXPECT_EQ(sums[7], 0);
+        EXPECT_EQ(m(3, 3), 0);
+        EXPECT_EQ(m(3, 7), 0);
+        for (int i = 0; i < 40; i++) {
+            if (!result.masked[i]) {
+                EXPECT_NEAR(sums[i], kr ? 1.0 : sums[0], 1e-4 * sums[0]);
+            }
+        }
+    }
+
+    Matrix<double> m = raw.duplicate();
+    options.minNonZero = 40;
+    EXPECT_TRUE(balanceICE(m, options).masked[0]);
+
+    Matrix<double> rectangle(3, 4, 1.0);
+    EXPECT_THROW(balanceKR(rectangle), std::invalid_argument);
+    options.mask.assign(3, false);
+    EXPECT_THROW(balanceICE(m, options), std::invalid_argument);
+}
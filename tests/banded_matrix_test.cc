@@ -0,0 +1,94 @@
+#include "gtest/gtest.h"
+#include "../banded_matrix.h"
+
+#include <vector>
+
+static Matrix<double> bandedInput(int n, int lower, int upper) {
+    Matrix<double> m(n, n, 0.0);
+    for (int i = 0; i < n; i++) {
+        for (int j = std::max(0, i - lower); j <= std::min(n - 1, i + upper); j++) {
+            m(i, j) = 1 + (i * 5 + j * 3) % 7;
+        }
+    }
+    return m;
+}
+
+TEST(BandedMatrixTest, ConstructorAndAccess) {
+    BandedMatrix<int> b(5, 1, 2, 3);
+    EXPECT_EQ(b.getShape(), std::make_pair(5, 5));
+    EXPECT_EQ(b.diagonal(0).size(), 5u);
+    EXPECT_EQ(b.diagonal(2).size(), 3u);
+    EXPECT_EQ(b.diagonal(-1).size(), 4u);
+    EXPECT_THROW(b.diagonal(3), std::out_of_range);
+
+    b(3, 2) = 7;
+    EXPECT_EQ(b.diagonal(-1)[2], 7);
+    const BandedMatrix<int>& cb = b;
+    EXPECT_EQ(cb(4, 0), 0);
+    EXPECT_THROW(b(4, 0) = 1, std::out_of_range);
+    EXPECT_EQ(b.sum(), 3 * 16 + 4);
+
+    BandedMatrix<int> wide(3, 10, 10);
+    EXPECT_EQ(wide.getLower(), 2);
+    EXPECT_THROW(BandedMatrix<int>(3, -1, 0), std::invalid_argument);
+}
+
+TEST(BandedMatrixTest, DenseConversion) {
+    Matrix<double> m = bandedInput(8, 2, 3);
+    BandedMatrix<double> b(m, 2, 3);
+    EXPECT_TRUE(b.toMatrix() == m);
+    EXPECT_EQ(b.diagonal(1), m.diagonal(1));
+    EXPECT_EQ(b.diagonal(-2), m.diagonal(-2));
+    EXPECT_DOUBLE_EQ(b.sum(), m.sum());
+}
+
+TEST(BandedMatrixTest, Products) {
+    Matrix<double> m = bandedInput(11, 3, 1);
+    BandedMatrix<double> b(m, 3, 1);
+    std::vector<double> v(11);
+    Matrix<double> column(11, 1);
+    for (int i = 0; i < 11; i++) {
+        v[i] = column(i, 0) = i - 4;
+    }
+    std::vector<double> y = b.dot(v);
+    Matrix<double> expected = m.dot(column);
+    for (int i = 0; i < 11; i++) {
+        EXPECT_DOUBLE_EQ(y[i], expected(i, 0));
+    }
+
+    Matrix<double> other = bandedInput(11, 10, 10);
+    EXPECT_TRUE(b.dot(other) == m.dot(other));
+}
+
+TEST(BandedMatrixTest, DiagonalReductions) {
+    Matrix<double> m = bandedInput(6, 1, 2);
+    BandedMatrix<double> b(m, 1, 2);
+    std::vector<double> sums = b.diagonalSum();
+    std::vector<double> means = b.diagonalMean();
+    ASSERT_EQ(sums.size(), 4u);
+    for (int d = -1; d <= 2; d++) {
+        std::vector<double> diag = m.diagonal(d);
+        double total = 0;
+        for (double x : diag) {
+            total += x;
+        }
+        EXPECT_DOUBLE_EQ(sums[d + 1], total);
+        EXPECT_DOUBLE_EQ(means[d + 1], total / diag.size());
+    }
+
+    BandedMatrix<double> scan = b.cumuSumDiagonal();
+    EXPECT_DOUBLE_EQ(scan.diagonal(1)[0], m(0, 1));
+    EXPECT_DOUBLE_EQ(scan.diagonal(1)[2], m(0, 1) + m(1, 2) + m(2, 3));
+}
+
+TEST(BandedMatrixTest, Proto) {
+    BandedMatrix<double> b(bandedInput(7, 2, 1), 2, 1);
+    std::string path = testing::TempDir() + "banded.pb";
+    b.dumpToProto(path);
+
+    BandedMatrix<double> loaded = BandedMatrix<double>::loadFromProto(path);
+    EXPECT_EQ(loaded.getLower(), 2);
+    EXPECT_EQ(loaded.getUpper(), 1);
+    EXPECT_TRUE(loaded.toMatrix() == b.toMatrix());
+    EXPECT_TRUE(Matrix<double>::loadFromProto(path) == b.toMatrix());
+}
@@ -0,0 +1,127 @@
+#include "gtest/gtest.h"
+#include "../decomposition.h"
+
+#include <cmath>
+#include <random>
+
+static Matrix<double> randomSymmetric(int n, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    Matrix<double> m(n, n);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j <= i; j++) {
+            m(i, j) = m(j, i) = dist(gen);
+        }
+    }
+    return m;
+}
+
+// Symmetric matrix with eigenvalues 100, 50, 25 and a small random remainder
+static Matrix<double> dominantSymmetric(int n) {
+    Matrix<double> m = randomSymmetric(n, 3);
+    m *= 0.01;
+    const double values[3] = {100, 50, 25};
+    for (int c = 0; c < 3; c++) {
+        std::vector<double> x(n);
+        double norm = 0;
+        for (int i = 0; i < n; i++) {
+            x[i] = std::sin(0.1 * (c + 1) * i + c);
+            norm += x[i] * x[i];
+        }
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) {
+                m(i, j) += values[c] * x[i] * x[j] / norm;
+            }
+        }
+    }
+    return m;
+}
+
+static void expectEigenpairs(const Matrix<double>& m, const EigenDecomposition<double>& eig, double tolerance) {
+    int n = m.getHeight();
+    for (int k = 0; k < static_cast<int>(eig.values.size()); k++) {
+        std::vector<double> mv = m.dot(eig.vectors(k));
+        for (int i = 0; i < n; i++) {
+            EXPECT_NEAR(mv[i], eig.values[k] * eig.vectors(k, i), tolerance);
+        }
+        double norm = 0;
+        for (int i = 0; i < n; i++) {
+            norm += eig.vectors(k, i) * eig.vectors(k, i);
+        }
+        EXPECT_NEAR(norm, 1.0, 1e-9);
+    }
+}
+
+TEST(DecompositionTest, FullSymmetric) {
+    Matrix<double> small(std::vector<std::vector<double>>{{2, 1}, {1, 2}});
+    EigenDecomposition<double> eig = eigh(small);
+    EXPECT_NEAR(eig.values[0], 3, 1e-12);
+    EXPECT_NEAR(eig.values[1], 1, 1e-12);
+    EXPECT_NEAR(std::abs(eig.vectors(0, 0)), std::sqrt(0.5), 1e-12);
+
+    Matrix<double> m = randomSymmetric(70, 1);
+    eig = eigh(m);
+    ASSERT_EQ(eig.values.size(), 70u);
+    EXPECT_TRUE(std::is_sorted(eig.values.rbegin(), eig.values.rend()));
+    expectEigenpairs(m, eig, 1e-9);
+    double trace = 0;
+    double total = 0;
+    for (int i = 0; i < 70; i++) {
+        trace += m(i, i);
+        total += eig.values[i];
+    }
+    EXPECT_NEAR(trace, total, 1e-9);
+
+    EXPECT_THROW(eigh(Matrix<double>(2, 3)), std::invalid_argument);
+}
+
+TEST(DecompositionTest, Lanczos) {
+    Matrix<double> m = randomSymmetric(150, 2);
+    EigenDecomposition<double> full = eigh(m);
+    EigenDecomposition<double> top = lanczos(m, 3, 1e-10, 150);
+    ASSERT_EQ(top.values.size(), 3u);
+    for (int k = 0; k < 3; k++) {
+        EXPECT_NEAR(top.values[k], full.values[k], 1e-8);
+    }
+    expectEigenpairs(m, top, 1e-6);
+
+    Matrix<double> dominant = dominantSymmetric(300);
+    top = lanczos(dominant, 3);
+    EXPECT_NEAR(top.values[0], 100, 0.5);
+    EXPECT_NEAR(top.values[2], 25, 0.5);
+    expectEigenpairs(dominant, top, 1e-5);
+
+    Matrix<float> single = dominant.astype<float>();
+    EigenDecomposition<float> topFloat = lanczos(single, 2);
+    EXPECT_NEAR(topFloat.values[0], top.values[0], 1e-3);
+    EXPECT_THROW(lanczos(m, 0), std::invalid_argument);
+}
+
+TEST(DecompositionTest, Randomized) {
+    Matrix<double> m = dominantSymmetric(300);
+    EigenDecomposition<double> full = eigh(m);
+    EigenDecomposition<double> top = randomizedEigh(m, 3);
+    for (int k = 0; k < 3; k++) {
+        EXPECT_NEAR(top.values[k], full.values[k], 1e-6);
+    }
+    expectEigenpairs(m, top, 1e-4);
+
+    // Rank 2 rectangular matrix: the SVD reconstructs it
+    int rows = 120, cols = 80;
+    Matrix<double> r(rows, cols);
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++) {
+            r(i, j) = 3 * std::cos(0.05 * i) * std::sin(0.1 * j + 1) + 0.5 * std::sin(0.07 * i) * std::cos(0.02 * j);
+        }
+    }
+    SingularValueDecomposition<double> svd = randomizedSvd(r, 2);
+    ASSERT_EQ(svd.s.size(), 2u);
+    EXPECT_GT(svd.s[0], svd.s[1]);
+    for (int i = 0; i < rows; i += 7) {
+        for (int j = 0; j < cols; j += 5) {
+            double value = svd.s[0] * svd.u(0, i) * svd.v(0, j) + svd.s[1] * svd.u(1, i) * svd.v(1, j);
+            EXPECT_NEAR(value, r(i, j), 1e-9);
+        }
+    }
+    EXPECT_THROW(randomizedSvd(r, 81), std::invalid_argument);
+}
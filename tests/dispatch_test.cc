@@ -0,0 +1,190 @@
+#include "gtest/gtest.h"
+#include "../dispatch.h"
+#include "../elementwise.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+// Results of the dispatched kernels under the active instruction set
+template<typename T>
+struct Results {
+    Matrix<T> product;
+    Matrix<T> transposed;
+    Matrix<T> exp;
+    Matrix<T> log;
+    Matrix<T> arithmetic;
+    Matrix<T> compound;
+    std::vector<T> gemv;
+    std::vector<T> gemvTransposed;
+    Matrix<T> cumuRows;
+    Matrix<T> cumuCols;
+    T sum;
+    T kahan;
+    std::vector<T> rowSums;
+    std::vector<T> colSums;
+    std::vector<T> rowMax;
+    std::vector<T> colMin;
+    T max;
+};
+
+template<typename T>
+static Results<T> compute(const Matrix<T>& a, const Matrix<T>& b) {
+    Results<T> r;
+    r.product = a.dot(b);
+    r.transposed = a.transpose();
+    r.exp = elementwise::exp(a);
+    r.log = elementwise::log(elementwise::abs(a));
+    std::vector<T> scale(a.getWidth());
+    for (int j = 0; j < a.getWidth(); j++) {
+        scale[j] = static_cast<T>(1 + j % 7);
+    }
+    Matrix<T> c = a.multiply(static_cast<T>(3));
+    Matrix<T> d = c.add(Matrix<T>(a.getHeight(), a.getWidth(), static_cast<T>(1000)));
+    r.arithmetic = a.add(c).subtract(a.divide(static_cast<T>(7))).multiply(c).divide(d).multiply(scale).divide(scale);
+    r.compound = a;
+    r.compound += c;
+    r.compound -= a;
+    r.compound *= c;
+    r.compound /= static_cast<T>(3);
+    r.compound *= scale;
+    r.compound /= scale;
+    r.compound *= static_cast<T>(2);
+    r.compound /= d;
+    r.gemv = a.dot(b.sum(0));
+    r.gemvTransposed = a.dotTransposed(a.sum(0), Summation::Kahan);
+    r.cumuRows = a.cumuSum(1, Summation::Kahan);
+    r.cumuCols = a.cumuSum(0);
+    r.sum = a.sum();
+    r.kahan = a.sum(Summation::Kahan);
+    r.rowSums = a.sum(0, Summation::Pairwise);
+    r.colSums = a.sum(1);
+    r.rowMax = a.max(0);
+    r.colMin = a.min(1);
+    r.max = a.max();
+    return r;
+}
+
+template<typename T>
+static void checkVariants() {
+    std::mt19937 gen(3);
+    std::normal_distribution<double> dist(0, 4);
+    Matrix<T> a(77, 301);
+    Matrix<T> b(301, 45);
+    for (int i = 0; i < 77; i++) {
+        for (int j = 0; j < 301; j++) {
+            a(i, j) = static_cast<T>(dist(gen));
+            b(j, i % 45) += static_cast<T>(dist(gen));
+        }
+    }
+
+    dispatch::Isa initial = dispatch::active();
+    dispatch::force(dispatch::Isa::Generic);
+    Results<T> expected = compute(a, b);
+    // The double exp and log of the generic variant may call the C library
+    // (elementwise.h): the variants running the kernels are compared together
+    const bool expectedKernels = elementwise::doubleKernels();
+    std::vector<Matrix<T>> kernelResults;
+    for (int i = 0; i < dispatch::ISA_COUNT; i++) {
+        dispatch::Isa isa = static_cast<dispatch::Isa>(i);
+        // Variants the CPU cannot run are left out
+        if (!dispatch::supported(isa)) {
+            continue;
+        }
+        SCOPED_TRACE(dispatch::name(isa));
+        dispatch::force(isa);
+        EXPECT_EQ(dispatch::active(), isa);
+        Results<T> got = compute(a, b);
+        EXPECT_TRUE(got.product == expected.product);
+        EXPECT_TRUE(got.transposed == expected.transposed);
+        if (elementwise::doubleKernels() == expectedKernels) {
+            EXPECT_TRUE(got.exp == expected.exp);
+            EXPECT_TRUE(got.log == expected.log);
+        } else {
+            for (int r = 0; r < a.getHeight(); r++) {
+                for (int c = 0; c < a.getWidth(); c++) {
+                    ASSERT_NEAR(got.exp(r, c), expected.exp(r, c), 1e-15 * std::abs(expected.exp(r, c)));
+                    ASSERT_NEAR(got.log(r, c), expected.log(r, c), 1e-15 * std::abs(expected.log(r, c)));
+                }
+            }
+            if (kernelResults.empty()) {
+                kernelResults = {got.exp, got.log};
+            }
+            EXPECT_TRUE(got.exp == kernelResults[0]);
+            EXPECT_TRUE(got.log == kernelResults[1]);
+        }
+        EXPECT_TRUE(got.arithmetic == expected.arithmetic);
+        EXPECT_TRUE(got.compound == expected.compound);
+        EXPECT_EQ(got.gemv, expected.gemv);
+        EXPECT_EQ(got.gemvTransposed, expected.gemvTransposed);
+        EXPECT_TRUE(got.cumuRows == expected.cumuRows);
+        EXPECT_TRUE(got.cumuCols == expected.cumuCols);
+        EXPECT_EQ(got.sum, expected.sum);
+        EXPECT_EQ(got.kahan, expected.kahan);
+        EXPECT_EQ(got.rowSums, expected.rowSums);
+        EXPECT_EQ(got.colSums, expected.colSums);
+        EXPECT_EQ(got.rowMax, expected.rowMax);
+        EXPECT_EQ(got.colMin, expected.colMin);
+        EXPECT_EQ(got.max, expected.max);
+    }
+    dispatch::force(initial);
+}
+
+#if defined(MATRIX_HAS_FLOAT16)
+// The F16C and AVX-512 conversions round like the scalar one
+TEST(DispatchTest, HalfConversionsAgree) {
+    std::mt19937 gen(5);
+    std::uniform_real_distribution<float> dist(-70000.0f, 70000.0f);
+    // Ties, subnormals, overflow and signed zero, then random values
+    Matrix<float> m(3, 45);
+    const float special[] = {1.0f + 1.0f / 2048, 1.0f + 3.0f / 2048, 6.0e-8f, 3.0e-8f, -1.0e-5f, 65520.0f, -65519.0f, -0.0f};
+    for (int i = 0; i < m.getHeight(); i++) {
+        for (int j = 0; j < m.getWidth(); j++) {
+            m(i, j) = j < 8 ? special[j] : dist(gen) / static_cast<float>(1 << (j % 24));
+        }
+    }
+
+    dispatch::Isa initial = dispatch::active();
+    dispatch::force(dispatch::Isa::Generic);
+    Matrix<float16> expected = m.astype<float16>();
+    Matrix<float> back = expected.astype<float>();
+    EXPECT_EQ(back(0, 0), 1.0f);
+    EXPECT_EQ(back(0, 1), 1.0f + 4.0f / 2048);
+    EXPECT_TRUE(std::isinf(back(0, 5)));
+    EXPECT_TRUE(std::signbit(back(0, 7)));
+    for (int i = 1; i < dispatch::ISA_COUNT; i++) {
+        dispatch::Isa isa = static_cast<dispatch::Isa>(i);
+        if (!dispatch::supported(isa)) {
+            continue;
+        }
+        SCOPED_TRACE(dispatch::name(isa));
+        dispatch::force(isa);
+        Matrix<float16> got = m.astype<float16>();
+        for (int r = 0; r < m.getHeight(); r++) {
+            for (int c = 0; c < m.getWidth(); c++) {
+                uint16_t a, b;
+                std::memcpy(&a, &got(r, c), 2);
+                std::memcpy(&b, &expected(r, c), 2);
+                ASSERT_EQ(a, b) << m(r, c);
+            }
+        }
+        EXPECT_TRUE(got.astype<float>() == back);
+    }
+    dispatch::force(initial);
+}
+#endif
+
+TEST(DispatchTest, VariantsAgree) {
+    if (std::getenv("MATRIX_ISA") == nullptr) {
+        EXPECT_EQ(dispatch::detect(), dispatch::active());
+    }
+    EXPECT_TRUE(dispatch::supported(dispatch::Isa::Generic));
+    checkVariants<float>();
+    checkVariants<double>();
+    for (int i = 0; i < dispatch::ISA_COUNT; i++) {
+        if (!dispatch::supported(static_cast<dispatch::Isa>(i))) {
+            EXPECT_THROW(dispatch::force(static_cast<dispatch::Isa>(i)), std::invalid_argument);
+        }
+    }
+}
@@ -0,0 +1,138 @@
+#include "gtest/gtest.h"
+#include "../distributed_matrix.h"
+
+#include <cmath>
+#include <random>
+
+// Run with mpiexec, every rank runs every test
+int main(int argc, char** argv) {
+    MPI_Init(&argc, &argv);
+    testing::InitGoogleTest(&argc, argv);
+    int rank = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if (rank != 0) {
+        testing::TestEventListeners& listeners = testing::UnitTest::GetInstance()->listeners();
+        delete listeners.Release(listeners.default_result_printer());
+    }
+    int result = RUN_ALL_TESTS();
+    MPI_Allreduce(MPI_IN_PLACE, &result, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    MPI_Finalize();
+    return result;
+}
+
+template<typename T>
+static Matrix<T> randomMatrix(int rows, int cols, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> dist(-1, 1);
+    Matrix<T> m(rows, cols);
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++) {
+            m(i, j) = static_cast<T>(dist(gen));
+        }
+    }
+    return m;
+}
+
+// Every rank must agree, gathered results only exist on rank 0
+static Matrix<double> gathered(const DistributedMatrix<double>& m) {
+    Matrix<double> whole = m.gather(0);
+    if (m.getGrid().rank() != 0) {
+        whole = Matrix<double>(m.getHeight(), m.getWidth());
+    }
+    for (int i = 0; i < m.getHeight(); i++) {
+        MPI_Bcast(whole(i).data(), m.getWidth(), MPI_DOUBLE, 0, m.getGrid().comm());
+    }
+    return whole;
+}
+
+TEST(DistributedMatrixTest, LayoutAndGather) {
+    ProcessGrid grid = ProcessGrid::create();
+    int size = 0;
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    EXPECT_EQ(grid.getRows() * grid.getCols(), size);
+
+    Matrix<double> m = randomMatrix<double>(23, 17, 1);
+    DistributedMatrix<double> d = DistributedMatrix<double>::fromMatrix(grid, m, 4);
+    for (int li = 0; li < d.local().getHeight(); li++) {
+        for (int lj = 0; lj < d.local().getWidth(); lj++) {
+            ASSERT_EQ(d.local()(li, lj), m(d.globalRow(li), d.globalCol(lj)));
+        }
+    }
+    int elements = d.local().getHeight() * d.local().getWidth();
+    MPI_Allreduce(MPI_IN_PLACE, &elements, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+    EXPECT_EQ(elements, 23 * 17);
+    EXPECT_TRUE(gathered(d) == m);
+}
+
+TEST(DistributedMatrixTest, ElementwiseAndDot) {
+    ProcessGrid grid = ProcessGrid::create();
+    Matrix<double> a = randomMatrix<double>(30, 21, 2);
+    Matrix<double> b = randomMatrix<double>(21, 26, 3);
+    Matrix<double> c = randomMatrix<double>(30, 21, 4);
+    DistributedMatrix<double> da = DistributedMatrix<double>::fromMatrix(grid, a, 4);
+    DistributedMatrix<double> db = DistributedMatrix<double>::fromMatrix(grid, b, 4);
+    DistributedMatrix<double> dc = DistributedMatrix<double>::fromMatrix(grid, c, 4);
+
+    EXPECT_TRUE(gathered(da.add(dc)) == a.add(c));
+    EXPECT_TRUE(gathered(da.multiply(dc)) == a.multiply(c));
+    EXPECT_TRUE(gathered(da.multiply(2.0)) == a.multiply(2.0));
+
+    Matrix<double> product = gathered(da.dot(db));
+    Matrix<double> expected = a.dot(b);
+    ASSERT_EQ(product.getShape(), expected.getShape());
+    for (int i = 0; i < 30; i++) {
+        for (int j = 0; j < 26; j++) {
+            ASSERT_NEAR(product(i, j), expected(i, j), 1e-12);
+        }
+    }
+    EXPECT_THROW(da.dot(dc), std::invalid_argument);
+    EXPECT_THROW(da.add(db), std::invalid_argument);
+    DistributedMatrix<double> other = DistributedMatrix<double>::fromMatrix(grid, c, 5);
+    EXPECT_THROW(da.add(other), std::invalid_argument);
+}
+
+TEST(DistributedMatrixTest, Reductions) {
+    ProcessGrid grid = ProcessGrid::create();
+    Matrix<double> m = randomMatrix<double>(19, 13, 5);
+    m(7, 3) = NAN;
+    DistributedMatrix<double> d = DistributedMatrix<double>::fromMatrix(grid, m, 3);
+    for (int axis : {0, 1}) {
+        std::vector<double> sums = d.sum(axis);
+        std::vector<double> maxs = d.max(axis);
+        std::vector<double> mins = d.min(axis);
+        std::vector<double> expectedSums = m.sum(axis);
+        std::vector<double> expectedMaxs = m.max(axis);
+        std::vector<double> expectedMins = m.min(axis);
+        ASSERT_EQ(sums.size(), expectedSums.size());
+        for (std::size_t x = 0; x < sums.size(); x++) {
+            if (std::isnan(expectedSums[x])) {
+                EXPECT_TRUE(std::isnan(sums[x]));
+                EXPECT_TRUE(std::isnan(maxs[x]));
+                EXPECT_TRUE(std::isnan(mins[x]));
+                continue;
+            }
+            EXPECT_NEAR(sums[x], expectedSums[x], 1e-12);
+            EXPECT_EQ(maxs[x], expectedMaxs[x]);
+            EXPECT_EQ(mins[x], expectedMins[x]);
+        }
+    }
+    DistributedMatrix<int> ones(grid, 11, 9, 2, 1);
+    EXPECT_EQ(ones.sum(), 99);
+    EXPECT_THROW(d.sum(2), std::invalid_argument);
+    DistributedMatrix<double> empty(grid, 0, 4);
+    EXPECT_THROW(empty.max(0), std::out_of_range);
+}
+
+TEST(DistributedMatrixTest, WriteAndRead) {
+    ProcessGrid grid = ProcessGrid::create();
+    std::string path = testing::TempDir() + "distributed.bin";
+    Matrix<double> m = randomMatrix<double>(29, 18, 6);
+    DistributedMatrix<double>::fromMatrix(grid, m, 4).write(path);
+
+    // The file does not depend on the block size (nor on the grid)
+    DistributedMatrix<double> d = DistributedMatrix<double>::read(grid, path, 5);
+    EXPECT_EQ(d.getShape(), std::make_pair(29, 18));
+    EXPECT_TRUE(gathered(d) == m);
+    EXPECT_THROW(DistributedMatrix<float>::read(grid, path), std::runtime_error);
+    EXPECT_THROW(DistributedMatrix<double>::read(grid, testing::TempDir() + "missing.bin"), std::runtime_error);
+}
@@ -0,0 +1,165 @@
+#include "gtest/gtest.h"
+#include "../dispatch.h"
+#include "../elementwise.h"
+
+#include <cmath>
+#include <limits>
+#include <random>
+
+// Error in ULP of got against a long double reference, results in the flushed range are skipped
+template<typename F>
+static double ulpError(F got, long double reference) {
+    if (std::isnan(reference)) {
+        return std::isnan(got) ? 0 : 1e9;
+    }
+    if (std::isinf(reference)) {
+        return got == reference ? 0 : 1e9;
+    }
+    if (std::abs(reference) < std::numeric_limits<F>::min()) {
+        return 0;
+    }
+    F rounded = static_cast<F>(reference);
+    long double ulp = std::nextafter(std::abs(rounded), std::numeric_limits<F>::infinity()) - std::abs(rounded);
+    return static_cast<double>(std::abs(got - reference) / ulp);
+}
+
+template<typename F, typename Function, typename Reference>
+static double maxUlpError(Function function, Reference reference, double lo, double hi) {
+    const int n = 100000;
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<double> dist(lo, hi);
+    Matrix<F> m(1, n);
+    for (int j = 0; j < n; j++) {
+        m(0, j) = static_cast<F>(dist(gen));
+    }
+    Matrix<F> result = function(m);
+    double worst = 0;
+    for (int j = 0; j < n; j++) {
+        worst = std::max(worst, ulpError(result(0, j), reference(static_cast<long double>(m(0, j)))));
+    }
+    return worst;
+}
+
+TEST(ElementwiseTest, TranscendentalAccuracy) {
+    auto expl_ = [](long double x) { return std::exp(x); };
+    auto logl_ = [](long double x) { return std::log(x); };
+    auto log1pl_ = [](long double x) { return std::log1p(x); };
+    EXPECT_LE(maxUlpError<float>(elementwise::exp<float>, expl_, -87, 88), 1.1);
+    EXPECT_LE(maxUlpError<double>(elementwise::exp<double>, expl_, -708, 709), 1.0);
+    EXPECT_LE(maxUlpError<float>(elementwise::log<float>, logl_, 0, 1e6), 1.0);
+    EXPECT_LE(maxUlpError<double>(elementwise::log<double>, logl_, 0, 1e6), 1.3);
+    EXPECT_LE(maxUlpError<float>(elementwise::log<float>, logl_, 0.5, 2), 1.0);
+    EXPECT_LE(maxUlpError<double>(elementwise::log<double>, logl_, 0.5, 2), 1.3);
+    EXPECT_LE(maxUlpError<float>(elementwise::log1p<float>, log1pl_, -0.999, 10), 2.5);
+    EXPECT_LE(maxUlpError<double>(elementwise::log1p<double>, log1pl_, -1e-3, 1e-3), 2.5);
+}
+
+TEST(ElementwiseTest, SpecialValues) {
+    const double inf = std::numeric_limits<double>::infinity();
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    const double tiny = std::numeric_limits<double>::denorm_min();
+    Matrix<double> m(std::vector<std::vector<double>>{{0, -1, inf, nan, tiny, 1, -inf, 800, -800}});
+    Matrix<double> l = elementwise::log(m);
+    EXPECT_EQ(l(0, 0), -inf);
+    EXPECT_TRUE(std::isnan(l(0, 1)));
+    EXPECT_EQ(l(0, 2), inf);
+    EXPECT_TRUE(std::isnan(l(0, 3)));
+    EXPECT_DOUBLE_EQ(l(0, 4), std::log(tiny));
+    EXPECT_EQ(l(0, 5), 0);
+
+    Matrix<double> e = elementwise::exp(m);
+    EXPECT_EQ(e(0, 0), 1);
+    EXPECT_EQ(e(0, 2), inf);
+    EXPECT_TRUE(std::isnan(e(0, 3)));
+    EXPECT_EQ(e(0, 6), 0);
+    EXPECT_EQ(e(0, 7), inf);
+    EXPECT_EQ(e(0, 8), 0);
+
+    Matrix<double> l1p = elementwise::log1p(m);
+    EXPECT_EQ(l1p(0, 0), 0);
+    EXPECT_EQ(l1p(0, 1), -inf);
+    EXPECT_EQ(l1p(0, 2), inf);
+    EXPECT_EQ(l1p(0, 4), tiny);
+}
+
+// Run under every forced MATRIX_ISA (tests/CMakeLists.txt): exp(-720) is
+// subnormal, the kernels flush it to zero and the C library does not
+TEST(ElementwiseTest, DoubleKernelsInDispatchedVariants) {
+    Matrix<double> m(1, 2, -720.0);
+    m(0, 1) = 0.5;
+    Matrix<double> e = elementwise::exp(m);
+    Matrix<double> p = elementwise::pow(m.subMat(0, 1, 1, 1), 3.0);
+    if (elementwise::doubleKernels()) {
+        EXPECT_EQ(e(0, 0), 0);
+    } else {
+        EXPECT_GT(e(0, 0), 0);
+    }
+    EXPECT_DOUBLE_EQ(e(0, 1), std::exp(0.5));
+    EXPECT_DOUBLE_EQ(p(0, 0), 0.125);
+    // Only the baseline variant may fall back to the C library
+    if (dispatch::active() != dispatch::Isa::Generic) {
+        EXPECT_TRUE(elementwise::doubleKernels());
+    }
+}
+
+TEST(ElementwiseTest, PowSqrtAbsClip) {
+    Matrix<double> m(std::vector<std::vector<double>>{{4, 0, -2, 2.5, -9}});
+    Matrix<double> cube = elementwise::pow(m, 3.0);
+    EXPECT_NEAR(cube(0, 0), 64, 1e-12);
+    EXPECT_EQ(cube(0, 1), 0);
+    EXPECT_NEAR(cube(0, 2), -8, 1e-13);
+    Matrix<double> root = elementwise::pow(m, 0.5);
+    EXPECT_NEAR(root(0, 3), std::sqrt(2.5), 1e-15);
+    EXPECT_TRUE(std::isnan(root(0, 2)));
+    EXPECT_EQ(elementwise::pow(m, -1.0)(0, 1), std::numeric_limits<double>::infinity());
+    EXPECT_EQ(elementwise::pow(m, 0.0)(0, 2), 1);
+
+    Matrix<double> s = elementwise::sqrt(m);
+    EXPECT_EQ(s(0, 0), 2);
+    EXPECT_TRUE(std::isnan(s(0, 4)));
+    EXPECT_EQ(elementwise::abs(m)(0, 4), 9);
+    Matrix<double> c = elementwise::clip(m, -1.0, 3.0);
+    EXPECT_EQ(c(0, 0), 3);
+    EXPECT_EQ(c(0, 2), -1);
+    EXPECT_EQ(c(0, 3), 2.5);
+    EXPECT_THROW(elementwise::clip(m, 1.0, 0.0), std::invalid_argument);
+
+    // Types without kernels go through double or float
+    Matrix<int> ints(std::vector<std::vector<int>>{{1, 8, 100}});
+    Matrix<int> logs = elementwise::log(ints);
+    EXPECT_EQ(logs(0, 1), 2);
+    EXPECT_EQ(logs(0, 2), 4);
+    EXPECT_EQ(elementwise::abs(Matrix<int>(1, 2, -3))(0, 1), 3);
+    Matrix<bfloat16> half(1, 3, bfloat16(2.0f));
+    EXPECT_NEAR(static_cast<float>(elementwise::exp(half)(0, 2)), std::exp(2.0f), 0.05);
+}
+
+TEST(ElementwiseTest, MasksAndSelection) {
+    Matrix<float> a(std::vector<std::vector<float>>{{1, 5, 3}, {-2, 0, 7}});
+    Matrix<float> b(2, 3, 2.0f);
+    Mask positive = elementwise::greater(a, 0.0f);
+    EXPECT_EQ(elementwise::count(positive), 4);
+    EXPECT_EQ(positive(1, 0), 0);
+    EXPECT_EQ(elementwise::count(elementwise::less(a, b)), 3);
+    EXPECT_EQ(elementwise::count(elementwise::equal(a, 3.0f)), 1);
+    EXPECT_EQ(elementwise::count(elementwise::notEqual(a, 3.0f)), 5);
+    EXPECT_EQ(elementwise::count(elementwise::greaterEqual(a, 3.0f)), 3);
+    EXPECT_EQ(elementwise::count(elementwise::lessEqual(a, 0.0f)), 2);
+
+    Matrix<float> selected = elementwise::where(positive, a, b);
+    EXPECT_EQ(selected(0, 1), 5);
+    EXPECT_EQ(selected(1, 0), 2);
+    Matrix<float> zeroed = elementwise::where(positive, a, 0.0f);
+    EXPECT_EQ(zeroed(1, 0), 0);
+    EXPECT_THROW(elementwise::where(positive, a, Matrix<float>(3, 2)), std::invalid_argument);
+    EXPECT_THROW(elementwise::greater(a, Matrix<float>(3, 2)), std::invalid_argument);
+}
+
+TEST(ElementwiseTest, Map) {
+    Matrix<int> m(std::vector<std::vector<int>>{{1, 2}, {3, 4}});
+    Matrix<int> squared = m.map([](int x) { return x * x; });
+    EXPECT_EQ(squared(1, 1), 16);
+    EXPECT_EQ(m(1, 1), 4);
+    m.mapInPlace([](int x) { return x + 10; }).mapInPlace([](int x) { return -x; });
+    EXPECT_EQ(m(0, 0), -11);
+}
@@ -0,0 +1,173 @@
+#include "gtest/gtest.h"
+#include "../filters.h"
+
+#include <cmath>
+#include <random>
+
+template<typename T>
+static Matrix<T> randomMatrix(int rows, int cols, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> dist(-1, 1);
+    Matrix<T> m(rows, cols);
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++) {
+            m(i, j) = static_cast<T>(dist(gen));
+        }
+    }
+    return m;
+}
+
+// Element (i, j) with the boundary mode applied, written independently of filters.cpp
+static double at(const Matrix<double>& m, int i, int j, Boundary boundary) {
+    auto map = [boundary](int p, int n) {
+        if (boundary == Boundary::Nearest) {
+            return std::min(std::max(p, 0), n - 1);
+        }
+        if (boundary == Boundary::Reflect) {
+            while (p < 0 || p >= n) {
+                p = p < 0 ? -p - 1 : 2 * n - 1 - p;
+            }
+        }
+        return p;
+    };
+    i = map(i, m.getHeight());
+    j = map(j, m.getWidth());
+    if (i < 0 || i >= m.getHeight() || j < 0 || j >= m.getWidth()) {
+        return 0;
+    }
+    return m(i, j);
+}
+
+static Matrix<double> reference(const Matrix<double>& m, const Matrix<double>& kernel, Boundary boundary) {
+    int kh = kernel.getHeight();
+    int kw = kernel.getWidth();
+    Matrix<double> result(m.getHeight(), m.getWidth(), 0.0);
+    for (int i = 0; i < m.getHeight(); i++) {
+        for (int j = 0; j < m.getWidth(); j++) {
+            for (int a = 0; a < kh; a++) {
+                for (int b = 0; b < kw; b++) {
+                    result(i, j) += kernel(a, b) * at(m, i - a + kh / 2, j - b + kw / 2, boundary);
+                }
+            }
+        }
+    }
+    return result;
+}
+
+static void expectNear(const Matrix<double>& a, const Matrix<double>& b, double tolerance) {
+    ASSERT_EQ(a.getShape(), b.getShape());
+    for (int i = 0; i < a.getHeight(); i++) {
+        for (int j = 0; j < a.getWidth(); j++) {
+            ASSERT_NEAR(a(i, j), b(i, j), tolerance) << "at (" << i << ", " << j << ")";
+        }
+    }
+}
+
+static const Boundary BOUNDARIES[] = {Boundary::Zero, Boundary::Reflect, Boundary::Nearest};
+
+TEST(FiltersTest, DirectMatchesReference) {
+    Matrix<double> m = randomMatrix<double>(23, 1100, 1);
+    for (Boundary boundary : BOUNDARIES) {
+        for (auto shape : {std::make_pair(3, 3), std::make_pair(4, 5), std::make_pair(1, 7)}) {
+            Matrix<double> kernel = randomMatrix<double>(shape.first, shape.second, 2);
+            expectNear(convolve2d(m, kernel, boundary), reference(m, kernel, boundary), 1e-12);
+        }
+    }
+}
+
+TEST(FiltersTest, FFTMatchesDirect) {
+    Matrix<double> m = randomMatrix<double>(40, 37, 3);
+    for (Boundary boundary : BOUNDARIES) {
+        Matrix<double> kernel = randomMatrix<double>(9, 6, 4);
+        expectNear(convolve2dFFT(m, kernel, boundary), reference(m, kernel, boundary), 1e-10);
+    }
+    // Kernel larger than the matrix, reflected more than once
+    Matrix<double> small = randomMatrix<double>(5, 4, 5);
+    Matrix<double> large = randomMatrix<double>(13, 11, 6);
+    expectNear(convolve2dFFT(small, large, Boundary::Reflect), reference(small, large, Boundary::Reflect), 1e-10);
+    expectNear(convolve2d(small, large, Boundary::Reflect), reference(small, large, Boundary::Reflect), 1e-12);
+}
+
+TEST(FiltersTest, WindowReadsNeighbours) {
+    Matrix<double> m = randomMatrix<double>(30, 30, 7);
+    Matrix<double> kernel = randomMatrix<double>(5, 5, 8);
+    Matrix<double> full = convolve2d(m, kernel, Boundary::Nearest);
+    Window window{10, 0, 8, 12};
+    Matrix<double> tile = convolve2d(m, kernel, Boundary::Nearest, window);
+    Matrix<double> tileFFT = convolve2dFFT(m, kernel, Boundary::Nearest, window);
+    ASSERT_EQ(tile.getShape(), std::make_pair(8, 12));
+    for (int i = 0; i < 8; i++) {
+        for (int j = 0; j < 12; j++) {
+            EXPECT_NEAR(tile(i, j), full(10 + i, j), 1e-12);
+            EXPECT_NEAR(tileFFT(i, j), full(10 + i, j), 1e-10);
+        }
+    }
+    EXPECT_THROW(convolve2d(m, kernel, Boundary::Zero, Window{25, 0, 10, -1}), std::out_of_range);
+    EXPECT_THROW(convolve2d(m, Matrix<double>(), Boundary::Zero), std::invalid_argument);
+}
+
+TEST(FiltersTest, SeparableAndGaussian) {
+    Matrix<double> m = randomMatrix<double>(31, 45, 9);
+    std::vector<double> columnKernel = {0.5, -1, 2, 0.25};
+    std::vector<double> rowKernel = {1, 3, -2};
+    Matrix<double> outer(4, 3);
+    for (int a = 0; a < 4; a++) {
+        for (int b = 0; b < 3; b++) {
+            outer(a, b) = columnKernel[a] * rowKernel[b];
+        }
+    }
+    for (Boundary boundary : BOUNDARIES) {
+        expectNear(convolveSeparable(m, columnKernel, rowKernel, boundary), reference(m, outer, boundary), 1e-12);
+    }
+
+    // A normalized kernel keeps a constant matrix constant away from zero padding
+    Matrix<float> constant(20, 20, 3.0f);
+    Matrix<float> smooth = gaussianFilter(constant, 1.5);
+    EXPECT_NEAR(smooth(0, 0), 3.0f, 1e-5);
+    EXPECT_NEAR(smooth(10, 10), 3.0f, 1e-5);
+    EXPECT_LT(gaussianFilter(constant, 1.5, Boundary::Zero)(0, 0), 2.0f);
+    EXPECT_THROW(gaussianFilter(constant, 0.0), std::invalid_argument);
+
+    // Matrices without elements keep their shape whatever the boundary mode
+    EXPECT_EQ(gaussianFilter(Matrix<double>(0, 5), 1.5).getShape(), std::make_pair(0, 5));
+    for (Boundary boundary : BOUNDARIES) {
+        EXPECT_EQ(convolveSeparable(Matrix<double>(3, 0), columnKernel, rowKernel, boundary).getShape(),
+                  std::make_pair(3, 0));
+        EXPECT_EQ(convolve2d(Matrix<double>(0, 4), outer, boundary).getShape(), std::make_pair(0, 4));
+        EXPECT_EQ(convolve2dFFT(Matrix<double>(2, 0), outer, boundary).getShape(), std::make_pair(2, 0));
+        EXPECT_EQ(boxFilter(Matrix<double>(0, 3), 1, 1, boundary).getShape(), std::make_pair(0, 3));
+    }
+}
+
+TEST(FiltersTest, BoxFilterMatchesUniformKernel) {
+    Matrix<double> m = randomMatrix<double>(26, 33, 10);
+    Matrix<double> uniform(5, 7, 1.0 / 35);
+    for (Boundary boundary : BOUNDARIES) {
+        expectNear(boxFilter(m, 2, 3, boundary), reference(m, uniform, boundary), 1e-12);
+    }
+    Matrix<double> tile = boxFilter(m, 2, 3, Boundary::Zero, Window{3, 4, 5, 6});
+    Matrix<double> full = boxFilter(m, 2, 3, Boundary::Zero);
+    EXPECT_NEAR(tile(2, 2), full(5, 6), 1e-12);
+}
+
+TEST(FiltersTest, SummedAreaTable) {
+    Matrix<double> m = randomMatrix<double>(12, 9, 11);
+    SummedAreaTable<double> table(m);
+    auto direct = [&m](int top, int left, int height, int width) {
+        double sum = 0;
+        for (int i = std::max(top, 0); i < std::min(top + height, m.getHeight()); i++) {
+            for (int j = std::max(left, 0); j < std::min(left + width, m.getWidth()); j++) {
+                sum += m(i, j);
+            }
+        }
+        return sum;
+    };
+    EXPECT_NEAR(table.sum(0, 0, 12, 9), direct(0, 0, 12, 9), 1e-12);
+    EXPECT_NEAR(table.sum(3, 2, 4, 5), direct(3, 2, 4, 5), 1e-12);
+    EXPECT_NEAR(table.sum(-2, 7, 5, 10), direct(-2, 7, 5, 10), 1e-12);
+    EXPECT_EQ(table.sum(20, 0, 3, 3), 0);
+
+    // Donut around (6, 4): 7x7 square minus the 3x3 center
+    double donut = table.sum(3, 1, 7, 7) - table.sum(5, 3, 3, 3);
+    EXPECT_NEAR(donut, direct(3, 1, 7, 7) - direct(5, 3, 3, 3), 1e-12);
+}
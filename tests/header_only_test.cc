@@ -0,0 +1,20 @@
+#define MATRIX_HEADER_ONLY
+#include "gtest/gtest.h"
+#include "../matrix.h"
+
+#include <cstdint>
+
+// Element types the library is not compiled for
+TEST(HeaderOnlyTest, AnyElementType) {
+    Matrix<long long> a(3, 4, 2);
+    a(2, 3) = -7;
+    EXPECT_EQ(a.sum(), 15);
+    EXPECT_EQ(a.min(), -7);
+    EXPECT_TRUE(a.transpose().dot(a) == a.transpose().dot(a.duplicate()));
+    EXPECT_EQ(a.transpose().dot(a)(3, 3), 57);
+
+    Matrix<long double> b(2, 2, 0.5L);
+    b(0, 1) = 3;
+    EXPECT_EQ(b.max(0)[0], 3.0L);
+    EXPECT_EQ(b.dot(b)(0, 0), 0.25L + 1.5L);
+}
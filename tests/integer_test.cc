@@ -0,0 +1,113 @@
+#include "gtest/gtest.h"
+#include "../integer.h"
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+// Sums and products past the range of the element type are exact in int64
+TEST(IntegerTest, WideSumAndDot) {
+    const int big = std::numeric_limits<int>::max();
+    Matrix<int> m(3, 70000, big);
+    m(2, 5) = -1;
+    const int64_t expected = static_cast<int64_t>(big) * (3 * 70000 - 1) - 1;
+    EXPECT_EQ(integer::sum(m), expected);
+    std::vector<int64_t> rows = integer::sum(m, 0);
+    EXPECT_EQ(rows[0], static_cast<int64_t>(big) * 70000);
+    EXPECT_EQ(rows[2], static_cast<int64_t>(big) * 69999 - 1);
+    std::vector<int64_t> cols = integer::sum(m, 1);
+    EXPECT_EQ(cols.size(), 70000u);
+    EXPECT_EQ(cols[5], 2 * static_cast<int64_t>(big) - 1);
+    EXPECT_EQ(cols[69999], 3 * static_cast<int64_t>(big));
+    EXPECT_THROW(integer::sum(m, 2), std::invalid_argument);
+
+    // Several blocks of the int32 partial sums of the 8 and 16 bit types
+    Matrix<int16_t> s(2, 100000, std::numeric_limits<int16_t>::min());
+    EXPECT_EQ(integer::sum(s), -32768LL * 200000);
+    Matrix<uint8_t> u(1, 200000, 255);
+    EXPECT_EQ(integer::sum(u), 255ULL * 200000);
+
+    Matrix<int8_t> a(2, 100000, -128);
+    Matrix<int8_t> b(100000, 3, -128);
+    b(7, 1) = 127;
+    Matrix<int64_t> p = integer::dot(a, b);
+    EXPECT_EQ(p.getShape(), std::make_pair(2, 3));
+    EXPECT_EQ(p(0, 0), 16384LL * 100000);
+    EXPECT_EQ(p(1, 1), 16384LL * 99999 - 128 * 127);
+
+    // Unsigned products are exact up to 2^64, signed ones whenever the result fits in int64
+    Matrix<uint32_t> c(1, 1, 4000000000u);
+    Matrix<uint64_t> square = integer::dot(c, c);
+    EXPECT_EQ(square(0, 0), 16000000000000000000ULL);
+    EXPECT_EQ(integer::sum(Matrix<uint32_t>(2, 3, 4000000000u)), 24000000000ULL);
+    Matrix<int> s32(1, 3, std::numeric_limits<int>::min());
+    Matrix<int> t32(3, 1, std::numeric_limits<int>::min());
+    t32(2, 0) = std::numeric_limits<int>::max();
+    // 2^62 + 2^62 - 2^62 + 2^31: the intermediate sum passes 2^63
+    EXPECT_EQ(integer::dot(s32, t32)(0, 0), (1LL << 62) + (1LL << 31));
+    Matrix<int> x(2, 3, 1);
+    EXPECT_THROW(integer::dot(x, x), std::invalid_argument);
+    x(0, 1) = 50000;
+    EXPECT_EQ(integer::dot(x, x.transpose())(0, 0), 2500000002LL);
+}
+
+// The Matrix reductions wrap around like unsigned arithmetic in T instead of overflowing
+TEST(IntegerTest, MatrixReductionsWrapAround) {
+    const int big = std::numeric_limits<int>::max();
+    Matrix<int> m(2, 3, big);
+    EXPECT_EQ(m.sum(), -6);
+    EXPECT_EQ(m.sum(1, Summation::Kahan)[0], -2);
+    EXPECT_EQ(m.cumuSum(1, Summation::Pairwise)(0, 2), big - 2);
+    EXPECT_EQ(m.dot(std::vector<int>{2, 2, 2})[1], -6);
+    EXPECT_EQ(m.dotTransposed(std::vector<int>{1, 1})[0], -2);
+
+    // uint16 operands are promoted to int, their products must not be
+    Matrix<uint16_t> u(40, 40, 65535);
+    Matrix<uint16_t> p = u.dot(u);
+    EXPECT_EQ(p(3, 7), 40);
+    EXPECT_TRUE(u.dotStrassen(u, 8) == p);
+    EXPECT_EQ(Matrix<int16_t>(1, 3, 30000).sum(), static_cast<int16_t>(90000));
+}
+
+TEST(IntegerTest, SaturateDivideAndNarrow) {
+    Matrix<int16_t> a(2, 3, 30000);
+    Matrix<int16_t> b(2, 3, 5000);
+    b(1, 2) = -5000;
+    Matrix<int16_t> s = integer::add(a, b);
+    EXPECT_EQ(s(0, 0), 32767);
+    EXPECT_EQ(s(1, 2), 25000);
+    EXPECT_EQ(integer::add(a, b, integer::Overflow::Wrap)(0, 0), static_cast<int16_t>(35000));
+    EXPECT_EQ(integer::subtract(b, a)(1, 2), -32768);
+    EXPECT_EQ(integer::multiply(a, static_cast<int16_t>(-2))(0, 0), -32768);
+    EXPECT_EQ(integer::multiply(a, static_cast<int16_t>(-2), integer::Overflow::Wrap)(0, 0), static_cast<int16_t>(-60000));
+
+    Matrix<uint32_t> u(1, 2, 7);
+    u(0, 1) = 4000000000u;
+    EXPECT_EQ(integer::subtract(Matrix<uint32_t>(1, 2, 3), u)(0, 0), 0u);
+    EXPECT_EQ(integer::multiply(u, 2u)(0, 1), std::numeric_limits<uint32_t>::max());
+    Matrix<int64_t> w(1, 1, std::numeric_limits<int64_t>::min() + 1);
+    EXPECT_EQ(integer::add(w, w)(0, 0), std::numeric_limits<int64_t>::min());
+    EXPECT_EQ(integer::subtract(w.multiply(-1), w)(0, 0), std::numeric_limits<int64_t>::max());
+    EXPECT_EQ(integer::multiply(w, int64_t(-3))(0, 0), std::numeric_limits<int64_t>::max());
+    EXPECT_THROW(integer::add(a, Matrix<int16_t>(3, 2, 1)), std::invalid_argument);
+
+    Matrix<int> n(1, 3, 7);
+    Matrix<int> d(1, 3, 2);
+    d(0, 2) = 0;
+    Matrix<double> r = integer::divide(n, d);
+    EXPECT_EQ(r(0, 0), 3.5);
+    EXPECT_TRUE(std::isinf(r(0, 2)));
+    EXPECT_EQ(integer::divide<float>(n, 4)(0, 1), 1.75f);
+
+    Matrix<int> counts(1, 4, 300);
+    counts(0, 1) = -5;
+    counts(0, 2) = 100000;
+    Matrix<uint8_t> small = integer::narrow<uint8_t>(counts);
+    EXPECT_EQ(small(0, 0), 255);
+    EXPECT_EQ(small(0, 1), 0);
+    Matrix<int16_t> medium = integer::narrow<int16_t>(counts);
+    EXPECT_EQ(medium(0, 2), 32767);
+    EXPECT_EQ(medium(0, 3), 300);
+    EXPECT_EQ(integer::narrow<int8_t>(counts, integer::Overflow::Wrap)(0, 0), static_cast<int8_t>(300));
+    EXPECT_TRUE(medium.astype<int>() == integer::narrow<int>(medium));
+}
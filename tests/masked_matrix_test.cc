@@ -0,0 +1,173 @@
+#include "gtest/gtest.h"
+#include "../masked_matrix.h"
+
+#include <cmath>
+#include <limits>
+#include <random>
+
+static const float NaN = std::numeric_limits<float>::quiet_NaN();
+
+// Random matrix with about a quarter of NaN, wider than a column block
+static Matrix<float> randomWithNaN(int rows, int cols, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dist(-10, 10);
+    std::uniform_int_distribution<int> pick(0, 3);
+    Matrix<float> m(rows, cols);
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++) {
+            m(i, j) = pick(gen) == 0 ? NaN : dist(gen);
+        }
+    }
+    return m;
+}
+
+TEST(NaNReductionTest, SkipNaN) {
+    Matrix<float> m({{1, NaN, 3}, {NaN, NaN, NaN}, {-2, 5, NaN}});
+
+    EXPECT_FLOAT_EQ(nansum(m), 7);
+    EXPECT_FLOAT_EQ(nanmax(m), 5);
+    EXPECT_FLOAT_EQ(nanmin(m), -2);
+    EXPECT_FLOAT_EQ(nanmean(m), 7.0f / 4);
+
+    std::vector<float> rowMax = nanmax(m, 0);
+    EXPECT_FLOAT_EQ(rowMax[0], 3);
+    EXPECT_TRUE(std::isnan(rowMax[1]));
+    EXPECT_FLOAT_EQ(rowMax[2], 5);
+
+    std::vector<float> colMin = nanmin(m, 1);
+    EXPECT_FLOAT_EQ(colMin[0], -2);
+    EXPECT_FLOAT_EQ(colMin[1], 5);
+    EXPECT_FLOAT_EQ(colMin[2], 3);
+
+    std::vector<float> colSum = nansum(m, 1, Summation::Kahan);
+    EXPECT_FLOAT_EQ(colSum[0], -1);
+    EXPECT_FLOAT_EQ(colSum[1], 5);
+    EXPECT_FLOAT_EQ(colSum[2], 3);
+
+    std::vector<float> rowMean = nanmean(m, 0);
+    EXPECT_FLOAT_EQ(rowMean[0], 2);
+    EXPECT_TRUE(std::isnan(rowMean[1]));
+    EXPECT_FLOAT_EQ(rowMean[2], 1.5f);
+
+    // The plain reductions propagate NaN
+    EXPECT_TRUE(std::isnan(m.max()));
+    EXPECT_TRUE(std::isnan(m.min(1)[2]));
+    EXPECT_TRUE(std::isnan(m.max(1)[0]));
+}
+
+TEST(NaNReductionTest, MatchesScalarReference) {
+    Matrix<float> m = randomWithNaN(37, 700, 3);
+    for (int axis = 0; axis <= 1; axis++) {
+        std::vector<float> max = nanmax(m, axis);
+        std::vector<float> sum = nansum(m, axis, Summation::Widened);
+        int n = axis == 0 ? m.getHeight() : m.getWidth();
+        for (int k = 0; k < n; k++) {
+            float referenceMax = -std::numeric_limits<float>::infinity();
+            double referenceSum = 0;
+            int length = axis == 0 ? m.getWidth() : m.getHeight();
+            for (int l = 0; l < length; l++) {
+                float x = axis == 0 ? m(k, l) : m(l, k);
+                if (!std::isnan(x)) {
+                    referenceMax = std::max(referenceMax, x);
+                    referenceSum += x;
+                }
+            }
+            EXPECT_EQ(max[k], referenceMax);
+            EXPECT_NEAR(sum[k], referenceSum, 1e-3);
+        }
+    }
+}
+
+TEST(NaNReductionTest, Double) {
+    Matrix<double> m({{-0.5, std::nan("")}, {std::numeric_limits<double>::infinity(), -3}});
+    EXPECT_EQ(nanmax(m), std::numeric_limits<double>::infinity());
+    EXPECT_DOUBLE_EQ(nanmin(m), -3);
+    EXPECT_DOUBLE_EQ(nanmax(m, 0)[0], -0.5);
+    EXPECT_DOUBLE_EQ(nanmin(m, 1)[1], -3);
+}
+
+TEST(NaNReductionTest, Integer) {
+    Matrix<int> m({{4, -1}, {2, 7}});
+    EXPECT_EQ(nansum(m), 12);
+    EXPECT_EQ(nanmax(m), 7);
+    EXPECT_EQ(nanmin(m, 1)[0], 2);
+    EXPECT_EQ(nanmean(m, 0)[1], 4);
+}
+
+TEST(MaskedMatrixTest, MaskAndCount) {
+    MaskedMatrix<float> m(Matrix<float>(3, 130, 1.0f));
+    EXPECT_EQ(m.count(), 390);
+    m.mask(0, 0);
+    m.mask(2, 129);
+    m.maskCol(64);
+    EXPECT_TRUE(m.isMasked(2, 129));
+    EXPECT_TRUE(m.isMasked(1, 64));
+    EXPECT_FALSE(m.isMasked(1, 65));
+    EXPECT_EQ(m.count(), 390 - 5);
+
+    m.maskRow(1);
+    EXPECT_EQ(m.count(), 390 - 4 - 130);
+    EXPECT_EQ(m.count(0)[1], 0);
+    EXPECT_EQ(m.count(1)[64], 0);
+    EXPECT_EQ(m.count(1)[129], 1);
+
+    m.unmask(2, 129);
+    EXPECT_FALSE(m.isMasked(2, 129));
+    EXPECT_THROW(m.mask(3, 0), std::out_of_range);
+
+    Mask mask = m.getMask();
+    EXPECT_EQ(mask(0, 0), 1);
+    EXPECT_EQ(mask(0, 1), 0);
+}
+
+TEST(MaskedMatrixTest, Reductions) {
+    Matrix<float> data({{1, 100, 3}, {4, 5, 6}});
+    Mask mask({{0, 1, 0}, {1, 1, 1}});
+    MaskedMatrix<float> m(std::move(data), mask);
+
+    EXPECT_FLOAT_EQ(m.sum(), 4);
+    EXPECT_FLOAT_EQ(m.max(), 3);
+    EXPECT_FLOAT_EQ(m.min(), 1);
+    EXPECT_FLOAT_EQ(m.mean(), 2);
+
+    std::vector<float> rowMax = m.max(0);
+    EXPECT_FLOAT_EQ(rowMax[0], 3);
+    EXPECT_TRUE(std::isnan(rowMax[1]));
+
+    std::vector<float> colSum = m.sum(1);
+    EXPECT_FLOAT_EQ(colSum[0], 1);
+    EXPECT_FLOAT_EQ(colSum[1], 0);
+    EXPECT_FLOAT_EQ(colSum[2], 3);
+
+    std::vector<float> colMean = m.mean(1);
+    EXPECT_TRUE(std::isnan(colMean[1]));
+
+    Matrix<float> filled = m.filled(-1);
+    EXPECT_FLOAT_EQ(filled(0, 0), 1);
+    EXPECT_FLOAT_EQ(filled(0, 1), -1);
+    EXPECT_FLOAT_EQ(filled(1, 2), -1);
+}
+
+TEST(MaskedMatrixTest, MaskNaNMatchesNaNReductions) {
+    Matrix<float> m = randomWithNaN(40, 600, 5);
+    std::vector<float> expectedMin = nanmin(m, 1);
+    std::vector<float> expectedSum = nansum(m, 0, Summation::Kahan);
+    float expectedMean = nanmean(m, Summation::Widened);
+
+    MaskedMatrix<float> masked = MaskedMatrix<float>::maskNaN(std::move(m));
+    EXPECT_EQ(masked.min(1), expectedMin);
+    std::vector<float> sum = masked.sum(0, Summation::Kahan);
+    for (std::size_t k = 0; k < sum.size(); k++) {
+        EXPECT_FLOAT_EQ(sum[k], expectedSum[k]);
+    }
+    EXPECT_FLOAT_EQ(masked.mean(Summation::Widened), expectedMean);
+}
+
+TEST(MaskedMatrixTest, ShapeMismatch) {
+    EXPECT_THROW(MaskedMatrix<int>(Matrix<int>(2, 2), Mask(2, 3)), std::invalid_argument);
+    EXPECT_THROW(MaskedMatrix<int>(Matrix<int>()).max(), std::out_of_range);
+    // Empty rows and columns throw like in Matrix, fully masked ones are NaN
+    EXPECT_THROW(MaskedMatrix<float>(Matrix<float>(2, 0)).max(0), std::out_of_range);
+    EXPECT_THROW(MaskedMatrix<float>(Matrix<float>(0, 3)).min(1), std::out_of_range);
+    EXPECT_TRUE(MaskedMatrix<float>(Matrix<float>()).max(0).empty());
+}
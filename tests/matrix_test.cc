@@ -1,6 +1,13 @@
 #include "gtest/gtest.h"
-#include "../core/component/matrix.h"
-
+#include "../matrix.h"
+#include "temp_files.h"
+
+#include <cmath>
+#include <complex>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <thread>
 #include <vector>
 
 TEST(MatrixTest, DefaultConstructor) {
@@ -89,6 +96,54 @@ TEST(MatrixMethodTest, Duplicate) {
     EXPECT_EQ(m2.get(0, 0), 1);
 }
 
+TEST(MatrixMethodTest, CopyOnWrite) {
+    Matrix<int> m(3, 3, 1);
+    Matrix<int> copy(m);
+    Matrix<int> duplicate = m.duplicate();
+    EXPECT_TRUE(m.isShared());
+    const Matrix<int>& view = copy;
+    EXPECT_EQ(view(0).data(), static_cast<const Matrix<int>&>(m)(0).data());
+
+    // Each modification copies the rows of the modified matrix only
+    copy(0, 0) = 2;
+    duplicate.put(1, 1, 3);
+    m += Matrix<int>(3, 3, 1);
+    EXPECT_EQ(copy(0, 0), 2);
+    EXPECT_EQ(copy(1, 1), 1);
+    EXPECT_EQ(duplicate(0, 0), 1);
+    EXPECT_EQ(duplicate(1, 1), 3);
+    EXPECT_EQ(m(0, 0), 2);
+    EXPECT_EQ(m(1, 1), 2);
+    EXPECT_FALSE(m.isShared());
+
+    Matrix<int> assigned;
+    assigned = m;
+    m.fill(7);
+    EXPECT_EQ(assigned(2, 2), 2);
+
+    // A snapshot read by other threads while the original is modified
+    Matrix<int> snapshot = m;
+    std::vector<std::thread> readers;
+    std::vector<long> sums(4);
+    for (int t = 0; t < 4; t++) {
+        readers.emplace_back([&snapshot, &sums, t]() {
+            Matrix<int> local = snapshot;
+            for (int k = 0; k < 1000; k++) {
+                sums[t] += local.sum();
+            }
+        });
+    }
+    for (int k = 0; k < 100; k++) {
+        m(k % 3, k % 3) += 1;
+    }
+    for (std::thread& reader : readers) {
+        reader.join();
+    }
+    for (long sum : sums) {
+        EXPECT_EQ(sum, 63000);
+    }
+}
+
 TEST(MatrixMethodTest, Erase) {
     Matrix<int> m(3, 3, 1);
     m.erase(1, 0);
@@ -143,6 +198,20 @@ TEST(MatrixMethodTest, ReserveAndResize) {
     m.resize(2, 2);
     EXPECT_EQ(m.getHeight(), 2);
     EXPECT_EQ(m.getWidth(), 2);
+
+    // Shrinking keeps the row buffers, a shared matrix is left untouched
+    Matrix<int> big(4, 6, 7);
+    const int* row = big(1).data();
+    Matrix<int> copy(big);
+    copy.resize(3, 8);
+    EXPECT_EQ(copy(2, 5), 7);
+    EXPECT_EQ(copy(2, 7), 0);
+    EXPECT_EQ(big.getShape(), std::make_pair(4, 6));
+    big.resize(2, 3);
+    EXPECT_EQ(big(1).data(), row);
+    EXPECT_EQ(big(1).size(), 3u);
+    big.resize(3);
+    EXPECT_EQ(big(2), std::vector<int>(3, 0));
 }
 
 TEST(MatrixMethodTest, SubMat) {
@@ -248,6 +317,29 @@ TEST(MatrixMathTest, MaxMinSum) {
     EXPECT_EQ(sumCol[1], 6);
 }
 
+TEST(MatrixMathTest, MaxMinEdgeCases) {
+    Matrix<float> empty;
+    EXPECT_THROW(empty.max(), std::out_of_range);
+    EXPECT_TRUE(empty.max(1).empty());
+    Matrix<float> noRows(0, 3);
+    EXPECT_THROW(noRows.max(1), std::out_of_range);
+    EXPECT_THROW(Matrix<float>(2, 2).min(2), std::invalid_argument);
+
+    // NaN propagates wherever it is, -0 is below +0
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    Matrix<float> m({{nan, 1, -3}, {2, 0.0f, -0.0f}});
+    EXPECT_TRUE(std::isnan(m.max()));
+    EXPECT_TRUE(std::isnan(m.min(0)[0]));
+    EXPECT_FLOAT_EQ(m.min(0)[1], -0.0f);
+    EXPECT_TRUE(std::signbit(m.min(0)[1]));
+    EXPECT_TRUE(std::isnan(m.max(1)[0]));
+    EXPECT_FLOAT_EQ(m.max(1)[2], 0.0f);
+
+    Matrix<double> d({{-1e300, -std::numeric_limits<double>::infinity()}});
+    EXPECT_EQ(d.max(), -1e300);
+    EXPECT_EQ(d.min(), -std::numeric_limits<double>::infinity());
+}
+
 TEST(MatrixMathTest, CumulativeSum) {
     Matrix<int> m(2, 2);
     m.put(0, 0, 1);
@@ -418,3 +510,309 @@ TEST(MatrixOperatorTest, OperatorStream) {
     std::string expectedOutput = "1 1 \n1 1 \n";
     EXPECT_EQ(output, expectedOutput);
 }
+
+
+TEST(MatrixTypesTest, WideAndUnsignedIntegers) {
+    // 3e9 does not fit in an int, every policy sums exactly
+    Matrix<int64_t> big(1000, 3, 1000000);
+    EXPECT_EQ(big.sum(), 3000000000LL);
+    EXPECT_EQ(big.sum(Summation::Kahan), 3000000000LL);
+    EXPECT_EQ(big.sum(1)[2], 1000000000LL);
+    EXPECT_EQ(big.max(), 1000000);
+
+    Matrix<uint32_t> u(2, 2, 4000000000u);
+    u(1, 1) = 3;
+    EXPECT_EQ(u.max(), 4000000000u);
+    EXPECT_EQ(u.min(0)[1], 3u);
+    TempFiles files;
+    std::string path = files.path("u32.csv");
+    u.toCSV(path);
+    EXPECT_TRUE(Matrix<uint32_t>::fromCSV(path) == u);
+}
+
+TEST(MatrixTypesTest, Complex) {
+    using C = std::complex<double>;
+    Matrix<C> a(2, 2);
+    a(0, 0) = C(1, 2);
+    a(0, 1) = C(0, -1);
+    a(1, 0) = C(3, 0);
+    a(1, 1) = C(-0.5, 0.25);
+    Matrix<C> product = a.dot(a);
+    EXPECT_EQ(product(0, 0), C(1, 2) * C(1, 2) + C(0, -1) * C(3, 0));
+    EXPECT_EQ(a.sum(Summation::Kahan), C(3.5, 1.25));
+    EXPECT_TRUE(a.transpose()(0, 1) == C(3, 0));
+    EXPECT_THROW(a.max(), std::invalid_argument);
+    EXPECT_THROW(a.min(1), std::invalid_argument);
+
+    a.accumulate(1, 1, C(1, 1));
+    EXPECT_EQ(a(1, 1), C(0.5, 1.25));
+    TempFiles files;
+    std::string path = files.path("complex.csv");
+    a.toCSV(path);
+    EXPECT_TRUE(Matrix<C>::fromCSV(path) == a);
+    protoMatrix proto;
+    MatrixToProto(a, proto);
+    EXPECT_TRUE(ProtoToMatrix<C>(proto) == a);
+
+    std::stringstream text;
+    text << Matrix<std::complex<float>>(1, 1, std::complex<float>(1.5f, -2));
+    EXPECT_EQ(text.str(), "1.5-2j \n");
+}
+
+TEST(MatrixTypesTest, FloatProto) {
+    Matrix<float> m(3, 2, 0.25f);
+    protoMatrix proto;
+    MatrixToProto(m, proto);
+    EXPECT_TRUE(ProtoToMatrix<float>(proto) == m);
+}
+
+TEST(MatrixHalfTest, StorageSize) {
+    EXPECT_EQ(sizeof(bfloat16), 2u);
+#if defined(MATRIX_HAS_FLOAT16)
+    EXPECT_EQ(sizeof(float16), 2u);
+#endif
+}
+
+TEST(MatrixHalfTest, AsType) {
+    Matrix<float> m(3, 20, 1.5f);
+    m(2, 19) = -3.25f;
+
+    Matrix<bfloat16> b = m.astype<bfloat16>();
+    Matrix<float> back = b.astype<float>();
+    EXPECT_TRUE(back == m);
+
+#if defined(MATRIX_HAS_FLOAT16)
+    Matrix<float16> h = m.astype<float16>();
+    EXPECT_FLOAT_EQ(static_cast<float>(h(2, 19)), -3.25f);
+    EXPECT_TRUE(h.astype<float>() == m);
+#endif
+
+    Matrix<int> mi = m.astype<int>();
+    EXPECT_EQ(mi(0, 0), 1);
+    EXPECT_EQ(mi(2, 19), -3);
+}
+
+TEST(MatrixHalfTest, ReductionsAccumulateInFloat) {
+    // bf16 has 8 bits of precision: a bf16 accumulator would stall at 256
+    Matrix<bfloat16> m(64, 64, 1.0f);
+    EXPECT_FLOAT_EQ(static_cast<float>(m.sum()), 4096.0f);
+
+    Matrix<bfloat16> d = m.dot(m);
+    EXPECT_FLOAT_EQ(static_cast<float>(d(0, 0)), 64.0f);
+
+    auto rows = m.sum(0);
+    EXPECT_FLOAT_EQ(static_cast<float>(rows[0]), 64.0f);
+}
+
+
+TEST(MatrixSummationTest, CompensatedPolicies) {
+    Matrix<float> m(std::vector<std::vector<float>>{{1e8f, 1.0f, -1e8f, 1.0f}});
+
+    EXPECT_FLOAT_EQ(m.sum(0, Summation::Kahan)[0], 2.0f);
+    EXPECT_FLOAT_EQ(m.sum(0, Summation::Widened)[0], 2.0f);
+    EXPECT_FLOAT_EQ(m.sum(Summation::Kahan), 2.0f);
+
+    auto cumu = m.cumuSum(1, Summation::Kahan);
+    EXPECT_FLOAT_EQ(cumu(0, 2), 1.0f);
+    EXPECT_FLOAT_EQ(cumu(0, 3), 2.0f);
+}
+
+TEST(MatrixSummationTest, PoliciesAgree) {
+    Matrix<float> m(300, 500);
+    for (int i = 0; i < 300; i++) {
+        for (int j = 0; j < 500; j++) {
+            m(i, j) = 0.1f * static_cast<float>((i * 7 + j * 3) % 11);
+        }
+    }
+    Matrix<double> md = m.astype<double>();
+    double expected = md.sum(Summation::Kahan);
+    auto expectedCols = md.sum(1);
+
+    for (Summation mode : {Summation::Naive, Summation::Pairwise, Summation::Kahan, Summation::Widened}) {
+        EXPECT_NEAR(m.sum(mode), expected, expected * 1e-6);
+        auto cols = m.sum(1, mode);
+        EXPECT_NEAR(cols[499], expectedCols[499], expectedCols[499] * 1e-6);
+        EXPECT_NEAR(m.cumuSum(0, mode)(299, 10), md.cumuSum(0)(299, 10), 1e-2);
+    }
+}
+
+TEST(MatrixSummationTest, DotPolicies) {
+    Matrix<int> m1(3, 200, 2);
+    Matrix<int> m2(200, 4, 3);
+    for (Summation mode : {Summation::Naive, Summation::Pairwise, Summation::Kahan, Summation::Widened}) {
+        Matrix<int> result = m1.dot(m2, mode);
+        EXPECT_EQ(result.getHeight(), 3);
+        EXPECT_EQ(result.getWidth(), 4);
+        EXPECT_EQ(result(2, 3), 1200);
+    }
+}
+
+
+TEST(MatrixTextTest, PrintAlignsColumns) {
+    Matrix<double> m(std::vector<std::vector<double>>{{1.5, -20}, {0.1, 3}});
+    std::stringstream buffer;
+    buffer << m;
+    EXPECT_EQ(buffer.str(), "1.5 -20 \n0.1 3   \n");
+
+    std::stringstream reference;
+    reference << 1.0 / 3.0;
+    std::stringstream third;
+    third << Matrix<double>(1, 1, 1.0 / 3.0);
+    EXPECT_EQ(third.str(), reference.str() + " \n");
+}
+
+TEST(MatrixTextTest, CSVRoundTrip) {
+    Matrix<double> m(300, 7);
+    for (int i = 0; i < 300; i++) {
+        for (int j = 0; j < 7; j++) {
+            m(i, j) = (i - 150) * 0.37 + j / 3.0;
+        }
+    }
+    std::string path = testing::TempDir() + "matrix_test.csv";
+    m.toCSV(path);
+    Matrix<double> loaded = Matrix<double>::fromCSV(path);
+    EXPECT_TRUE(loaded == m);
+
+    std::string tsvPath = testing::TempDir() + "matrix_test.tsv";
+    Matrix<int> mi(3, 4, 7);
+    mi(2, 3) = -12;
+    mi.toCSV(tsvPath, '\t');
+    EXPECT_TRUE(Matrix<int>::fromCSV(tsvPath, '\t') == mi);
+}
+
+TEST(MatrixTextTest, FromCSVParsesAndValidates) {
+    std::string path = testing::TempDir() + "matrix_test_input.csv";
+    {
+        std::ofstream out(path);
+        out << "1, 2,3\r\n4,+5,6\n\n7,8,9";
+    }
+    Matrix<float> m = Matrix<float>::fromCSV(path);
+    EXPECT_EQ(m.getHeight(), 3);
+    EXPECT_EQ(m.getWidth(), 3);
+    EXPECT_FLOAT_EQ(m(1, 1), 5.0f);
+    EXPECT_FLOAT_EQ(m(2, 2), 9.0f);
+
+    {
+        std::ofstream out(path);
+        out << "1,2,3\n4,5\n";
+    }
+    EXPECT_THROW(Matrix<float>::fromCSV(path), std::runtime_error);
+    {
+        std::ofstream out(path);
+        out << "1,2\n4,x\n";
+    }
+    EXPECT_THROW(Matrix<float>::fromCSV(path), std::runtime_error);
+    {
+        std::ofstream out(path);
+        out << "1,+-2\n";
+    }
+    EXPECT_THROW(Matrix<float>::fromCSV(path), std::runtime_error);
+    {
+        std::ofstream out(path);
+        out << "1+-2j\n";
+    }
+    EXPECT_THROW(Matrix<std::complex<double>>::fromCSV(path), std::runtime_error);
+    EXPECT_THROW(Matrix<float>::fromCSV(path + ".missing"), std::runtime_error);
+}
+
+#if defined(__linux__)
+// Every write to /dev/full fails with ENOSPC
+TEST(MatrixTextTest, ToCSVReportsWriteErrors) {
+    EXPECT_THROW(Matrix<double>(1000, 10, 1.5).toCSV("/dev/full"), std::runtime_error);
+}
+#endif
+
+
+// Built either way: without MATRIX_PROFILING the macros compile to nothing and no counter moves
+TEST(MatrixProfilingTest, CountsOperations) {
+    profiling::reset();
+    Matrix<double> m1(3, 4, 1.0);
+    Matrix<double> m2(4, 5, 2.0);
+    Matrix<double> product = m1.dot(m2);
+    Matrix<double> sum = m1.add(m1);
+    sum = sum.add(m1);
+    {
+        MATRIX_PROFILE(Print, 0, 0, 0, 0);
+        MATRIX_PROFILE_SHAPE(2, 7, 14, 0);
+    }
+
+    std::string json = profiling::toJSON();
+#if defined(MATRIX_PROFILING)
+    EXPECT_NE(json.find("\"dot\":{\"calls\":1,\"elements\":60"), std::string::npos);
+    EXPECT_NE(json.find("\"add\":{\"calls\":2,\"elements\":24,\"bytes_allocated\":192"), std::string::npos);
+    EXPECT_NE(json.find("\"largest_shape\":[3,5]"), std::string::npos);
+    EXPECT_NE(json.find("\"print\":{\"calls\":1,\"elements\":14"), std::string::npos);
+    EXPECT_EQ(json.find("\"subMat\""), std::string::npos);
+#else
+    EXPECT_EQ(json, "{}");
+#endif
+}
+
+
+TEST(MatrixStrassenTest, MatchesClassicalProduct) {
+    // Odd and non-square sizes exercise the padding at every level
+    Matrix<int> a(37, 29);
+    Matrix<int> b(29, 41);
+    for (int i = 0; i < 37; i++) {
+        for (int j = 0; j < 29; j++) {
+            a(i, j) = (i * 3 + j * 5) % 7 - 3;
+        }
+    }
+    for (int i = 0; i < 29; i++) {
+        for (int j = 0; j < 41; j++) {
+            b(i, j) = (i * 2 + j) % 5 - 2;
+        }
+    }
+    Matrix<int> expected = a.dot(b);
+    Matrix<int> result = a.dotStrassen(b, 4);
+    EXPECT_TRUE(result == expected);
+    EXPECT_TRUE(a.dotStrassen(b) == expected);
+
+    Matrix<double> ad = a.astype<double>();
+    Matrix<double> bd = b.astype<double>();
+    Matrix<double> rd = ad.dotStrassen(bd, 3);
+    EXPECT_NEAR(rd(36, 40), expected(36, 40), 1e-9);
+
+    EXPECT_THROW(a.dotStrassen(a), std::invalid_argument);
+}
+
+
+TEST(MatrixGemvTest, MatchesDenseProduct) {
+    // Tall, wide and blocked shapes exercise every split of dotTransposed
+    for (auto shape : {std::make_pair(7, 5), std::make_pair(3, 700), std::make_pair(3000, 4), std::make_pair(600, 600)}) {
+        int rows = shape.first;
+        int cols = shape.second;
+        Matrix<double> m(rows, cols);
+        std::vector<double> x(cols);
+        std::vector<double> y(rows);
+        Matrix<double> column(cols, 1);
+        Matrix<double> line(1, rows);
+        for (int i = 0; i < rows; i++) {
+            for (int j = 0; j < cols; j++) {
+                m(i, j) = (i * 7 + j * 3) % 11 - 5;
+            }
+            y[i] = line(0, i) = i % 5 - 2;
+        }
+        for (int j = 0; j < cols; j++) {
+            x[j] = column(j, 0) = j % 3 - 1;
+        }
+
+        std::vector<double> mx = m.dot(x);
+        Matrix<double> expected = m.dot(column);
+        for (int i = 0; i < rows; i++) {
+            EXPECT_EQ(mx[i], expected(i, 0));
+        }
+        for (Summation mode : {Summation::Naive, Summation::Pairwise, Summation::Kahan, Summation::Widened}) {
+            std::vector<double> ym = m.dotTransposed(y, mode);
+            Matrix<double> expectedT = line.dot(m);
+            for (int j = 0; j < cols; j++) {
+                EXPECT_EQ(ym[j], expectedT(0, j));
+            }
+        }
+    }
+
+    Matrix<int> m(2, 3, 1);
+    EXPECT_THROW(m.dot(std::vector<int>(2)), std::invalid_argument);
+    EXPECT_THROW(m.dotTransposed(std::vector<int>(3)), std::invalid_argument);
+    EXPECT_EQ(m.dotTransposed(std::vector<int>{1, 2}), std::vector<int>({3, 3, 3}));
+}
@@ -0,0 +1,115 @@
+#include "gtest/gtest.h"
+#include "../packed_matrix.h"
+
+#include <vector>
+
+static Matrix<double> symmetricInput(int n) {
+    Matrix<double> m(n, n);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j <= i; j++) {
+            m(i, j) = m(j, i) = (i * 3 + j * 7) % 11 - 4;
+        }
+    }
+    return m;
+}
+
+TEST(SymmetricMatrixTest, ConstructorAndAccess) {
+    SymmetricMatrix<int> s(3, 1);
+    EXPECT_EQ(s.getShape(), std::make_pair(3, 3));
+    EXPECT_EQ(s.packed().size(), 6u);
+    s(0, 2) = 5;
+    EXPECT_EQ(s(2, 0), 5);
+    EXPECT_EQ(s.toMatrix()(0, 2), 5);
+
+    Matrix<int> notSquare(2, 3);
+    EXPECT_THROW(SymmetricMatrix<int> bad(notSquare), std::invalid_argument);
+}
+
+TEST(SymmetricMatrixTest, Reductions) {
+    Matrix<double> m = symmetricInput(9);
+    SymmetricMatrix<double> s(m);
+    EXPECT_TRUE(s.toMatrix() == m);
+    EXPECT_DOUBLE_EQ(s.sum(), m.sum());
+    EXPECT_DOUBLE_EQ(s.max(), m.max());
+    EXPECT_DOUBLE_EQ(s.min(), m.min());
+    EXPECT_EQ(s.sum(0), m.sum(0));
+    EXPECT_EQ(s.sum(1), m.sum(1));
+}
+
+TEST(SymmetricMatrixTest, SymmAndSyrk) {
+    Matrix<double> m = symmetricInput(7);
+    SymmetricMatrix<double> s(m);
+    Matrix<double> b(7, 4);
+    for (int i = 0; i < 7; i++) {
+        for (int j = 0; j < 4; j++) {
+            b(i, j) = i - 2 * j;
+        }
+    }
+    EXPECT_TRUE(s.dot(b) == m.dot(b));
+
+    Matrix<double> a = b.transpose();
+    SymmetricMatrix<double> gram = SymmetricMatrix<double>::syrk(b);
+    EXPECT_TRUE(gram.toMatrix() == b.dot(a));
+}
+
+TEST(SymmetricMatrixTest, ProtoWritesOneTriangle) {
+    SymmetricMatrix<double> s(symmetricInput(5));
+    std::string path = testing::TempDir() + "symmetric.pb";
+    s.dumpToProto(path);
+
+    SymmetricMatrix<double> loaded = SymmetricMatrix<double>::loadFromProto(path);
+    EXPECT_EQ(loaded.packed(), s.packed());
+    EXPECT_TRUE(Matrix<double>::loadFromProto(path) == s.toMatrix());
+}
+
+TEST(TriangularMatrixTest, Access) {
+    TriangularMatrix<int> l(3, Triangle::Lower, 1);
+    const TriangularMatrix<int>& cl = l;
+    EXPECT_EQ(cl(0, 2), 0);
+    EXPECT_EQ(cl(2, 0), 1);
+    EXPECT_THROW(l(0, 2) = 3, std::out_of_range);
+    EXPECT_EQ(l.sum(), 6);
+    EXPECT_EQ(l.max(), 1);
+    EXPECT_EQ(l.min(), 0);
+
+    TriangularMatrix<int> u = l.transpose();
+    EXPECT_EQ(u.getTriangle(), Triangle::Upper);
+    const TriangularMatrix<int>& cu = u;
+    EXPECT_EQ(cu(0, 2), 1);
+    EXPECT_EQ(cu(2, 0), 0);
+}
+
+TEST(TriangularMatrixTest, TrmmAndTrsm) {
+    Matrix<double> m = symmetricInput(6);
+    for (int i = 0; i < 6; i++) {
+        m(i, i) = 10 + i;
+    }
+    Matrix<double> b(6, 3);
+    for (int i = 0; i < 6; i++) {
+        for (int j = 0; j < 3; j++) {
+            b(i, j) = i + j;
+        }
+    }
+
+    for (Triangle triangle : {Triangle::Lower, Triangle::Upper}) {
+        TriangularMatrix<double> t(m, triangle);
+        Matrix<double> dense = t.toMatrix();
+        EXPECT_TRUE(t.dot(b) == dense.dot(b));
+
+        Matrix<double> x = t.solve(b);
+        Matrix<double> check = dense.dot(x);
+        for (int i = 0; i < 6; i++) {
+            for (int j = 0; j < 3; j++) {
+                EXPECT_NEAR(check(i, j), b(i, j), 1e-12);
+            }
+        }
+
+        std::string path = testing::TempDir() + "triangular.pb";
+        t.dumpToProto(path);
+        EXPECT_EQ(TriangularMatrix<double>::loadFromProto(path).packed(), t.packed());
+        EXPECT_TRUE(Matrix<double>::loadFromProto(path) == dense);
+    }
+
+    TriangularMatrix<double> singular(3, Triangle::Lower, 0.0);
+    EXPECT_THROW(singular.solve(Matrix<double>(3, 1, 1.0)), std::invalid_argument);
+}
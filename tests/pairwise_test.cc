@@ -0,0 +1,169 @@
+#include "gtest/gtest.h"
+#include "../pairwise.h"
+
+#include <cmath>
+#include <random>
+
+template<typename T>
+static Matrix<T> randomMatrix(int rows, int cols, unsigned seed, double offset=0) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> dist(-1, 1);
+    Matrix<T> m(rows, cols);
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++) {
+            m(i, j) = static_cast<T>(offset + dist(gen));
+        }
+    }
+    return m;
+}
+
+// Covariance of the rows of m, computed from the definition
+static Matrix<double> referenceCov(const Matrix<double>& m, int ddof) {
+    int n = m.getHeight();
+    int length = m.getWidth();
+    std::vector<double> means(n, 0.0);
+    for (int i = 0; i < n; i++) {
+        for (int k = 0; k < length; k++) {
+            means[i] += m(i, k) / length;
+        }
+    }
+    Matrix<double> result(n, n, 0.0);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            for (int k = 0; k < length; k++) {
+                result(i, j) += (m(i, k) - means[i]) * (m(j, k) - means[j]);
+            }
+            result(i, j) /= length - ddof;
+        }
+    }
+    return result;
+}
+
+static double referenceDistance(const Matrix<double>& a, int i, const Matrix<double>& b, int j, Metric metric) {
+    double sum = 0, dot = 0, na = 0, nb = 0;
+    for (int k = 0; k < a.getWidth(); k++) {
+        double d = a(i, k) - b(j, k);
+        sum += metric == Metric::Manhattan ? std::abs(d) : d * d;
+        dot += a(i, k) * b(j, k);
+        na += a(i, k) * a(i, k);
+        nb += b(j, k) * b(j, k);
+    }
+    if (metric == Metric::Cosine) {
+        return 1 - dot / std::sqrt(na * nb);
+    }
+    return metric == Metric::Euclidean ? std::sqrt(sum) : sum;
+}
+
+static void expectNear(const Matrix<double>& a, const Matrix<double>& b, double tolerance) {
+    ASSERT_EQ(a.getShape(), b.getShape());
+    for (int i = 0; i < a.getHeight(); i++) {
+        for (int j = 0; j < a.getWidth(); j++) {
+            ASSERT_NEAR(a(i, j), b(i, j), tolerance) << "at (" << i << ", " << j << ")";
+        }
+    }
+}
+
+static const Metric METRICS[] = {Metric::Euclidean, Metric::Cosine, Metric::Manhattan};
+
+TEST(PairwiseTest, CovAndCorrcoef) {
+    Matrix<double> m = randomMatrix<double>(13, 301, 1, 5.0);
+    Matrix<double> expected = referenceCov(m, 1);
+    expectNear(cov(m), expected, 1e-12);
+    expectNear(cov(m.transpose(), 1), expected, 1e-12);
+    expectNear(cov(m, 0, 0), referenceCov(m, 0), 1e-12);
+
+    Matrix<double> correlation = corrcoef(m);
+    for (int i = 0; i < 13; i++) {
+        EXPECT_EQ(correlation(i, i), 1.0);
+        for (int j = 0; j < 13; j++) {
+            EXPECT_NEAR(correlation(i, j), expected(i, j) / std::sqrt(expected(i, i) * expected(j, j)), 1e-12);
+            EXPECT_EQ(correlation(i, j), correlation(j, i));
+        }
+    }
+
+    // Float packs and reduces in float, centered first so the offset does not matter
+    Matrix<float> f = m.astype<float>();
+    Matrix<float> covFloat = cov(f);
+    for (int i = 0; i < 13; i++) {
+        for (int j = 0; j < 13; j++) {
+            EXPECT_NEAR(covFloat(i, j), expected(i, j), 1e-5);
+        }
+    }
+
+    // A constant variable has no correlation
+    Matrix<double> constant = randomMatrix<double>(3, 10, 2);
+    constant(1).assign(10, 4.0);
+    Matrix<double> withConstant = corrcoef(constant);
+    EXPECT_TRUE(std::isnan(withConstant(0, 1)));
+    EXPECT_TRUE(std::isnan(withConstant(1, 1)));
+    EXPECT_EQ(withConstant(0, 0), 1.0);
+
+    EXPECT_THROW(cov(m, 2), std::invalid_argument);
+    EXPECT_THROW(cov(Matrix<double>(3, 1), 0, 1), std::invalid_argument);
+}
+
+TEST(PairwiseTest, CdistMatchesDefinition) {
+    Matrix<double> a = randomMatrix<double>(37, 19, 3, 100.0);
+    Matrix<double> b = randomMatrix<double>(22, 19, 4, 100.0);
+    for (Metric metric : METRICS) {
+        Matrix<double> expected(37, 22);
+        for (int i = 0; i < 37; i++) {
+            for (int j = 0; j < 22; j++) {
+                expected(i, j) = referenceDistance(a, i, b, j, metric);
+            }
+        }
+        // The shift by the mean of a keeps euclidean distances accurate despite the offset
+        expectNear(cdist(a, b, metric), expected, 1e-9);
+    }
+    EXPECT_THROW(cdist(a, Matrix<double>(2, 3), Metric::Euclidean), std::invalid_argument);
+}
+
+TEST(PairwiseTest, SelfDistanceIsSymmetric) {
+    Matrix<float> a = randomMatrix<float>(300, 17, 5);
+    Matrix<float> copy = a.duplicate();
+    for (Metric metric : METRICS) {
+        Matrix<float> self = cdist(a, a, metric);
+        Matrix<float> other = cdist(a, copy, metric);
+        for (int i = 0; i < 300; i++) {
+            EXPECT_EQ(self(i, i), 0.0f);
+            for (int j = 0; j < 300; j++) {
+                ASSERT_EQ(self(i, j), self(j, i));
+                ASSERT_NEAR(self(i, j), other(i, j), 1e-4);
+            }
+        }
+    }
+}
+
+TEST(PairwiseTest, TilesStreamTheResult) {
+    Matrix<double> a = randomMatrix<double>(45, 8, 6);
+    Matrix<double> b = randomMatrix<double>(30, 8, 7);
+    Matrix<double> full = cdist(a, b, Metric::Manhattan);
+    Matrix<double> streamed(45, 30, -1.0);
+    int tiles = 0;
+    cdist(a, b, Metric::Manhattan, [&](int row, int col, const Matrix<double>& tile) {
+        EXPECT_LE(tile.getHeight(), 16);
+        EXPECT_LE(tile.getWidth(), 16);
+        for (int i = 0; i < tile.getHeight(); i++) {
+            for (int j = 0; j < tile.getWidth(); j++) {
+                streamed(row + i, col + j) = tile(i, j);
+            }
+        }
+        tiles++;
+    }, 16);
+    EXPECT_EQ(tiles, 3 * 2);
+    expectNear(streamed, full, 0);
+
+    // Symmetric results only stream the tiles on and above the diagonal
+    Matrix<double> correlation = corrcoef(a);
+    tiles = 0;
+    corrcoef(a, 0, [&](int row, int col, const Matrix<double>& tile) {
+        EXPECT_LE(row, col);
+        for (int i = 0; i < tile.getHeight(); i++) {
+            for (int j = 0; j < tile.getWidth(); j++) {
+                EXPECT_EQ(tile(i, j), correlation(row + i, col + j));
+            }
+        }
+        tiles++;
+    }, 16);
+    EXPECT_EQ(tiles, 3 + 2 + 1);
+}
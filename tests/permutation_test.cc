@@ -0,0 +1,110 @@
+#include "gtest/gtest.h"
+#include "../permutation.h"
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+static std::vector<int> randomPermutation(int n, unsigned seed) {
+    std::vector<int> perm(n);
+    std::iota(perm.begin(), perm.end(), 0);
+    std::shuffle(perm.begin(), perm.end(), std::mt19937(seed));
+    return perm;
+}
+
+// Several tiles in both directions, element (i, j) = i * width + j
+static Matrix<double> numbered(int height, int width) {
+    Matrix<double> m(height, width);
+    for (int i = 0; i < height; i++) {
+        for (int j = 0; j < width; j++) {
+            m(i, j) = i * width + j;
+        }
+    }
+    return m;
+}
+
+TEST(PermutationTest, Permute) {
+    const int height = 70;
+    const int width = 2500;
+    Matrix<double> m = numbered(height, width);
+    std::vector<int> rows = randomPermutation(height, 1);
+    std::vector<int> cols = randomPermutation(width, 2);
+
+    Matrix<double> byRows = permutation::permuteRows(m, rows);
+    Matrix<double> byCols = permutation::permuteCols(m, cols);
+    for (int i = 0; i < height; i++) {
+        for (int j = 0; j < width; j++) {
+            ASSERT_EQ(byRows(i, j), m(rows[i], j));
+            ASSERT_EQ(byCols(i, j), m(i, cols[j]));
+        }
+    }
+
+    Matrix<double> inPlace(m);
+    permutation::permuteRowsInPlace(inPlace, rows);
+    EXPECT_TRUE(inPlace == byRows);
+    EXPECT_EQ(m(1, 0), width);
+    permutation::permuteColsInPlace(inPlace, cols);
+    EXPECT_TRUE(inPlace == permutation::permuteCols(byRows, cols));
+    permutation::permuteColsInPlace(inPlace, permutation::inverse(cols));
+    permutation::permuteRowsInPlace(inPlace, permutation::inverse(rows));
+    EXPECT_TRUE(inPlace == m);
+
+    rows[3] = rows[4];
+    EXPECT_THROW(permutation::permuteRows(m, rows), std::invalid_argument);
+    EXPECT_THROW(permutation::permuteRowsInPlace(inPlace, rows), std::invalid_argument);
+    EXPECT_TRUE(inPlace == m);
+    cols.pop_back();
+    EXPECT_THROW(permutation::permuteCols(m, cols), std::invalid_argument);
+}
+
+TEST(PermutationTest, TakeSelectScatter) {
+    const int height = 40;
+    const int width = 1500;
+    Matrix<double> m = numbered(height, width);
+
+    std::vector<int> rows = {3, -1, 3, 0};
+    Matrix<double> taken = permutation::take(m, rows);
+    EXPECT_EQ(taken.getShape(), std::make_pair(4, width));
+    EXPECT_TRUE(taken(1) == m(height - 1));
+    EXPECT_TRUE(taken(2) == m(3));
+    std::vector<int> cols;
+    for (int j = 0; j < 2000; j++) {
+        cols.push_back((j * 7) % width);
+    }
+    Matrix<double> takenCols = permutation::take(m, cols, 1);
+    for (int i = 0; i < height; i++) {
+        for (int j = 0; j < 2000; j++) {
+            ASSERT_EQ(takenCols(i, j), m(i, cols[j]));
+        }
+    }
+    EXPECT_THROW(permutation::take(m, {height}), std::out_of_range);
+    EXPECT_THROW(permutation::take(m, {0}, 2), std::invalid_argument);
+
+    std::vector<bool> mask(width, false);
+    for (int j = 0; j < width; j += 3) {
+        mask[j] = true;
+    }
+    Matrix<double> selected = permutation::select(m, mask, 1);
+    EXPECT_EQ(selected.getWidth(), width / 3);
+    EXPECT_EQ(selected(2, 5), m(2, 15));
+    EXPECT_EQ(permutation::select(m, std::vector<bool>(height, false)).getShape(), std::make_pair(0, width));
+    EXPECT_EQ(permutation::take(m, {}, 1).getShape(), std::make_pair(height, 0));
+    EXPECT_EQ(permutation::take(Matrix<double>(0, 3), {}).getShape(), std::make_pair(0, 3));
+    EXPECT_THROW(permutation::select(m, mask, 0), std::invalid_argument);
+
+    // Scatter undoes take, repeated indices keep the last one
+    Matrix<double> target(height, width);
+    permutation::scatter(takenCols, cols, target, 1);
+    for (int j = 0; j < width; j += 7) {
+        EXPECT_EQ(target(5, j), m(5, j));
+    }
+    Matrix<double> copy(m);
+    Matrix<double> rowsSource(3, width, -1.0);
+    rowsSource(2, 0) = -2.0;
+    permutation::scatter(rowsSource, {4, 9, 4}, copy);
+    EXPECT_EQ(m(4, 0), 4.0 * width);
+    EXPECT_EQ(copy(4, 0), -2.0);
+    EXPECT_EQ(copy(9, 1), -1.0);
+    EXPECT_EQ(copy(5, 1), m(5, 1));
+    EXPECT_THROW(permutation::scatter(rowsSource, {4, 9}, copy), std::invalid_argument);
+}
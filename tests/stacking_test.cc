@@ -0,0 +1,67 @@
+#include "gtest/gtest.h"
+#include "../stacking.h"
+
+// Element (i, j) = start + i * width + j
+static Matrix<int> numbered(int height, int width, int start) {
+    Matrix<int> m(height, width);
+    for (int i = 0; i < height; i++) {
+        for (int j = 0; j < width; j++) {
+            m(i, j) = start + i * width + j;
+        }
+    }
+    return m;
+}
+
+TEST(StackingTest, ConcatAndBlock) {
+    Matrix<int> a = numbered(2, 3, 0);
+    Matrix<int> b = numbered(4, 3, 100);
+    Matrix<int> c = numbered(2, 5, 200);
+
+    Matrix<int> v = stacking::vstack({a, Matrix<int>(), b});
+    EXPECT_EQ(v.getShape(), std::make_pair(6, 3));
+    EXPECT_TRUE(v.subMat(0, 0, 2, 3) == a);
+    EXPECT_TRUE(v.subMat(2, 0, 4, 3) == b);
+    EXPECT_TRUE(stacking::concat({a, b}) == v);
+
+    Matrix<int> h = stacking::hstack({a, c});
+    EXPECT_EQ(h.getShape(), std::make_pair(2, 8));
+    EXPECT_EQ(h(1, 2), a(1, 2));
+    EXPECT_EQ(h(1, 3), c(1, 0));
+    EXPECT_TRUE(stacking::concat({a, c}, 1) == h);
+
+    // Grid rows may be cut at different columns
+    Matrix<int> d = numbered(4, 5, 300);
+    Matrix<int> grid = stacking::block({{a, c}, {d, b}});
+    EXPECT_EQ(grid.getShape(), std::make_pair(6, 8));
+    EXPECT_TRUE(grid.subMat(0, 0, 2, 8) == h);
+    EXPECT_TRUE(grid.subMat(2, 0, 4, 5) == d);
+    EXPECT_TRUE(grid.subMat(2, 5, 4, 3) == b);
+    EXPECT_EQ(stacking::vstack<int>({}).getShape(), std::make_pair(0, 0));
+
+    // A result without elements keeps the other dimension
+    EXPECT_EQ(stacking::vstack({Matrix<int>(0, 5), Matrix<int>(0, 5)}).getShape(), std::make_pair(0, 5));
+    EXPECT_EQ(stacking::hstack({Matrix<int>(3, 0), Matrix<int>(3, 0)}).getShape(), std::make_pair(3, 0));
+    EXPECT_EQ(stacking::hstack({Matrix<int>(0, 2), Matrix<int>(0, 3)}).getShape(), std::make_pair(0, 5));
+    EXPECT_EQ(stacking::block({{Matrix<int>(2, 0)}, {Matrix<int>(4, 0)}}).getShape(), std::make_pair(6, 0));
+
+    EXPECT_THROW(stacking::vstack({a, c}), std::invalid_argument);
+    EXPECT_THROW(stacking::hstack({a, b}), std::invalid_argument);
+    EXPECT_THROW(stacking::block({{a, c}, {b}}), std::invalid_argument);
+    EXPECT_THROW(stacking::concat({a, b}, 2), std::invalid_argument);
+}
+
+TEST(StackingTest, Tile) {
+    Matrix<int> a = numbered(300, 70, 0);
+    Matrix<int> t = stacking::tile(a, 3, 4);
+    EXPECT_EQ(t.getShape(), std::make_pair(900, 280));
+    for (int i = 0; i < 900; i += 7) {
+        for (int j = 0; j < 280; j++) {
+            ASSERT_EQ(t(i, j), a(i % 300, j % 70));
+        }
+    }
+    EXPECT_TRUE(stacking::tile(a, 2, 1) == stacking::vstack({a, a}));
+    EXPECT_EQ(stacking::tile(a, 0, 2).getShape(), std::make_pair(0, 140));
+    EXPECT_EQ(stacking::tile(a, 2, 0).getShape(), std::make_pair(600, 0));
+    EXPECT_EQ(stacking::tile(Matrix<int>(0, 4), 3, 2).getShape(), std::make_pair(0, 8));
+    EXPECT_THROW(stacking::tile(a, -1, 2), std::invalid_argument);
+}
@@ -0,0 +1,43 @@
+//
+// Temporary files of the tests, unique to the running test and process.
+//
+
+#include "gtest/gtest.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#ifndef TEMP_FILES_H
+#define TEMP_FILES_H
+
+// Paths in the test temporary directory, named after the running test and
+// the process so that concurrent test processes (ctest -j, the per-ISA
+// runs) never share a file. The files are removed when the object goes out
+// of scope: declare it before the objects that keep them open.
+class TempFiles {
+public:
+    TempFiles() = default;
+    TempFiles(const TempFiles&) = delete;
+    TempFiles& operator=(const TempFiles&) = delete;
+    ~TempFiles() {
+        for (const std::string& path : paths_) {
+            std::remove(path.c_str());
+        }
+    }
+
+    std::string path(const std::string& name) {
+        const testing::TestInfo* test = testing::UnitTest::GetInstance()->current_test_info();
+        paths_.push_back(testing::TempDir() + test->test_suite_name() + "_" + test->name() + "_" +
+                         std::to_string(getpid()) + "_" + name);
+        return paths_.back();
+    }
+
+private:
+    std::vector<std::string> paths_;
+};
+
+
+#endif // TEMP_FILES_H
@@ -0,0 +1,97 @@
+#include "gtest/gtest.h"
+#include "../tiled_matrix.h"
+#include "temp_files.h"
+
+#include <random>
+
+template<typename T>
+static Matrix<T> randomMatrix(int rows, int cols, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> dist(-1, 1);
+    Matrix<T> m(rows, cols);
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++) {
+            m(i, j) = static_cast<T>(dist(gen));
+        }
+    }
+    return m;
+}
+
+TEST(TiledMatrixTest, FilesAndTiles) {
+    TempFiles files;
+    std::string path = files.path("tiled_a.bin");
+    Matrix<float> m = randomMatrix<float>(37, 53, 1);
+    {
+        TiledMatrix<float> tiled = TiledMatrix<float>::fromMatrix(m, path, 16);
+        EXPECT_EQ(tiled.getShape(), std::make_pair(37, 53));
+        EXPECT_EQ(tiled.tileRows(), 3);
+        EXPECT_EQ(tiled.tileCols(), 4);
+    }
+    TiledMatrix<float> tiled = TiledMatrix<float>::open(path);
+    EXPECT_TRUE(tiled.toMatrix() == m);
+
+    // Edge tiles are returned without their padding
+    Matrix<float> edge = tiled.readTile(2, 3);
+    ASSERT_EQ(edge.getShape(), std::make_pair(5, 5));
+    EXPECT_EQ(edge(4, 4), m(36, 52));
+
+    Matrix<float> replacement(5, 5, 2.0f);
+    tiled.writeTile(2, 3, replacement);
+    EXPECT_EQ(tiled.toMatrix()(36, 52), 2.0f);
+    EXPECT_THROW(tiled.writeTile(0, 0, replacement), std::invalid_argument);
+    EXPECT_THROW(tiled.readTile(3, 0), std::out_of_range);
+
+    EXPECT_THROW(TiledMatrix<double>::open(path), std::runtime_error);
+    EXPECT_THROW(TiledMatrix<float>::open(files.path("missing.bin")), std::runtime_error);
+}
+
+TEST(TiledMatrixTest, DotMatchesInMemory) {
+    TempFiles files;
+    Matrix<double> a = randomMatrix<double>(45, 70, 2);
+    Matrix<double> b = randomMatrix<double>(70, 33, 3);
+    Matrix<double> expected = a.dot(b);
+    TiledMatrix<double> ta = TiledMatrix<double>::fromMatrix(a, files.path("tiled_a.bin"), 16);
+    TiledMatrix<double> tb = TiledMatrix<double>::fromMatrix(b, files.path("tiled_b.bin"), 16);
+    const std::string productPath = files.path("tiled_c.bin");
+
+    const std::size_t tileBytes = 16 * 16 * sizeof(double);
+    // 5 tiles: one output tile at a time, 8 tiles: 2 x 1 blocks, default: the whole output
+    for (std::size_t budget : {5 * tileBytes, 8 * tileBytes, DEFAULT_MEMORY_BUDGET}) {
+        TiledMatrix<double> product = ta.dot(tb, productPath, budget);
+        Matrix<double> result = product.toMatrix();
+        ASSERT_EQ(result.getShape(), expected.getShape());
+        for (int i = 0; i < 45; i++) {
+            for (int j = 0; j < 33; j++) {
+                ASSERT_NEAR(result(i, j), expected(i, j), 1e-12);
+            }
+        }
+    }
+    EXPECT_THROW(ta.dot(tb, productPath, 4 * tileBytes), std::invalid_argument);
+    EXPECT_THROW(ta.dot(ta, productPath), std::invalid_argument);
+}
+
+TEST(TiledMatrixTest, TransposeAndSums) {
+    TempFiles files;
+    Matrix<double> m = randomMatrix<double>(50, 21, 4);
+    TiledMatrix<double> tiled = TiledMatrix<double>::fromMatrix(m, files.path("tiled_a.bin"), 8);
+    TiledMatrix<double> transposed = tiled.transpose(files.path("tiled_t.bin"));
+    EXPECT_TRUE(transposed.toMatrix() == m.transpose());
+
+    for (Summation mode : {Summation::Naive, Summation::Kahan}) {
+        EXPECT_NEAR(tiled.sum(mode), m.sum(), 1e-12);
+        std::vector<double> rows = tiled.sum(0, mode);
+        std::vector<double> cols = tiled.sum(1, mode);
+        std::vector<double> expectedRows = m.sum(0);
+        std::vector<double> expectedCols = m.sum(1);
+        ASSERT_EQ(rows.size(), 50u);
+        ASSERT_EQ(cols.size(), 21u);
+        for (int i = 0; i < 50; i++) {
+            EXPECT_NEAR(rows[i], expectedRows[i], 1e-12);
+        }
+        for (int j = 0; j < 21; j++) {
+            EXPECT_NEAR(cols[j], expectedCols[j], 1e-12);
+        }
+    }
+    EXPECT_THROW(tiled.sum(Summation::Naive, 8 * 8 * sizeof(double)), std::invalid_argument);
+    EXPECT_THROW(tiled.sum(2), std::invalid_argument);
+}
@@ -0,0 +1,105 @@
+#include "gtest/gtest.h"
+#include "../triples.h"
+
+#include <fstream>
+#include <random>
+#include <utility>
+
+struct Triples {
+    std::vector<int> rows;
+    std::vector<int> cols;
+    std::vector<double> values;
+};
+
+// Many duplicates, spread over several tiles in both directions
+static Triples randomTriples(int n, int height, int width, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<int> row(0, height - 1);
+    std::uniform_int_distribution<int> col(0, width - 1);
+    std::uniform_int_distribution<int> value(-8, 8);
+    Triples t;
+    for (int k = 0; k < n; k++) {
+        t.rows.push_back(row(gen));
+        t.cols.push_back(col(gen));
+        t.values.push_back(value(gen) * 0.5);
+    }
+    return t;
+}
+
+TEST(TriplesTest, FromTriples) {
+    const int height = 150;
+    const int width = 1100;
+    Triples t = randomTriples(200000, height, width, 1);
+    for (Combine combine : {Combine::Sum, Combine::Max, Combine::Min, Combine::Last}) {
+        Matrix<double> expected(height, width);
+        Matrix<int> written(height, width);
+        for (std::size_t k = 0; k < t.values.size(); k++) {
+            double& x = expected(t.rows[k], t.cols[k]);
+            double v = t.values[k];
+            bool first = written(t.rows[k], t.cols[k])++ == 0;
+            switch (combine) {
+                case Combine::Sum: x += v; break;
+                case Combine::Max: x = first ? v : std::max(x, v); break;
+                case Combine::Min: x = first ? v : std::min(x, v); break;
+                case Combine::Last: x = v; break;
+            }
+        }
+        Matrix<double> m = Matrix<double>::fromTriples(t.rows, t.cols, t.values, {height, width}, combine);
+        EXPECT_TRUE(m == expected);
+    }
+
+    t.cols[123] = width;
+    EXPECT_THROW(Matrix<double>::fromTriples(t.rows, t.cols, t.values, {height, width}), std::out_of_range);
+    t.values.pop_back();
+    EXPECT_THROW(Matrix<double>::fromTriples(t.rows, t.cols, t.values, {height, width}), std::invalid_argument);
+}
+
+TEST(TriplesTest, Builder) {
+    Triples t = randomTriples(30000, 70, 600, 2);
+    Matrix<double> expected = Matrix<double>::fromTriples(t.rows, t.cols, t.values, {70, 600}, Combine::Last);
+
+    // Batches of 1000 records: the order of the records is kept across batches
+    TripletBuilder<double> builder(70, 600, Combine::Last, 1000);
+    for (int k = 0; k < 10000; k++) {
+        builder.add(t.rows[k], t.cols[k], t.values[k]);
+    }
+    builder.add(std::vector<int>(t.rows.begin() + 10000, t.rows.begin() + 12000),
+                std::vector<int>(t.cols.begin() + 10000, t.cols.begin() + 12000),
+                std::vector<double>(t.values.begin() + 10000, t.values.begin() + 12000));
+    std::vector<std::tuple<int, int, double>> tuples;
+    for (std::size_t k = 12000; k < t.values.size(); k++) {
+        tuples.emplace_back(t.rows[k], t.cols[k], t.values[k]);
+    }
+    builder.add(tuples.begin(), tuples.end());
+    EXPECT_TRUE(builder.build() == expected);
+    EXPECT_EQ(builder.build().sum(), 0.0);
+
+    // Pairs count as 1, from an iterator or a file
+    std::string path = testing::TempDir() + "pairs.txt";
+    std::vector<std::pair<int, int>> pairs;
+    {
+        std::ofstream out(path);
+        for (int k = 0; k < 5000; k++) {
+            pairs.emplace_back(t.rows[k], t.cols[k]);
+            out << t.rows[k] << (k % 2 ? "\t" : " ") << t.cols[k] << (k % 3 ? "\n" : " 1\r\n");
+        }
+        out << "\n3 4 2";
+    }
+    TripletBuilder<int> counts(70, 600);
+    counts.add(pairs.begin(), pairs.end());
+    Matrix<int> fromPairs = counts.build();
+    EXPECT_EQ(fromPairs.sum(), 5000);
+    TripletBuilder<int> fromFile(70, 600);
+    fromFile.addFile(path);
+    Matrix<int> read = fromFile.build();
+    read(3, 4) -= 2;
+    EXPECT_TRUE(read == fromPairs);
+
+    {
+        std::ofstream out(path);
+        out << "1 2\n3 x\n";
+    }
+    EXPECT_THROW(fromFile.addFile(path), std::runtime_error);
+    EXPECT_THROW(fromFile.addFile(testing::TempDir() + "missing.txt"), std::runtime_error);
+    EXPECT_THROW(builder.add(70, 0, 1.0); builder.build(), std::out_of_range);
+}
@@ -0,0 +1,100 @@
+//
+// Number formatting and parsing helpers used by the Matrix text output.
+//
+
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <system_error>
+#include <type_traits>
+
+#include "half.h"
+
+#ifndef TEXTIO_H
+#define TEXTIO_H
+
+namespace textio {
+
+// Large enough for any element written by formatValue
+constexpr std::size_t MAX_CHARS = 64;
+
+/*
+ * Write value in [first, last) and return the end of the written characters
+ * A negative precision writes the shortest representation that reads back
+ * to the same value, otherwise the output matches std::ostream with the
+ * given precision (%g).
+ */
+template<typename T>
+inline char* formatValue(char* first, char* last, const T& value, int precision) {
+    if constexpr (std::is_integral<T>::value) {
+        return std::to_chars(first, last, value).ptr;
+    } else if constexpr (std::is_floating_point<T>::value) {
+        if (precision < 0) {
+            return std::to_chars(first, last, value).ptr;
+        }
+        return std::to_chars(first, last, value, std::chars_format::general, precision).ptr;
+    } else if constexpr (IsComplex<T>::value) {
+        // re+imj, like Python and NumPy
+        first = formatValue(first, last, value.real(), precision);
+        if (!std::signbit(value.imag()) && first < last) {
+            *first++ = '+';
+        }
+        first = formatValue(first, last, value.imag(), precision);
+        if (first < last) {
+            *first++ = 'j';
+        }
+        return first;
+    } else {
+        return formatValue(first, last, static_cast<float>(value), precision);
+    }
+}
+
+/*
+ * Parse a value from [first, last), leading spaces are skipped
+ * Return the end of the parsed characters, or nullptr on error.
+ */
+template<typename T>
+inline const char* parseValue(const char* first, const char* last, T& value) {
+    while (first < last && *first == ' ') {
+        ++first;
+    }
+    if (first < last && *first == '+') {
+        ++first;
+        // from_chars reads the '-' itself, "+-5" would pass as -5
+        if (first < last && *first == '-') {
+            return nullptr;
+        }
+    }
+    if constexpr (std::is_arithmetic<T>::value) {
+        auto res = std::from_chars(first, last, value);
+        return res.ec == std::errc() ? res.ptr : nullptr;
+    } else if constexpr (IsComplex<T>::value) {
+        // re, imj or re+imj
+        typename T::value_type re = 0;
+        typename T::value_type im = 0;
+        const char* end = parseValue(first, last, re);
+        if (end != nullptr && end < last && *end == 'j') {
+            value = T(0, re);
+            return end + 1;
+        }
+        if (end != nullptr && end < last && (*end == '+' || *end == '-')) {
+            end = parseValue(end, last, im);
+            if (end == nullptr || end == last || *end != 'j') {
+                return nullptr;
+            }
+            ++end;
+        }
+        value = T(re, im);
+        return end;
+    } else {
+        float f = 0;
+        auto res = std::from_chars(first, last, f);
+        value = static_cast<T>(f);
+        return res.ec == std::errc() ? res.ptr : nullptr;
+    }
+}
+
+} // namespace textio
+
+
+#endif // TEXTIO_H
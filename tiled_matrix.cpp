@@ -0,0 +1,536 @@
+//
+// Disk-backed matrices stored by tiles, with out-of-core products and reductions.
+//
+
+#include "tiled_matrix.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <future>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Rows of a B tile used together by the tile product, they stay in L2 while
+// every row of the output tile is updated
+static const int K_BLOCK = 128;
+
+// File header, padded to HEADER_BYTES
+static const char MAGIC[8] = {'M', 'T', 'I', 'L', 'E', 'D', '0', '1'};
+static const std::size_t HEADER_BYTES = 64;
+
+namespace {
+
+struct Header {
+    char magic[8];
+    uint32_t elementSize;
+    int32_t rows;
+    int32_t cols;
+    int32_t tile;
+};
+
+/*
+ * Double buffer over a sequence of steps
+ * load(step, buffer) fills the buffer of a step. next() returns the buffer
+ * of the next step and starts reading the following one in the background,
+ * so the returned buffer is valid until the following call. Errors of a
+ * load are rethrown by next().
+ */
+template<typename T>
+class Prefetcher {
+public:
+    using Load = std::function<void(std::size_t step, T* buffer)>;
+
+    Prefetcher(std::size_t steps, std::size_t elements, Load load)
+        : load_(std::move(load)), steps_(steps), buffers_{std::vector<T>(elements), std::vector<T>(elements)} {
+        if (steps_ > 0) {
+            start(0);
+        }
+    }
+
+    Prefetcher(const Prefetcher&) = delete;
+    Prefetcher& operator=(const Prefetcher&) = delete;
+
+    ~Prefetcher() {
+        if (pending_.valid()) {
+            pending_.wait();
+        }
+    }
+
+    T* next() {
+        pending_.get();
+        T* current = buffers_[step_ % 2].data();
+        step_++;
+        if (step_ < steps_) {
+            start(step_);
+        }
+        return current;
+    }
+
+private:
+    void start(std::size_t step) {
+        pending_ = std::async(std::launch::async, [this, step]() { load_(step, buffers_[step % 2].data()); });
+    }
+
+    Load load_;
+    std::size_t steps_;
+    std::size_t step_ = 0;
+    std::vector<T> buffers_[2];
+    std::future<void> pending_;
+};
+
+} // namespace
+
+
+static void readFully(int fd, void* data, std::size_t size, off_t offset, const std::string& path) {
+    char* p = static_cast<char*>(data);
+    while (size > 0) {
+        ssize_t n = ::pread(fd, p, size, offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            throw std::runtime_error("Cannot read " + path + ".");
+        }
+        p += n;
+        size -= static_cast<std::size_t>(n);
+        offset += n;
+    }
+}
+
+static void writeFully(int fd, const void* data, std::size_t size, off_t offset, const std::string& path) {
+    const char* p = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t n = ::pwrite(fd, p, size, offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            throw std::runtime_error("Cannot write " + path + ".");
+        }
+        p += n;
+        size -= static_cast<std::size_t>(n);
+        offset += n;
+    }
+}
+
+
+/*
+ * Construction and files
+ */
+
+template<typename T>
+TiledMatrix<T>::TiledMatrix(TiledMatrix<T>&& m) noexcept
+    : path_(std::move(m.path_)), fd_(m.fd_), height_(m.height_), width_(m.width_), tile_(m.tile_) {
+    m.fd_ = -1;
+}
+
+template<typename T>
+TiledMatrix<T>& TiledMatrix<T>::operator=(TiledMatrix<T>&& m) noexcept {
+    if (this != &m) {
+        close();
+        path_ = std::move(m.path_);
+        fd_ = m.fd_;
+        height_ = m.height_;
+        width_ = m.width_;
+        tile_ = m.tile_;
+        m.fd_ = -1;
+    }
+    return *this;
+}
+
+template<typename T>
+TiledMatrix<T>::~TiledMatrix() {
+    close();
+}
+
+template<typename T>
+void TiledMatrix<T>::close() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+template<typename T>
+TiledMatrix<T> TiledMatrix<T>::create(const std::string& filePath, int rows, int cols, int tile) {
+    if (rows < 0 || cols < 0 || tile <= 0)
+        throw std::invalid_argument("Dimensions must be positive.");
+    TiledMatrix<T> m;
+    m.fd_ = ::open(filePath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (m.fd_ < 0) {
+        throw std::runtime_error("Cannot open " + filePath + " for writing.");
+    }
+    m.path_ = filePath;
+    m.height_ = rows;
+    m.width_ = cols;
+    m.tile_ = tile;
+
+    char header[HEADER_BYTES] = {};
+    Header h{};
+    std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    h.elementSize = sizeof(T);
+    h.rows = rows;
+    h.cols = cols;
+    h.tile = tile;
+    std::memcpy(header, &h, sizeof(h));
+    writeFully(m.fd_, header, HEADER_BYTES, 0, filePath);
+    off_t size = static_cast<off_t>(HEADER_BYTES + static_cast<std::size_t>(m.tileRows()) * m.tileCols() * m.tileBytes());
+    if (::ftruncate(m.fd_, size) != 0) {
+        throw std::runtime_error("Cannot resize " + filePath + ".");
+    }
+    return m;
+}
+
+template<typename T>
+TiledMatrix<T> TiledMatrix<T>::open(const std::string& filePath) {
+    TiledMatrix<T> m;
+    m.fd_ = ::open(filePath.c_str(), O_RDWR);
+    if (m.fd_ < 0) {
+        m.fd_ = ::open(filePath.c_str(), O_RDONLY);
+    }
+    if (m.fd_ < 0) {
+        throw std::runtime_error("Cannot open " + filePath + " for reading.");
+    }
+    m.path_ = filePath;
+    Header h{};
+    readFully(m.fd_, &h, sizeof(h), 0, filePath);
+    if (std::memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0 || h.rows < 0 || h.cols < 0 || h.tile <= 0)
+        throw std::runtime_error(filePath + " is not a tiled matrix.");
+    if (h.elementSize != sizeof(T))
+        throw std::runtime_error(filePath + " has elements of " + std::to_string(h.elementSize) + " bytes.");
+    m.height_ = h.rows;
+    m.width_ = h.cols;
+    m.tile_ = h.tile;
+    struct stat st{};
+    if (::fstat(m.fd_, &st) != 0) {
+        throw std::runtime_error("Cannot stat " + filePath + ".");
+    }
+    if (static_cast<std::size_t>(st.st_size) < HEADER_BYTES + static_cast<std::size_t>(m.tileRows()) * m.tileCols() * m.tileBytes())
+        throw std::runtime_error(filePath + " is truncated.");
+    return m;
+}
+
+template<typename T>
+TiledMatrix<T> TiledMatrix<T>::fromMatrix(const Matrix<T>& m, const std::string& filePath, int tile) {
+    TiledMatrix<T> result = create(filePath, m.getHeight(), m.getWidth(), tile);
+    std::vector<T> buffer(result.tileElements());
+    for (int ti = 0; ti < result.tileRows(); ti++) {
+        for (int tj = 0; tj < result.tileCols(); tj++) {
+            std::fill(buffer.begin(), buffer.end(), T(0));
+            const int rows = std::min(tile, m.getHeight() - ti * tile);
+            const int cols = std::min(tile, m.getWidth() - tj * tile);
+            for (int i = 0; i < rows; i++) {
+                const T* row = m(ti * tile + i).data() + tj * tile;
+                std::copy(row, row + cols, buffer.data() + static_cast<std::size_t>(i) * tile);
+            }
+            result.writeRaw(ti, tj, buffer.data());
+        }
+    }
+    return result;
+}
+
+template<typename T>
+Matrix<T> TiledMatrix<T>::toMatrix() const {
+    Matrix<T> result(height_, width_);
+    std::vector<T> buffer(tileElements());
+    for (int ti = 0; ti < tileRows(); ti++) {
+        for (int tj = 0; tj < tileCols(); tj++) {
+            readRaw(ti, tj, buffer.data());
+            const int rows = std::min(tile_, height_ - ti * tile_);
+            const int cols = std::min(tile_, width_ - tj * tile_);
+            for (int i = 0; i < rows; i++) {
+                const T* row = buffer.data() + static_cast<std::size_t>(i) * tile_;
+                std::copy(row, row + cols, result(ti * tile_ + i).data() + tj * tile_);
+            }
+        }
+    }
+    return result;
+}
+
+
+/*
+ * Tiles
+ */
+
+template<typename T>
+void TiledMatrix<T>::readRaw(int ti, int tj, T* buffer) const {
+    off_t offset = static_cast<off_t>(HEADER_BYTES + (static_cast<std::size_t>(ti) * tileCols() + tj) * tileBytes());
+    readFully(fd_, buffer, tileBytes(), offset, path_);
+}
+
+template<typename T>
+void TiledMatrix<T>::writeRaw(int ti, int tj, const T* buffer) {
+    off_t offset = static_cast<off_t>(HEADER_BYTES + (static_cast<std::size_t>(ti) * tileCols() + tj) * tileBytes());
+    writeFully(fd_, buffer, tileBytes(), offset, path_);
+}
+
+template<typename T>
+Matrix<T> TiledMatrix<T>::readTile(int ti, int tj) const {
+    if (ti < 0 || tj < 0 || ti >= tileRows() || tj >= tileCols())
+        throw std::out_of_range("Tile index out of range.");
+    std::vector<T> buffer(tileElements());
+    readRaw(ti, tj, buffer.data());
+    const int rows = std::min(tile_, height_ - ti * tile_);
+    const int cols = std::min(tile_, width_ - tj * tile_);
+    Matrix<T> result(rows, cols);
+    for (int i = 0; i < rows; i++) {
+        const T* row = buffer.data() + static_cast<std::size_t>(i) * tile_;
+        std::copy(row, row + cols, result(i).data());
+    }
+    return result;
+}
+
+template<typename T>
+void TiledMatrix<T>::writeTile(int ti, int tj, const Matrix<T>& tile) {
+    if (ti < 0 || tj < 0 || ti >= tileRows() || tj >= tileCols())
+        throw std::out_of_range("Tile index out of range.");
+    const int rows = std::min(tile_, height_ - ti * tile_);
+    const int cols = std::min(tile_, width_ - tj * tile_);
+    if (tile.getShape() != std::make_pair(rows, cols))
+        throw std::invalid_argument("Tile shape does not match.");
+    // The padding stays zero
+    std::vector<T> buffer(tileElements(), T(0));
+    for (int i = 0; i < rows; i++) {
+        std::copy(tile(i).data(), tile(i).data() + cols, buffer.data() + static_cast<std::size_t>(i) * tile_);
+    }
+    writeRaw(ti, tj, buffer.data());
+}
+
+
+/*
+ * Out-of-core product
+ * The output is computed by blocks of R x S tiles held in Accumulator<T>.
+ * Step p of a block reads the R tiles A(i, p) and the S tiles B(p, j) while
+ * the previous step is computed. The zero padding of the tiles makes every
+ * product a full t x t one.
+ */
+
+// c += a * b on t x t tiles, i-k-j order by blocks of K_BLOCK rows of b
+template<typename T, typename A>
+static void multiplyAdd(const T* a, const T* b, A* c, int t) {
+    #pragma omp parallel if(static_cast<long>(t) * t * t > PARALLEL_THRESHOLD)
+    for (int k0 = 0; k0 < t; k0 += K_BLOCK) {
+        const int k1 = std::min(k0 + K_BLOCK, t);
+        #pragma omp for schedule(static)
+        for (int i = 0; i < t; i++) {
+            A* __restrict cRow = c + static_cast<std::size_t>(i) * t;
+            const T* aRow = a + static_cast<std::size_t>(i) * t;
+            for (int k = k0; k < k1; k++) {
+                const A aik = static_cast<A>(aRow[k]);
+                const T* __restrict bRow = b + static_cast<std::size_t>(k) * t;
+                for (int j = 0; j < t; j++) {
+                    cRow[j] += aik * static_cast<A>(bRow[j]);
+                }
+            }
+        }
+    }
+}
+
+template<typename T>
+TiledMatrix<T> TiledMatrix<T>::dot(const TiledMatrix<T>& m, const std::string& filePath,
+                                   std::size_t memoryBudget) const {
+    if (width_ != m.height_)
+        throw std::invalid_argument("Dot product not compatible.");
+    if (tile_ != m.tile_)
+        throw std::invalid_argument("Tile sizes must be the same.");
+    using A = typename Accumulator<T>::type;
+    const int tilesM = tileRows();
+    const int tilesK = tileCols();
+    const int tilesN = m.tileCols();
+    const std::size_t te = tileElements();
+
+    // Largest R x S output block such that the block and two sets of input tiles fit
+    auto bytes = [&](long r, long s) { return (r * s * sizeof(A) + 2 * (r + s) * sizeof(T)) * te; };
+    if (bytes(1, 1) > memoryBudget)
+        throw std::invalid_argument("Memory budget too small for the tile size.");
+    int R = 1;
+    int S = 1;
+    for (;;) {
+        const bool growR = R < tilesM && bytes(R + 1, S) <= memoryBudget;
+        const bool growS = S < tilesN && bytes(R, S + 1) <= memoryBudget;
+        if (growR && (R <= S || !growS)) {
+            R++;
+        }
+        else if (growS) {
+            S++;
+        }
+        else {
+            break;
+        }
+    }
+    MATRIX_PROFILE(Dot, height_, m.width_, static_cast<long>(height_) * width_ * m.width_, bytes(R, S));
+
+    TiledMatrix<T> result = create(filePath, height_, m.width_, tile_);
+    const int blocksN = (tilesN + S - 1) / S;
+    const int blocks = (tilesM + R - 1) / R * blocksN;
+    const std::size_t steps = static_cast<std::size_t>(blocks) * tilesK;
+    if (steps == 0) {
+        return result;
+    }
+
+    // Buffer of a step: the R tiles of A, then the S tiles of B
+    auto load = [&](std::size_t step, T* buffer) {
+        const int block = static_cast<int>(step / tilesK);
+        const int p = static_cast<int>(step % tilesK);
+        const int r0 = block / blocksN * R;
+        const int s0 = block % blocksN * S;
+        for (int r = 0; r < std::min(R, tilesM - r0); r++) {
+            readRaw(r0 + r, p, buffer + r * te);
+        }
+        for (int s = 0; s < std::min(S, tilesN - s0); s++) {
+            m.readRaw(p, s0 + s, buffer + (R + s) * te);
+        }
+    };
+    Prefetcher<T> prefetcher(steps, (R + S) * te, load);
+    std::vector<A> c(static_cast<std::size_t>(R) * S * te);
+    std::vector<T> out(te);
+    for (std::size_t step = 0; step < steps; step++) {
+        const T* buffer = prefetcher.next();
+        const int block = static_cast<int>(step / tilesK);
+        const int p = static_cast<int>(step % tilesK);
+        const int r0 = block / blocksN * R;
+        const int s0 = block % blocksN * S;
+        const int rCount = std::min(R, tilesM - r0);
+        const int sCount = std::min(S, tilesN - s0);
+        if (p == 0) {
+            std::fill(c.begin(), c.end(), A(0));
+        }
+        for (int r = 0; r < rCount; r++) {
+            for (int s = 0; s < sCount; s++) {
+                multiplyAdd(buffer + r * te, buffer + (R + s) * te, c.data() + (r * S + s) * te, tile_);
+            }
+        }
+        if (p == tilesK - 1) {
+            for (int r = 0; r < rCount; r++) {
+                for (int s = 0; s < sCount; s++) {
+                    const A* tile = c.data() + (r * S + s) * te;
+                    for (std::size_t e = 0; e < te; e++) {
+                        out[e] = static_cast<T>(tile[e]);
+                    }
+                    result.writeRaw(r0 + r, s0 + s, out.data());
+                }
+            }
+        }
+    }
+    return result;
+}
+
+
+/*
+ * Out-of-core transpose and sums
+ * Every tile is read once, in row-major order of tiles.
+ */
+
+template<typename T>
+TiledMatrix<T> TiledMatrix<T>::transpose(const std::string& filePath, std::size_t memoryBudget) const {
+    if (3 * tileBytes() > memoryBudget)
+        throw std::invalid_argument("Memory budget too small for the tile size.");
+    MATRIX_PROFILE(Transpose, height_, width_, static_cast<long>(height_) * width_, 3 * tileBytes());
+    TiledMatrix<T> result = create(filePath, width_, height_, tile_);
+    const int cols = tileCols();
+    const std::size_t steps = static_cast<std::size_t>(tileRows()) * cols;
+    Prefetcher<T> prefetcher(steps, tileElements(), [this, cols](std::size_t step, T* buffer) {
+        readRaw(static_cast<int>(step / cols), static_cast<int>(step % cols), buffer);
+    });
+    std::vector<T> out(tileElements());
+    for (std::size_t step = 0; step < steps; step++) {
+        const T* buffer = prefetcher.next();
+        for (int i = 0; i < tile_; i++) {
+            for (int j = 0; j < tile_; j++) {
+                out[static_cast<std::size_t>(j) * tile_ + i] = buffer[static_cast<std::size_t>(i) * tile_ + j];
+            }
+        }
+        result.writeRaw(static_cast<int>(step % cols), static_cast<int>(step / cols), out.data());
+    }
+    return result;
+}
+
+/*
+ * Row sums (axis 0) or column sums (axis 1) in Widened<T>
+ * Within a tile the rows are reduced with the summation policy, the partial
+ * sums of the tiles are added in Widened<T>, compensated with Kahan.
+ */
+template<typename T, typename Read>
+static std::vector<typename Widened<T>::type> tiledSums(int height, int width, int tile, int axis, Summation mode,
+                                                        Read read) {
+    using Wide = typename Widened<T>::type;
+    const int tilesM = (height + tile - 1) / tile;
+    const int tilesN = (width + tile - 1) / tile;
+    const int n = axis == 0 ? height : width;
+    std::vector<Wide> sums(n, Wide(0));
+    std::vector<Wide> comp(mode == Summation::Kahan ? n : 0, Wide(0));
+    const std::size_t steps = static_cast<std::size_t>(tilesM) * tilesN;
+    Prefetcher<T> prefetcher(steps, static_cast<std::size_t>(tile) * tile, [&read, tilesN](std::size_t step, T* buffer) {
+        read(static_cast<int>(step / tilesN), static_cast<int>(step % tilesN), buffer);
+    });
+    std::vector<Wide> partial(tile);
+    for (std::size_t step = 0; step < steps; step++) {
+        const T* buffer = prefetcher.next();
+        const int ti = static_cast<int>(step / tilesN);
+        const int tj = static_cast<int>(step % tilesN);
+        const int rows = std::min(tile, height - ti * tile);
+        const int cols = std::min(tile, width - tj * tile);
+        if (axis == 0) {
+            #pragma omp parallel for schedule(static) if(static_cast<long>(rows) * cols > PARALLEL_THRESHOLD)
+            for (int i = 0; i < rows; i++) {
+                partial[i] = reduceSum(buffer + static_cast<std::size_t>(i) * tile, cols, mode);
+            }
+        }
+        else {
+            std::fill(partial.begin(), partial.begin() + cols, Wide(0));
+            for (int i = 0; i < rows; i++) {
+                const T* row = buffer + static_cast<std::size_t>(i) * tile;
+                for (int j = 0; j < cols; j++) {
+                    partial[j] += static_cast<Wide>(row[j]);
+                }
+            }
+        }
+        const int offset = axis == 0 ? ti * tile : tj * tile;
+        const int count = axis == 0 ? rows : cols;
+        for (int x = 0; x < count; x++) {
+            if (mode == Summation::Kahan) {
+                summation::compensatedAdd(sums[offset + x], comp[offset + x], partial[x]);
+            }
+            else {
+                sums[offset + x] += partial[x];
+            }
+        }
+    }
+    for (std::size_t x = 0; x < comp.size(); x++) {
+        sums[x] += comp[x];
+    }
+    return sums;
+}
+
+template<typename T>
+T TiledMatrix<T>::sum(Summation mode, std::size_t memoryBudget) const {
+    if (2 * tileBytes() > memoryBudget)
+        throw std::invalid_argument("Memory budget too small for the tile size.");
+    MATRIX_PROFILE(Sum, height_, width_, static_cast<long>(height_) * width_, 2 * tileBytes());
+    auto read = [this](int ti, int tj, T* buffer) { readRaw(ti, tj, buffer); };
+    auto rows = tiledSums<T>(height_, width_, tile_, 0, mode, read);
+    return static_cast<T>(reduceSum(rows.data(), rows.size(), mode));
+}
+
+template<typename T>
+std::vector<T> TiledMatrix<T>::sum(int axis, Summation mode, std::size_t memoryBudget) const {
+    if (axis != 0 && axis != 1)
+        throw std::invalid_argument("Axis must be 0 or 1.");
+    if (2 * tileBytes() > memoryBudget)
+        throw std::invalid_argument("Memory budget too small for the tile size.");
+    MATRIX_PROFILE(Sum, height_, width_, static_cast<long>(height_) * width_, 2 * tileBytes());
+    auto read = [this](int ti, int tj, T* buffer) { readRaw(ti, tj, buffer); };
+    auto sums = tiledSums<T>(height_, width_, tile_, axis, mode, read);
+    return std::vector<T>(sums.begin(), sums.end());
+}
+
+
+// Explicit instantiation
+template class TiledMatrix<int>;
+template class TiledMatrix<float>;
+template class TiledMatrix<double>;
@@ -0,0 +1,101 @@
+//
+// Disk-backed matrices stored by tiles, with out-of-core products and reductions.
+//
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "matrix.h"
+
+#ifndef TILED_MATRIX_H
+#define TILED_MATRIX_H
+
+
+// Default tile size (rows and columns)
+constexpr int DEFAULT_TILE = 1024;
+// Default memory the out-of-core operations may use for their tiles
+constexpr std::size_t DEFAULT_MEMORY_BUDGET = static_cast<std::size_t>(256) << 20;
+
+/*
+ * TiledMatrix class
+ * A matrix stored in a file as a grid of tile x tile blocks, each block
+ * contiguous and row-major, blocks in row-major order after a 64-byte
+ * header. The blocks of the last row and column are padded with zeros to
+ * the full tile size, so every block has the same offset arithmetic and
+ * the kernels never special-case the edges. Elements are written in the
+ * native representation of T.
+ *
+ * Only the file descriptor is held in memory: a TiledMatrix can be far
+ * larger than RAM. Tiles are read and written with pread / pwrite, which
+ * are safe to call from several threads.
+ */
+
+template<typename T>
+class TiledMatrix {
+public:
+    TiledMatrix() = default;
+    TiledMatrix(TiledMatrix<T>&& m) noexcept;
+    TiledMatrix<T>& operator=(TiledMatrix<T>&& m) noexcept;
+    TiledMatrix(const TiledMatrix<T>& m) = delete;
+    TiledMatrix<T>& operator=(const TiledMatrix<T>& m) = delete;
+    ~TiledMatrix();
+
+    // A new file of zeros (the file is sparse until written)
+    static TiledMatrix<T> create(const std::string& filePath, int rows, int cols, int tile=DEFAULT_TILE);
+    static TiledMatrix<T> open(const std::string& filePath);
+    static TiledMatrix<T> fromMatrix(const Matrix<T>& m, const std::string& filePath, int tile=DEFAULT_TILE);
+    Matrix<T> toMatrix() const;
+
+    // Inline getters
+    [[nodiscard]] inline int getHeight() const { return height_; }
+    [[nodiscard]] inline int getWidth() const { return width_; }
+    [[nodiscard]] inline std::pair<int, int> getShape() const { return std::make_pair(height_, width_); }
+    [[nodiscard]] inline int getTile() const { return tile_; }
+    [[nodiscard]] inline int tileRows() const { return (height_ + tile_ - 1) / tile_; }
+    [[nodiscard]] inline int tileCols() const { return (width_ + tile_ - 1) / tile_; }
+    [[nodiscard]] inline const std::string& getPath() const { return path_; }
+
+    // Tile (ti, tj) without its padding: min(tile, rows left) x min(tile, columns left)
+    Matrix<T> readTile(int ti, int tj) const;
+    void writeTile(int ti, int tj, const Matrix<T>& tile);
+
+    /*
+     * Out-of-core operations
+     * Tiles are streamed through a double buffer: the tiles of the next step
+     * are read by a background thread while the current ones are computed.
+     * The tiles held in memory never exceed memoryBudget bytes, an
+     * operation whose minimal working set does not fit throws.
+     *
+     * dot keeps a block of R x S output tiles in memory and streams the R
+     * tiles of A and S tiles of B of each inner step: every tile read is
+     * used R (or S) times. R and S are the largest the budget allows,
+     * (R * S + 2 * (R + S)) tiles. Finished output tiles are written at the
+     * end of their block. Both operands must have the same tile size.
+     * sum and transpose read every tile once.
+     */
+    TiledMatrix<T> dot(const TiledMatrix<T>& m, const std::string& filePath,
+                       std::size_t memoryBudget=DEFAULT_MEMORY_BUDGET) const;
+    TiledMatrix<T> transpose(const std::string& filePath, std::size_t memoryBudget=DEFAULT_MEMORY_BUDGET) const;
+    T sum(Summation mode=Summation::Naive, std::size_t memoryBudget=DEFAULT_MEMORY_BUDGET) const;
+    std::vector<T> sum(int axis, Summation mode=Summation::Naive,
+                       std::size_t memoryBudget=DEFAULT_MEMORY_BUDGET) const;
+
+private:
+    inline std::size_t tileElements() const { return static_cast<std::size_t>(tile_) * tile_; }
+    inline std::size_t tileBytes() const { return tileElements() * sizeof(T); }
+
+    // Full padded tile, buffer holds tileElements()
+    void readRaw(int ti, int tj, T* buffer) const;
+    void writeRaw(int ti, int tj, const T* buffer);
+    void close();
+
+    std::string path_;
+    int fd_ = -1;
+    int height_ = 0;
+    int width_ = 0;
+    int tile_ = 0;
+};
+
+
+#endif // TILED_MATRIX_H
@@ -0,0 +1,372 @@
+//
+// Bulk construction of matrices from (row, col, value) triples and pair streams.
+//
+
+#include "triples.h"
+#include "textio.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <fstream>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Largest number of tiles, above it the tiles are enlarged
+static const int MAX_TILES = 1 << 14;
+// Bytes of a text file parsed at once by addFile
+static const std::size_t FILE_WINDOW = static_cast<std::size_t>(64) << 20;
+
+// Number of threads used by the parallel loops
+static inline int maxThreads() {
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+namespace {
+
+template<typename T>
+struct Record {
+    int row;
+    int col;
+    T value;
+};
+
+// Tiles of at least TRIPLES_TILE_ROWS x TRIPLES_TILE_COLS, at most MAX_TILES of them
+struct Tiling {
+    int tileRows;
+    int tileCols;
+    int rowTiles;
+    int colTiles;
+
+    Tiling(int rows, int cols) : tileRows(TRIPLES_TILE_ROWS), tileCols(TRIPLES_TILE_COLS) {
+        update(rows, cols);
+        while (static_cast<long>(rowTiles) * colTiles > MAX_TILES) {
+            if (colTiles >= rowTiles) {
+                tileCols *= 2;
+            }
+            else {
+                tileRows *= 2;
+            }
+            update(rows, cols);
+        }
+    }
+    void update(int rows, int cols) {
+        rowTiles = std::max(1, (rows + tileRows - 1) / tileRows);
+        colTiles = std::max(1, (cols + tileCols - 1) / tileCols);
+    }
+    inline int tile(int row, int col) const { return row / tileRows * colTiles + col / tileCols; }
+    inline int count() const { return rowTiles * colTiles; }
+};
+
+/*
+ * Partition then apply (see triples.h)
+ * seen holds one bit per element, rows padded to whole words so that two
+ * tiles never share a word. It is only used by Max, Min and Last.
+ */
+template<typename T>
+void applyTriples(Matrix<T>& m, std::vector<uint64_t>& seen, const int* rows, const int* cols, const T* values,
+                  std::size_t n, Combine combine) {
+    if (n == 0) {
+        return;
+    }
+    MATRIX_PROFILE(Compound, m.getHeight(), m.getWidth(), static_cast<long>(n), sizeof(Record<T>) * n);
+    const int height = m.getHeight();
+    const int width = m.getWidth();
+    const Tiling tiling(height, width);
+    const int tiles = tiling.count();
+    const int chunks = static_cast<long>(n) > PARALLEL_THRESHOLD ? maxThreads() : 1;
+    const std::size_t chunkSize = (n + chunks - 1) / chunks;
+
+    // Pass 1: histogram of every chunk, indices are checked here
+    std::vector<std::size_t> offsets(static_cast<std::size_t>(chunks) * tiles + 1, 0);
+    bool inBounds = true;
+    #pragma omp parallel for schedule(static, 1) reduction(&&:inBounds) if(chunks > 1)
+    for (int c = 0; c < chunks; c++) {
+        // Column c of the tile-major table: tile t of chunk c is at t * chunks + c
+        const std::size_t first = c * chunkSize;
+        const std::size_t last = std::min(n, first + chunkSize);
+        std::vector<std::size_t> counts(tiles, 0);
+        for (std::size_t k = first; k < last; k++) {
+            if (rows[k] < 0 || rows[k] >= height || cols[k] < 0 || cols[k] >= width) {
+                inBounds = false;
+                break;
+            }
+            counts[tiling.tile(rows[k], cols[k])]++;
+        }
+        for (int t = 0; t < tiles; t++) {
+            offsets[static_cast<std::size_t>(t) * chunks + c + 1] = counts[t];
+        }
+    }
+    if (!inBounds)
+        throw std::out_of_range("Index out of bounds.");
+    for (std::size_t x = 1; x < offsets.size(); x++) {
+        offsets[x] += offsets[x - 1];
+    }
+
+    // Pass 2: every chunk copies its records to their tiles, in input order
+    std::vector<Record<T>> sorted(n);
+    #pragma omp parallel for schedule(static, 1) if(chunks > 1)
+    for (int c = 0; c < chunks; c++) {
+        const std::size_t first = c * chunkSize;
+        const std::size_t last = std::min(n, first + chunkSize);
+        std::vector<std::size_t> next(tiles);
+        for (int t = 0; t < tiles; t++) {
+            next[t] = offsets[static_cast<std::size_t>(t) * chunks + c];
+        }
+        for (std::size_t k = first; k < last; k++) {
+            sorted[next[tiling.tile(rows[k], cols[k])]++] = Record<T>{rows[k], cols[k], values[k]};
+        }
+    }
+
+    // Pass 3: every tile is written by one thread (see Matrix::detach)
+    m.detach();
+    std::vector<T*> out(height);
+    for (int i = 0; i < height; i++) {
+        out[i] = m(i).data();
+    }
+    const std::size_t words = (static_cast<std::size_t>(width) + 63) / 64;
+    #pragma omp parallel for schedule(dynamic) if(chunks > 1)
+    for (int t = 0; t < tiles; t++) {
+        const std::size_t first = offsets[static_cast<std::size_t>(t) * chunks];
+        const std::size_t last = offsets[static_cast<std::size_t>(t + 1) * chunks];
+        if (combine == Combine::Sum) {
+            for (std::size_t k = first; k < last; k++) {
+                out[sorted[k].row][sorted[k].col] += sorted[k].value;
+            }
+            continue;
+        }
+        for (std::size_t k = first; k < last; k++) {
+            const Record<T>& r = sorted[k];
+            uint64_t& word = seen[r.row * words + r.col / 64];
+            const uint64_t bit = static_cast<uint64_t>(1) << (r.col % 64);
+            T& x = out[r.row][r.col];
+            if (!(word & bit) || combine == Combine::Last) {
+                x = r.value;
+                word |= bit;
+            }
+            else if (combine == Combine::Max ? x < r.value : r.value < x) {
+                x = r.value;
+            }
+        }
+    }
+}
+
+} // namespace
+
+
+/*
+ * Matrix::fromTriples
+ */
+
+template<typename T>
+Matrix<T> Matrix<T>::fromTriples(const std::vector<int>& rows, const std::vector<int>& cols,
+                                 const std::vector<T>& values, std::pair<int, int> shape, Combine combine) {
+    if (rows.size() != cols.size() || rows.size() != values.size())
+        throw std::invalid_argument("Rows, columns and values must have the same size.");
+    if (shape.first < 0 || shape.second < 0)
+        throw std::invalid_argument("Dimensions must be positive.");
+    Matrix<T> result(shape.first, shape.second);
+    std::vector<uint64_t> seen;
+    if (combine != Combine::Sum) {
+        seen.resize(static_cast<std::size_t>(shape.first) * ((shape.second + 63) / 64), 0);
+    }
+    applyTriples(result, seen, rows.data(), cols.data(), values.data(), values.size(), combine);
+    return result;
+}
+
+
+/*
+ * TripletBuilder
+ */
+
+template<typename T>
+TripletBuilder<T>::TripletBuilder(int rows, int cols, Combine combine, std::size_t batch)
+    : combine_(combine), batch_(std::max<std::size_t>(batch, 1)) {
+    if (rows < 0 || cols < 0)
+        throw std::invalid_argument("Dimensions must be positive.");
+    matrix_ = Matrix<T>(rows, cols);
+    if (combine != Combine::Sum) {
+        seen_.resize(static_cast<std::size_t>(rows) * ((cols + 63) / 64), 0);
+    }
+    rows_.reserve(batch_);
+    cols_.reserve(batch_);
+    values_.reserve(batch_);
+}
+
+// On error the batch is dropped, the matrix keeps the previous batches
+template<typename T>
+void TripletBuilder<T>::flush() {
+    auto clear = [this]() {
+        rows_.clear();
+        cols_.clear();
+        values_.clear();
+    };
+    try {
+        applyTriples(matrix_, seen_, rows_.data(), cols_.data(), values_.data(), values_.size(), combine_);
+    } catch (...) {
+        clear();
+        throw;
+    }
+    clear();
+}
+
+template<typename T>
+void TripletBuilder<T>::add(const std::vector<int>& rows, const std::vector<int>& cols, const std::vector<T>& values) {
+    if (rows.size() != cols.size() || rows.size() != values.size())
+        throw std::invalid_argument("Rows, columns and values must have the same size.");
+    // Large arrays are applied directly, without going through the buffer
+    if (rows.size() >= batch_) {
+        flush();
+        applyTriples(matrix_, seen_, rows.data(), cols.data(), values.data(), values.size(), combine_);
+        return;
+    }
+    rows_.insert(rows_.end(), rows.begin(), rows.end());
+    cols_.insert(cols_.end(), cols.begin(), cols.end());
+    values_.insert(values_.end(), values.begin(), values.end());
+    if (rows_.size() >= batch_) {
+        flush();
+    }
+}
+
+template<typename T>
+Matrix<T> TripletBuilder<T>::build() {
+    flush();
+    Matrix<T> result = std::move(matrix_);
+    matrix_ = Matrix<T>(result.getHeight(), result.getWidth());
+    std::fill(seen_.begin(), seen_.end(), 0);
+    return result;
+}
+
+// Length of a line without its line ending
+static inline const char* lineEnd(const char* begin, const char* end) {
+    const char* eol = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+    if (eol == nullptr) {
+        eol = end;
+    }
+    if (eol > begin && eol[-1] == '\r') {
+        --eol;
+    }
+    return eol;
+}
+
+static inline const char* skipBlanks(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        ++p;
+    }
+    return p;
+}
+
+/*
+ * Text files are read by windows of FILE_WINDOW bytes cut at a line end.
+ * Each window is split in chunks of whole lines parsed in parallel, the
+ * records of the window are then added in the order of the file.
+ */
+template<typename T>
+void TripletBuilder<T>::addFile(const std::string& filePath) {
+    std::ifstream in(filePath, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Cannot open " + filePath + " for reading.");
+    }
+    const int nChunks = std::max(1, 4 * maxThreads());
+    std::vector<std::vector<int>> chunkRows(nChunks);
+    std::vector<std::vector<int>> chunkCols(nChunks);
+    std::vector<std::vector<T>> chunkValues(nChunks);
+    std::vector<std::exception_ptr> errors(nChunks);
+    std::vector<char> window(FILE_WINDOW);
+    std::size_t carried = 0;
+    while (true) {
+        in.read(window.data() + carried, static_cast<std::streamsize>(window.size() - carried));
+        const std::size_t size = carried + static_cast<std::size_t>(in.gcount());
+        if (size == 0) {
+            break;
+        }
+        const char* text = window.data();
+        const char* textEnd = text + size;
+        // Lines cut by the end of the window are carried to the next one
+        if (in) {
+            const char* p = textEnd;
+            while (p > text && p[-1] != '\n') {
+                --p;
+            }
+            if (p == text)
+                throw std::runtime_error("Line longer than the read window in " + filePath + ".");
+            textEnd = p;
+        }
+
+        std::vector<const char*> bounds(nChunks + 1, textEnd);
+        bounds[0] = text;
+        for (int c = 1; c < nChunks; c++) {
+            const char* p = std::max(bounds[c - 1], text + (textEnd - text) / nChunks * c);
+            const char* eol = p < textEnd ? static_cast<const char*>(std::memchr(p, '\n', textEnd - p)) : nullptr;
+            bounds[c] = eol == nullptr ? textEnd : eol + 1;
+        }
+        #pragma omp parallel for schedule(dynamic)
+        for (int c = 0; c < nChunks; c++) {
+            chunkRows[c].clear();
+            chunkCols[c].clear();
+            chunkValues[c].clear();
+            try {
+                for (const char* p = bounds[c]; p < bounds[c + 1];) {
+                    const char* eol = lineEnd(p, bounds[c + 1]);
+                    const char* field = skipBlanks(p, eol);
+                    if (field < eol) {
+                        int row = 0;
+                        int col = 0;
+                        T value = T(1);
+                        const char* end = textio::parseValue(field, eol, row);
+                        end = end == nullptr ? nullptr : textio::parseValue(skipBlanks(end, eol), eol, col);
+                        if (end != nullptr) {
+                            end = skipBlanks(end, eol);
+                            if (end < eol) {
+                                end = textio::parseValue(end, eol, value);
+                                end = end == nullptr ? nullptr : skipBlanks(end, eol);
+                            }
+                        }
+                        if (end != eol) {
+                            throw std::runtime_error("Invalid record in " + filePath + ": " + std::string(p, eol));
+                        }
+                        chunkRows[c].push_back(row);
+                        chunkCols[c].push_back(col);
+                        chunkValues[c].push_back(value);
+                    }
+                    const char* next = static_cast<const char*>(std::memchr(eol, '\n', bounds[c + 1] - eol));
+                    p = next == nullptr ? bounds[c + 1] : next + 1;
+                }
+            } catch (...) {
+                errors[c] = std::current_exception();
+            }
+        }
+        for (int c = 0; c < nChunks; c++) {
+            if (errors[c]) {
+                std::rethrow_exception(errors[c]);
+            }
+        }
+        for (int c = 0; c < nChunks; c++) {
+            add(chunkRows[c], chunkCols[c], chunkValues[c]);
+        }
+
+        carried = static_cast<std::size_t>(text + size - textEnd);
+        std::memmove(window.data(), textEnd, carried);
+        if (!in && carried == 0) {
+            break;
+        }
+    }
+}
+
+
+// Explicit instantiation
+#define TRIPLES_INSTANTIATE(T) \
+    template Matrix<T> Matrix<T>::fromTriples(const std::vector<int>& rows, const std::vector<int>& cols, \
+                                              const std::vector<T>& values, std::pair<int, int> shape, \
+                                              Combine combine); \
+    template class TripletBuilder<T>;
+
+TRIPLES_INSTANTIATE(int)
+TRIPLES_INSTANTIATE(float)
+TRIPLES_INSTANTIATE(double)
@@ -0,0 +1,94 @@
+//
+// Bulk construction of matrices from (row, col, value) triples and pair streams.
+//
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "matrix.h"
+
+#ifndef TRIPLES_H
+#define TRIPLES_H
+
+
+// Tile of the radix partition, the writes of one bucket stay in a tile of this many rows and columns
+constexpr int TRIPLES_TILE_ROWS = 64;
+constexpr int TRIPLES_TILE_COLS = 2048;
+// Records buffered by TripletBuilder before they are written to the matrix
+constexpr std::size_t DEFAULT_TRIPLES_BATCH = static_cast<std::size_t>(1) << 22;
+
+/*
+ * Triples are written in two passes instead of one random write each:
+ * 1. partition: the records are split in one chunk per thread, every
+ *    thread counts the records of its chunk per tile, then copies them to
+ *    their tile (a one-digit radix sort on the tile index, stable).
+ * 2. apply: the tiles are spread over the threads, each tile written by
+ *    one thread only, so no atomics, and its writes stay in cache.
+ * Large matrices use larger tiles so that the per-thread histograms stay
+ * small. Indices are checked before anything is written.
+ *
+ * Matrix<T>::fromTriples builds a matrix from whole arrays (see matrix.h).
+ * TripletBuilder takes the records by batches of any size: single
+ * records, arrays, iterator ranges or text files. They are buffered and
+ * written every `batch` records, memory stays bounded whatever the size
+ * of the input. With Combine::Max, Min or Last the builder keeps one bit
+ * per element to know whether it was already written.
+ */
+
+template<typename T>
+class TripletBuilder {
+public:
+    TripletBuilder(int rows, int cols, Combine combine=Combine::Sum, std::size_t batch=DEFAULT_TRIPLES_BATCH);
+
+    inline void add(int row, int col, T value) {
+        rows_.push_back(row);
+        cols_.push_back(col);
+        values_.push_back(value);
+        if (rows_.size() >= batch_) {
+            flush();
+        }
+    }
+    void add(const std::vector<int>& rows, const std::vector<int>& cols, const std::vector<T>& values);
+    // Elements are (row, col, value) tuples, or (row, col) pairs counted as a value of 1
+    template<typename Iterator> void add(Iterator first, Iterator last);
+    // Text file with one "row col [value]" record per line, separated by spaces or tabs, value 1 if missing
+    void addFile(const std::string& filePath);
+
+    // The matrix of every record added so far, the builder starts over empty
+    Matrix<T> build();
+
+    [[nodiscard]] inline std::pair<int, int> getShape() const { return matrix_.getShape(); }
+
+private:
+    void flush();
+
+    Matrix<T> matrix_;
+    std::vector<uint64_t> seen_;
+    std::vector<int> rows_;
+    std::vector<int> cols_;
+    std::vector<T> values_;
+    Combine combine_;
+    std::size_t batch_;
+};
+
+template<typename T>
+template<typename Iterator>
+void TripletBuilder<T>::add(Iterator first, Iterator last) {
+    using Record = typename std::iterator_traits<Iterator>::value_type;
+    for (; first != last; ++first) {
+        const Record& record = *first;
+        if constexpr (std::tuple_size<Record>::value == 2) {
+            add(std::get<0>(record), std::get<1>(record), T(1));
+        }
+        else {
+            add(std::get<0>(record), std::get<1>(record), static_cast<T>(std::get<2>(record)));
+        }
+    }
+}
+
+
+#endif // TRIPLES_H